@@ -29,7 +29,11 @@ macro(POPPLER_ADD_UNITTEST exe build_flag)
   endif(NOT build_test)
 
   add_executable(${exe} ${_add_executable_param} ${ARGN})
-  add_test(${exe} ${EXECUTABLE_OUTPUT_PATH}/${exe})
+  if(EXECUTABLE_OUTPUT_PATH)
+    add_test(${exe} ${EXECUTABLE_OUTPUT_PATH}/${exe})
+  else(EXECUTABLE_OUTPUT_PATH)
+    add_test(${exe} ${CMAKE_CURRENT_BINARY_DIR}/${exe})
+  endif(EXECUTABLE_OUTPUT_PATH)
 
   # if the tests are EXCLUDE_FROM_ALL, add a target "buildtests" to build all tests
   if(NOT build_test)
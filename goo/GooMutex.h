@@ -75,8 +75,9 @@ inline void gInitMutex(GooMutex *m) {
 
 class MutexLocker {
 public:
-  MutexLocker(GooMutex *mutexA) : mutex(mutexA) { gLockMutex(mutex); }
-  ~MutexLocker() { gUnlockMutex(mutex); }
+  MutexLocker(GooMutex *mutexA, bool lockA = true)
+    : mutex(lockA ? mutexA : NULL) { if (mutex) gLockMutex(mutex); }
+  ~MutexLocker() { if (mutex) gUnlockMutex(mutex); }
 
 private:
   GooMutex *mutex;
@@ -34,6 +34,7 @@
 #include "goo/gmem.h"
 #include "Object.h"
 #include "Array.h"
+#include "ObjectArena.h"
 
 #if MULTITHREADED
 #  define arrayLocker()   MutexLocker locker(&mutex)
@@ -47,6 +48,7 @@
 Array::Array(XRef *xrefA) {
   xref = xrefA;
   elems = NULL;
+  arena = NULL;
   size = length = 0;
   ref = 1;
 #if MULTITHREADED
@@ -54,12 +56,41 @@ Array::Array(XRef *xrefA) {
 #endif
 }
 
+Array::Array(XRef *xrefA, ObjectArena *arenaA) {
+  xref = xrefA;
+  elems = NULL;
+  arena = arenaA;
+  size = length = 0;
+  ref = 1;
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
+}
+
+void *Array::operator new(size_t size) {
+  return ObjectArena::allocObject(size, NULL);
+}
+
+void *Array::operator new(size_t size, ObjectArena *arenaA) {
+  return ObjectArena::allocObject(size, arenaA);
+}
+
+void Array::operator delete(void *p) {
+  ObjectArena::freeObject(p);
+}
+
+void Array::operator delete(void *p, ObjectArena * /*arenaA*/) {
+  ObjectArena::freeObject(p);
+}
+
 Array::~Array() {
   int i;
 
   for (i = 0; i < length; ++i)
     elems[i].free();
-  gfree(elems);
+  if (!arena) {
+    gfree(elems);
+  }
 #if MULTITHREADED
   gDestroyMutex(&mutex);
 #endif
@@ -89,13 +120,26 @@ int Array::decRef() {
 
 void Array::add(Object *elem) {
   arrayLocker();
+  if (arena && !arena->isOpen()) {
+    // the arena no longer allows allocations
+    Object *elemsA = (Object *)gmallocn(size, sizeof(Object));
+    memcpy(elemsA, elems, length * sizeof(Object));
+    elems = elemsA;
+    arena = NULL;
+  }
   if (length == size) {
     if (length == 0) {
       size = 8;
     } else {
       size *= 2;
     }
-    elems = (Object *)greallocn(elems, size, sizeof(Object));
+    if (arena) {
+      Object *elemsA = (Object *)arena->alloc(size * sizeof(Object));
+      memcpy(elemsA, elems, length * sizeof(Object));
+      elems = elemsA;
+    } else {
+      elems = (Object *)greallocn(elems, size, sizeof(Object));
+    }
   }
   elems[length] = *elem;
   ++length;
@@ -34,6 +34,7 @@
 #include "goo/GooMutex.h"
 
 class XRef;
+class ObjectArena;
 
 //------------------------------------------------------------------------
 // Array
@@ -45,9 +46,19 @@ public:
   // Constructor.
   Array(XRef *xrefA);
 
+  // Create an array whose element table, like the array itself, is
+  // allocated from <arenaA>, which must not have been released yet.
+  // Use as 'new (arena) Array(xref, arena)'.
+  Array(XRef *xrefA, ObjectArena *arenaA);
+
   // Destructor.
   ~Array();
 
+  static void *operator new(size_t size);
+  static void *operator new(size_t size, ObjectArena *arenaA);
+  static void operator delete(void *p);
+  static void operator delete(void *p, ObjectArena *arenaA);
+
   // Reference counting.
   int incRef();
   int decRef();
@@ -73,6 +84,7 @@ private:
 
   XRef *xref;			// the xref table for this PDF file
   Object *elems;		// array of elements
+  ObjectArena *arena;		// arena holding <elems>, or NULL
   int size;			// size of <elems> array
   int length;			// number of elements in array
   int ref;			// reference count
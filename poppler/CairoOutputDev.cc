@@ -2802,24 +2802,18 @@ cleanup:
 
 GBool CairoOutputDev::getStreamData (Stream *str, char **buffer, int *length)
 {
-  int len, i;
-  char *strBuffer;
+  int len;
+  Guchar *strBuffer;
 
-  len = 0;
   str->close();
-  str->reset();
-  while (str->getChar() != EOF) len++;
-  if (len == 0)
-    return gFalse;
-
-  strBuffer = (char *)gmalloc (len);
-
+  strBuffer = str->toUnsignedChars(&len);
   str->close();
-  str->reset();
-  for (i = 0; i < len; ++i)
-    strBuffer[i] = str->getChar();
+  if (len == 0) {
+    gfree(strBuffer);
+    return gFalse;
+  }
 
-  *buffer = strBuffer;
+  *buffer = (char *)strBuffer;
   *length = len;
 
   return gTrue;
@@ -46,6 +46,7 @@
 
 #include <stddef.h>
 #include <stdlib.h>
+#include <algorithm>
 #include "goo/gmem.h"
 #include "Object.h"
 #include "PDFDoc.h"
@@ -68,6 +69,56 @@
 #else
 #  define catalogLocker()
 #endif
+
+//------------------------------------------------------------------------
+// PageTreeNode
+//------------------------------------------------------------------------
+
+// An intermediate node of the page tree, with the number of pages
+// before each of its kids, taken from the /Count entries.  Nodes are
+// built the first time a page below them is requested, so a page can be
+// found without walking the tree from the first page.
+class PageTreeNode {
+public:
+
+  PageTreeNode(int nKidsA);
+  ~PageTreeNode();
+
+  int nKids;
+  Ref *kids;			// object ID of each kid
+  int *firstPage;		// number of pages before each kid, and the
+				//   total in firstPage[nKids]
+  GBool *leaf;			// true if the kid is a page
+  PageTreeNode **kidNodes;	// intermediate kids, built on demand
+  PageAttrs *attrs;		// attributes inherited by the kids, built
+				//   when the first page below is created
+};
+
+PageTreeNode::PageTreeNode(int nKidsA) {
+  nKids = nKidsA;
+  kids = (Ref *)gmallocn(nKids, sizeof(Ref));
+  firstPage = (int *)gmallocn(nKids + 1, sizeof(int));
+  leaf = (GBool *)gmallocn(nKids, sizeof(GBool));
+  kidNodes = (PageTreeNode **)gmallocn(nKids, sizeof(PageTreeNode *));
+  attrs = NULL;
+  firstPage[0] = 0;
+  for (int i = 0; i < nKids; ++i) {
+    leaf[i] = gFalse;
+    kidNodes[i] = NULL;
+  }
+}
+
+PageTreeNode::~PageTreeNode() {
+  for (int i = 0; i < nKids; ++i) {
+    delete kidNodes[i];
+  }
+  gfree(kids);
+  gfree(firstPage);
+  gfree(leaf);
+  gfree(kidNodes);
+  delete attrs;
+}
+
 //------------------------------------------------------------------------
 // Catalog
 //------------------------------------------------------------------------
@@ -85,6 +136,11 @@ Catalog::Catalog(PDFDoc *docA) {
   xref = doc->getXRef();
   pages = NULL;
   pageRefs = NULL;
+  pagesRef.num = pagesRef.gen = -1;
+  pageTree = NULL;
+  pageTreeOk = gTrue;
+  pageRefOrder = NULL;
+  stalePages = NULL;
   numPages = -1;
   pagesSize = 0;
   baseURI = NULL;
@@ -147,6 +203,8 @@ Catalog::Catalog(PDFDoc *docA) {
 }
 
 Catalog::~Catalog() {
+  delete pageTree;
+  gfree(pageRefOrder);
   delete kidsIdxList;
   if (attrsList) {
     std::vector<PageAttrs *>::iterator it;
@@ -174,6 +232,12 @@ Catalog::~Catalog() {
     gfree(pages);
   }
   gfree(pageRefs);
+  if (stalePages) {
+    for (size_t i = 0; i < stalePages->size(); ++i) {
+      delete (*stalePages)[i];
+    }
+    delete stalePages;
+  }
   names.free();
   dests.free();
   delete destNameTree;
@@ -220,7 +284,7 @@ GooString *Catalog::readMetadata() {
     return NULL;
   }
   dict = metadata.streamGetDict();
-  if (!dict->lookup("Subtype", &obj)->isName("XML")) {
+  if (!dict->lookup(atomSubtype, &obj)->isName("XML")) {
     error(errSyntaxWarning, -1, "Unknown Metadata type: '{0:s}'",
 	  obj.isName() ? obj.getName() : "???");
   }
@@ -236,11 +300,14 @@ Page *Catalog::getPage(int i)
   if (i < 1) return NULL;
 
   catalogLocker();
-  if (i > lastCachedPage) {
-     GBool cached = cachePageTree(i);
-     if ( cached == gFalse) {
-       return NULL;
-     }
+  if (!initPageCache() || i > pagesSize) {
+    return NULL;
+  }
+  if (!pages[i-1] && (!pageTreeOk || !indexPageTree(i, gTrue))) {
+    dropPageTreeIndex();
+    if (!cachePageTree(i)) {
+      return NULL;
+    }
   }
   return pages[i-1];
 }
@@ -250,48 +317,116 @@ Ref *Catalog::getPageRef(int i)
   if (i < 1) return NULL;
 
   catalogLocker();
-  if (i > lastCachedPage) {
-     GBool cached = cachePageTree(i);
-     if ( cached == gFalse) {
-       return NULL;
-     }
+  if (!initPageCache() || i > pagesSize) {
+    return NULL;
+  }
+  if (pageRefs[i-1].num < 0 && (!pageTreeOk || !indexPageTree(i, gFalse))) {
+    dropPageTreeIndex();
+    if (!cachePageTree(i)) {
+      return NULL;
+    }
   }
   return &pageRefs[i-1];
 }
 
-GBool Catalog::cachePageTree(int page)
+PageAttrs *Catalog::getPageAttrs(int i, Ref *ref)
 {
-  Dict *pagesDict;
-
-  if (pagesList == NULL) {
+  PageAttrs *attrs;
 
-    Object catDict;
-    Ref pagesRef;
+  if (i < 1) return NULL;
 
-    xref->getCatalog(&catDict);
+  catalogLocker();
+  if (!initPageCache() || i > pagesSize || !pageTreeOk) {
+    return NULL;
+  }
+  attrs = NULL;
+  if (!indexPageTree(i, gFalse, &attrs)) {
+    dropPageTreeIndex();
+    return NULL;
+  }
+  *ref = pageRefs[i-1];
+  return attrs;
+}
 
-    if (catDict.isDict()) {
-      Object pagesDictRef;
-      if (catDict.dictLookupNF("Pages", &pagesDictRef)->isRef() &&
-          pagesDictRef.getRefNum() >= 0 &&
-          pagesDictRef.getRefNum() < xref->getNumObjects()) {
-        pagesRef = pagesDictRef.getRef();
-        pagesDictRef.free();
-      } else {
-        error(errSyntaxError, -1, "Catalog dictionary does not contain a valid \"Pages\" entry");
-        pagesDictRef.free();
-        catDict.free();
-        return gFalse;
-      }
-    } else {
-      error(errSyntaxError, -1, "Could not find catalog dictionary");
-      catDict.free();
-      return gFalse;
+void Catalog::setPageRefs(Ref *refs, int n)
+{
+  catalogLocker();
+  if (!initPageCache()) {
+    return;
+  }
+  if (n > pagesSize) {
+    n = pagesSize;
+  }
+  for (int i = 0; i < n; ++i) {
+    if (refs[i].num >= 0 && pageRefs[i].num < 0) {
+      pageRefs[i] = refs[i];
     }
+  }
+}
 
-    Object obj;
-    catDict.dictLookup("Pages", &obj);
+GBool Catalog::initPageCache()
+{
+  Object catDict, pagesDictRef;
+
+  if (pages) {
+    return gTrue;
+  }
+  // this also sets up the cache if the top-level pages object is a
+  // single page
+  if (getNumPages() == 0) {
+    return gFalse;
+  }
+  if (pages) {
+    return gTrue;
+  }
+
+  xref->getCatalog(&catDict);
+  if (!catDict.isDict()) {
+    error(errSyntaxError, -1, "Could not find catalog dictionary");
+    catDict.free();
+    return gFalse;
+  }
+  if (catDict.dictLookupNF(atomPages, &pagesDictRef)->isRef() &&
+      pagesDictRef.getRefNum() >= 0 &&
+      pagesDictRef.getRefNum() < xref->getNumObjects()) {
+    pagesRef = pagesDictRef.getRef();
+  } else {
+    error(errSyntaxError, -1, "Catalog dictionary does not contain a valid \"Pages\" entry");
+    pagesDictRef.free();
     catDict.free();
+    return gFalse;
+  }
+  pagesDictRef.free();
+  catDict.free();
+
+  pagesSize = numPages;
+  pages = (Page **)gmallocn_checkoverflow(pagesSize, sizeof(Page *));
+  pageRefs = (Ref *)gmallocn_checkoverflow(pagesSize, sizeof(Ref));
+  if (pages == NULL || pageRefs == NULL ) {
+    error(errSyntaxError, -1, "Cannot allocate page cache");
+    gfree(pages);
+    gfree(pageRefs);
+    pages = NULL;
+    pageRefs = NULL;
+    pagesSize = 0;
+    return gFalse;
+  }
+  for (int i = 0; i < pagesSize; ++i) {
+    pages[i] = NULL;
+    pageRefs[i].num = -1;
+    pageRefs[i].gen = -1;
+  }
+  return gTrue;
+}
+
+GBool Catalog::cachePageTree(int page)
+{
+  Dict *pagesDict;
+
+  if (pagesList == NULL) {
+
+    Object obj;
+    xref->fetch(pagesRef.num, pagesRef.gen, &obj);
     // This should really be isDict("Pages"), but I've seen at least one
     // PDF file where the /Type entry is missing.
     if (obj.isDict()) {
@@ -305,21 +440,6 @@ GBool Catalog::cachePageTree(int page)
       return gFalse;
     }
 
-    pagesSize = getNumPages();
-    pages = (Page **)gmallocn_checkoverflow(pagesSize, sizeof(Page *));
-    pageRefs = (Ref *)gmallocn_checkoverflow(pagesSize, sizeof(Ref));
-    if (pages == NULL || pageRefs == NULL ) {
-      error(errSyntaxError, -1, "Cannot allocate page cache");
-      pagesDict->decRef();
-      pagesSize = 0;
-      return gFalse;
-    }
-    for (int i = 0; i < pagesSize; ++i) {
-      pages[i] = NULL;
-      pageRefs[i].num = -1;
-      pageRefs[i].gen = -1;
-    }
-
     pagesList = new std::vector<Dict *>();
     pagesList->push_back(pagesDict);
     pagesRefList = new std::vector<Ref>();
@@ -340,7 +460,7 @@ GBool Catalog::cachePageTree(int page)
 
     pagesDict = pagesList->back();
     Object kids;
-    pagesDict->lookup("Kids", &kids);
+    pagesDict->lookup(atomKids, &kids);
     if (!kids.isArray()) {
       error(errSyntaxError, -1, "Kids object (page {0:d}) is wrong type ({1:s})",
             lastCachedPage+1, kids.getTypeName());
@@ -391,7 +511,14 @@ GBool Catalog::cachePageTree(int page)
     Object kid;
     kids.arrayGet(kidsIdx, &kid);
     kids.free();
-    if (kid.isDict("Page") || (kid.isDict() && !kid.getDict()->hasKey("Kids"))) {
+    if (kid.isDict("Page") || (kid.isDict() && !kid.getDict()->hasKey(atomKids))) {
+      if (lastCachedPage >= numPages) {
+        error(errSyntaxError, -1, "Page count in top-level pages object is incorrect");
+        kidRef.free();
+        kid.free();
+        return gFalse;
+      }
+
       PageAttrs *attrs = new PageAttrs(attrsList->back(), kid.getDict());
       Page *p = new Page(doc, lastCachedPage+1, kid.getDict(),
                      kidRef.getRef(), attrs, form);
@@ -403,13 +530,6 @@ GBool Catalog::cachePageTree(int page)
         return gFalse;
       }
 
-      if (lastCachedPage >= numPages) {
-        error(errSyntaxError, -1, "Page count in top-level pages object is incorrect");
-        kidRef.free();
-        kid.free();
-        return gFalse;
-      }
-
       pages[lastCachedPage] = p;
       pageRefs[lastCachedPage].num = kidRef.getRefNum();
       pageRefs[lastCachedPage].gen = kidRef.getRefGen();
@@ -438,13 +558,286 @@ GBool Catalog::cachePageTree(int page)
   return gFalse;
 }
 
+// Stop using the page tree index, for good.  The pages and object IDs
+// it found are forgotten, past the ones the sequential walk already went
+// through: a kid with a wrong /Count makes the index put the pages after
+// it at other numbers than the walk, and mixing both would put a page at
+// two numbers.  The Pages may have been handed out, so they are kept
+// until the Catalog is deleted.
+void Catalog::dropPageTreeIndex()
+{
+  if (!pageTreeOk) {
+    return;
+  }
+  pageTreeOk = gFalse;
+  for (int i = lastCachedPage; i < pagesSize; ++i) {
+    if (pages[i]) {
+      if (!stalePages) {
+	stalePages = new std::vector<Page *>();
+      }
+      stalePages->push_back(pages[i]);
+      pages[i] = NULL;
+    }
+    pageRefs[i].num = -1;
+    pageRefs[i].gen = -1;
+  }
+  gfree(pageRefOrder);
+  pageRefOrder = NULL;
+}
+
+// Build the index of an intermediate node of the page tree.  Returns
+// NULL if the node has no usable /Kids or /Count entry, or if the
+// counts of its kids don't add up to its own.
+PageTreeNode *Catalog::buildPageTreeNode(Ref ref, Dict *dict)
+{
+  PageTreeNode *node;
+  Object obj, kids, kidRef, kid;
+  int count, n;
+
+  // some PDF files actually use real numbers here ("/Count 9.0")
+  if (!dict->lookup(atomCount, &obj)->isNum() ||
+      obj.getNum() < 0 || obj.getNum() > numPages) {
+    obj.free();
+    return NULL;
+  }
+  count = (int)obj.getNum();
+  obj.free();
+  if (!dict->lookup(atomKids, &kids)->isArray()) {
+    kids.free();
+    return NULL;
+  }
+
+  node = new PageTreeNode(kids.arrayGetLength());
+  for (int i = 0; i < node->nKids; ++i) {
+    if (!kids.arrayGetNF(i, &kidRef)->isRef() ||
+	kidRef.getRefNum() == ref.num) {
+      kidRef.free();
+      kids.free();
+      delete node;
+      return NULL;
+    }
+    node->kids[i] = kidRef.getRef();
+    kidRef.free();
+
+    // kids that are neither pages nor page tree nodes contain no pages
+    n = 0;
+    kids.arrayGet(i, &kid);
+    if (kid.isDict("Page") || (kid.isDict() && !kid.getDict()->hasKey(atomKids))) {
+      node->leaf[i] = gTrue;
+      n = 1;
+    } else if (kid.isDict()) {
+      if (!kid.dictLookup(atomCount, &obj)->isNum() ||
+	  obj.getNum() < 0 || obj.getNum() > count) {
+	obj.free();
+	kid.free();
+	kids.free();
+	delete node;
+	return NULL;
+      }
+      n = (int)obj.getNum();
+      obj.free();
+      // a node that claims no pages is never descended into, so it
+      // must not have any: the sequential walk would find them
+      if (n == 0 && kid.dictLookup(atomKids, &obj)->isArray() &&
+	  obj.arrayGetLength() > 0) {
+	obj.free();
+	kid.free();
+	kids.free();
+	delete node;
+	return NULL;
+      }
+      obj.free();
+    }
+    kid.free();
+
+    node->firstPage[i + 1] = node->firstPage[i] + n;
+    if (node->firstPage[i + 1] > count) {
+      kids.free();
+      delete node;
+      return NULL;
+    }
+  }
+  kids.free();
+
+  if (node->firstPage[node->nKids] != count) {
+    delete node;
+    return NULL;
+  }
+  return node;
+}
+
+// Find page <page> by descending the page tree index through the kids
+// that contain it.  Sets its entry in pageRefs, and creates the Page if
+// <makePage> is set, or only its attributes if <pageAttrs> is not NULL.
+// Returns false if the page tree doesn't match its /Count entries, in
+// which case the caller falls back to cachePageTree().
+GBool Catalog::indexPageTree(int page, GBool makePage, PageAttrs **pageAttrs)
+{
+  PageTreeNode *node, *kidNode;
+  std::vector<int> path;
+  Object obj, kid;
+  GBool needAttrs;
+  int idx, lo, hi, mid;
+
+  needAttrs = makePage || pageAttrs;
+
+  // the node dictionaries are only fetched to build the index and the
+  // inherited attributes, which are kept: refetching a node with many
+  // kids for every page would make a flat page tree quadratic
+  if (pagesRef.num < 0) {
+    return gFalse;
+  }
+  if (!pageTree || (needAttrs && !pageTree->attrs)) {
+    if (!xref->fetch(pagesRef.num, pagesRef.gen, &obj)->isDict()) {
+      obj.free();
+      return gFalse;
+    }
+    if (!pageTree &&
+	(!(pageTree = buildPageTreeNode(pagesRef, obj.getDict())) ||
+	 pageTree->firstPage[pageTree->nKids] != numPages)) {
+      obj.free();
+      return gFalse;
+    }
+    if (needAttrs && !pageTree->attrs) {
+      pageTree->attrs = new PageAttrs(NULL, obj.getDict());
+    }
+    obj.free();
+  }
+  path.push_back(pagesRef.num);
+
+  node = pageTree;
+  idx = page - 1;
+  while (1) {
+    // find the kid with firstPage[i] <= idx < firstPage[i+1]
+    lo = 0;
+    hi = node->nKids - 1;
+    while (lo < hi) {
+      mid = (lo + hi) / 2;
+      if (node->firstPage[mid + 1] > idx) {
+	hi = mid;
+      } else {
+	lo = mid + 1;
+      }
+    }
+    Ref kidRef = node->kids[lo];
+    for (size_t i = 0; i < path.size(); ++i) {
+      if (path[i] == kidRef.num) {
+	return gFalse;
+      }
+    }
+
+    if (node->leaf[lo]) {
+      pageRefs[page-1] = kidRef;
+      if (makePage) {
+	if (xref->fetch(kidRef.num, kidRef.gen, &kid)->isDict()) {
+	  PageAttrs *attrs = new PageAttrs(node->attrs, kid.getDict());
+	  Page *p = new Page(doc, page, kid.getDict(), kidRef, attrs, form);
+	  if (p->isOk()) {
+	    pages[page-1] = p;
+	  } else {
+	    error(errSyntaxError, -1, "Failed to create page (page {0:d})", page);
+	    delete p;
+	  }
+	}
+	kid.free();
+      } else if (pageAttrs) {
+	if (!xref->fetch(kidRef.num, kidRef.gen, &kid)->isDict()) {
+	  kid.free();
+	  return gFalse;
+	}
+	*pageAttrs = new PageAttrs(node->attrs, kid.getDict());
+	(*pageAttrs)->clipBoxes();
+	kid.free();
+      }
+      return gTrue;
+    }
+
+    kidNode = node->kidNodes[lo];
+    if (!kidNode || (needAttrs && !kidNode->attrs)) {
+      if (!xref->fetch(kidRef.num, kidRef.gen, &kid)->isDict()) {
+	kid.free();
+	return gFalse;
+      }
+      if (!kidNode &&
+	  !(kidNode = node->kidNodes[lo] =
+	      buildPageTreeNode(kidRef, kid.getDict()))) {
+	kid.free();
+	return gFalse;
+      }
+      if (needAttrs && !kidNode->attrs) {
+	kidNode->attrs = new PageAttrs(node->attrs, kid.getDict());
+      }
+      kid.free();
+    }
+    path.push_back(kidRef.num);
+    idx -= node->firstPage[lo];
+    node = kidNode;
+  }
+}
+
+struct PageRefCmp {
+  PageRefCmp(Ref *refsA): refs(refsA) {}
+  bool operator()(int a, int b) {
+    if (refs[a].num != refs[b].num) {
+      return refs[a].num < refs[b].num;
+    }
+    if (refs[a].gen != refs[b].gen) {
+      return refs[a].gen < refs[b].gen;
+    }
+    return a < b;
+  }
+  Ref *refs;
+};
+
+// Fill in the object IDs of all pages from the page tree index, without
+// creating the pages, and sort them for findPage().
+GBool Catalog::buildPageRefOrder()
+{
+  if (!initPageCache()) {
+    return gFalse;
+  }
+  for (int i = 0; i < pagesSize; ++i) {
+    if (pageRefs[i].num < 0 && (!pageTreeOk || !indexPageTree(i + 1, gFalse))) {
+      dropPageTreeIndex();
+      return gFalse;
+    }
+  }
+  pageRefOrder = (int *)gmallocn(pagesSize, sizeof(int));
+  for (int i = 0; i < pagesSize; ++i) {
+    pageRefOrder[i] = i;
+  }
+  std::sort(pageRefOrder, pageRefOrder + pagesSize, PageRefCmp(pageRefs));
+  return gTrue;
+}
+
 int Catalog::findPage(int num, int gen) {
-  int i;
+  int i, lo, hi, mid;
 
-  for (i = 0; i < getNumPages(); ++i) {
-    Ref *ref = getPageRef(i+1);
-    if (ref != NULL && ref->num == num && ref->gen == gen)
-      return i + 1;
+  catalogLocker();
+  if (!pageRefOrder && !buildPageRefOrder()) {
+    for (i = 0; i < getNumPages(); ++i) {
+      Ref *ref = getPageRef(i+1);
+      if (ref != NULL && ref->num == num && ref->gen == gen)
+	return i + 1;
+    }
+    return 0;
+  }
+
+  // find the first page with this object ID
+  lo = 0;
+  hi = pagesSize;
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    Ref *ref = &pageRefs[pageRefOrder[mid]];
+    if (ref->num < num || (ref->num == num && ref->gen < gen)) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo < pagesSize && pageRefs[pageRefOrder[lo]].num == num &&
+      pageRefs[pageRefOrder[lo]].gen == gen) {
+    return pageRefOrder[lo] + 1;
   }
   return 0;
 }
@@ -711,7 +1104,7 @@ void NameTree::parse(Object *tree) {
   names.free();
 
   // root or intermediate node
-  if (tree->dictLookup("Kids", &kids)->isArray()) {
+  if (tree->dictLookup(atomKids, &kids)->isArray()) {
     for (i = 0; i < kids.arrayGetLength(); ++i) {
       if (kids.arrayGet(i, &kid)->isDict())
 	parse(&kid);
@@ -813,7 +1206,7 @@ int Catalog::getNumPages()
       catDict.free();
       return 0;
     }
-    catDict.dictLookup("Pages", &pagesDict);
+    catDict.dictLookup(atomPages, &pagesDict);
 
     // This should really be isDict("Pages"), but I've seen at least one
     // PDF file where the /Type entry is missing.
@@ -825,12 +1218,12 @@ int Catalog::getNumPages()
       return 0;
     }
 
-    pagesDict.dictLookup("Count", &obj);
+    pagesDict.dictLookup(atomCount, &obj);
     // some PDF files actually use real numbers here ("/Count 9.0")
     if (!obj.isNum()) {
       if (pagesDict.dictIs("Page")) {
 	Object pageRootRef;
-	catDict.dictLookupNF("Pages", &pageRootRef);
+	catDict.dictLookupNF(atomPages, &pageRootRef);
 
 	error(errSyntaxError, -1, "Pages top-level is a single Page. The document is malformed, trying to recover...");
 
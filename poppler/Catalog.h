@@ -49,6 +49,7 @@ class XRef;
 class Object;
 class Page;
 class PageAttrs;
+class PageTreeNode;
 struct Ref;
 class LinkDest;
 class LinkAction;
@@ -121,6 +122,17 @@ public:
   // Get the reference for a page object.
   Ref *getPageRef(int i);
 
+  // Get the attributes of page <i>, inherited ones included, and its
+  // object ID, without creating the Page.  Returns NULL if the page
+  // tree doesn't match its /Count entries; use getPage() then.  The
+  // caller owns the returned PageAttrs.
+  PageAttrs *getPageAttrs(int i, Ref *ref);
+
+  // Set the object IDs of the first <n> pages, e.g. from a DocIndex, so
+  // that getPageRef() and findPage() don't walk the page tree.  Entries
+  // with a negative object number are skipped.
+  void setPageRefs(Ref *refs, int n);
+
   // Return base URI, or NULL if none.
   GooString *getBaseURI() { return baseURI; }
 
@@ -228,6 +240,14 @@ private:
   XRef *xref;			// the xref table for this PDF file
   Page **pages;			// array of pages
   Ref *pageRefs;		// object ID for each page
+  Ref pagesRef;			// top-level Pages object
+  PageTreeNode *pageTree;	// page tree index, built on demand
+  GBool pageTreeOk;		// false if the page tree index can't be used
+  int *pageRefOrder;		// page indices sorted by object ID, for
+				//   findPage
+  std::vector<Page *> *stalePages;	// pages found with the page tree
+				//   index, dropped when it turned out
+				//   to be unusable
   int lastCachedPage;
   std::vector<Dict *> *pagesList;
   std::vector<Ref> *pagesRefList;
@@ -256,7 +276,13 @@ private:
   PageLayout pageLayout;	// page layout
   Object additionalActions;     // page additional actions
 
+  GBool initPageCache();
   GBool cachePageTree(int page); // Cache first <page> pages.
+  GBool indexPageTree(int page, GBool makePage,
+		      PageAttrs **pageAttrs = NULL);
+  void dropPageTreeIndex();
+  PageTreeNode *buildPageTreeNode(Ref ref, Dict *dict);
+  GBool buildPageRefOrder();
   Object *findDestInTree(Object *tree, GooString *name, Object *obj);
 
   Object *getNames();
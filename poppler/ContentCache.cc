@@ -0,0 +1,460 @@
+//========================================================================
+//
+// ContentCache.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <string.h>
+#include "goo/gmem.h"
+#include "goo/GooString.h"
+#include "NameAtoms.h"
+#include "ContentCache.h"
+
+//------------------------------------------------------------------------
+
+// token tags
+enum {
+  tokEOF,
+  tokInt8,			// int, 1 byte
+  tokInt,			// int, 4 bytes
+  tokInt64,			// long long, 8 bytes
+  tokFloat,			// real that fits in a float, 4 bytes
+  tokReal,			// double, 8 bytes
+  tokTrue,
+  tokFalse,
+  tokNull,
+  tokError,
+  tokNameAtom,			// interned name, 1 byte index in atoms
+  tokCmdAtom,			// interned command, 1 byte index in atoms
+  tokName,			// interned name, pointer
+  tokCmd,			// interned command, pointer
+  tokNameChars,			// other name: int length, chars
+  tokCmdChars,			// other command: int length, chars
+  tokString			// int length, chars
+};
+
+// recordings start with this many bytes and double when full
+#define contentTokensMinSize 256
+
+// size of the table of names and commands referenced by index, and of
+// the hash table used to fill it
+#define contentTokensMaxAtoms 256
+#define contentTokensAtomHashSize 512
+
+//------------------------------------------------------------------------
+// ContentTokens
+//------------------------------------------------------------------------
+
+ContentTokens::ContentTokens(int maxSizeA) {
+  data = NULL;
+  len = size = 0;
+  maxSize = maxSizeA;
+  atoms = NULL;
+  nAtoms = 0;
+  atomHash = NULL;
+  complete = spoiled = gFalse;
+  refCnt = 1;
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
+}
+
+ContentTokens::~ContentTokens() {
+  gfree(data);
+  gfree(atoms);
+  gfree(atomHash);
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
+}
+
+// Return room for <n> more bytes at the end of the data, or NULL if that
+// would exceed the size limit.
+Guchar *ContentTokens::grow(int n) {
+  Guchar *p;
+
+  if (n > maxSize - len) {
+    spoil();
+    return NULL;
+  }
+  if (len + n > size) {
+    size = size ? size : contentTokensMinSize;
+    while (len + n > size) {
+      size = size > maxSize / 2 ? maxSize : 2 * size;
+    }
+    data = (Guchar *)grealloc(data, size);
+  }
+  p = data + len;
+  len += n;
+  return p;
+}
+
+// Return the index of <atom> in the atoms table, adding it if needed, or
+// -1 if the table is full.
+int ContentTokens::getAtomIdx(const char *atom) {
+  Guint h;
+  int i;
+
+  if (!atomHash) {
+    atoms = (const char **)gmallocn(contentTokensMaxAtoms,
+				    sizeof(const char *));
+    atomHash = (int *)gmallocn(contentTokensAtomHashSize, sizeof(int));
+    memset(atomHash, 0, contentTokensAtomHashSize * sizeof(int));
+  }
+  h = NameAtoms::getHash(atom) & (contentTokensAtomHashSize - 1);
+  while ((i = atomHash[h])) {
+    if (atoms[i - 1] == atom) {
+      return i - 1;
+    }
+    h = (h + 1) & (contentTokensAtomHashSize - 1);
+  }
+  if (nAtoms == contentTokensMaxAtoms) {
+    return -1;
+  }
+  atoms[nAtoms] = atom;
+  atomHash[h] = ++nAtoms;
+  return nAtoms - 1;
+}
+
+void ContentTokens::add(Object *obj) {
+  Guchar *p;
+  const char *s;
+  long long ll;
+  double x;
+  float f;
+  int i, n;
+
+  if (complete || spoiled) {
+    return;
+  }
+  switch (obj->getType()) {
+  case objInt:
+    i = obj->getInt();
+    if (i >= -128 && i < 128) {
+      if ((p = grow(2))) {
+	p[0] = tokInt8;
+	p[1] = (Guchar)(signed char)i;
+      }
+    } else if ((p = grow(1 + sizeof(int)))) {
+      p[0] = tokInt;
+      memcpy(p + 1, &i, sizeof(int));
+    }
+    break;
+  case objInt64:
+    ll = obj->getInt64();
+    if ((p = grow(1 + sizeof(long long)))) {
+      p[0] = tokInt64;
+      memcpy(p + 1, &ll, sizeof(long long));
+    }
+    break;
+  case objReal:
+    x = obj->getReal();
+    f = (float)x;
+    if ((double)f == x) {
+      if ((p = grow(1 + sizeof(float)))) {
+	p[0] = tokFloat;
+	memcpy(p + 1, &f, sizeof(float));
+      }
+    } else if ((p = grow(1 + sizeof(double)))) {
+      p[0] = tokReal;
+      memcpy(p + 1, &x, sizeof(double));
+    }
+    break;
+  case objBool:
+    if ((p = grow(1))) {
+      p[0] = obj->getBool() ? tokTrue : tokFalse;
+    }
+    break;
+  case objNull:
+    if ((p = grow(1))) {
+      p[0] = tokNull;
+    }
+    break;
+  case objError:
+    if ((p = grow(1))) {
+      p[0] = tokError;
+    }
+    break;
+  case objName:
+  case objCmd:
+    s = obj->isName() ? obj->getName() : obj->getCmd();
+    if (NameAtoms::isInterned(s) && (i = getAtomIdx(s)) >= 0) {
+      if ((p = grow(2))) {
+	p[0] = obj->isName() ? tokNameAtom : tokCmdAtom;
+	p[1] = (Guchar)i;
+      }
+    } else if (NameAtoms::isInterned(s)) {
+      if ((p = grow(1 + sizeof(const char *)))) {
+	p[0] = obj->isName() ? tokName : tokCmd;
+	memcpy(p + 1, &s, sizeof(const char *));
+      }
+    } else {
+      n = NameAtoms::getLength(s);
+      if ((p = grow(1 + sizeof(int) + n))) {
+	p[0] = obj->isName() ? tokNameChars : tokCmdChars;
+	memcpy(p + 1, &n, sizeof(int));
+	memcpy(p + 1 + sizeof(int), s, n);
+      }
+    }
+    break;
+  case objString:
+    n = obj->getString()->getLength();
+    if ((p = grow(1 + sizeof(int) + n))) {
+      p[0] = tokString;
+      memcpy(p + 1, &n, sizeof(int));
+      memcpy(p + 1 + sizeof(int), obj->getString()->getCString(), n);
+    }
+    break;
+  case objEOF:
+    if ((p = grow(1))) {
+      p[0] = tokEOF;
+      complete = gTrue;
+      // the recording won't grow any more
+      data = (Guchar *)grealloc(data, len);
+      size = len;
+      atoms = (const char **)greallocn(atoms, nAtoms, sizeof(const char *));
+      gfree(atomHash);
+      atomHash = NULL;
+    }
+    break;
+  default:
+    // the Lexer doesn't return any other kind of object
+    spoil();
+    break;
+  }
+}
+
+void ContentTokens::spoil() {
+  spoiled = gTrue;
+  gfree(data);
+  data = NULL;
+  len = size = 0;
+  gfree(atoms);
+  atoms = NULL;
+  nAtoms = 0;
+  gfree(atomHash);
+  atomHash = NULL;
+}
+
+Object *ContentTokens::read(int *pos, Object *obj) {
+  const Guchar *p;
+  const char *s;
+  long long ll;
+  double x;
+  float f;
+  int tag, i, n;
+
+  if (*pos >= len) {
+    return obj->initEOF();
+  }
+  p = data + *pos;
+  switch (tag = *p++) {
+  case tokInt8:
+    obj->initInt((signed char)*p++);
+    break;
+  case tokInt:
+    memcpy(&i, p, sizeof(int));
+    p += sizeof(int);
+    obj->initInt(i);
+    break;
+  case tokInt64:
+    memcpy(&ll, p, sizeof(long long));
+    p += sizeof(long long);
+    obj->initInt64(ll);
+    break;
+  case tokFloat:
+    memcpy(&f, p, sizeof(float));
+    p += sizeof(float);
+    obj->initReal(f);
+    break;
+  case tokReal:
+    memcpy(&x, p, sizeof(double));
+    p += sizeof(double);
+    obj->initReal(x);
+    break;
+  case tokTrue:
+    obj->initBool(gTrue);
+    break;
+  case tokFalse:
+    obj->initBool(gFalse);
+    break;
+  case tokNull:
+    obj->initNull();
+    break;
+  case tokError:
+    obj->initError();
+    break;
+  case tokNameAtom:
+    obj->initNameAtom(atoms[*p++]);
+    break;
+  case tokCmdAtom:
+    obj->initCmdAtom(atoms[*p++]);
+    break;
+  case tokName:
+  case tokCmd:
+    memcpy(&s, p, sizeof(const char *));
+    if (tag == tokName) {
+      obj->initNameAtom(s);
+    } else {
+      obj->initCmdAtom(s);
+    }
+    p += sizeof(const char *);
+    break;
+  case tokNameChars:
+  case tokCmdChars:
+  case tokString:
+    memcpy(&n, p, sizeof(int));
+    p += sizeof(int);
+    if (tag == tokNameChars) {
+      obj->initName((const char *)p, n);
+    } else if (tag == tokCmdChars) {
+      obj->initCmd((const char *)p, n);
+    } else {
+      obj->initString(new GooString((const char *)p, n));
+    }
+    p += n;
+    break;
+  case tokEOF:
+  default:
+    obj->initEOF();
+    break;
+  }
+  *pos = (int)(p - data);
+  return obj;
+}
+
+void ContentTokens::incRef() {
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  ++refCnt;
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+}
+
+void ContentTokens::decRef() {
+  GBool done;
+
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  done = --refCnt == 0;
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+  if (done) {
+    delete this;
+  }
+}
+
+//------------------------------------------------------------------------
+// ContentCacheItem
+//------------------------------------------------------------------------
+
+class ContentCacheItem {
+public:
+
+  ContentCacheItem(ContentTokens *tokensA): tokens(tokensA) {}
+  ~ContentCacheItem() { tokens->decRef(); }
+
+  ContentTokens *tokens;
+};
+
+//------------------------------------------------------------------------
+// ContentCache
+//------------------------------------------------------------------------
+
+ContentCache::ContentCache(Goffset maxBytesA) {
+  maxBytes = maxBytesA;
+  cache = new PopplerCache<PopplerCacheRefKey, ContentCacheItem>(0, maxBytes);
+  refCnt = 1;
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
+}
+
+ContentCache::~ContentCache() {
+  delete cache;
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
+}
+
+ContentTokens *ContentCache::lookup(const Ref &ref) {
+  ContentCacheItem *item;
+
+#if MULTITHREADED
+  MutexLocker locker(&mutex);
+#endif
+  if (!(item = cache->lookup(ref))) {
+    return NULL;
+  }
+  item->tokens->incRef();
+  return item->tokens;
+}
+
+ContentTokens *ContentCache::startRecording() {
+  // a single recording may use half of the budget, so that one large
+  // page doesn't keep pushing everything else out
+  return new ContentTokens(maxBytes / 2 < 0x7fffffff ? (int)(maxBytes / 2)
+		                                     : 0x7fffffff);
+}
+
+void ContentCache::put(const Ref &ref, ContentTokens *tokens) {
+  if (!tokens->isComplete()) {
+    tokens->decRef();
+    return;
+  }
+#if MULTITHREADED
+  MutexLocker locker(&mutex);
+#endif
+  cache->put(ref, new ContentCacheItem(tokens), tokens->getSize());
+}
+
+void ContentCache::clear() {
+#if MULTITHREADED
+  MutexLocker locker(&mutex);
+#endif
+  cache->clear();
+}
+
+void ContentCache::getStats(PopplerCacheStats *stats) {
+#if MULTITHREADED
+  MutexLocker locker(&mutex);
+#endif
+  cache->getStats(stats);
+}
+
+void ContentCache::incRef() {
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  ++refCnt;
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+}
+
+void ContentCache::decRef() {
+  GBool done;
+
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  done = --refCnt == 0;
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+  if (done) {
+    delete this;
+  }
+}
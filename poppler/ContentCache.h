@@ -0,0 +1,142 @@
+//========================================================================
+//
+// ContentCache.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef CONTENTCACHE_H
+#define CONTENTCACHE_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include "poppler-config.h"
+#include "goo/gtypes.h"
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
+#include "Object.h"
+#include "PopplerCache.h"
+
+class ContentCacheItem;
+
+//------------------------------------------------------------------------
+// ContentTokens
+//
+// The tokens of a content stream, as returned by Lexer::getObj(), in a
+// compact buffer: numbers are stored in binary, names and operators as
+// one-byte indexes into a table of their NameAtoms entries, and strings
+// inline.  A Lexer
+// replaying them gives the Parser the same objects as the stream
+// itself, without decompressing or lexing it again.
+//
+// A recording is only usable once the Lexer has reached the end of the
+// stream.  It is spoiled if anything reads the raw data of the stream
+// (inline images), which the tokens can't reproduce, or if it grows
+// beyond its size limit.
+//
+// The tokens are reference counted, so that a cache can drop them while
+// another thread is still replaying them.
+//------------------------------------------------------------------------
+
+class ContentTokens {
+public:
+
+  // Create an empty recording of at most <maxSizeA> bytes.
+  ContentTokens(int maxSizeA);
+
+  // Append <obj>, which must be a token returned by the Lexer.  An EOF
+  // token completes the recording.
+  void add(Object *obj);
+
+  // Mark the recording as unusable.
+  void spoil();
+
+  // Return true if the recording is complete and not spoiled.
+  GBool isComplete() { return complete && !spoiled; }
+
+  // Size of the tokens, in bytes.
+  int getSize() { return len + nAtoms * (int)sizeof(const char *); }
+
+  // Get the token at *<pos> and advance *<pos> to the next one.  Returns
+  // EOF at the end of the tokens.
+  Object *read(int *pos, Object *obj);
+
+  void incRef();
+  void decRef();
+
+private:
+
+  ~ContentTokens();
+  Guchar *grow(int n);
+  int getAtomIdx(const char *atom);
+  void freeRecordingData();
+
+  Guchar *data;
+  int len;			// bytes used in <data>
+  int size;			// bytes allocated for <data>
+  int maxSize;
+  const char **atoms;		// the distinct interned names and
+				//   operators, up to contentTokensMaxAtoms
+  int nAtoms;
+  int *atomHash;		// open addressing hash table mapping
+				//   names to 1 + their index in <atoms>,
+				//   while recording
+  GBool complete;
+  GBool spoiled;
+  int refCnt;
+#if MULTITHREADED
+  GooMutex mutex;
+#endif
+};
+
+//------------------------------------------------------------------------
+// ContentCache
+//
+// Keeps the ContentTokens of recently displayed page contents and form
+// XObjects of a document, keyed by the object ID of the page or form,
+// within a budget of bytes (GlobalParams::setContentCacheSize).  The
+// cache is owned by the document's XRef, and shared with its copies.
+//------------------------------------------------------------------------
+
+class ContentCache {
+public:
+
+  ContentCache(Goffset maxBytesA);
+
+  // Return the complete recording for <ref>, with a new reference, or
+  // NULL.
+  ContentTokens *lookup(const Ref &ref);
+
+  // Start a recording within the size limit of the cache, to be passed
+  // to put() once the stream has been read.
+  ContentTokens *startRecording();
+
+  // Add <tokens> for <ref>, if the recording is complete, and drop the
+  // caller's reference.
+  void put(const Ref &ref, ContentTokens *tokens);
+
+  // Drop all recordings, when the document is modified.
+  void clear();
+
+  void getStats(PopplerCacheStats *stats);
+
+  void incRef();
+  void decRef();
+
+private:
+
+  ~ContentCache();
+
+  PopplerCache<PopplerCacheRefKey, ContentCacheItem> *cache;
+  Goffset maxBytes;
+  int refCnt;
+#if MULTITHREADED
+  GooMutex mutex;
+#endif
+};
+
+#endif
@@ -557,6 +557,56 @@ int DecryptStream::lookChar() {
   return (nextCharBuff = c);
 }
 
+int DecryptStream::getChars(int nChars, Guchar *buffer) {
+  Guchar *buf;
+  int *bufIdx;
+  int n, m, c, i;
+
+  n = 0;
+  if (nextCharBuff != EOF && nChars > 0) {
+    buffer[n++] = (Guchar)nextCharBuff;
+    nextCharBuff = EOF;
+  }
+  switch (algo) {
+  case cryptRC4:
+    m = str->doGetChars(nChars - n, buffer + n);
+    for (i = 0; i < m; ++i) {
+      buffer[n + i] = rc4DecryptByte(state.rc4.state, &state.rc4.x,
+				     &state.rc4.y, buffer[n + i]);
+    }
+    n += m;
+    break;
+  case cryptAES:
+  case cryptAES256:
+    if (algo == cryptAES) {
+      buf = state.aes.buf;
+      bufIdx = &state.aes.bufIdx;
+    } else {
+      buf = state.aes256.buf;
+      bufIdx = &state.aes256.bufIdx;
+    }
+    while (n < nChars) {
+      // lookChar() decrypts the next block when the current one is used
+      // up; the rest of the block is then copied directly
+      if ((c = DecryptStream::lookChar()) == EOF) {
+	break;
+      }
+      buffer[n++] = (Guchar)c;
+      nextCharBuff = EOF;
+      m = 16 - *bufIdx;
+      if (m > nChars - n) {
+	m = nChars - n;
+      }
+      memcpy(buffer + n, buf + *bufIdx, m);
+      *bufIdx += m;
+      n += m;
+    }
+    break;
+  }
+  charactersRead += n;
+  return n;
+}
+
 //------------------------------------------------------------------------
 // RC4-compatible decryption
 //------------------------------------------------------------------------
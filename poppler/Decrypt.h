@@ -152,6 +152,11 @@ public:
   ~DecryptStream();
   virtual void reset();
   virtual int lookChar();
+
+private:
+
+  virtual GBool hasGetChars() { return true; }
+  virtual int getChars(int nChars, Guchar *buffer);
 };
  
 //------------------------------------------------------------------------
@@ -40,6 +40,8 @@
 #include "Object.h"
 #include "XRef.h"
 #include "Dict.h"
+#include "ObjectArena.h"
+#include "NameAtoms.h"
 
 #if MULTITHREADED
 #  define dictLocker()   MutexLocker locker(&mutex)
@@ -78,6 +80,7 @@ static int binarySearch(const char *key, DictEntry *entries, int length)
 Dict::Dict(XRef *xrefA) {
   xref = xrefA;
   entries = NULL;
+  arena = NULL;
   size = length = 0;
   ref = 1;
   sorted = gFalse;
@@ -95,13 +98,42 @@ Dict::Dict(Dict* dictA) {
 #endif
 
   sorted = dictA->sorted;
+  arena = NULL;
   entries = (DictEntry *)gmallocn(size, sizeof(DictEntry));
   for (int i=0; i<length; i++) {
-    entries[i].key = copyString(dictA->entries[i].key);
+    entries[i].key = NameAtoms::copy(dictA->entries[i].key);
     dictA->entries[i].val.copy(&entries[i].val);
   }
 }
 
+Dict::Dict(XRef *xrefA, ObjectArena *arenaA) {
+  xref = xrefA;
+  entries = NULL;
+  arena = arenaA;
+  size = length = 0;
+  ref = 1;
+  sorted = gFalse;
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
+}
+
+void *Dict::operator new(size_t size) {
+  return ObjectArena::allocObject(size, NULL);
+}
+
+void *Dict::operator new(size_t size, ObjectArena *arenaA) {
+  return ObjectArena::allocObject(size, arenaA);
+}
+
+void Dict::operator delete(void *p) {
+  ObjectArena::freeObject(p);
+}
+
+void Dict::operator delete(void *p, ObjectArena * /*arenaA*/) {
+  ObjectArena::freeObject(p);
+}
+
 Dict *Dict::copy(XRef *xrefA) {
   dictLocker();
   Dict *dictA = new Dict(this);
@@ -123,15 +155,28 @@ Dict::~Dict() {
   int i;
 
   for (i = 0; i < length; ++i) {
-    gfree(entries[i].key);
+    NameAtoms::release(entries[i].key);
     entries[i].val.free();
   }
-  gfree(entries);
+  if (!arena) {
+    gfree(entries);
+  }
 #if MULTITHREADED
   gDestroyMutex(&mutex);
 #endif
 }
 
+// Move the entry table out of the arena, which no longer allows
+// allocations.
+void Dict::detachEntries() {
+  DictEntry *entriesA;
+
+  entriesA = (DictEntry *)gmallocn(size, sizeof(DictEntry));
+  memcpy(entriesA, entries, length * sizeof(DictEntry));
+  entries = entriesA;
+  arena = NULL;
+}
+
 int Dict::incRef() {
   dictLocker();
   ++ref;
@@ -145,6 +190,17 @@ int Dict::decRef() {
 }
 
 void Dict::add(char *key, Object *val) {
+  addEntry(NameAtoms::intern(key), val);
+  gfree(key);
+}
+
+void Dict::add(Object *key, Object *val) {
+  addEntry(key->getName(), val);
+  // the name now belongs to the entry
+  key->initNull();
+}
+
+void Dict::addEntry(char *key, Object *val) {
   dictLocker();
   if (sorted) {
     // We use add on very few occasions so
@@ -152,27 +208,39 @@ void Dict::add(char *key, Object *val) {
     sorted = gFalse;
   }
 
+  if (arena && !arena->isOpen()) {
+    detachEntries();
+  }
   if (length == size) {
     if (length == 0) {
       size = 8;
     } else {
       size *= 2;
     }
-    entries = (DictEntry *)greallocn(entries, size, sizeof(DictEntry));
+    if (arena) {
+      DictEntry *entriesA = (DictEntry *)arena->alloc(size * sizeof(DictEntry));
+      memcpy(entriesA, entries, length * sizeof(DictEntry));
+      entries = entriesA;
+    } else {
+      entries = (DictEntry *)greallocn(entries, size, sizeof(DictEntry));
+    }
   }
   entries[length].key = key;
   entries[length].val = *val;
   ++length;
 }
 
-inline DictEntry *Dict::find(const char *key) {
+inline void Dict::sortIfLarge() {
   if (!sorted && length >= SORT_LENGTH_LOWER_LIMIT)
   {
       dictLocker();
       sorted = gTrue;
       std::sort(entries, entries+length, cmpDictEntries);
   }
+}
 
+inline DictEntry *Dict::find(const char *key) {
+  sortIfLarge();
   if (sorted) {
     const int pos = binarySearch(key, entries, length);
     if (pos != -1) {
@@ -189,17 +257,40 @@ inline DictEntry *Dict::find(const char *key) {
   return NULL;
 }
 
+// <atom> is interned, so is any key equal to it.
+inline DictEntry *Dict::findAtom(const char *atom) {
+  sortIfLarge();
+  if (sorted) {
+    const int pos = binarySearch(atom, entries, length);
+    if (pos != -1) {
+      return &entries[pos];
+    }
+  } else {
+    int i;
+
+    for (i = length - 1; i >=0; --i) {
+      if (entries[i].key == atom)
+        return &entries[i];
+    }
+  }
+  return NULL;
+}
+
 GBool Dict::hasKey(const char *key) {
   return find(key) != NULL;
 }
 
+GBool Dict::hasKey(NameAtomKey key) {
+  return findAtom(NameAtoms::get(key)) != NULL;
+}
+
 void Dict::remove(const char *key) {
   dictLocker();
   if (sorted) {
     const int pos = binarySearch(key, entries, length);
     if (pos != -1) {
       length -= 1;
-      gfree(entries[pos].key);
+      NameAtoms::release(entries[pos].key);
       entries[pos].val.free();
       if (pos != length) {
         memmove(&entries[pos], &entries[pos + 1], (length - pos) * sizeof(DictEntry));
@@ -223,7 +314,7 @@ void Dict::remove(const char *key) {
       return;
     }
     //replace the deleted entry with the last entry
-    gfree(entries[i].key);
+    NameAtoms::release(entries[i].key);
     entries[i].val.free();
     length -= 1;
     tmp = entries[length];
@@ -244,7 +335,7 @@ void Dict::set(const char *key, Object *val) {
     e->val.free();
     e->val = *val;
   } else {
-    add (copyString(key), val);
+    addEntry(NameAtoms::intern(key), val);
   }
 }
 
@@ -252,7 +343,7 @@ void Dict::set(const char *key, Object *val) {
 GBool Dict::is(const char *type) {
   DictEntry *e;
 
-  return (e = find("Type")) && e->val.isName(type);
+  return (e = findAtom(NameAtoms::get(atomType))) && e->val.isName(type);
 }
 
 Object *Dict::lookup(const char *key, Object *obj, int recursion) {
@@ -267,6 +358,20 @@ Object *Dict::lookupNF(const char *key, Object *obj) {
   return (e = find(key)) ? e->val.copy(obj) : obj->initNull();
 }
 
+Object *Dict::lookup(NameAtomKey key, Object *obj, int recursion) {
+  DictEntry *e;
+
+  return (e = findAtom(NameAtoms::get(key))) ?
+	   e->val.fetch(xref, obj, recursion) : obj->initNull();
+}
+
+Object *Dict::lookupNF(NameAtomKey key, Object *obj) {
+  DictEntry *e;
+
+  return (e = findAtom(NameAtoms::get(key))) ?
+	   e->val.copy(obj) : obj->initNull();
+}
+
 GBool Dict::lookupInt(const char *key, const char *alt_key, int *value)
 {
   Object obj1;
@@ -36,12 +36,14 @@
 #include "Object.h"
 #include "goo/GooMutex.h"
 
+class ObjectArena;
+
 //------------------------------------------------------------------------
 // Dict
 //------------------------------------------------------------------------
 
 struct DictEntry {
-  char *key;
+  char *key;			// from NameAtoms
   Object val;
 };
 
@@ -53,9 +55,19 @@ public:
   Dict(Dict* dictA);
   Dict *copy(XRef *xrefA);
 
+  // Create a dictionary whose entry table, like the dictionary itself,
+  // is allocated from <arenaA>, which must not have been released yet.
+  // Use as 'new (arena) Dict(xref, arena)'.
+  Dict(XRef *xrefA, ObjectArena *arenaA);
+
   // Destructor.
   ~Dict();
 
+  static void *operator new(size_t size);
+  static void *operator new(size_t size, ObjectArena *arenaA);
+  static void operator delete(void *p);
+  static void operator delete(void *p, ObjectArena *arenaA);
+
   // Reference counting.
   int incRef();
   int decRef();
@@ -63,9 +75,15 @@ public:
   // Get number of entries.
   int getLength() { return length; }
 
-  // Add an entry.  NB: does not copy key.
+  // Add an entry.  NB: takes over key, which must have been allocated
+  // with gmalloc: it is interned and freed right away, so the caller
+  // must not use it after the call.
   void add(char *key, Object *val);
 
+  // Add an entry with the name object <key> as its key.  Takes over
+  // both <key> and <val>, like add().
+  void add(Object *key, Object *val);
+
   // Update the value of an existing entry, otherwise create it
   void set(const char *key, Object *val);
   // Remove an entry. This invalidate indexes
@@ -80,6 +98,11 @@ public:
   Object *lookupNF(const char *key, Object *obj);
   GBool lookupInt(const char *key, const char *alt_key, int *value);
 
+  // Same as above for a predefined name, compares interned pointers
+  // instead of strings.
+  Object *lookup(NameAtomKey key, Object *obj, int recursion = 0);
+  Object *lookupNF(NameAtomKey key, Object *obj);
+
   // Iterative accessors.
   char *getKey(int i);
   Object *getVal(int i, Object *obj);
@@ -93,12 +116,14 @@ public:
   XRef *getXRef() { return xref; }
   
   GBool hasKey(const char *key);
+  GBool hasKey(NameAtomKey key);
 
 private:
 
   GBool sorted;
   XRef *xref;			// the xref table for this PDF file
   DictEntry *entries;		// array of entries
+  ObjectArena *arena;		// arena holding <entries>, or NULL
   int size;			// size of <entries> array
   int length;			// number of entries in dictionary
   int ref;			// reference count
@@ -106,7 +131,11 @@ private:
   GooMutex mutex;
 #endif
 
+  void sortIfLarge();
   DictEntry *find(const char *key);
+  DictEntry *findAtom(const char *atom);
+  void addEntry(char *key, Object *val);
+  void detachEntries();
 };
 
 #endif
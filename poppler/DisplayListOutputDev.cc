@@ -0,0 +1,1546 @@
+//========================================================================
+//
+// DisplayListOutputDev.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <limits.h>
+#include <string.h>
+#include "goo/gmem.h"
+#include "goo/GooList.h"
+#include "goo/GooString.h"
+#include "Error.h"
+#include "Function.h"
+#include "Stream.h"
+#include "DisplayListOutputDev.h"
+
+//------------------------------------------------------------------------
+
+enum DisplayListOpKind {
+  dlSaveState,
+  dlRestoreState,
+  dlUpdateAll,
+  dlUpdateCTM,
+  dlUpdateLineDash,
+  dlUpdateFlatness,
+  dlUpdateLineJoin,
+  dlUpdateLineCap,
+  dlUpdateMiterLimit,
+  dlUpdateLineWidth,
+  dlUpdateStrokeAdjust,
+  dlUpdateAlphaIsShape,
+  dlUpdateTextKnockout,
+  dlUpdateFillColorSpace,
+  dlUpdateStrokeColorSpace,
+  dlUpdateFillColor,
+  dlUpdateStrokeColor,
+  dlUpdateBlendMode,
+  dlUpdateFillOpacity,
+  dlUpdateStrokeOpacity,
+  dlUpdatePatternOpacity,
+  dlClearPatternOpacity,
+  dlUpdateFillOverprint,
+  dlUpdateStrokeOverprint,
+  dlUpdateOverprintMode,
+  dlUpdateTransfer,
+  dlUpdateFont,
+  dlUpdateTextMat,
+  dlUpdateCharSpace,
+  dlUpdateRender,
+  dlUpdateRise,
+  dlUpdateWordSpace,
+  dlUpdateHorizScaling,
+  dlUpdateTextPos,
+  dlUpdateTextShift,
+  dlSaveTextPos,
+  dlRestoreTextPos,
+  dlStroke,
+  dlFill,
+  dlEoFill,
+  dlFunctionShadedFill,
+  dlAxialShadedFill,
+  dlRadialShadedFill,
+  dlGouraudTriangleShadedFill,
+  dlPatchMeshShadedFill,
+  dlClip,
+  dlEoClip,
+  dlClipToStrokePath,
+  dlBeginStringOp,
+  dlEndStringOp,
+  dlBeginString,
+  dlEndString,
+  dlDrawChar,
+  dlDrawString,
+  dlBeginType3Char,
+  dlEndType3Char,
+  dlBeginTextObject,
+  dlEndTextObject,
+  dlIncCharCount,
+  dlBeginActualText,
+  dlEndActualText,
+  dlDrawImageMask,
+  dlSetSoftMaskFromImageMask,
+  dlUnsetSoftMaskFromImageMask,
+  dlDrawImage,
+  dlDrawMaskedImage,
+  dlDrawSoftMaskedImage,
+  dlType3D0,
+  dlType3D1,
+  dlBeginTransparencyGroup,
+  dlEndTransparencyGroup,
+  dlPaintTransparencyGroup,
+  dlSetSoftMask,
+  dlClearSoftMask,
+  dlSetVectorAntialias
+};
+
+// DisplayListOp flags
+#define dlFlagInlineImg     (1 << 2)
+#define dlFlagIsolated      (1 << 3)
+#define dlFlagKnockout      (1 << 4)
+#define dlFlagForSoftMask   (1 << 5)
+#define dlFlagAlpha         (1 << 6)
+#define dlFlagOn            (1 << 7)
+
+//------------------------------------------------------------------------
+// DisplayListImage
+//------------------------------------------------------------------------
+
+struct DisplayListImage {
+  DisplayListImage();
+  ~DisplayListImage();
+
+  int width, height;
+  Guchar *data;			// decoded samples, one row after the other
+  int size;
+  GfxImageColorMap *colorMap;	// NULL for image masks
+  GBool invert;
+  GBool interpolate;
+  GBool hasMaskColors;
+  int maskColors[2 * gfxColorMaxComps];
+  DisplayListImage *mask;	// explicit or soft mask, or NULL
+};
+
+DisplayListImage::DisplayListImage() {
+  width = height = 0;
+  data = NULL;
+  size = 0;
+  colorMap = NULL;
+  invert = gFalse;
+  interpolate = gFalse;
+  hasMaskColors = gFalse;
+  mask = NULL;
+}
+
+DisplayListImage::~DisplayListImage() {
+  gfree(data);
+  delete colorMap;
+  delete mask;
+}
+
+//------------------------------------------------------------------------
+// DisplayListSoftMask
+//------------------------------------------------------------------------
+
+struct DisplayListSoftMask {
+  Function *transferFunc;
+  GBool hasBackdropColor;
+  GfxColor backdropColor;
+};
+
+//------------------------------------------------------------------------
+// DisplayList
+//------------------------------------------------------------------------
+
+DisplayList::DisplayList() {
+  pageNum = 0;
+  xref = NULL;
+  hDPI = vDPI = 72;
+  box.x1 = box.y1 = box.x2 = box.y2 = 0;
+  rotate = 0;
+  upsideDown = gFalse;
+  for (int i = 0; i < 6; ++i) {
+    baseCTM[i] = 0;
+  }
+  strings = new GooList();
+  size = sizeof(DisplayList);
+  exact = gTrue;
+  refCnt = 1;
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
+}
+
+DisplayList::~DisplayList() {
+  size_t i;
+
+  for (i = 0; i < states.size(); ++i) {
+    delete states[i];
+  }
+  for (i = 0; i < paths.size(); ++i) {
+    delete paths[i];
+  }
+  for (i = 0; i < images.size(); ++i) {
+    delete images[i];
+  }
+  for (i = 0; i < softMasks.size(); ++i) {
+    delete softMasks[i]->transferFunc;
+    delete softMasks[i];
+  }
+  for (i = 0; i < colorSpaces.size(); ++i) {
+    delete colorSpaces[i];
+  }
+  for (i = 0; i < shadings.size(); ++i) {
+    delete shadings[i];
+  }
+  deleteGooList(strings, GooString);
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
+}
+
+void DisplayList::incRefCnt() {
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  ++refCnt;
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+}
+
+void DisplayList::decRefCnt() {
+  GBool done;
+
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  done = --refCnt == 0;
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+  if (done) {
+    delete this;
+  }
+}
+
+DisplayListOp *DisplayList::addOp(int kind, int state) {
+  DisplayListOp op;
+
+  memset(&op, 0, sizeof(op));
+  op.kind = kind;
+  op.state = state;
+  op.arg = -1;
+  ops.push_back(op);
+  size += sizeof(DisplayListOp);
+  return &ops.back();
+}
+
+int DisplayList::addPath(GfxPath *path) {
+  int i;
+
+  paths.push_back(path->copy());
+  size += sizeof(GfxPath);
+  for (i = 0; i < path->getNumSubpaths(); ++i) {
+    size += path->getSubpath(i)->getNumPoints() *
+            (2 * sizeof(double) + sizeof(GBool));
+  }
+  return (int)paths.size() - 1;
+}
+
+// Create the replay copy of a recorded state: <m> maps the recording
+// device space to the replay one (or is NULL if they are the same), and
+// (<offX>, <offY>) is the device offset the replay device applied to
+// the current state (e.g., while drawing into a transparency group or a
+// Type 3 glyph cache).
+static GfxState *replayState(GfxState *recorded, double *m, GfxState *page,
+			     double offX, double offY) {
+  GfxState *state;
+
+  state = recorded->copy(gTrue);
+  if (m) {
+    state->mapToDevice(m, page);
+  }
+  if (offX != 0 || offY != 0) {
+    state->shiftCTMAndClip(offX, offY);
+  }
+  return state;
+}
+
+static MemStream *replayStream(DisplayListImage *image) {
+  Object dictObj;
+
+  dictObj.initNull();
+  return new MemStream((char *)image->data, 0, image->size, &dictObj);
+}
+
+void DisplayList::replay(OutputDev *out, double hDPIA, double vDPIA) {
+  GfxState *page;
+  double m[6], *mPtr, *ctm;
+  double det;
+  int i;
+
+  page = new GfxState(hDPIA, vDPIA, &box, rotate, out->upsideDown());
+
+  // device transform from the recording page state to the replay one:
+  // inverse(baseCTM) * page CTM
+  ctm = page->getCTM();
+  mPtr = NULL;
+  for (i = 0; i < 6; ++i) {
+    if (ctm[i] != baseCTM[i]) {
+      mPtr = m;
+      break;
+    }
+  }
+  if (mPtr) {
+    double inv[6];
+    det = baseCTM[0] * baseCTM[3] - baseCTM[1] * baseCTM[2];
+    if (det == 0) {
+      error(errInternal, -1, "Singular display list page transform");
+      delete page;
+      return;
+    }
+    det = 1 / det;
+    inv[0] = baseCTM[3] * det;
+    inv[1] = -baseCTM[1] * det;
+    inv[2] = -baseCTM[2] * det;
+    inv[3] = baseCTM[0] * det;
+    inv[4] = (baseCTM[2] * baseCTM[5] - baseCTM[3] * baseCTM[4]) * det;
+    inv[5] = (baseCTM[1] * baseCTM[4] - baseCTM[0] * baseCTM[5]) * det;
+    m[0] = inv[0] * ctm[0] + inv[1] * ctm[2];
+    m[1] = inv[0] * ctm[1] + inv[1] * ctm[3];
+    m[2] = inv[2] * ctm[0] + inv[3] * ctm[2];
+    m[3] = inv[2] * ctm[1] + inv[3] * ctm[3];
+    m[4] = inv[4] * ctm[0] + inv[5] * ctm[2] + ctm[4];
+    m[5] = inv[4] * ctm[1] + inv[5] * ctm[3] + ctm[5];
+  }
+
+  replayPage(out, page, mPtr, 0, 0);
+  delete page;
+}
+
+void DisplayList::replaySlice(OutputDev *out, int sliceX, int sliceY,
+			      int sliceW, int sliceH) {
+  GfxState *page;
+
+  if (out->upsideDown() != upsideDown) {
+    error(errInternal, -1, "Display list replayed upside down");
+    return;
+  }
+  page = new GfxState(hDPI, vDPI, &box, rotate, upsideDown);
+  page->cropToDeviceArea(sliceX, sliceY, sliceW, sliceH);
+  replayPage(out, page, NULL, -sliceX, -sliceY);
+  delete page;
+}
+
+// Replay the recorded calls into <out>, whose page state is <page>.  The
+// recorded states are mapped with <m> (see replayState) and moved by
+// (<offX>, <offY>).  The side tables are shared by concurrent replays;
+// the objects a device may modify (functions, shadings, color maps) are
+// copied for each call.
+void DisplayList::replayPage(OutputDev *out, GfxState *page, double *m,
+			     double offX, double offY) {
+  GfxState *state;
+  double baseMatrix[6];
+  double ctmE, ctmF;
+  std::vector<GBool> vaaStack;
+  Object refObj;
+  MemStream *str, *maskStr;
+  DisplayListImage *image;
+  DisplayListSoftMask *softMask;
+  GfxImageColorMap *colorMap, *maskColorMap;
+  GfxShading *shading;
+  Function *transferFunc;
+  GooString *s;
+  int wantState, curState, skipDepth, i, j;
+
+  out->startPage(pageNum, page, xref);
+  out->setDefaultCTM(page->getCTM());
+
+  refObj.initNull();
+  for (i = 0; i < 6; ++i) {
+    baseMatrix[i] = page->getCTM()[i];
+  }
+  state = NULL;
+  curState = -1;
+  wantState = -1;
+  ctmE = ctmF = 0;
+  skipDepth = 0;
+
+  for (j = 0; j < (int)ops.size(); ++j) {
+    DisplayListOp *op = &ops[j];
+
+    if (op->state >= 0) {
+      wantState = op->state;
+    }
+
+    // skip the glyph description of Type 3 chars the device has cached
+    if (skipDepth > 0) {
+      if (op->kind == dlBeginType3Char) {
+	++skipDepth;
+      } else if (op->kind == dlEndType3Char) {
+	--skipDepth;
+      }
+      continue;
+    }
+
+    if (wantState < 0) {
+      continue;
+    }
+    if (wantState != curState) {
+      delete state;
+      state = replayState(states[wantState], m, page, offX, offY);
+      curState = wantState;
+      ctmE = state->getCTM()[4];
+      ctmF = state->getCTM()[5];
+    }
+    if (op->arg >= 0 &&
+	(op->kind == dlStroke || op->kind == dlFill || op->kind == dlEoFill ||
+	 op->kind == dlClip || op->kind == dlEoClip ||
+	 op->kind == dlClipToStrokePath)) {
+      state->setPath(paths[op->arg]->copy());
+    }
+
+    switch (op->kind) {
+    case dlSaveState:
+      out->saveState(state);
+      break;
+    case dlRestoreState:
+      out->restoreState(state);
+      break;
+    case dlUpdateAll:
+      out->updateAll(state);
+      break;
+    case dlUpdateCTM:
+      out->updateCTM(state, op->d[0], op->d[1], op->d[2],
+		     op->d[3], op->d[4], op->d[5]);
+      break;
+    case dlUpdateLineDash:
+      out->updateLineDash(state);
+      break;
+    case dlUpdateFlatness:
+      out->updateFlatness(state);
+      break;
+    case dlUpdateLineJoin:
+      out->updateLineJoin(state);
+      break;
+    case dlUpdateLineCap:
+      out->updateLineCap(state);
+      break;
+    case dlUpdateMiterLimit:
+      out->updateMiterLimit(state);
+      break;
+    case dlUpdateLineWidth:
+      out->updateLineWidth(state);
+      break;
+    case dlUpdateStrokeAdjust:
+      out->updateStrokeAdjust(state);
+      break;
+    case dlUpdateAlphaIsShape:
+      out->updateAlphaIsShape(state);
+      break;
+    case dlUpdateTextKnockout:
+      out->updateTextKnockout(state);
+      break;
+    case dlUpdateFillColorSpace:
+      out->updateFillColorSpace(state);
+      break;
+    case dlUpdateStrokeColorSpace:
+      out->updateStrokeColorSpace(state);
+      break;
+    case dlUpdateFillColor:
+      out->updateFillColor(state);
+      break;
+    case dlUpdateStrokeColor:
+      out->updateStrokeColor(state);
+      break;
+    case dlUpdateBlendMode:
+      out->updateBlendMode(state);
+      break;
+    case dlUpdateFillOpacity:
+      out->updateFillOpacity(state);
+      break;
+    case dlUpdateStrokeOpacity:
+      out->updateStrokeOpacity(state);
+      break;
+    case dlUpdatePatternOpacity:
+      out->updatePatternOpacity(state);
+      break;
+    case dlClearPatternOpacity:
+      out->clearPatternOpacity(state);
+      break;
+    case dlUpdateFillOverprint:
+      out->updateFillOverprint(state);
+      break;
+    case dlUpdateStrokeOverprint:
+      out->updateStrokeOverprint(state);
+      break;
+    case dlUpdateOverprintMode:
+      out->updateOverprintMode(state);
+      break;
+    case dlUpdateTransfer:
+      out->updateTransfer(state);
+      break;
+    case dlUpdateFont:
+      out->updateFont(state);
+      break;
+    case dlUpdateTextMat:
+      out->updateTextMat(state);
+      break;
+    case dlUpdateCharSpace:
+      out->updateCharSpace(state);
+      break;
+    case dlUpdateRender:
+      out->updateRender(state);
+      break;
+    case dlUpdateRise:
+      out->updateRise(state);
+      break;
+    case dlUpdateWordSpace:
+      out->updateWordSpace(state);
+      break;
+    case dlUpdateHorizScaling:
+      out->updateHorizScaling(state);
+      break;
+    case dlUpdateTextPos:
+      out->updateTextPos(state);
+      break;
+    case dlUpdateTextShift:
+      out->updateTextShift(state, op->d[0]);
+      break;
+    case dlSaveTextPos:
+      out->saveTextPos(state);
+      break;
+    case dlRestoreTextPos:
+      out->restoreTextPos(state);
+      break;
+    case dlStroke:
+      out->stroke(state);
+      break;
+    case dlFill:
+      out->fill(state);
+      break;
+    case dlEoFill:
+      out->eoFill(state);
+      break;
+    case dlFunctionShadedFill:
+    case dlAxialShadedFill:
+    case dlRadialShadedFill:
+    case dlGouraudTriangleShadedFill:
+    case dlPatchMeshShadedFill:
+      shading = shadings[op->arg]->copy();
+      state->clearPath();
+      if (op->kind == dlFunctionShadedFill) {
+	out->functionShadedFill(state, (GfxFunctionShading *)shading);
+      } else if (op->kind == dlAxialShadedFill) {
+	out->axialShadedFill(state, (GfxAxialShading *)shading,
+			     op->d[0], op->d[1]);
+      } else if (op->kind == dlRadialShadedFill) {
+	out->radialShadedFill(state, (GfxRadialShading *)shading,
+			      op->d[0], op->d[1]);
+      } else if (op->kind == dlGouraudTriangleShadedFill) {
+	out->gouraudTriangleShadedFill(state,
+				       (GfxGouraudTriangleShading *)shading);
+      } else {
+	out->patchMeshShadedFill(state, (GfxPatchMeshShading *)shading);
+      }
+      delete shading;
+      break;
+    case dlClip:
+      out->clip(state);
+      break;
+    case dlEoClip:
+      out->eoClip(state);
+      break;
+    case dlClipToStrokePath:
+      out->clipToStrokePath(state);
+      break;
+    case dlBeginStringOp:
+      out->beginStringOp(state);
+      break;
+    case dlEndStringOp:
+      out->endStringOp(state);
+      break;
+    case dlBeginString:
+      out->beginString(state, (GooString *)strings->get(op->arg));
+      break;
+    case dlEndString:
+      out->endString(state);
+      break;
+    case dlDrawChar:
+      out->drawChar(state, op->d[0], op->d[1], op->d[2], op->d[3],
+		    op->d[4], op->d[5], op->code, op->nBytes,
+		    op->uLen > 0 ? &unicode[op->uStart] : (Unicode *)NULL,
+		    op->uLen);
+      break;
+    case dlDrawString:
+      out->drawString(state, (GooString *)strings->get(op->arg));
+      break;
+    case dlBeginType3Char:
+      if (out->beginType3Char(state, op->d[0], op->d[1], op->d[2], op->d[3],
+			      op->code,
+			      op->uLen > 0 ? &unicode[op->uStart]
+			                   : (Unicode *)NULL,
+			      op->uLen)) {
+	skipDepth = 1;
+      }
+      break;
+    case dlEndType3Char:
+      out->endType3Char(state);
+      break;
+    case dlBeginTextObject:
+      out->beginTextObject(state);
+      break;
+    case dlEndTextObject:
+      out->endTextObject(state);
+      break;
+    case dlIncCharCount:
+      out->incCharCount(op->arg);
+      break;
+    case dlBeginActualText:
+      s = op->arg >= 0 ? (GooString *)strings->get(op->arg) : (GooString *)NULL;
+      out->beginActualText(state, s);
+      break;
+    case dlEndActualText:
+      out->endActualText(state);
+      break;
+    case dlDrawImageMask:
+      image = images[op->arg];
+      str = replayStream(image);
+      out->drawImageMask(state, &refObj, str, image->width, image->height,
+			 image->invert, image->interpolate,
+			 (op->flags & dlFlagInlineImg) ? gTrue : gFalse);
+      delete str;
+      break;
+    case dlSetSoftMaskFromImageMask:
+      image = images[op->arg];
+      str = replayStream(image);
+      out->setSoftMaskFromImageMask(state, &refObj, str,
+				    image->width, image->height,
+				    image->invert,
+				    (op->flags & dlFlagInlineImg) ? gTrue : gFalse,
+				    baseMatrix);
+      delete str;
+      break;
+    case dlUnsetSoftMaskFromImageMask:
+      out->unsetSoftMaskFromImageMask(state, baseMatrix);
+      break;
+    case dlDrawImage:
+      image = images[op->arg];
+      str = replayStream(image);
+      colorMap = image->colorMap->copy();
+      out->drawImage(state, &refObj, str, image->width, image->height,
+		     colorMap, image->interpolate,
+		     image->hasMaskColors ? image->maskColors : (int *)NULL,
+		     (op->flags & dlFlagInlineImg) ? gTrue : gFalse);
+      delete colorMap;
+      delete str;
+      break;
+    case dlDrawMaskedImage:
+      image = images[op->arg];
+      str = replayStream(image);
+      maskStr = replayStream(image->mask);
+      colorMap = image->colorMap->copy();
+      out->drawMaskedImage(state, &refObj, str, image->width, image->height,
+			   colorMap, image->interpolate,
+			   maskStr, image->mask->width, image->mask->height,
+			   image->mask->invert, image->mask->interpolate);
+      delete colorMap;
+      delete maskStr;
+      delete str;
+      break;
+    case dlDrawSoftMaskedImage:
+      image = images[op->arg];
+      str = replayStream(image);
+      maskStr = replayStream(image->mask);
+      colorMap = image->colorMap->copy();
+      maskColorMap = image->mask->colorMap->copy();
+      out->drawSoftMaskedImage(state, &refObj, str,
+			       image->width, image->height,
+			       colorMap, image->interpolate,
+			       maskStr, image->mask->width,
+			       image->mask->height, maskColorMap,
+			       image->mask->interpolate);
+      delete maskColorMap;
+      delete colorMap;
+      delete maskStr;
+      delete str;
+      break;
+    case dlType3D0:
+      out->type3D0(state, op->d[0], op->d[1]);
+      break;
+    case dlType3D1:
+      out->type3D1(state, op->d[0], op->d[1], op->d[2], op->d[3],
+		   op->d[4], op->d[5]);
+      break;
+    case dlBeginTransparencyGroup:
+      out->beginTransparencyGroup(state, op->d,
+				  op->arg >= 0 ? colorSpaces[op->arg]
+				               : (GfxColorSpace *)NULL,
+				  (op->flags & dlFlagIsolated) ? gTrue : gFalse,
+				  (op->flags & dlFlagKnockout) ? gTrue : gFalse,
+				  (op->flags & dlFlagForSoftMask) ? gTrue
+				                                  : gFalse);
+      break;
+    case dlEndTransparencyGroup:
+      out->endTransparencyGroup(state);
+      break;
+    case dlPaintTransparencyGroup:
+      out->paintTransparencyGroup(state, op->d);
+      break;
+    case dlSetSoftMask:
+      softMask = softMasks[op->arg];
+      transferFunc = softMask->transferFunc ? softMask->transferFunc->copy()
+	                                    : (Function *)NULL;
+      out->setSoftMask(state, op->d,
+		       (op->flags & dlFlagAlpha) ? gTrue : gFalse,
+		       transferFunc,
+		       softMask->hasBackdropColor ? &softMask->backdropColor
+		                                  : (GfxColor *)NULL);
+      delete transferFunc;
+      break;
+    case dlClearSoftMask:
+      out->clearSoftMask(state);
+      break;
+    case dlSetVectorAntialias:
+      // Gfx only ever turns vector antialiasing off temporarily, so this
+      // is replayed relative to the setting of the replay device
+      if (op->flags & dlFlagOn) {
+	if (!vaaStack.empty()) {
+	  out->setVectorAntialias(vaaStack.back());
+	  vaaStack.pop_back();
+	}
+      } else {
+	vaaStack.push_back(out->getVectorAntialias());
+	out->setVectorAntialias(gFalse);
+      }
+      break;
+    }
+
+    // the device may move the origin of the state it was given (e.g.,
+    // into a transparency group bitmap), apply the same offset to the
+    // states that follow
+    if (state->getCTM()[4] != ctmE || state->getCTM()[5] != ctmF) {
+      offX += state->getCTM()[4] - ctmE;
+      offY += state->getCTM()[5] - ctmF;
+      ctmE = state->getCTM()[4];
+      ctmF = state->getCTM()[5];
+    }
+  }
+
+  while (!vaaStack.empty()) {
+    out->setVectorAntialias(vaaStack.back());
+    vaaStack.pop_back();
+  }
+  out->endPage();
+  delete state;
+}
+
+//------------------------------------------------------------------------
+// DisplayListOutputDev
+//------------------------------------------------------------------------
+
+DisplayListOutputDev::DisplayListOutputDev(OutputDev *protoA) {
+  proto = protoA;
+  list = new DisplayList();
+  curState = -1;
+  pendingOp = -1;
+  stateChanged = gTrue;
+  vectorAntialias = gTrue;
+}
+
+DisplayListOutputDev::~DisplayListOutputDev() {
+  list->decRefCnt();
+}
+
+DisplayList *DisplayListOutputDev::takeDisplayList() {
+  DisplayList *l;
+
+  l = list;
+  list = new DisplayList();
+  curState = -1;
+  pendingOp = -1;
+  stateChanged = gTrue;
+  vectorAntialias = gTrue;
+  return l;
+}
+
+void DisplayListOutputDev::startPage(int pageNum, GfxState *state,
+				     XRef *xref) {
+  int i;
+
+  list->pageNum = pageNum;
+  list->xref = xref;
+  list->hDPI = state->getHDPI();
+  list->vDPI = state->getVDPI();
+  list->box.x1 = state->getX1();
+  list->box.y1 = state->getY1();
+  list->box.x2 = state->getX2();
+  list->box.y2 = state->getY2();
+  list->rotate = state->getRotate();
+  list->upsideDown = upsideDown();
+  for (i = 0; i < 6; ++i) {
+    list->baseCTM[i] = state->getCTM()[i];
+  }
+  stateChanged = gTrue;
+}
+
+void DisplayListOutputDev::endPage() {
+}
+
+// Record a state update call.  The state is only snapshotted by the
+// next drawing call, all the updates since the previous snapshot are
+// replayed with it.
+void DisplayListOutputDev::addUpdate(GfxState *state, int kind) {
+  list->addOp(kind, -1);
+  if (!stateChanged || pendingOp < 0) {
+    pendingOp = (int)list->ops.size() - 1;
+  }
+  stateChanged = gTrue;
+}
+
+DisplayListOp *DisplayListOutputDev::addOp(GfxState *state, int kind) {
+  DisplayListOp *op;
+  GfxState *last, *snapshot;
+  int idx;
+
+  // Gfx changes a few things (mostly the CTM, for patterns and Type 3
+  // chars) without telling the device
+  if (!stateChanged) {
+    last = list->states[curState];
+    if (memcmp(last->getCTM(), state->getCTM(), 6 * sizeof(double)) ||
+	last->getFont() != state->getFont()) {
+      stateChanged = gTrue;
+    }
+  }
+  op = list->addOp(kind, -1);
+  if (stateChanged) {
+    snapshot = state->copy(gTrue);
+    snapshot->setPath(new GfxPath());
+    list->states.push_back(snapshot);
+    list->size += sizeof(GfxState);
+    idx = (int)list->states.size() - 1;
+    if (pendingOp >= 0) {
+      list->ops[pendingOp].state = idx;
+    } else {
+      op->state = idx;
+    }
+    curState = idx;
+    stateChanged = gFalse;
+  }
+  pendingOp = -1;
+  return op;
+}
+
+DisplayListOp *DisplayListOutputDev::addPathOp(GfxState *state, int kind) {
+  DisplayListOp *op;
+
+  op = addOp(state, kind);
+  op->arg = list->addPath(state->getPath());
+  return op;
+}
+
+// Read the samples of an image into <image>, <bitsPerPixel> per pixel,
+// rows padded to a byte boundary.
+void DisplayListOutputDev::readImage(Stream *str, int width, int height,
+				     int bitsPerPixel,
+				     DisplayListImage *image) {
+  int rowSize, n;
+
+  image->width = width;
+  image->height = height;
+  image->data = NULL;
+  image->size = 0;
+  if (width > 0 && height > 0 && bitsPerPixel > 0 &&
+      width <= (INT_MAX - 7) / bitsPerPixel) {
+    rowSize = (width * bitsPerPixel + 7) >> 3;
+    if (height <= INT_MAX / rowSize) {
+      image->size = rowSize * height;
+    }
+  }
+  if (image->size > 0) {
+    image->data = (Guchar *)gmalloc(image->size);
+    str->reset();
+    n = str->doGetChars(image->size, image->data);
+    if (n < image->size) {
+      memset(image->data + n, 0, image->size - n);
+    }
+    str->close();
+  } else {
+    error(errInternal, -1, "Invalid image size in display list");
+    image->height = 0;
+  }
+  list->size += sizeof(DisplayListImage) + image->size;
+}
+
+int DisplayListOutputDev::addImage(DisplayListImage *image) {
+  list->images.push_back(image);
+  return (int)list->images.size() - 1;
+}
+
+void DisplayListOutputDev::saveState(GfxState *state) {
+  addOp(state, dlSaveState);
+}
+
+void DisplayListOutputDev::restoreState(GfxState *state) {
+  stateChanged = gTrue;
+  addOp(state, dlRestoreState);
+}
+
+void DisplayListOutputDev::updateAll(GfxState *state) {
+  addUpdate(state, dlUpdateAll);
+}
+
+void DisplayListOutputDev::updateCTM(GfxState *state, double m11, double m12,
+				     double m21, double m22,
+				     double m31, double m32) {
+  DisplayListOp *op;
+
+  addUpdate(state, dlUpdateCTM);
+  op = &list->ops.back();
+  op->d[0] = m11;
+  op->d[1] = m12;
+  op->d[2] = m21;
+  op->d[3] = m22;
+  op->d[4] = m31;
+  op->d[5] = m32;
+}
+
+void DisplayListOutputDev::updateLineDash(GfxState *state) {
+  addUpdate(state, dlUpdateLineDash);
+}
+
+void DisplayListOutputDev::updateFlatness(GfxState *state) {
+  addUpdate(state, dlUpdateFlatness);
+}
+
+void DisplayListOutputDev::updateLineJoin(GfxState *state) {
+  addUpdate(state, dlUpdateLineJoin);
+}
+
+void DisplayListOutputDev::updateLineCap(GfxState *state) {
+  addUpdate(state, dlUpdateLineCap);
+}
+
+void DisplayListOutputDev::updateMiterLimit(GfxState *state) {
+  addUpdate(state, dlUpdateMiterLimit);
+}
+
+void DisplayListOutputDev::updateLineWidth(GfxState *state) {
+  addUpdate(state, dlUpdateLineWidth);
+}
+
+void DisplayListOutputDev::updateStrokeAdjust(GfxState *state) {
+  addUpdate(state, dlUpdateStrokeAdjust);
+}
+
+void DisplayListOutputDev::updateAlphaIsShape(GfxState *state) {
+  addUpdate(state, dlUpdateAlphaIsShape);
+}
+
+void DisplayListOutputDev::updateTextKnockout(GfxState *state) {
+  addUpdate(state, dlUpdateTextKnockout);
+}
+
+void DisplayListOutputDev::updateFillColorSpace(GfxState *state) {
+  addUpdate(state, dlUpdateFillColorSpace);
+}
+
+void DisplayListOutputDev::updateStrokeColorSpace(GfxState *state) {
+  addUpdate(state, dlUpdateStrokeColorSpace);
+}
+
+void DisplayListOutputDev::updateFillColor(GfxState *state) {
+  addUpdate(state, dlUpdateFillColor);
+}
+
+void DisplayListOutputDev::updateStrokeColor(GfxState *state) {
+  addUpdate(state, dlUpdateStrokeColor);
+}
+
+void DisplayListOutputDev::updateBlendMode(GfxState *state) {
+  addUpdate(state, dlUpdateBlendMode);
+}
+
+void DisplayListOutputDev::updateFillOpacity(GfxState *state) {
+  addUpdate(state, dlUpdateFillOpacity);
+}
+
+void DisplayListOutputDev::updateStrokeOpacity(GfxState *state) {
+  addUpdate(state, dlUpdateStrokeOpacity);
+}
+
+void DisplayListOutputDev::updatePatternOpacity(GfxState *state) {
+  addUpdate(state, dlUpdatePatternOpacity);
+}
+
+void DisplayListOutputDev::clearPatternOpacity(GfxState *state) {
+  addUpdate(state, dlClearPatternOpacity);
+}
+
+void DisplayListOutputDev::updateFillOverprint(GfxState *state) {
+  addUpdate(state, dlUpdateFillOverprint);
+}
+
+void DisplayListOutputDev::updateStrokeOverprint(GfxState *state) {
+  addUpdate(state, dlUpdateStrokeOverprint);
+}
+
+void DisplayListOutputDev::updateOverprintMode(GfxState *state) {
+  addUpdate(state, dlUpdateOverprintMode);
+}
+
+void DisplayListOutputDev::updateTransfer(GfxState *state) {
+  addUpdate(state, dlUpdateTransfer);
+}
+
+void DisplayListOutputDev::updateFont(GfxState *state) {
+  addUpdate(state, dlUpdateFont);
+}
+
+void DisplayListOutputDev::updateTextMat(GfxState *state) {
+  addUpdate(state, dlUpdateTextMat);
+}
+
+void DisplayListOutputDev::updateCharSpace(GfxState *state) {
+  addUpdate(state, dlUpdateCharSpace);
+}
+
+void DisplayListOutputDev::updateRender(GfxState *state) {
+  addUpdate(state, dlUpdateRender);
+}
+
+void DisplayListOutputDev::updateRise(GfxState *state) {
+  addUpdate(state, dlUpdateRise);
+}
+
+void DisplayListOutputDev::updateWordSpace(GfxState *state) {
+  addUpdate(state, dlUpdateWordSpace);
+}
+
+void DisplayListOutputDev::updateHorizScaling(GfxState *state) {
+  addUpdate(state, dlUpdateHorizScaling);
+}
+
+void DisplayListOutputDev::updateTextPos(GfxState *state) {
+  addUpdate(state, dlUpdateTextPos);
+}
+
+void DisplayListOutputDev::updateTextShift(GfxState *state, double shift) {
+  addUpdate(state, dlUpdateTextShift);
+  list->ops.back().d[0] = shift;
+}
+
+void DisplayListOutputDev::saveTextPos(GfxState *state) {
+  addOp(state, dlSaveTextPos);
+}
+
+void DisplayListOutputDev::restoreTextPos(GfxState *state) {
+  addOp(state, dlRestoreTextPos);
+}
+
+void DisplayListOutputDev::stroke(GfxState *state) {
+  addPathOp(state, dlStroke);
+}
+
+void DisplayListOutputDev::fill(GfxState *state) {
+  addPathOp(state, dlFill);
+}
+
+void DisplayListOutputDev::eoFill(GfxState *state) {
+  addPathOp(state, dlEoFill);
+}
+
+// Gfx draws the cells of tiling patterns into the list instead.
+GBool DisplayListOutputDev::useTilingPatternFill() {
+  if (proto->useTilingPatternFill()) {
+    list->exact = gFalse;
+  }
+  return gFalse;
+}
+
+// The shading is copied, the device rasterizes it when the list is
+// replayed.
+void DisplayListOutputDev::addShadingOp(GfxState *state, int kind,
+					GfxShading *shading) {
+  DisplayListOp *op;
+
+  op = addOp(state, kind);
+  list->shadings.push_back(shading->copy());
+  list->size += sizeof(GfxShading);
+  op->arg = (int)list->shadings.size() - 1;
+}
+
+GBool DisplayListOutputDev::functionShadedFill(GfxState *state,
+					       GfxFunctionShading *shading) {
+  addShadingOp(state, dlFunctionShadedFill, shading);
+  return gTrue;
+}
+
+GBool DisplayListOutputDev::axialShadedFill(GfxState *state,
+					    GfxAxialShading *shading,
+					    double tMin, double tMax) {
+  addShadingOp(state, dlAxialShadedFill, shading);
+  list->ops.back().d[0] = tMin;
+  list->ops.back().d[1] = tMax;
+  return gTrue;
+}
+
+GBool DisplayListOutputDev::radialShadedFill(GfxState *state,
+					     GfxRadialShading *shading,
+					     double sMin, double sMax) {
+  addShadingOp(state, dlRadialShadedFill, shading);
+  list->ops.back().d[0] = sMin;
+  list->ops.back().d[1] = sMax;
+  return gTrue;
+}
+
+GBool DisplayListOutputDev::gouraudTriangleShadedFill(
+			      GfxState *state,
+			      GfxGouraudTriangleShading *shading) {
+  addShadingOp(state, dlGouraudTriangleShadedFill, shading);
+  return gTrue;
+}
+
+GBool DisplayListOutputDev::patchMeshShadedFill(GfxState *state,
+						GfxPatchMeshShading *shading) {
+  addShadingOp(state, dlPatchMeshShadedFill, shading);
+  return gTrue;
+}
+
+// Gfx has already shrunk the clip bounding box of the state
+void DisplayListOutputDev::clip(GfxState *state) {
+  stateChanged = gTrue;
+  addPathOp(state, dlClip);
+}
+
+void DisplayListOutputDev::eoClip(GfxState *state) {
+  stateChanged = gTrue;
+  addPathOp(state, dlEoClip);
+}
+
+void DisplayListOutputDev::clipToStrokePath(GfxState *state) {
+  stateChanged = gTrue;
+  addPathOp(state, dlClipToStrokePath);
+}
+
+void DisplayListOutputDev::beginStringOp(GfxState *state) {
+  addOp(state, dlBeginStringOp);
+}
+
+void DisplayListOutputDev::endStringOp(GfxState *state) {
+  addOp(state, dlEndStringOp);
+}
+
+void DisplayListOutputDev::beginString(GfxState *state, GooString *s) {
+  DisplayListOp *op;
+
+  op = addOp(state, dlBeginString);
+  list->strings->append(s->copy());
+  list->size += sizeof(GooString) + s->getLength();
+  op->arg = list->strings->getLength() - 1;
+}
+
+void DisplayListOutputDev::endString(GfxState *state) {
+  addOp(state, dlEndString);
+}
+
+void DisplayListOutputDev::drawChar(GfxState *state, double x, double y,
+				    double dx, double dy,
+				    double originX, double originY,
+				    CharCode code, int nBytes,
+				    Unicode *u, int uLen) {
+  DisplayListOp *op;
+
+  op = addOp(state, dlDrawChar);
+  op->d[0] = x;
+  op->d[1] = y;
+  op->d[2] = dx;
+  op->d[3] = dy;
+  op->d[4] = originX;
+  op->d[5] = originY;
+  op->code = code;
+  op->nBytes = nBytes;
+  if (u && uLen > 0) {
+    op->uStart = (int)list->unicode.size();
+    op->uLen = uLen;
+    list->unicode.insert(list->unicode.end(), u, u + uLen);
+    list->size += uLen * sizeof(Unicode);
+  }
+}
+
+void DisplayListOutputDev::drawString(GfxState *state, GooString *s) {
+  DisplayListOp *op;
+
+  op = addOp(state, dlDrawString);
+  list->strings->append(s->copy());
+  list->size += sizeof(GooString) + s->getLength();
+  op->arg = list->strings->getLength() - 1;
+}
+
+// The glyph description is always recorded, the replay device decides
+// whether it is needed.
+GBool DisplayListOutputDev::beginType3Char(GfxState *state,
+					   double x, double y,
+					   double dx, double dy,
+					   CharCode code, Unicode *u,
+					   int uLen) {
+  DisplayListOp *op;
+
+  op = addOp(state, dlBeginType3Char);
+  op->d[0] = x;
+  op->d[1] = y;
+  op->d[2] = dx;
+  op->d[3] = dy;
+  op->code = code;
+  if (u && uLen > 0) {
+    op->uStart = (int)list->unicode.size();
+    op->uLen = uLen;
+    list->unicode.insert(list->unicode.end(), u, u + uLen);
+    list->size += uLen * sizeof(Unicode);
+  }
+  return gFalse;
+}
+
+void DisplayListOutputDev::endType3Char(GfxState *state) {
+  addOp(state, dlEndType3Char);
+}
+
+void DisplayListOutputDev::beginTextObject(GfxState *state) {
+  addOp(state, dlBeginTextObject);
+}
+
+void DisplayListOutputDev::endTextObject(GfxState *state) {
+  addOp(state, dlEndTextObject);
+}
+
+void DisplayListOutputDev::incCharCount(int nChars) {
+  DisplayListOp *op;
+
+  op = list->addOp(dlIncCharCount, -1);
+  op->arg = nChars;
+}
+
+void DisplayListOutputDev::beginActualText(GfxState *state, GooString *text) {
+  DisplayListOp *op;
+
+  op = addOp(state, dlBeginActualText);
+  if (text) {
+    list->strings->append(text->copy());
+    list->size += sizeof(GooString) + text->getLength();
+    op->arg = list->strings->getLength() - 1;
+  }
+}
+
+void DisplayListOutputDev::endActualText(GfxState *state) {
+  addOp(state, dlEndActualText);
+}
+
+void DisplayListOutputDev::drawImageMask(GfxState *state, Object *ref,
+					 Stream *str, int width, int height,
+					 GBool invert, GBool interpolate,
+					 GBool inlineImg) {
+  DisplayListImage *image;
+  DisplayListOp *op;
+
+  op = addOp(state, dlDrawImageMask);
+  image = new DisplayListImage();
+  image->invert = invert;
+  image->interpolate = interpolate;
+  readImage(str, width, height, 1, image);
+  op->arg = addImage(image);
+  if (inlineImg) {
+    op->flags |= dlFlagInlineImg;
+  }
+}
+
+void DisplayListOutputDev::setSoftMaskFromImageMask(GfxState *state,
+						    Object *ref, Stream *str,
+						    int width, int height,
+						    GBool invert,
+						    GBool inlineImg,
+						    double *baseMatrix) {
+  DisplayListImage *image;
+  DisplayListOp *op;
+
+  op = addOp(state, dlSetSoftMaskFromImageMask);
+  image = new DisplayListImage();
+  image->invert = invert;
+  readImage(str, width, height, 1, image);
+  op->arg = addImage(image);
+  if (inlineImg) {
+    op->flags |= dlFlagInlineImg;
+  }
+}
+
+void DisplayListOutputDev::unsetSoftMaskFromImageMask(GfxState *state,
+						      double *baseMatrix) {
+  addOp(state, dlUnsetSoftMaskFromImageMask);
+}
+
+void DisplayListOutputDev::drawImage(GfxState *state, Object *ref,
+				     Stream *str, int width, int height,
+				     GfxImageColorMap *colorMap,
+				     GBool interpolate, int *maskColors,
+				     GBool inlineImg) {
+  DisplayListImage *image;
+  DisplayListOp *op;
+  int i;
+
+  op = addOp(state, dlDrawImage);
+  image = new DisplayListImage();
+  image->colorMap = colorMap->copy();
+  image->interpolate = interpolate;
+  if (maskColors) {
+    image->hasMaskColors = gTrue;
+    for (i = 0; i < 2 * colorMap->getNumPixelComps(); ++i) {
+      image->maskColors[i] = maskColors[i];
+    }
+  }
+  readImage(str, width, height,
+	    colorMap->getNumPixelComps() * colorMap->getBits(), image);
+  op->arg = addImage(image);
+  if (inlineImg) {
+    op->flags |= dlFlagInlineImg;
+  }
+}
+
+void DisplayListOutputDev::drawMaskedImage(GfxState *state, Object *ref,
+					   Stream *str, int width, int height,
+					   GfxImageColorMap *colorMap,
+					   GBool interpolate,
+					   Stream *maskStr,
+					   int maskWidth, int maskHeight,
+					   GBool maskInvert,
+					   GBool maskInterpolate) {
+  DisplayListImage *image, *mask;
+  DisplayListOp *op;
+
+  op = addOp(state, dlDrawMaskedImage);
+  image = new DisplayListImage();
+  image->colorMap = colorMap->copy();
+  image->interpolate = interpolate;
+  mask = new DisplayListImage();
+  mask->invert = maskInvert;
+  mask->interpolate = maskInterpolate;
+  image->mask = mask;
+  readImage(maskStr, maskWidth, maskHeight, 1, mask);
+  readImage(str, width, height,
+	    colorMap->getNumPixelComps() * colorMap->getBits(), image);
+  op->arg = addImage(image);
+}
+
+void DisplayListOutputDev::drawSoftMaskedImage(GfxState *state, Object *ref,
+					       Stream *str,
+					       int width, int height,
+					       GfxImageColorMap *colorMap,
+					       GBool interpolate,
+					       Stream *maskStr,
+					       int maskWidth, int maskHeight,
+					       GfxImageColorMap *maskColorMap,
+					       GBool maskInterpolate) {
+  DisplayListImage *image, *mask;
+  DisplayListOp *op;
+
+  op = addOp(state, dlDrawSoftMaskedImage);
+  image = new DisplayListImage();
+  image->colorMap = colorMap->copy();
+  image->interpolate = interpolate;
+  mask = new DisplayListImage();
+  mask->colorMap = maskColorMap->copy();
+  mask->interpolate = maskInterpolate;
+  image->mask = mask;
+  readImage(maskStr, maskWidth, maskHeight,
+	    maskColorMap->getNumPixelComps() * maskColorMap->getBits(), mask);
+  readImage(str, width, height,
+	    colorMap->getNumPixelComps() * colorMap->getBits(), image);
+  op->arg = addImage(image);
+}
+
+void DisplayListOutputDev::type3D0(GfxState *state, double wx, double wy) {
+  DisplayListOp *op;
+
+  op = addOp(state, dlType3D0);
+  op->d[0] = wx;
+  op->d[1] = wy;
+}
+
+void DisplayListOutputDev::type3D1(GfxState *state, double wx, double wy,
+				   double llx, double lly,
+				   double urx, double ury) {
+  DisplayListOp *op;
+
+  op = addOp(state, dlType3D1);
+  op->d[0] = wx;
+  op->d[1] = wy;
+  op->d[2] = llx;
+  op->d[3] = lly;
+  op->d[4] = urx;
+  op->d[5] = ury;
+}
+
+void DisplayListOutputDev::beginTransparencyGroup(GfxState *state,
+						  double *bbox,
+						  GfxColorSpace *blendingColorSpace,
+						  GBool isolated,
+						  GBool knockout,
+						  GBool forSoftMask) {
+  DisplayListOp *op;
+  int i;
+
+  op = addOp(state, dlBeginTransparencyGroup);
+  for (i = 0; i < 4; ++i) {
+    op->d[i] = bbox[i];
+  }
+  if (blendingColorSpace) {
+    list->colorSpaces.push_back(blendingColorSpace->copy());
+    op->arg = (int)list->colorSpaces.size() - 1;
+  }
+  if (isolated) {
+    op->flags |= dlFlagIsolated;
+  }
+  if (knockout) {
+    op->flags |= dlFlagKnockout;
+  }
+  if (forSoftMask) {
+    op->flags |= dlFlagForSoftMask;
+  }
+}
+
+void DisplayListOutputDev::endTransparencyGroup(GfxState *state) {
+  addOp(state, dlEndTransparencyGroup);
+}
+
+void DisplayListOutputDev::paintTransparencyGroup(GfxState *state,
+						  double *bbox) {
+  DisplayListOp *op;
+  int i;
+
+  op = addOp(state, dlPaintTransparencyGroup);
+  for (i = 0; i < 4; ++i) {
+    op->d[i] = bbox[i];
+  }
+}
+
+void DisplayListOutputDev::setSoftMask(GfxState *state, double *bbox,
+				       GBool alpha, Function *transferFunc,
+				       GfxColor *backdropColor) {
+  DisplayListSoftMask *softMask;
+  DisplayListOp *op;
+  int i;
+
+  op = addOp(state, dlSetSoftMask);
+  for (i = 0; i < 4; ++i) {
+    op->d[i] = bbox[i];
+  }
+  if (alpha) {
+    op->flags |= dlFlagAlpha;
+  }
+  softMask = new DisplayListSoftMask;
+  softMask->transferFunc = transferFunc ? transferFunc->copy()
+                                        : (Function *)NULL;
+  softMask->hasBackdropColor = backdropColor != NULL;
+  if (backdropColor) {
+    softMask->backdropColor = *backdropColor;
+  }
+  list->softMasks.push_back(softMask);
+  op->arg = (int)list->softMasks.size() - 1;
+}
+
+void DisplayListOutputDev::clearSoftMask(GfxState *state) {
+  addOp(state, dlClearSoftMask);
+}
+
+void DisplayListOutputDev::setVectorAntialias(GBool vaa) {
+  DisplayListOp *op;
+
+  vectorAntialias = vaa;
+  op = list->addOp(dlSetVectorAntialias, -1);
+  if (vaa) {
+    op->flags |= dlFlagOn;
+  }
+}
+
+//------------------------------------------------------------------------
+// DisplayListCacheKey
+//------------------------------------------------------------------------
+
+DisplayListCacheKey::DisplayListCacheKey(OutputDev *out,
+					 double hDPIA, double vDPIA,
+					 int rotateA, GBool useMediaBoxA,
+					 GBool cropA, GBool printingA) {
+  devType = &typeid(*out);
+  upsideDown = out->upsideDown();
+  hDPI = hDPIA;
+  vDPI = vDPIA;
+  rotate = rotateA;
+  useMediaBox = useMediaBoxA;
+  crop = cropA;
+  printing = printingA;
+}
+
+Guint DisplayListCacheKey::hash() const {
+  Guint h;
+
+  h = (Guint)(hDPI * 16) * 2654435761u;
+  h ^= (Guint)(vDPI * 16) * 40503u;
+  h ^= (Guint)rotate << 4;
+  h ^= (upsideDown ? 8 : 0) ^ (useMediaBox ? 4 : 0) ^ (crop ? 2 : 0) ^
+       (printing ? 1 : 0);
+  return h;
+}
+
+bool DisplayListCacheKey::operator==(const DisplayListCacheKey &key) const {
+  return *devType == *key.devType && upsideDown == key.upsideDown &&
+         hDPI == key.hDPI && vDPI == key.vDPI && rotate == key.rotate &&
+         useMediaBox == key.useMediaBox && crop == key.crop &&
+         printing == key.printing;
+}
+
+//------------------------------------------------------------------------
+// DisplayListCache
+//------------------------------------------------------------------------
+
+// The cache holds one reference to each of its lists, an evicted list
+// lives on until the replays using it are done.
+class DisplayListCacheItem {
+public:
+
+  DisplayListCacheItem(DisplayList *listA): list(listA)
+    { list->incRefCnt(); }
+  ~DisplayListCacheItem() { list->decRefCnt(); }
+
+  DisplayList *list;
+};
+
+DisplayListCache::DisplayListCache(int maxListsA) {
+  cache = new PopplerCache<DisplayListCacheKey, DisplayListCacheItem>(
+		  maxListsA > 0 ? maxListsA : 1);
+}
+
+DisplayListCache::~DisplayListCache() {
+  delete cache;
+}
+
+DisplayList *DisplayListCache::lookup(const DisplayListCacheKey &key) {
+  DisplayListCacheItem *item;
+
+  if (!(item = cache->lookup(key))) {
+    return NULL;
+  }
+  item->list->incRefCnt();
+  return item->list;
+}
+
+void DisplayListCache::put(const DisplayListCacheKey &key,
+			   DisplayList *list) {
+  cache->put(key, new DisplayListCacheItem(list), list->getSize());
+}
@@ -0,0 +1,397 @@
+//========================================================================
+//
+// DisplayListOutputDev.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef DISPLAYLISTOUTPUTDEV_H
+#define DISPLAYLISTOUTPUTDEV_H
+
+#include "poppler-config.h"
+#include "goo/gtypes.h"
+#include "CharTypes.h"
+#include "Object.h"
+#include "GfxState.h"
+#include "OutputDev.h"
+#include "Page.h"
+#include "PopplerCache.h"
+
+#include <vector>
+#include <typeinfo>
+
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
+
+class GooList;
+class GooString;
+class PDFDoc;
+class XRef;
+struct DisplayListImage;
+class DisplayListCacheItem;
+struct DisplayListSoftMask;
+
+//------------------------------------------------------------------------
+// DisplayListOp
+//------------------------------------------------------------------------
+
+struct DisplayListOp {
+  int kind;			// DisplayListOpKind
+  int state;			// index of the state to switch to, or -1
+  int arg;			// path, image, string, ... index, or -1
+  int flags;
+  double d[6];			// numeric arguments
+  CharCode code;
+  int nBytes;
+  int uStart, uLen;		// range in the Unicode table
+};
+
+//------------------------------------------------------------------------
+// DisplayList
+//
+// The sequence of OutputDev calls made by Gfx while displaying a page,
+// recorded by DisplayListOutputDev.  The calls are kept in one
+// contiguous array of fixed size records; graphics states, paths, image
+// data and strings live in side tables the records point into.  Image
+// data is stored after the stream filters have been applied, so replaying
+// a list doesn't parse or decode anything.
+//
+// Replaying a list into another OutputDev reproduces the calls in the
+// same order.  The list can be replayed at any resolution: the CTM of
+// every recorded state is mapped from the recording page transform to
+// the replay one.  Gfx makes a few resolution dependent decisions while
+// recording (Type 3 glyph caching, stroke adjustment, ...), so only a
+// replay at the recording resolution is guaranteed to match a direct
+// display of the page exactly.  Such a replay can also be limited to a
+// slice of the page.
+//
+// Replays only read the list, so several threads may replay one list at
+// once.  Fonts are kept referenced by the recorded states, so a list
+// must not outlive the PDFDoc it was recorded from.
+//------------------------------------------------------------------------
+
+class DisplayList {
+public:
+
+  DisplayList();
+
+  // Lists are reference counted, the creator holds the first reference.
+  void incRefCnt();
+  void decRefCnt();
+
+  // Replay the list into <out> at <hDPI> x <vDPI>, calling startPage()
+  // and endPage() around the recorded calls.
+  void replay(OutputDev *out, double hDPI, double vDPI);
+
+  // Replay the device area (<sliceX>, <sliceY>, <sliceW>, <sliceH>) of
+  // the page at the recording resolution into <out>, whose page is that
+  // area.  <out> must have the same upsideDown() as the recording device.
+  // The area is cut out by moving the device space by whole pixels, so
+  // it matches the full page replay except where coordinates that fall
+  // exactly on a pixel boundary round the other way.
+  void replaySlice(OutputDev *out, int sliceX, int sliceY,
+		   int sliceW, int sliceH);
+
+  // Whether a replay at the recording resolution draws exactly what a
+  // direct display of the page into the recording device draws.  This
+  // isn't the case when the device would have filled tiling patterns
+  // itself, they are recorded as the drawing of their cells.
+  GBool isExact() { return exact; }
+
+  // Page the list was recorded from.
+  int getPageNum() { return pageNum; }
+
+  // Number of recorded calls.
+  int getNumOps() { return (int)ops.size(); }
+
+  // Approximate memory used by the list, in bytes.
+  size_t getSize() { return size; }
+
+private:
+
+  ~DisplayList();
+
+  DisplayListOp *addOp(int kind, int state);
+  int addPath(GfxPath *path);
+  void replayPage(OutputDev *out, GfxState *page, double *m,
+		  double offX, double offY);
+
+  int pageNum;
+  XRef *xref;
+  double hDPI, vDPI;		// resolution of the recording state
+  PDFRectangle box;		// page box of the recording state
+  int rotate;
+  GBool upsideDown;
+  double baseCTM[6];		// CTM of the recording page state
+  std::vector<DisplayListOp> ops;
+  std::vector<GfxState *> states;
+  std::vector<GfxPath *> paths;
+  std::vector<Unicode> unicode;
+  std::vector<DisplayListImage *> images;
+  std::vector<DisplayListSoftMask *> softMasks;
+  std::vector<GfxColorSpace *> colorSpaces;
+  std::vector<GfxShading *> shadings;
+  GooList *strings;		// [GooString]
+  size_t size;
+  GBool exact;
+  int refCnt;
+#if MULTITHREADED
+  GooMutex mutex;
+#endif
+
+  friend class DisplayListOutputDev;
+};
+
+//------------------------------------------------------------------------
+// DisplayListOutputDev
+//
+// Records the calls it receives into a DisplayList.  The capability
+// queries Gfx makes (upsideDown, interpretType3Chars, useShadedFills,
+// ...) are answered by <protoA>, which should be of the same class as
+// the devices the list will be replayed into; <protoA> is never drawn
+// into.  Shaded fills the device handles are recorded as such, so the
+// replay device rasterizes them at its own resolution.  Tiling patterns
+// are reduced to the drawing of their cells, which loses no quality at
+// any zoom but doesn't match the tile bitmaps some devices fill them
+// with, see DisplayList::isExact().
+//------------------------------------------------------------------------
+
+class DisplayListOutputDev: public OutputDev {
+public:
+
+  DisplayListOutputDev(OutputDev *protoA);
+  virtual ~DisplayListOutputDev();
+
+  // Return the recorded list and start a new one.  The caller owns the
+  // reference to the returned list.
+  DisplayList *takeDisplayList();
+
+  //----- get info about output device
+  virtual GBool upsideDown() { return proto->upsideDown(); }
+  virtual GBool useDrawChar() { return proto->useDrawChar(); }
+  virtual GBool interpretType3Chars() { return proto->interpretType3Chars(); }
+  virtual GBool needNonText() { return proto->needNonText(); }
+  virtual GBool needCharCount() { return proto->needCharCount(); }
+  virtual GBool needClipToCropBox() { return proto->needClipToCropBox(); }
+  virtual GBool useShadedFills(int type)
+    { return proto->useShadedFills(type); }
+  virtual GBool useTilingPatternFill();
+
+  //----- initialization and control
+  virtual void startPage(int pageNum, GfxState *state, XRef *xref);
+  virtual void endPage();
+
+  //----- save/restore graphics state
+  virtual void saveState(GfxState *state);
+  virtual void restoreState(GfxState *state);
+
+  //----- update graphics state
+  virtual void updateAll(GfxState *state);
+  virtual void updateCTM(GfxState *state, double m11, double m12,
+			 double m21, double m22, double m31, double m32);
+  virtual void updateLineDash(GfxState *state);
+  virtual void updateFlatness(GfxState *state);
+  virtual void updateLineJoin(GfxState *state);
+  virtual void updateLineCap(GfxState *state);
+  virtual void updateMiterLimit(GfxState *state);
+  virtual void updateLineWidth(GfxState *state);
+  virtual void updateStrokeAdjust(GfxState *state);
+  virtual void updateAlphaIsShape(GfxState *state);
+  virtual void updateTextKnockout(GfxState *state);
+  virtual void updateFillColorSpace(GfxState *state);
+  virtual void updateStrokeColorSpace(GfxState *state);
+  virtual void updateFillColor(GfxState *state);
+  virtual void updateStrokeColor(GfxState *state);
+  virtual void updateBlendMode(GfxState *state);
+  virtual void updateFillOpacity(GfxState *state);
+  virtual void updateStrokeOpacity(GfxState *state);
+  virtual void updatePatternOpacity(GfxState *state);
+  virtual void clearPatternOpacity(GfxState *state);
+  virtual void updateFillOverprint(GfxState *state);
+  virtual void updateStrokeOverprint(GfxState *state);
+  virtual void updateOverprintMode(GfxState *state);
+  virtual void updateTransfer(GfxState *state);
+
+  //----- update text state
+  virtual void updateFont(GfxState *state);
+  virtual void updateTextMat(GfxState *state);
+  virtual void updateCharSpace(GfxState *state);
+  virtual void updateRender(GfxState *state);
+  virtual void updateRise(GfxState *state);
+  virtual void updateWordSpace(GfxState *state);
+  virtual void updateHorizScaling(GfxState *state);
+  virtual void updateTextPos(GfxState *state);
+  virtual void updateTextShift(GfxState *state, double shift);
+  virtual void saveTextPos(GfxState *state);
+  virtual void restoreTextPos(GfxState *state);
+
+  //----- path painting
+  virtual void stroke(GfxState *state);
+  virtual void fill(GfxState *state);
+  virtual void eoFill(GfxState *state);
+  virtual GBool functionShadedFill(GfxState *state,
+				   GfxFunctionShading *shading);
+  virtual GBool axialShadedFill(GfxState *state, GfxAxialShading *shading,
+				double tMin, double tMax);
+  virtual GBool axialShadedSupportExtend(GfxState *state,
+					 GfxAxialShading *shading)
+    { return proto->axialShadedSupportExtend(state, shading); }
+  virtual GBool radialShadedFill(GfxState *state, GfxRadialShading *shading,
+				 double sMin, double sMax);
+  virtual GBool radialShadedSupportExtend(GfxState *state,
+					  GfxRadialShading *shading)
+    { return proto->radialShadedSupportExtend(state, shading); }
+  virtual GBool gouraudTriangleShadedFill(GfxState *state,
+					  GfxGouraudTriangleShading *shading);
+  virtual GBool patchMeshShadedFill(GfxState *state,
+				    GfxPatchMeshShading *shading);
+
+  //----- path clipping
+  virtual void clip(GfxState *state);
+  virtual void eoClip(GfxState *state);
+  virtual void clipToStrokePath(GfxState *state);
+
+  //----- text drawing
+  virtual void beginStringOp(GfxState *state);
+  virtual void endStringOp(GfxState *state);
+  virtual void beginString(GfxState *state, GooString *s);
+  virtual void endString(GfxState *state);
+  virtual void drawChar(GfxState *state, double x, double y,
+			double dx, double dy,
+			double originX, double originY,
+			CharCode code, int nBytes, Unicode *u, int uLen);
+  virtual void drawString(GfxState *state, GooString *s);
+  virtual GBool beginType3Char(GfxState *state, double x, double y,
+			       double dx, double dy,
+			       CharCode code, Unicode *u, int uLen);
+  virtual void endType3Char(GfxState *state);
+  virtual void beginTextObject(GfxState *state);
+  virtual void endTextObject(GfxState *state);
+  virtual void incCharCount(int nChars);
+  virtual void beginActualText(GfxState *state, GooString *text);
+  virtual void endActualText(GfxState *state);
+
+  //----- image drawing
+  virtual void drawImageMask(GfxState *state, Object *ref, Stream *str,
+			     int width, int height, GBool invert,
+			     GBool interpolate, GBool inlineImg);
+  virtual void setSoftMaskFromImageMask(GfxState *state,
+					Object *ref, Stream *str,
+					int width, int height, GBool invert,
+					GBool inlineImg, double *baseMatrix);
+  virtual void unsetSoftMaskFromImageMask(GfxState *state, double *baseMatrix);
+  virtual void drawImage(GfxState *state, Object *ref, Stream *str,
+			 int width, int height, GfxImageColorMap *colorMap,
+			 GBool interpolate, int *maskColors, GBool inlineImg);
+  virtual void drawMaskedImage(GfxState *state, Object *ref, Stream *str,
+			       int width, int height,
+			       GfxImageColorMap *colorMap, GBool interpolate,
+			       Stream *maskStr, int maskWidth, int maskHeight,
+			       GBool maskInvert, GBool maskInterpolate);
+  virtual void drawSoftMaskedImage(GfxState *state, Object *ref, Stream *str,
+				   int width, int height,
+				   GfxImageColorMap *colorMap,
+				   GBool interpolate,
+				   Stream *maskStr,
+				   int maskWidth, int maskHeight,
+				   GfxImageColorMap *maskColorMap,
+				   GBool maskInterpolate);
+
+  //----- Type 3 font operators
+  virtual void type3D0(GfxState *state, double wx, double wy);
+  virtual void type3D1(GfxState *state, double wx, double wy,
+		       double llx, double lly, double urx, double ury);
+
+  //----- transparency groups and soft masks
+  // The answer depends on the state of the device the list is replayed
+  // into, so transparency groups are always recorded.
+  virtual GBool checkTransparencyGroup(GfxState *state, GBool knockout)
+    { return gTrue; }
+  virtual void beginTransparencyGroup(GfxState *state, double *bbox,
+				      GfxColorSpace *blendingColorSpace,
+				      GBool isolated, GBool knockout,
+				      GBool forSoftMask);
+  virtual void endTransparencyGroup(GfxState *state);
+  virtual void paintTransparencyGroup(GfxState *state, double *bbox);
+  virtual void setSoftMask(GfxState *state, double *bbox, GBool alpha,
+			   Function *transferFunc, GfxColor *backdropColor);
+  virtual void clearSoftMask(GfxState *state);
+
+  virtual GBool getVectorAntialias() { return vectorAntialias; }
+  virtual void setVectorAntialias(GBool vaa);
+
+private:
+
+  void addUpdate(GfxState *state, int kind);
+  DisplayListOp *addOp(GfxState *state, int kind);
+  DisplayListOp *addPathOp(GfxState *state, int kind);
+  void addShadingOp(GfxState *state, int kind, GfxShading *shading);
+  void readImage(Stream *str, int width, int height, int bitsPerPixel,
+		 DisplayListImage *image);
+  int addImage(DisplayListImage *image);
+
+  OutputDev *proto;
+  DisplayList *list;
+  int curState;			// index of the last recorded state, or -1
+  int pendingOp;		// first update since the last snapshot, or -1
+  GBool stateChanged;		// state changed since the last snapshot
+  GBool vectorAntialias;
+};
+
+//------------------------------------------------------------------------
+// DisplayListCacheKey
+//
+// What a display list depends on besides the page: the parameters it was
+// displayed with, and the class and orientation of the device it was
+// recorded for.
+//------------------------------------------------------------------------
+
+class DisplayListCacheKey {
+public:
+
+  DisplayListCacheKey(OutputDev *out, double hDPIA, double vDPIA,
+		      int rotateA, GBool useMediaBoxA, GBool cropA,
+		      GBool printingA);
+
+  Guint hash() const;
+  bool operator==(const DisplayListCacheKey &key) const;
+
+  const std::type_info *devType;
+  GBool upsideDown;
+  double hDPI, vDPI;
+  int rotate;
+  GBool useMediaBox, crop, printing;
+};
+
+//------------------------------------------------------------------------
+// DisplayListCache
+//
+// Keeps the display lists most recently recorded for one page, see
+// GlobalParams::setDisplayListCacheSize().  The cache does no locking of
+// its own.
+//------------------------------------------------------------------------
+
+class DisplayListCache {
+public:
+
+  // Keep up to <maxListsA> display lists.
+  DisplayListCache(int maxListsA);
+  ~DisplayListCache();
+
+  // Return the list recorded for <key>, with a reference the caller must
+  // release, or NULL.
+  DisplayList *lookup(const DisplayListCacheKey &key);
+
+  // Add <list> for <key>; the cache takes its own reference.
+  void put(const DisplayListCacheKey &key, DisplayList *list);
+
+  void getStats(PopplerCacheStats *stats) { cache->getStats(stats); }
+
+private:
+
+  PopplerCache<DisplayListCacheKey, DisplayListCacheItem> *cache;
+};
+
+#endif
@@ -0,0 +1,550 @@
+//========================================================================
+//
+// DocIndex.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "goo/gmem.h"
+#include "goo/gfile.h"
+#include "goo/GooString.h"
+#include "Error.h"
+#include "Object.h"
+#include "Stream.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "MmapStream.h"
+#include "XRef.h"
+#include "Catalog.h"
+#include "Page.h"
+#include "PDFDoc.h"
+#include "Decrypt.h"
+#include "DocIndex.h"
+
+//------------------------------------------------------------------------
+
+#define docIndexMagic "PDFINDEX"
+#define docIndexVersion 2
+#define docIndexByteOrder 0x01020304
+
+// number of bytes at each end of the document that are checked
+#define docIndexCheckSize 1024
+
+// flags
+#define docIndexXRefStream    0x01
+#define docIndexReconstructed 0x02
+
+// The index file is written in native byte order and used in place, so
+// every section is a multiple of 8 bytes long.  The layout is: header,
+// entries[nEntries], streamEnds[nStreamEnds], pages[nPages], trailer.
+struct DocIndexHeader {
+  char magic[8];
+  Guint version;
+  Guint byteOrder;
+  Goffset fileSize;		// size of the document
+  Goffset fileTime;		// modification time of the document
+  Guchar digest[16];		// MD5 of the first and last kilobytes and
+				//   the document ID
+  Goffset mainXRefOffset;
+  Goffset trailerPos;		// position of the trailer dictionary that
+				//   holds the document ID, or -1
+  int nEntries;
+  int nStreamEnds;
+  int nPages;
+  int trailerLen;
+  int rootNum, rootGen;
+  int flags;
+  int reserved;
+};
+
+struct DocIndexEntry {
+  Goffset offset;
+  int gen;
+  int type;			// XRefEntryType
+};
+
+//------------------------------------------------------------------------
+
+// Name of the index file of <fileName> in <dir>.
+static GooString *getIndexFileName(GooString *dir, GooString *fileName) {
+  GooString *path, *name;
+  Guchar digest[16];
+  char hex[33];
+  int i;
+
+  if (isAbsolutePath(fileName->getCString())) {
+    path = fileName->copy();
+  } else {
+    path = getCurrentDir();
+    appendToPath(path, fileName->getCString());
+  }
+  md5((Guchar *)path->getCString(), path->getLength(), digest);
+  delete path;
+  for (i = 0; i < 16; ++i) {
+    sprintf(hex + 2 * i, "%02x", digest[i]);
+  }
+  name = dir->copy();
+  appendToPath(name, hex);
+  name->append(".pdfidx");
+  return name;
+}
+
+// Append the document ID <idObj> (the /ID array of the trailer) to
+// <id>.
+static void appendFileID(Object *idObj, GooString *id) {
+  Object obj;
+  int i;
+
+  if (!idObj->isArray()) {
+    return;
+  }
+  for (i = 0; i < idObj->arrayGetLength(); ++i) {
+    if (idObj->arrayGet(i, &obj)->isString()) {
+      id->appendf("{0:d}:", obj.getString()->getLength());
+      id->append(obj.getString());
+    }
+    obj.free();
+  }
+}
+
+// Find the trailer dictionary of the xref section at <xrefOffset>: it
+// follows the table of a classic section, and is the dictionary of an
+// xref stream.  Returns -1 if there is none.
+static Goffset findTrailer(BaseStream *str, Goffset xrefOffset,
+			   GBool xrefStream) {
+  Lexer *lexer;
+  Object obj;
+  Goffset pos;
+
+  obj.initNull();
+  lexer = new Lexer(NULL, str->makeSubStream(str->getStart() + xrefOffset,
+					     gFalse, 0, &obj));
+  pos = -1;
+  while (!lexer->getObj(&obj)->isEOF()) {
+    if (obj.isCmd(xrefStream ? "obj" : "trailer")) {
+      pos = lexer->getPos();
+      obj.free();
+      break;
+    }
+    obj.free();
+  }
+  delete lexer;
+  return pos;
+}
+
+// Read the document ID from the trailer dictionary at <trailerPos> in
+// <str>, and append it to <id>.  Returns false if there is no
+// dictionary there.
+static GBool readFileID(BaseStream *str, Goffset trailerPos, GooString *id) {
+  Parser *parser;
+  Object obj, dict, idObj;
+  GBool ok;
+
+  obj.initNull();
+  parser = new Parser(NULL,
+		      new Lexer(NULL, str->makeSubStream(trailerPos, gFalse,
+							 0, &obj)),
+		      gTrue);
+  parser->getObj(&obj);
+  if (obj.isStream()) {
+    dict.initDict(obj.streamGetDict());
+  } else {
+    obj.copy(&dict);
+  }
+  if ((ok = dict.isDict())) {
+    appendFileID(dict.dictLookup("ID", &idObj), id);
+    idObj.free();
+  }
+  dict.free();
+  obj.free();
+  delete parser;
+  return ok;
+}
+
+// MD5 of the first and last kilobytes of <str>, followed by the
+// document ID <id>.
+static void getFileDigest(BaseStream *str, GooString *id, Guchar *digest) {
+  GooString *buf;
+  Guchar chunk[docIndexCheckSize];
+  Goffset len;
+  int n;
+
+  buf = new GooString();
+  len = str->getLength();
+  str->setPos(str->getStart());
+  n = str->doGetChars(docIndexCheckSize, chunk);
+  buf->append((char *)chunk, n);
+  if (len > docIndexCheckSize) {
+    str->setPos(docIndexCheckSize, -1);
+    n = str->doGetChars(docIndexCheckSize, chunk);
+    buf->append((char *)chunk, n);
+  }
+  buf->append(id);
+  md5((Guchar *)buf->getCString(), buf->getLength(), digest);
+  delete buf;
+}
+
+// Create a temporary file next to the index file <name>, with a name
+// unique to this call, so that concurrent saves of the same index don't
+// write to the same file.  It is renamed to <name> once complete.
+static FILE *openTempIndexFile(GooString *name, GooString **tmpName) {
+#if defined(_WIN32)
+  *tmpName = name->copy();
+  (*tmpName)->appendf(".tmp{0:d}_{1:d}",
+		      (int)GetCurrentProcessId(), (int)GetCurrentThreadId());
+  return openFile((*tmpName)->getCString(), "wb");
+#else
+  FILE *f;
+  int fd;
+#if HAVE_MKSTEMP
+  *tmpName = name->copy();
+  (*tmpName)->append(".XXXXXX");
+  fd = mkstemp((*tmpName)->getCString());
+#else
+  int i;
+
+  fd = -1;
+  *tmpName = NULL;
+  for (i = 0; fd < 0 && i < 1000; ++i) {
+    delete *tmpName;
+    *tmpName = name->copy();
+    (*tmpName)->appendf(".tmp{0:d}_{1:d}", (int)getpid(), i);
+    fd = open((*tmpName)->getCString(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+  }
+#endif
+  if (fd < 0) {
+    return NULL;
+  }
+  if (!(f = fdopen(fd, "wb"))) {
+    close(fd);
+    unlink((*tmpName)->getCString());
+  }
+  return f;
+#endif
+}
+
+static void setPageInfo(DocIndexPage *pageInfo, int rotate,
+			PDFRectangle *mediaBox, PDFRectangle *cropBox) {
+  pageInfo->rotate = rotate;
+  pageInfo->mediaBox[0] = mediaBox->x1;
+  pageInfo->mediaBox[1] = mediaBox->y1;
+  pageInfo->mediaBox[2] = mediaBox->x2;
+  pageInfo->mediaBox[3] = mediaBox->y2;
+  pageInfo->cropBox[0] = cropBox->x1;
+  pageInfo->cropBox[1] = cropBox->y1;
+  pageInfo->cropBox[2] = cropBox->x2;
+  pageInfo->cropBox[3] = cropBox->y2;
+}
+
+//------------------------------------------------------------------------
+// DocIndex
+//------------------------------------------------------------------------
+
+DocIndex *DocIndex::load(GooString *dir, GooString *fileName,
+			 BaseStream *str) {
+  GooString *name;
+  GooString *id;
+  MmapFile *f;
+  DocIndex *index;
+  Guchar digest[16];
+
+  name = getIndexFileName(dir, fileName);
+  f = MmapFile::open(name);
+  delete name;
+  if (!f) {
+    return NULL;
+  }
+  index = new DocIndex(f);
+  if (!index->check()) {
+    error(errIO, -1, "Ignoring invalid index file '{0:t}'", f->getFileName());
+    delete index;
+    return NULL;
+  }
+  if (index->header->fileSize != str->getLength() ||
+      index->header->fileTime !=
+          (Goffset)getModTime(fileName->getCString())) {
+    delete index;
+    return NULL;
+  }
+  // the document ID is read from the trailer the index was made from
+  id = new GooString();
+  if (index->header->trailerPos >= 0 &&
+      !readFileID(str, index->header->trailerPos, id)) {
+    delete id;
+    delete index;
+    return NULL;
+  }
+  getFileDigest(str, id, digest);
+  delete id;
+  if (memcmp(digest, index->header->digest, 16)) {
+    delete index;
+    return NULL;
+  }
+  return index;
+}
+
+GBool DocIndex::save(GooString *dir, PDFDoc *doc) {
+  DocIndexHeader hdr;
+  DocIndexEntry entry;
+  DocIndexPage pageInfo;
+  XRefEntry *e;
+  XRef *xref;
+  BaseStream *str;
+  GooString *fileName, *name, *tmpName, *id, *fileID;
+  FileOutStream *outStr;
+  Page *page;
+  PageAttrs *attrs;
+  Object idObj;
+  Ref ref;
+  FILE *f;
+  Goffset trailerStart;
+  GBool ok;
+  int i;
+
+  xref = doc->getXRef();
+  str = doc->getBaseStream();
+  fileName = doc->getFileName();
+  if (!fileName || !str || xref->getTrailerDict()->isNone()) {
+    return gFalse;
+  }
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, docIndexMagic, 8);
+  hdr.version = docIndexVersion;
+  hdr.byteOrder = docIndexByteOrder;
+  hdr.fileSize = str->getLength();
+  if (!(hdr.fileTime = (Goffset)getModTime(fileName->getCString()))) {
+    return gFalse;
+  }
+  hdr.rootNum = xref->getRootNum();
+  hdr.rootGen = xref->getRootGen();
+  hdr.mainXRefOffset = xref->mainXRefOffset;
+  hdr.flags = (xref->isXRefStream() ? docIndexXRefStream : 0) |
+              (xref->xrefReconstructed ? docIndexReconstructed : 0);
+
+  // resolve the whole xref table first: looking up an entry can read
+  // more xref sections, or reconstruct the table
+  for (i = 0; i < xref->getNumObjects(); ++i) {
+    xref->getEntry(i, gFalse);
+  }
+  if (!xref->isOk()) {
+    return gFalse;
+  }
+
+  // the key includes the document ID from the parsed trailer; load()
+  // reads it again from the main xref section's trailer, so that one
+  // must hold the same ID (it may not, e.g. if the xref table was
+  // reconstructed, and then only the ends of the file are checked)
+  id = new GooString();
+  appendFileID(xref->getTrailerDict()->dictLookup("ID", &idObj), id);
+  idObj.free();
+  hdr.trailerPos = -1;
+  if (!xref->xrefReconstructed) {
+    hdr.trailerPos = findTrailer(str, hdr.mainXRefOffset,
+				 xref->isXRefStream());
+  }
+  fileID = new GooString();
+  if (hdr.trailerPos < 0 || !readFileID(str, hdr.trailerPos, fileID) ||
+      fileID->cmp(id)) {
+    hdr.trailerPos = -1;
+    id->clear();
+  }
+  delete fileID;
+  getFileDigest(str, id, hdr.digest);
+  delete id;
+
+  name = getIndexFileName(dir, fileName);
+  if (!(f = openTempIndexFile(name, &tmpName))) {
+    delete tmpName;
+    delete name;
+    return gFalse;
+  }
+  ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+
+  hdr.nEntries = xref->getNumObjects();
+  for (i = 0; ok && i < hdr.nEntries; ++i) {
+    e = xref->getEntry(i, gFalse);
+    entry.offset = e->offset;
+    entry.gen = e->gen;
+    entry.type = e->type;
+    ok = fwrite(&entry, sizeof(entry), 1, f) == 1;
+  }
+
+  hdr.nStreamEnds = xref->streamEndsLen;
+  if (ok && hdr.nStreamEnds > 0) {
+    ok = fwrite(xref->streamEnds, sizeof(Goffset), hdr.nStreamEnds, f) ==
+         (size_t)hdr.nStreamEnds;
+  }
+
+  // the boxes come from the page tree, the pages are only created if
+  // the tree is broken
+  hdr.nPages = doc->getNumPages();
+  for (i = 1; ok && i <= hdr.nPages; ++i) {
+    memset(&pageInfo, 0, sizeof(pageInfo));
+    if ((attrs = doc->getCatalog()->getPageAttrs(i, &ref))) {
+      pageInfo.num = ref.num;
+      pageInfo.gen = ref.gen;
+      setPageInfo(&pageInfo, attrs->getRotate(),
+		  attrs->getMediaBox(), attrs->getCropBox());
+      delete attrs;
+    } else if ((page = doc->getPage(i))) {
+      pageInfo.num = page->getRef().num;
+      pageInfo.gen = page->getRef().gen;
+      setPageInfo(&pageInfo, page->getRotate(),
+		  page->getMediaBox(), page->getCropBox());
+    } else {
+      pageInfo.num = pageInfo.gen = -1;
+    }
+    ok = fwrite(&pageInfo, sizeof(pageInfo), 1, f) == 1;
+  }
+
+  if (ok) {
+    trailerStart = Gftell(f);
+    outStr = new FileOutStream(f, 0);
+    PDFDoc::writeObject(xref->getTrailerDict(), outStr, xref, 0,
+			NULL, cryptRC4, 0, 0, 0);
+    outStr->printf("\n");
+    delete outStr;
+    // pad the file to a multiple of 8 bytes
+    hdr.trailerLen = (int)(Gftell(f) - trailerStart);
+    while (Gftell(f) & 7) {
+      fputc(' ', f);
+    }
+    ok = Gfseek(f, 0, SEEK_SET) == 0 &&
+         fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+  }
+
+  if (fclose(f) != 0) {
+    ok = gFalse;
+  }
+  if (ok) {
+#ifdef _WIN32
+    unlink(name->getCString());
+#endif
+    ok = rename(tmpName->getCString(), name->getCString()) == 0;
+  }
+  if (!ok) {
+    error(errIO, -1, "Couldn't write index file '{0:t}'", name);
+    unlink(tmpName->getCString());
+  }
+  delete tmpName;
+  delete name;
+  return ok;
+}
+
+DocIndex::DocIndex(MmapFile *fileA) {
+  file = fileA;
+  header = NULL;
+  entries = NULL;
+  nEntries = 0;
+  streamEnds = NULL;
+  nStreamEnds = 0;
+  pages = NULL;
+  nPages = 0;
+  trailer = NULL;
+  trailerLen = 0;
+}
+
+DocIndex::~DocIndex() {
+  file->decRefCnt();
+}
+
+GBool DocIndex::check() {
+  const char *p;
+  Goffset len;
+
+  if (file->getSize() < (Goffset)sizeof(DocIndexHeader)) {
+    return gFalse;
+  }
+  p = file->getData();
+  header = (DocIndexHeader *)p;
+  if (memcmp(header->magic, docIndexMagic, 8) ||
+      header->version != docIndexVersion ||
+      header->byteOrder != docIndexByteOrder ||
+      header->nEntries < 0 || header->nStreamEnds < 0 ||
+      header->nPages < 0 || header->trailerLen <= 0) {
+    return gFalse;
+  }
+  len = (Goffset)sizeof(DocIndexHeader) +
+        (Goffset)header->nEntries * sizeof(DocIndexEntry) +
+        (Goffset)header->nStreamEnds * sizeof(Goffset) +
+        (Goffset)header->nPages * sizeof(DocIndexPage) +
+        (Goffset)header->trailerLen;
+  if (len > file->getSize() || file->getSize() - len >= 8) {
+    return gFalse;
+  }
+
+  p += sizeof(DocIndexHeader);
+  entries = (DocIndexEntry *)p;
+  nEntries = header->nEntries;
+  p += nEntries * sizeof(DocIndexEntry);
+  streamEnds = (Goffset *)p;
+  nStreamEnds = header->nStreamEnds;
+  p += nStreamEnds * sizeof(Goffset);
+  pages = (DocIndexPage *)p;
+  nPages = header->nPages;
+  p += nPages * sizeof(DocIndexPage);
+  trailer = p;
+  trailerLen = header->trailerLen;
+  return gTrue;
+}
+
+void DocIndex::getEntry(int i, Goffset *offset, int *gen, int *type) {
+  *offset = entries[i].offset;
+  *gen = entries[i].gen;
+  *type = entries[i].type;
+  if (*type < xrefEntryFree || *type > xrefEntryNone) {
+    *type = xrefEntryFree;
+  }
+}
+
+int DocIndex::getRootNum() {
+  return header->rootNum;
+}
+
+int DocIndex::getRootGen() {
+  return header->rootGen;
+}
+
+Goffset DocIndex::getMainXRefOffset() {
+  return header->mainXRefOffset;
+}
+
+GBool DocIndex::isXRefStream() {
+  return (header->flags & docIndexXRefStream) ? gTrue : gFalse;
+}
+
+GBool DocIndex::wasReconstructed() {
+  return (header->flags & docIndexReconstructed) ? gTrue : gFalse;
+}
+
+const char *DocIndex::getTrailer(int *len) {
+  *len = trailerLen;
+  return trailer;
+}
+
+Goffset DocIndex::getStreamEnd(int i) {
+  return streamEnds[i];
+}
+
+DocIndexPage *DocIndex::getPage(int page) {
+  if (page < 1 || page > nPages || pages[page - 1].num < 0) {
+    return NULL;
+  }
+  return &pages[page - 1];
+}
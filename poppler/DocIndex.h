@@ -0,0 +1,107 @@
+//========================================================================
+//
+// DocIndex.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef DOCINDEX_H
+#define DOCINDEX_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include "poppler-config.h"
+#include "goo/gtypes.h"
+#include "Object.h"
+
+class GooString;
+class BaseStream;
+class MmapFile;
+class PDFDoc;
+struct DocIndexHeader;
+struct DocIndexEntry;
+
+//------------------------------------------------------------------------
+
+// Page parameters saved in the index.
+struct DocIndexPage {
+  int num, gen;			// page object, or -1 if the page is broken
+  int rotate;
+  int reserved;
+  double mediaBox[4];		// x1, y1, x2, y2
+  double cropBox[4];
+};
+
+//------------------------------------------------------------------------
+// DocIndex
+//
+// A cache file holding what PDFDoc works out when a document is opened:
+// the resolved xref table (including the result of reconstructing a
+// damaged one), the trailer dictionary, and the object ID and boxes of
+// each page.  The file is mapped into memory and used in place.
+//
+// Index files live in the directory set with
+// GlobalParams::setDocIndexDir(), named after the document's absolute
+// path.  An index is only used if the document's size, modification
+// time, first and last kilobytes and ID are unchanged.  The ID is read
+// from the trailer of the last xref section, where the index was made
+// from; if that trailer doesn't hold the document's ID (e.g. if the
+// xref table was reconstructed), only the other checks are made.
+//------------------------------------------------------------------------
+
+class DocIndex {
+public:
+
+  // Load the index of <fileName>, read through <str>, from <dir>.
+  // Returns NULL if there is no index or it doesn't match the file.
+  static DocIndex *load(GooString *dir, GooString *fileName, BaseStream *str);
+
+  // Write the index of <doc>, which must have been opened from a file
+  // and must not have been modified.  The boxes are read from the page
+  // tree; pages are only created if the tree is broken.
+  static GBool save(GooString *dir, PDFDoc *doc);
+
+  ~DocIndex();
+
+  // Xref table.
+  int getNumEntries() { return nEntries; }
+  void getEntry(int i, Goffset *offset, int *gen, int *type);
+  int getRootNum();
+  int getRootGen();
+  Goffset getMainXRefOffset();
+  GBool isXRefStream();
+  GBool wasReconstructed();
+
+  // Trailer dictionary, as PDF text.
+  const char *getTrailer(int *len);
+
+  // 'endstream' positions found when reconstructing a damaged xref.
+  int getNumStreamEnds() { return nStreamEnds; }
+  Goffset getStreamEnd(int i);
+
+  // Pages.  Returns NULL if <page> is out of range or was broken when
+  // the index was written.
+  int getNumPages() { return nPages; }
+  DocIndexPage *getPage(int page);
+
+private:
+
+  DocIndex(MmapFile *fileA);
+  GBool check();
+
+  MmapFile *file;
+  DocIndexHeader *header;
+  DocIndexEntry *entries;
+  int nEntries;
+  Goffset *streamEnds;
+  int nStreamEnds;
+  DocIndexPage *pages;
+  int nPages;
+  const char *trailer;
+  int trailerLen;
+};
+
+#endif
@@ -18,112 +18,196 @@
 
 #include "poppler-config.h"
 
-#if ENABLE_ZLIB_UNCOMPRESS
+#if ENABLE_ZLIB
 
+#include <string.h>
+#include "goo/GooString.h"
+#include "Error.h"
 #include "FlateStream.h"
 
-FlateStream::FlateStream(Stream *strA, int predictor, int columns, int colors, int bits) :
-  FilterStream(strA)
-{
+//------------------------------------------------------------------------
+// ZlibFlateStream
+//------------------------------------------------------------------------
+
+ZlibFlateStream::ZlibFlateStream(Stream *strA, int predictor, int columns,
+				 int colors, int bits):
+    FilterStream(strA) {
   if (predictor != 1) {
     pred = new StreamPredictor(this, predictor, columns, colors, bits);
+    if (!pred->isOk()) {
+      delete pred;
+      pred = NULL;
+    }
   } else {
     pred = NULL;
   }
-  out_pos = 0;
-  memset(&d_stream, 0, sizeof(d_stream));
-  inflateInit(&d_stream);
+
+  // inline image data is followed by the rest of the content stream,
+  // which must not be consumed by reading ahead
+  if (dynamic_cast<EmbedStream *>(str->getBaseStream())) {
+    inBufSize = 1;
+  } else {
+    inBufSize = zlibFlateInBufSize;
+  }
+
+  memset(&zStream, 0, sizeof(zStream));
+  if (inflateInit(&zStream) != Z_OK) {
+    error(errInternal, -1, "Couldn't initialize zlib");
+    status = Z_STREAM_ERROR;
+  } else {
+    status = Z_OK;
+  }
+  inputEOF = gTrue;
+  outPos = outLen = 0;
 }
 
-FlateStream::~FlateStream() {
-  inflateEnd(&d_stream);
-  delete pred;
+ZlibFlateStream::~ZlibFlateStream() {
+  inflateEnd(&zStream);
+  if (pred) {
+    delete pred;
+  }
   delete str;
 }
 
-void FlateStream::reset() {
-  //FIXME: what are the semantics of reset?
-  //i.e. how much intialization has to happen in the constructor?
-
-  /* reinitialize zlib */
-  inflateEnd(&d_stream);
-  memset(&d_stream, 0, sizeof(d_stream));
-  inflateInit(&d_stream);
-
-  str->reset();
-  d_stream.avail_in = 0;
-  status = Z_OK;
-  out_pos = 0;
-  out_buf_len = 0;
+void ZlibFlateStream::zlibReset(GBool unfiltered) {
+  if (unfiltered) {
+    str->unfilteredReset();
+  } else {
+    str->reset();
+  }
+  status = inflateReset(&zStream) == Z_OK ? Z_OK : Z_STREAM_ERROR;
+  zStream.next_in = NULL;
+  zStream.avail_in = 0;
+  inputEOF = gFalse;
+  outPos = outLen = 0;
 }
 
-int FlateStream::getRawChar() {
-  return doGetRawChar();
+void ZlibFlateStream::reset() {
+  zlibReset(gFalse);
 }
 
-void FlateStream::getRawChars(int nChars, int *buffer) {
-  for (int i = 0; i < nChars; ++i)
-    buffer[i] = doGetRawChar();
+void ZlibFlateStream::unfilteredReset() {
+  zlibReset(gTrue);
 }
 
-int FlateStream::getChar() {
-  if (pred)
+int ZlibFlateStream::getChar() {
+  if (pred) {
     return pred->getChar();
-  else
-    return getRawChar();
+  }
+  return doGetRawChar();
 }
 
-int FlateStream::lookChar() {
-  if (pred)
+int ZlibFlateStream::lookChar() {
+  if (pred) {
     return pred->lookChar();
-
-  if (fill_buffer())
+  }
+  if (outPos >= outLen && !fillBuffer()) {
     return EOF;
+  }
+  return outBuf[outPos];
+}
 
-  return out_buf[out_pos];
+int ZlibFlateStream::getRawChar() {
+  return doGetRawChar();
 }
 
-int FlateStream::fill_buffer() {
-  /* only fill the buffer if it has all been used */
-  if (out_pos >= out_buf_len) {
-    /* check if the flatestream has been exhausted */
-    if (status == Z_STREAM_END) {
-      return -1;
-    }
+void ZlibFlateStream::getRawChars(int nChars, int *buffer) {
+  int n, i;
 
-    /* set to the begining of out_buf */
-    d_stream.avail_out = sizeof(out_buf);
-    d_stream.next_out = out_buf;
-    out_pos = 0;
-
-    while (1) {
-      /* buffer is empty so we need to fill it */
-      if (d_stream.avail_in == 0) {
-	int c;
-	/* read from the source stream */
-	while (d_stream.avail_in < sizeof(in_buf) && (c = str->getChar()) != EOF) {
-	  in_buf[d_stream.avail_in++] = c;
-	}
-	d_stream.next_in = in_buf;
+  i = 0;
+  while (i < nChars) {
+    if (outPos >= outLen && !fillBuffer()) {
+      for (; i < nChars; ++i) {
+	buffer[i] = EOF;
       }
+      return;
+    }
+    n = outLen - outPos;
+    if (n > nChars - i) {
+      n = nChars - i;
+    }
+    for (; n > 0; --n) {
+      buffer[i++] = outBuf[outPos++];
+    }
+  }
+}
 
-      /* keep decompressing until we can't anymore */
-      if (d_stream.avail_out == 0 || d_stream.avail_in == 0 || (status != Z_OK && status != Z_BUF_ERROR))
+int ZlibFlateStream::getChars(int nChars, Guchar *buffer) {
+  if (pred) {
+    return pred->getChars(nChars, buffer);
+  }
+  return getRawBlock(nChars, buffer);
+}
+
+int ZlibFlateStream::getRawBlock(int nChars, Guchar *buffer) {
+  int n, i;
+
+  i = 0;
+  while (i < nChars) {
+    if (outPos < outLen) {
+      n = outLen - outPos;
+      if (n > nChars - i) {
+	n = nChars - i;
+      }
+      memcpy(buffer + i, outBuf + outPos, n);
+      outPos += n;
+      i += n;
+    } else if (nChars - i >= zlibFlateOutBufSize) {
+      // large reads are inflated directly into the caller's buffer
+      if ((n = inflateInto(buffer + i, nChars - i)) == 0) {
 	break;
-      status = inflate(&d_stream, Z_SYNC_FLUSH);
+      }
+      i += n;
+    } else if (!fillBuffer()) {
+      break;
     }
-
-    out_buf_len = sizeof(out_buf) - d_stream.avail_out;
-    if (status != Z_OK && status != Z_STREAM_END)
-      return -1;
-    if (!out_buf_len)
-      return -1;
   }
+  return i;
+}
+
+GBool ZlibFlateStream::fillBuffer() {
+  outPos = 0;
+  outLen = inflateInto(outBuf, zlibFlateOutBufSize);
+  return outLen > 0;
+}
 
-  return 0;
+// Inflate up to <len> bytes into <buffer>.  Returns the number of bytes
+// written, which is only less than <len> at the end of the stream or on
+// an error.
+int ZlibFlateStream::inflateInto(Guchar *buffer, int len) {
+  int n;
+
+  if (status != Z_OK) {
+    return 0;
+  }
+  zStream.next_out = buffer;
+  zStream.avail_out = len;
+  while (zStream.avail_out > 0) {
+    if (zStream.avail_in == 0 && !inputEOF) {
+      n = str->doGetChars(inBufSize, inBuf);
+      if (n <= 0) {
+	inputEOF = gTrue;
+      }
+      zStream.next_in = inBuf;
+      zStream.avail_in = n > 0 ? n : 0;
+    }
+    status = inflate(&zStream, Z_NO_FLUSH);
+    if (status == Z_BUF_ERROR && zStream.avail_in == 0 && inputEOF) {
+      // the stream is truncated: return what has been decoded
+      break;
+    }
+    if (status != Z_OK) {
+      if (status != Z_STREAM_END) {
+	error(errSyntaxError, getPos(), "FlateDecode error: {0:s}",
+	      zStream.msg ? zStream.msg : "unknown");
+      }
+      break;
+    }
+  }
+  return len - zStream.avail_out;
 }
 
-GooString *FlateStream::getPSFilter(int psLevel, const char *indent) {
+GooString *ZlibFlateStream::getPSFilter(int psLevel, const char *indent) {
   GooString *s;
 
   if (psLevel < 3 || pred) {
@@ -136,7 +220,7 @@ GooString *FlateStream::getPSFilter(int psLevel, const char *indent) {
   return s;
 }
 
-GBool FlateStream::isBinary(GBool last) {
+GBool ZlibFlateStream::isBinary(GBool last) {
   return str->isBinary(gTrue);
 }
 
@@ -16,62 +16,67 @@
 #pragma interface
 #endif
 
-
-#ifdef USE_GCC_PRAGMAS
-#pragma implementation
-#endif
-
 #include "poppler-config.h"
-#include <stdio.h>
-#include <stdlib.h>
-#include <stddef.h>
-#ifdef HAVE_UNISTD_H
-#include <unistd.h>
-#endif
-#include <string.h>
-#include <ctype.h>
-#include "goo/gmem.h"
-#include "goo/gfile.h"
-#include "Error.h"
+#include "goo/gtypes.h"
 #include "Object.h"
-#include "Decrypt.h"
 #include "Stream.h"
 
 extern "C" {
 #include <zlib.h>
 }
 
-class FlateStream: public FilterStream {
+//------------------------------------------------------------------------
+// ZlibFlateStream
+//
+// FlateDecode filter backed by zlib.  This replaces the builtin
+// FlateStream when poppler is configured with ENABLE_ZLIB_UNCOMPRESS,
+// and is always available when poppler is built with zlib.
+//------------------------------------------------------------------------
+
+#define zlibFlateInBufSize  16384
+#define zlibFlateOutBufSize 32768
+
+class ZlibFlateStream: public FilterStream {
 public:
 
-  FlateStream(Stream *strA, int predictor, int columns, int colors, int bits);
-  virtual ~FlateStream();
+  ZlibFlateStream(Stream *strA, int predictor, int columns,
+		  int colors, int bits);
+  virtual ~ZlibFlateStream();
   virtual StreamKind getKind() { return strFlate; }
   virtual void reset();
+  virtual void unfilteredReset();
   virtual int getChar();
   virtual int lookChar();
   virtual int getRawChar();
   virtual void getRawChars(int nChars, int *buffer);
+  virtual int getRawBlock(int nChars, Guchar *buffer);
   virtual GooString *getPSFilter(int psLevel, const char *indent);
   virtual GBool isBinary(GBool last = gTrue);
 
 private:
+
+  void zlibReset(GBool unfiltered);
   inline int doGetRawChar() {
-    if (fill_buffer())
+    if (outPos >= outLen && !fillBuffer()) {
       return EOF;
-
-    return out_buf[out_pos++];
+    }
+    return outBuf[outPos++];
   }
+  GBool fillBuffer();
+  int inflateInto(Guchar *buffer, int len);
+
+  virtual GBool hasGetChars() { return true; }
+  virtual int getChars(int nChars, Guchar *buffer);
 
-  int fill_buffer(void);
-  z_stream d_stream;
-  StreamPredictor *pred;
-  int status;
-  /* in_buf currently needs to be 1 or we over read from EmbedStreams */
-  unsigned char in_buf[1];
-  unsigned char out_buf[4096];
-  int out_pos;
-  int out_buf_len;
+  StreamPredictor *pred;	// predictor
+  z_stream zStream;
+  int status;			// last value returned by inflate
+  GBool inputEOF;		// set when the input has been exhausted
+  int inBufSize;		// number of bytes read from <str> at once
+  Guchar inBuf[zlibFlateInBufSize];
+  Guchar outBuf[zlibFlateOutBufSize];
+  int outPos;			// current index into <outBuf>
+  int outLen;			// number of valid bytes in <outBuf>
 };
 
 #endif
@@ -67,7 +67,9 @@
 #include "Dict.h"
 #include "Stream.h"
 #include "Lexer.h"
+#include "ContentCache.h"
 #include "Parser.h"
+#include "ObjectArena.h"
 #include "GfxFont.h"
 #include "GfxState.h"
 #include "OutputDev.h"
@@ -311,6 +313,38 @@ Operator Gfx::opTab[] = {
 
 #define numOps (sizeof(opTab) / sizeof(Operator))
 
+// Operator names are at most three chars long, so findOp() packs them
+// into an int and maps that to a slot of opHashTab with a
+// multiplicative hash.  opHashMul was found by an offline search over
+// the names in opTab: it puts each of them in a slot of its own.  If an
+// operator added later collides, initOpHash() reports it and findOp()
+// falls back to a binary search.
+#define opHashBits 8
+#define opHashMul 0x8091713fu
+
+Guchar Gfx::opHashTab[1 << opHashBits];
+Guint Gfx::opKeys[numOps];
+GBool Gfx::opNumArgs[numOps];
+
+static inline Guint opHash(Guint key) {
+  return (key * opHashMul) >> (32 - opHashBits);
+}
+
+static inline GBool packOpName(const char *name, Guint *key) {
+  Guint k;
+  int i;
+
+  k = 0;
+  for (i = 0; name[i]; ++i) {
+    if (i == 3) {
+      return gFalse;
+    }
+    k |= (Guint)(Guchar)name[i] << (8 * i);
+  }
+  *key = k;
+  return gTrue;
+}
+
 static inline GBool isSameGfxColor(const GfxColor &colorA, const GfxColor &colorB, Guint nComps, double delta) {
   for (Guint k = 0; k < nComps; ++k) {
     if (abs(colorA.c[k] - colorB.c[k]) > delta) {
@@ -334,7 +368,7 @@ GfxResources::GfxResources(XRef *xref, Dict *resDictA, GfxResources *nextA) :
     // build font dictionary
     Dict *resDict = resDictA->copy(xref);
     fonts = NULL;
-    resDict->lookupNF("Font", &obj1);
+    resDict->lookupNF(atomFont, &obj1);
     if (obj1.isRef()) {
       obj1.fetch(xref, &obj2);
       if (obj2.isDict()) {
@@ -348,22 +382,22 @@ GfxResources::GfxResources(XRef *xref, Dict *resDictA, GfxResources *nextA) :
     obj1.free();
 
     // get XObject dictionary
-    resDict->lookup("XObject", &xObjDict);
+    resDict->lookup(atomXObject, &xObjDict);
 
     // get color space dictionary
-    resDict->lookup("ColorSpace", &colorSpaceDict);
+    resDict->lookup(atomColorSpace, &colorSpaceDict);
 
     // get pattern dictionary
-    resDict->lookup("Pattern", &patternDict);
+    resDict->lookup(atomPattern, &patternDict);
 
     // get shading dictionary
-    resDict->lookup("Shading", &shadingDict);
+    resDict->lookup(atomShading, &shadingDict);
 
     // get graphics state parameter dictionary
-    resDict->lookup("ExtGState", &gStateDict);
+    resDict->lookup(atomExtGState, &gStateDict);
 
     // get properties dictionary
-    resDict->lookup("Properties", &propertiesDict);
+    resDict->lookup(atomProperties, &propertiesDict);
 
     delete resDict;
   } else {
@@ -707,7 +741,10 @@ Gfx::~Gfx() {
   }
 }
 
-void Gfx::display(Object *obj, GBool topLevel) {
+void Gfx::display(Object *obj, GBool topLevel, const Ref *cacheRef) {
+  ContentCache *contentCache;
+  ContentTokens *tokens;
+  Lexer *lexer;
   Object obj2;
   int i;
 
@@ -725,13 +762,31 @@ void Gfx::display(Object *obj, GBool topLevel) {
     error(errSyntaxError, -1, "Weird page contents");
     return;
   }
-  parser = new Parser(xref, new Lexer(xref, obj), gFalse);
+  contentCache = cacheRef ? xref->getContentCache() : NULL;
+  tokens = NULL;
+  if (contentCache && (tokens = contentCache->lookup(*cacheRef))) {
+    lexer = new Lexer(xref, tokens);
+    tokens->decRef();
+    tokens = NULL;
+  } else {
+    lexer = new Lexer(xref, obj);
+    if (contentCache) {
+      tokens = contentCache->startRecording();
+      lexer->setRecorder(tokens);
+    }
+  }
+  parser = new Parser(xref, lexer, gFalse, new ObjectArena());
   go(topLevel);
+  parser->getArena()->release();
   delete parser;
   parser = NULL;
+  if (tokens) {
+    contentCache->put(*cacheRef, tokens);
+  }
 }
 
 void Gfx::go(GBool topLevel) {
+  ObjectArena *arena;
   Object obj;
   Object args[maxArgs];
   int numArgs, i;
@@ -786,6 +841,15 @@ void Gfx::go(GBool topLevel) {
 	args[i].free();
       numArgs = 0;
 
+      // unless an operator kept one of its arguments, nothing allocated
+      // from the arena is left, so its memory can be reused; a kept
+      // argument gets the arena to itself, so that it only holds the
+      // memory of its own operator's arguments
+      if ((arena = parser->getArena()) && !arena->reset()) {
+	arena->release();
+	parser->setArena(new ObjectArena());
+      }
+
       // periodically update display
       if (++updateLevel >= 20000) {
 	out->dump();
@@ -855,6 +919,21 @@ void Gfx::go(GBool topLevel) {
   }
 }
 
+inline GBool Gfx::checkArg(Object *arg, TchkType type) {
+  switch (type) {
+  case tchkBool:   return arg->isBool();
+  case tchkInt:    return arg->isInt();
+  case tchkNum:    return arg->isNum();
+  case tchkString: return arg->isString();
+  case tchkName:   return arg->isName();
+  case tchkArray:  return arg->isArray();
+  case tchkProps:  return arg->isDict() || arg->isName();
+  case tchkSCN:    return arg->isNum() || arg->isName();
+  case tchkNone:   return gFalse;
+  }
+  return gFalse;
+}
+
 void Gfx::execOp(Object *cmd, Object args[], int numArgs) {
   Operator *op;
   char *name;
@@ -869,6 +948,17 @@ void Gfx::execOp(Object *cmd, Object args[], int numArgs) {
     return;
   }
 
+  // fast path for the path, transform and text positioning operators
+  // (m, l, c, re, cm, Td, ...), which take a fixed number of numbers,
+  // and the ones without operands (q, Q, ...)
+  if (numArgs == op->numArgs && opNumArgs[op - opTab]) {
+    for (i = 0; i < numArgs && args[i].isNum(); ++i) ;
+    if (i == numArgs) {
+      (this->*op->func)(args, numArgs);
+      return;
+    }
+  }
+
   // type check args
   argPtr = args;
   if (op->numArgs >= 0) {
@@ -904,9 +994,48 @@ void Gfx::execOp(Object *cmd, Object args[], int numArgs) {
   (this->*op->func)(argPtr, numArgs);
 }
 
+GBool Gfx::initOpHash() {
+  Guint key;
+  int i, j, slot;
+
+  memset(opHashTab, 0, sizeof(opHashTab));
+  for (i = 0; i < (int)numOps; ++i) {
+    if (!packOpName(opTab[i].name, &key)) {
+      error(errInternal, -1, "Operator '{0:s}' is too long", opTab[i].name);
+      return gFalse;
+    }
+    opKeys[i] = key;
+    opNumArgs[i] = opTab[i].numArgs >= 0;
+    for (j = 0; j < opTab[i].numArgs; ++j) {
+      if (opTab[i].tchk[j] != tchkNum) {
+	opNumArgs[i] = gFalse;
+      }
+    }
+    slot = opHash(key);
+    if (opHashTab[slot]) {
+      error(errInternal, -1, "Operators '{0:s}' and '{1:s}' have the same hash",
+	    opTab[opHashTab[slot] - 1].name, opTab[i].name);
+      return gFalse;
+    }
+    opHashTab[slot] = (Guchar)(i + 1);
+  }
+  return gTrue;
+}
+
 Operator *Gfx::findOp(char *name) {
+  static GBool opHashOk = initOpHash();
+  Guint key;
   int a, b, m, cmp;
 
+  if (opHashOk) {
+    if (!packOpName(name, &key) ||
+	!(m = opHashTab[opHash(key)]) ||
+	opKeys[m - 1] != key) {
+      return NULL;
+    }
+    return &opTab[m - 1];
+  }
+
   a = -1;
   b = numOps;
   cmp = 0; // make gcc happy
@@ -926,21 +1055,6 @@ Operator *Gfx::findOp(char *name) {
   return &opTab[a];
 }
 
-GBool Gfx::checkArg(Object *arg, TchkType type) {
-  switch (type) {
-  case tchkBool:   return arg->isBool();
-  case tchkInt:    return arg->isInt();
-  case tchkNum:    return arg->isNum();
-  case tchkString: return arg->isString();
-  case tchkName:   return arg->isName();
-  case tchkArray:  return arg->isArray();
-  case tchkProps:  return arg->isDict() || arg->isName();
-  case tchkSCN:    return arg->isNum() || arg->isName();
-  case tchkNone:   return gFalse;
-  }
-  return gFalse;
-}
-
 Goffset Gfx::getPos() {
   return parser ? parser->getPos() : -1;
 }
@@ -1074,7 +1188,7 @@ void Gfx::opSetExtGState(Object args[], int numArgs) {
   obj2.free();
 #if 0 //~ need to add a new version of GfxResources::lookupFont() that
       //~ takes an indirect ref instead of a name
-  if (obj1.dictLookup("Font", &obj2)->isArray() &&
+  if (obj1.dictLookup(atomFont, &obj2)->isArray() &&
       obj2.arrayGetLength() == 2) {
     obj2.arrayGet(0, &args2[0]);
     obj2.arrayGet(1, &args2[1]);
@@ -1191,7 +1305,7 @@ void Gfx::opSetExtGState(Object args[], int numArgs) {
   obj2.free();
 
   // soft mask
-  if (!obj1.dictLookup("SMask", &obj2)->isNull()) {
+  if (!obj1.dictLookup(atomSMask, &obj2)->isNull()) {
     if (obj2.isName("None")) {
       out->clearSoftMask(state);
     } else if (obj2.isDict()) {
@@ -1276,7 +1390,7 @@ void Gfx::opSetExtGState(Object args[], int numArgs) {
     }
   }
   obj2.free();
-  if (obj1.dictLookup("Font", &obj2)->isArray()) {
+  if (obj1.dictLookup(atomFont, &obj2)->isArray()) {
     GfxFont *font;
     if (obj2.arrayGetLength() == 2) {
       Object fargs0, fargs1;
@@ -1372,7 +1486,7 @@ void Gfx::doSoftMask(Object *str, GBool alpha,
   obj1.free();
 
   // get bounding box
-  dict->lookup("BBox", &obj1);
+  dict->lookup(atomBBox, &obj1);
   if (!obj1.isArray()) {
     obj1.free();
     error(errSyntaxError, getPos(), "Bad form bounding box");
@@ -1392,7 +1506,7 @@ void Gfx::doSoftMask(Object *str, GBool alpha,
   obj1.free();
 
   // get matrix
-  dict->lookup("Matrix", &obj1);
+  dict->lookup(atomMatrix, &obj1);
   if (obj1.isArray()) {
     for (i = 0; i < 6; ++i) {
       obj1.arrayGet(i, &obj2);
@@ -1408,7 +1522,7 @@ void Gfx::doSoftMask(Object *str, GBool alpha,
   obj1.free();
 
   // get resources
-  dict->lookup("Resources", &obj1);
+  dict->lookup(atomResources, &obj1);
   resDict = obj1.isDict() ? obj1.getDict() : (Dict *)NULL;
 
   // draw it
@@ -4199,7 +4313,7 @@ void Gfx::opXObject(Object args[], int numArgs) {
     out->opiBegin(state, opiDict.getDict());
   }
 #endif
-  obj1.streamGetDict()->lookup("Subtype", &obj2);
+  obj1.streamGetDict()->lookup(atomSubtype, &obj2);
   if (obj2.isName("Image")) {
     if (out->needNonText()) {
       res->lookupXObjectNF(name, &refObj);
@@ -4222,7 +4336,12 @@ void Gfx::opXObject(Object args[], int numArgs) {
       if (out->useDrawForm() && refObj.isRef()) {
 	out->drawForm(refObj.getRef());
       } else {
-	doForm(&obj1);
+	if (refObj.isRef()) {
+	  Ref formRef = refObj.getRef();
+	  doForm(&obj1, &formRef);
+	} else {
+	  doForm(&obj1);
+	}
       }
     }
     if (refObj.isRef() && shouldDoForm) {
@@ -4287,7 +4406,7 @@ void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
   }
 
   // get size
-  dict->lookup("Width", &obj1);
+  dict->lookup(atomWidth, &obj1);
   if (obj1.isNull()) {
     obj1.free();
     dict->lookup("W", &obj1);
@@ -4299,7 +4418,7 @@ void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
   else
     goto err2;
   obj1.free();
-  dict->lookup("Height", &obj1);
+  dict->lookup(atomHeight, &obj1);
   if (obj1.isNull()) {
     obj1.free();
     dict->lookup("H", &obj1);
@@ -4329,7 +4448,7 @@ void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
   maskInterpolate = gFalse;
 
   // image or mask?
-  dict->lookup("ImageMask", &obj1);
+  dict->lookup(atomImageMask, &obj1);
   if (obj1.isNull()) {
     obj1.free();
     dict->lookup("IM", &obj1);
@@ -4343,7 +4462,7 @@ void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
 
   // bit depth
   if (bits == 0) {
-    dict->lookup("BitsPerComponent", &obj1);
+    dict->lookup(atomBitsPerComponent, &obj1);
     if (obj1.isNull()) {
       obj1.free();
       dict->lookup("BPC", &obj1);
@@ -4365,7 +4484,7 @@ void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
     if (bits != 1)
       goto err1;
     invert = gFalse;
-    dict->lookup("Decode", &obj1);
+    dict->lookup(atomDecode, &obj1);
     if (obj1.isNull()) {
       obj1.free();
       dict->lookup("D", &obj1);
@@ -4386,9 +4505,7 @@ void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
     if (!ocState || !out->needNonText()) {
       str->reset();
       n = height * ((width + 7) / 8);
-      for (i = 0; i < n; ++i) {
-	str->getChar();
-      }
+      str->discardChars(n);
       str->close();
 
     // draw it
@@ -4402,7 +4519,7 @@ void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
   } else {
 
     // get color space and color map
-    dict->lookup("ColorSpace", &obj1);
+    dict->lookup(atomColorSpace, &obj1);
     if (obj1.isNull()) {
       obj1.free();
       dict->lookup("CS", &obj1);
@@ -4467,7 +4584,7 @@ void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
     if (!colorSpace) {
       goto err1;
     }
-    dict->lookup("Decode", &obj1);
+    dict->lookup(atomDecode, &obj1);
     if (obj1.isNull()) {
       obj1.free();
       dict->lookup("D", &obj1);
@@ -4489,8 +4606,8 @@ void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
     maskWidth = maskHeight = 0; // make gcc happy
     maskInvert = gFalse; // make gcc happy
     maskColorMap = NULL; // make gcc happy
-    dict->lookup("Mask", &maskObj);
-    dict->lookup("SMask", &smaskObj);
+    dict->lookup(atomMask, &maskObj);
+    dict->lookup(atomSMask, &smaskObj);
     if (smaskObj.isStream()) {
       // soft mask
       if (inlineImg) {
@@ -4498,7 +4615,7 @@ void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
       }
       maskStr = smaskObj.getStream();
       maskDict = smaskObj.streamGetDict();
-      maskDict->lookup("Width", &obj1);
+      maskDict->lookup(atomWidth, &obj1);
       if (obj1.isNull()) {
 	obj1.free();
 	maskDict->lookup("W", &obj1);
@@ -4508,7 +4625,7 @@ void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
       }
       maskWidth = obj1.getInt();
       obj1.free();
-      maskDict->lookup("Height", &obj1);
+      maskDict->lookup(atomHeight, &obj1);
       if (obj1.isNull()) {
 	obj1.free();
 	maskDict->lookup("H", &obj1);
@@ -4528,7 +4645,7 @@ void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
       else
         maskInterpolate = gFalse;
       obj1.free();
-      maskDict->lookup("BitsPerComponent", &obj1);
+      maskDict->lookup(atomBitsPerComponent, &obj1);
       if (obj1.isNull()) {
 	obj1.free();
 	maskDict->lookup("BPC", &obj1);
@@ -4538,7 +4655,7 @@ void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
       }
       maskBits = obj1.getInt();
       obj1.free();
-      maskDict->lookup("ColorSpace", &obj1);
+      maskDict->lookup(atomColorSpace, &obj1);
       if (obj1.isNull()) {
 	obj1.free();
 	maskDict->lookup("CS", &obj1);
@@ -4557,7 +4674,7 @@ void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
       if (!maskColorSpace || maskColorSpace->getMode() != csDeviceGray) {
 	goto err1;
       }
-      maskDict->lookup("Decode", &obj1);
+      maskDict->lookup(atomDecode, &obj1);
       if (obj1.isNull()) {
 	obj1.free();
 	maskDict->lookup("D", &obj1);
@@ -4623,7 +4740,7 @@ void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
       }
       maskStr = maskObj.getStream();
       maskDict = maskObj.streamGetDict();
-      maskDict->lookup("Width", &obj1);
+      maskDict->lookup(atomWidth, &obj1);
       if (obj1.isNull()) {
 	obj1.free();
 	maskDict->lookup("W", &obj1);
@@ -4633,7 +4750,7 @@ void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
       }
       maskWidth = obj1.getInt();
       obj1.free();
-      maskDict->lookup("Height", &obj1);
+      maskDict->lookup(atomHeight, &obj1);
       if (obj1.isNull()) {
 	obj1.free();
 	maskDict->lookup("H", &obj1);
@@ -4653,7 +4770,7 @@ void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
       else
         maskInterpolate = gFalse;
       obj1.free();
-      maskDict->lookup("ImageMask", &obj1);
+      maskDict->lookup(atomImageMask, &obj1);
       if (obj1.isNull()) {
 	obj1.free();
 	maskDict->lookup("IM", &obj1);
@@ -4663,7 +4780,7 @@ void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
       }
       obj1.free();
       maskInvert = gFalse;
-      maskDict->lookup("Decode", &obj1);
+      maskDict->lookup(atomDecode, &obj1);
       if (obj1.isNull()) {
 	obj1.free();
 	maskDict->lookup("D", &obj1);
@@ -4688,9 +4805,7 @@ void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
       str->reset();
       n = height * ((width * colorMap->getNumPixelComps() *
 		     colorMap->getBits() + 7) / 8);
-      for (i = 0; i < n; ++i) {
-	str->getChar();
-      }
+      str->discardChars(n);
       str->close();
 
     // draw it
@@ -4736,7 +4851,7 @@ GBool Gfx::checkTransparencyGroup(Dict *resDict) {
   if (resDict == NULL)
     return gFalse;
   pushResources(resDict);
-  resDict->lookup("ExtGState", &extGStates);
+  resDict->lookup(atomExtGState, &extGStates);
   if (extGStates.isDict()) {
     Dict *dict = extGStates.getDict();
     for (int i = 0; i < dict->getLength() && !transpGroup; i++) {
@@ -4773,7 +4888,7 @@ GBool Gfx::checkTransparencyGroup(Dict *resDict) {
         }
         obj2.free();
         // soft mask
-        if (!transpGroup && !obj1.dictLookup("SMask", &obj2)->isNull()) {
+        if (!transpGroup && !obj1.dictLookup(atomSMask, &obj2)->isNull()) {
           if (!obj2.isName("None")) {
             transpGroup = gTrue;
           }
@@ -4788,7 +4903,7 @@ GBool Gfx::checkTransparencyGroup(Dict *resDict) {
   return transpGroup;
 }
 
-void Gfx::doForm(Object *str) {
+void Gfx::doForm(Object *str, const Ref *ref) {
   Dict *dict;
   GBool transpGroup, isolated, knockout;
   GfxColorSpace *blendingColorSpace;
@@ -4829,7 +4944,7 @@ void Gfx::doForm(Object *str) {
   obj1.free();
 
   // get bounding box
-  dict->lookup("BBox", &bboxObj);
+  dict->lookup(atomBBox, &bboxObj);
   if (!bboxObj.isArray()) {
     bboxObj.free();
     error(errSyntaxError, getPos(), "Bad form bounding box");
@@ -4850,7 +4965,7 @@ void Gfx::doForm(Object *str) {
   bboxObj.free();
 
   // get matrix
-  dict->lookup("Matrix", &matrixObj);
+  dict->lookup(atomMatrix, &matrixObj);
   if (matrixObj.isArray()) {
     for (i = 0; i < 6; ++i) {
       matrixObj.arrayGet(i, &obj1);
@@ -4866,7 +4981,7 @@ void Gfx::doForm(Object *str) {
   matrixObj.free();
 
   // get resources
-  dict->lookup("Resources", &resObj);
+  dict->lookup(atomResources, &resObj);
   resDict = resObj.isDict() ? resObj.getDict() : (Dict *)NULL;
 
   // check for a transparency group
@@ -4895,7 +5010,8 @@ void Gfx::doForm(Object *str) {
   // draw it
   ++formDepth;
   drawForm(str, resDict, m, bbox,
-	  transpGroup, gFalse, blendingColorSpace, isolated, knockout);
+	  transpGroup, gFalse, blendingColorSpace, isolated, knockout,
+	  gFalse, NULL, NULL, ref);
   --formDepth;
 
   if (blendingColorSpace) {
@@ -4911,7 +5027,7 @@ void Gfx::drawForm(Object *str, Dict *resDict, double *matrix, double *bbox,
 		  GfxColorSpace *blendingColorSpace,
 		  GBool isolated, GBool knockout,
 		  GBool alpha, Function *transferFunc,
-		  GfxColor *backdropColor) {
+		  GfxColor *backdropColor, const Ref *cacheRef) {
   Parser *oldParser;
   GfxState *savedState;
   double oldBaseMatrix[6];
@@ -4972,7 +5088,7 @@ void Gfx::drawForm(Object *str, Dict *resDict, double *matrix, double *bbox,
   GfxState *stateBefore = state;
 
   // draw the form
-  display(str, gFalse);
+  display(str, gFalse, cacheRef);
   
   if (stateBefore != state) {
     if (state->isParentState(stateBefore)) {
@@ -5044,7 +5160,7 @@ void Gfx::opBeginImage(Object args[], int numArgs) {
 Stream *Gfx::buildImageStream() {
   Object dict;
   Object obj;
-  char *key;
+  Object key;
   Stream *str;
 
   // build dictionary
@@ -5055,14 +5171,13 @@ Stream *Gfx::buildImageStream() {
       error(errSyntaxError, getPos(), "Inline image dictionary key must be a name object");
       obj.free();
     } else {
-      key = copyString(obj.getName());
-      obj.free();
+      obj.shallowCopy(&key);
       parser->getObj(&obj);
       if (obj.isEOF() || obj.isError()) {
-	gfree(key);
+	key.free();
 	break;
       }
-      dict.dictAdd(key, &obj);
+      dict.getDict()->add(&key, &obj);
     }
     parser->getObj(&obj);
   }
@@ -5315,7 +5430,7 @@ void Gfx::drawAnnot(Object *str, AnnotBorder *border, AnnotColor *aColor,
     dict = str->streamGetDict();
 
     // get the form bounding box
-    dict->lookup("BBox", &bboxObj);
+    dict->lookup(atomBBox, &bboxObj);
     if (!bboxObj.isArray()) {
       bboxObj.free();
       error(errSyntaxError, getPos(), "Bad form bounding box");
@@ -5336,7 +5451,7 @@ void Gfx::drawAnnot(Object *str, AnnotBorder *border, AnnotColor *aColor,
     bboxObj.free();
 
     // get the form matrix
-    dict->lookup("Matrix", &matrixObj);
+    dict->lookup(atomMatrix, &matrixObj);
     if (matrixObj.isArray() && matrixObj.arrayGetLength() >= 6) {
       for (i = 0; i < 6; ++i) {
 	matrixObj.arrayGet(i, &obj1);
@@ -5428,7 +5543,7 @@ void Gfx::drawAnnot(Object *str, AnnotBorder *border, AnnotColor *aColor,
     m[5] = m[5] * sy + ty;
 
     // get the resources
-    dict->lookup("Resources", &resObj);
+    dict->lookup(atomResources, &resObj);
     resDict = resObj.isDict() ? resObj.getDict() : (Dict *)NULL;
 
     // draw it
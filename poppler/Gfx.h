@@ -163,8 +163,11 @@ public:
 
   XRef *getXRef() { return xref; }
 
-  // Interpret a stream or array of streams.
-  void display(Object *obj, GBool topLevel = gTrue);
+  // Interpret a stream or array of streams.  If <cacheRef> is given, the
+  // tokens of the contents are looked up in, or added to, the
+  // document's ContentCache under that object ID.
+  void display(Object *obj, GBool topLevel = gTrue,
+	       const Ref *cacheRef = NULL);
 
   // Display an annotation, given its appearance (a Form XObject),
   // border style, and bounding box (in default user space).
@@ -193,7 +196,7 @@ public:
 	       GfxColorSpace *blendingColorSpace = NULL,
 	       GBool isolated = gFalse, GBool knockout = gFalse,
 	       GBool alpha = gFalse, Function *transferFunc = NULL,
-	       GfxColor *backdropColor = NULL);
+	       GfxColor *backdropColor = NULL, const Ref *cacheRef = NULL);
 
   void pushResources(Dict *resDict);
   void popResources();
@@ -234,9 +237,13 @@ private:
   void *abortCheckCbkData;
 
   static Operator opTab[];	// table of operators
+  static Guchar opHashTab[];	// operator hash table: opTab index + 1, or 0
+  static Guint opKeys[];	// packed names of the operators
+  static GBool opNumArgs[];	// all operands of the operator are numbers
 
   void go(GBool topLevel);
   void execOp(Object *cmd, Object args[], int numArgs);
+  static GBool initOpHash();
   Operator *findOp(char *name);
   GBool checkArg(Object *arg, TchkType type);
   Goffset getPos();
@@ -357,7 +364,7 @@ private:
   // XObject operators
   void opXObject(Object args[], int numArgs);
   void doImage(Object *ref, Stream *str, GBool inlineImg);
-  void doForm(Object *str);
+  void doForm(Object *str, const Ref *ref = NULL);
 
   // in-line image operators
   void opBeginImage(Object args[], int numArgs);
@@ -251,6 +251,9 @@ GfxFont::GfxFont(const char *tagA, Ref idA, GooString *nameA,
   refCnt = 1;
   encodingName = new GooString("");
   hasToUnicode = gFalse;
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
 }
 
 GfxFont::~GfxFont() {
@@ -265,14 +268,34 @@ GfxFont::~GfxFont() {
   if (encodingName) {
     delete encodingName;
   }
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
 }
 
+// Fonts are shared by the states of display lists, which can be replayed
+// by several threads at once.
 void GfxFont::incRefCnt() {
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
   refCnt++;
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
 }
 
 void GfxFont::decRefCnt() {
-  if (--refCnt == 0)
+  GBool done;
+
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  done = --refCnt == 0;
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+  if (done)
     delete this;
 }
 
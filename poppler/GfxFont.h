@@ -41,6 +41,10 @@
 #include "Object.h"
 #include "CharTypes.h"
 
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
+
 class Dict;
 class CMap;
 class CharCodeToUnicode;
@@ -310,6 +314,9 @@ protected:
   GBool ok;
   GBool hasToUnicode;
   GooString *encodingName;
+#if MULTITHREADED
+  GooMutex mutex;
+#endif
 };
 
 //------------------------------------------------------------------------
@@ -1847,38 +1847,6 @@ void GfxLabColorSpace::getDefaultRanges(double *decodeLow, double *decodeRange,
 // GfxICCBasedColorSpace
 //------------------------------------------------------------------------
 
-class GfxICCBasedColorSpaceKey : public PopplerCacheKey
-{
-  public:
-    GfxICCBasedColorSpaceKey(int numA, int genA) : num(numA), gen(genA)
-    {
-    }
-    
-    bool operator==(const PopplerCacheKey &key) const
-    {
-      const GfxICCBasedColorSpaceKey *k = static_cast<const GfxICCBasedColorSpaceKey*>(&key);
-      return k->num == num && k->gen == gen;
-    }
-    
-    int num, gen;
-};
-
-class GfxICCBasedColorSpaceItem : public PopplerCacheItem
-{
-  public:
-    GfxICCBasedColorSpaceItem(GfxICCBasedColorSpace *csA)
-    {
-      cs = static_cast<GfxICCBasedColorSpace*>(csA->copy());
-    }
-    
-    ~GfxICCBasedColorSpaceItem()
-    {
-      delete cs;
-    }
-    
-    GfxICCBasedColorSpace *cs;
-};
-
 GfxICCBasedColorSpace::GfxICCBasedColorSpace(int nCompsA, GfxColorSpace *altA,
 					     Ref *iccProfileStreamA) {
   nComps = nCompsA;
@@ -1946,11 +1914,10 @@ GfxColorSpace *GfxICCBasedColorSpace::parse(Array *arr, OutputDev *out, GfxState
 #ifdef USE_CMS
   // check cache
   if (out && iccProfileStreamA.num > 0) {
-    GfxICCBasedColorSpaceKey k(iccProfileStreamA.num, iccProfileStreamA.gen);
-    GfxICCBasedColorSpaceItem *item = static_cast<GfxICCBasedColorSpaceItem *>(out->getIccColorSpaceCache()->lookup(k));
+    GfxICCBasedColorSpace *item = out->getIccColorSpaceCache()->lookup(iccProfileStreamA);
     if (item != NULL)
     {
-      cs = static_cast<GfxICCBasedColorSpace*>(item->cs->copy());
+      cs = static_cast<GfxICCBasedColorSpace*>(item->copy());
       int transformIntent = cs->getIntent();
       int cmsIntent = INTENT_RELATIVE_COLORIMETRIC;
       if (state != NULL) {
@@ -2091,9 +2058,8 @@ GfxColorSpace *GfxICCBasedColorSpace::parse(Array *arr, OutputDev *out, GfxState
   obj1.free();
   // put this colorSpace into cache
   if (out && iccProfileStreamA.num > 0) {
-    GfxICCBasedColorSpaceKey *k = new GfxICCBasedColorSpaceKey(iccProfileStreamA.num, iccProfileStreamA.gen);
-    GfxICCBasedColorSpaceItem *item = new GfxICCBasedColorSpaceItem(cs);
-    out->getIccColorSpaceCache()->put(k, item);
+    out->getIccColorSpaceCache()->put(iccProfileStreamA,
+                                      static_cast<GfxICCBasedColorSpace*>(cs->copy()));
   }
 #endif
   return cs;
@@ -5995,25 +5961,26 @@ GfxImageColorMap::GfxImageColorMap(GfxImageColorMap *colorMap) {
   colorSpace2 = NULL;
   for (k = 0; k < gfxColorMaxComps; ++k) {
     lookup[k] = NULL;
+    lookup2[k] = NULL;
   }
+  byte_lookup = NULL;
+  // the tables are built for at most 8 bits, see the constructor
   n = 1 << bits;
+  if (n > 256) {
+    n = 256;
+  }
+  for (k = 0; k < nComps; ++k) {
+    lookup[k] = (GfxColorComp *)gmallocn(n, sizeof(GfxColorComp));
+    memcpy(lookup[k], colorMap->lookup[k], n * sizeof(GfxColorComp));
+  }
   if (colorSpace->getMode() == csIndexed) {
     colorSpace2 = ((GfxIndexedColorSpace *)colorSpace)->getBase();
-    for (k = 0; k < nComps2; ++k) {
-      lookup[k] = (GfxColorComp *)gmallocn(n, sizeof(GfxColorComp));
-      memcpy(lookup[k], colorMap->lookup[k], n * sizeof(GfxColorComp));
-    }
   } else if (colorSpace->getMode() == csSeparation) {
     colorSpace2 = ((GfxSeparationColorSpace *)colorSpace)->getAlt();
-    for (k = 0; k < nComps2; ++k) {
-      lookup[k] = (GfxColorComp *)gmallocn(n, sizeof(GfxColorComp));
-      memcpy(lookup[k], colorMap->lookup[k], n * sizeof(GfxColorComp));
-    }
-  } else {
-    for (k = 0; k < nComps; ++k) {
-      lookup[k] = (GfxColorComp *)gmallocn(n, sizeof(GfxColorComp));
-      memcpy(lookup[k], colorMap->lookup[k], n * sizeof(GfxColorComp));
-    }
+  }
+  for (k = 0; k < (colorSpace2 ? nComps2 : nComps); ++k) {
+    lookup2[k] = (GfxColorComp *)gmallocn(n, sizeof(GfxColorComp));
+    memcpy(lookup2[k], colorMap->lookup2[k], n * sizeof(GfxColorComp));
   }
   if (colorMap->byte_lookup) {
     int nc = colorSpace2 ? nComps2 : nComps;
@@ -7038,6 +7005,73 @@ void GfxState::shiftCTMAndClip(double tx, double ty) {
   clipYMax += ty;
 }
 
+void GfxState::mapToDevice(double *m, GfxState *pageState) {
+  double a, b, c, d, e, f, x, y;
+  double xMin, yMin, xMax, yMax;
+  int i;
+
+  a = ctm[0] * m[0] + ctm[1] * m[2];
+  b = ctm[0] * m[1] + ctm[1] * m[3];
+  c = ctm[2] * m[0] + ctm[3] * m[2];
+  d = ctm[2] * m[1] + ctm[3] * m[3];
+  e = ctm[4] * m[0] + ctm[5] * m[2] + m[4];
+  f = ctm[4] * m[1] + ctm[5] * m[3] + m[5];
+  setCTM(a, b, c, d, e, f);
+
+  // the clip bounding box is kept in device space
+  xMin = yMin = xMax = yMax = 0; // make gcc happy
+  for (i = 0; i < 4; ++i) {
+    x = (i & 1) ? clipXMax : clipXMin;
+    y = (i & 2) ? clipYMax : clipYMin;
+    a = x * m[0] + y * m[2] + m[4];
+    b = x * m[1] + y * m[3] + m[5];
+    if (i == 0 || a < xMin) {
+      xMin = a;
+    }
+    if (i == 0 || a > xMax) {
+      xMax = a;
+    }
+    if (i == 0 || b < yMin) {
+      yMin = b;
+    }
+    if (i == 0 || b > yMax) {
+      yMax = b;
+    }
+  }
+  clipXMin = xMin;
+  clipYMin = yMin;
+  clipXMax = xMax;
+  clipYMax = yMax;
+
+  hDPI = pageState->hDPI;
+  vDPI = pageState->vDPI;
+  rotate = pageState->rotate;
+  px1 = pageState->px1;
+  py1 = pageState->py1;
+  px2 = pageState->px2;
+  py2 = pageState->py2;
+  pageWidth = pageState->pageWidth;
+  pageHeight = pageState->pageHeight;
+}
+
+void GfxState::cropToDeviceArea(int x, int y, int w, int h) {
+  shiftCTMAndClip(-x, -y);
+  pageWidth = w;
+  pageHeight = h;
+  if (clipXMin < 0) {
+    clipXMin = 0;
+  }
+  if (clipYMin < 0) {
+    clipYMin = 0;
+  }
+  if (clipXMax > w) {
+    clipXMax = w;
+  }
+  if (clipYMax > h) {
+    clipYMax = h;
+  }
+}
+
 void GfxState::setFillColorSpace(GfxColorSpace *colorSpace) {
   if (fillColorSpace) {
     delete fillColorSpace;
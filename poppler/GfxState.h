@@ -50,7 +50,6 @@ class Gfx;
 class GfxFont;
 class PDFRectangle;
 class GfxShading;
-class PopplerCache;
 class GooList;
 class OutputDev;
 class GfxState;
@@ -1508,6 +1507,13 @@ public:
   void concatCTM(double a, double b, double c,
 		 double d, double e, double f);
   void shiftCTMAndClip(double tx, double ty);
+  // Move this state into the device space of <pageState>: <m> maps the
+  // device coordinates of this state to the ones of <pageState>, whose
+  // resolution, page box and rotation are taken over.
+  void mapToDevice(double *m, GfxState *pageState);
+  // Make the device area (<x>, <y>, <w>, <h>) the whole page: the CTM
+  // and clip are moved by (-<x>, -<y>) and the page becomes <w> x <h>.
+  void cropToDeviceArea(int x, int y, int w, int h);
   void setFillColorSpace(GfxColorSpace *colorSpace);
   void setStrokeColorSpace(GfxColorSpace *colorSpace);
   void setFillColor(GfxColor *color) { fillColor = *color; }
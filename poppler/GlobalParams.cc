@@ -622,6 +622,13 @@ GlobalParams::GlobalParams(const char *customPopplerDataDir)
   printCommands = gFalse;
   profileCommands = gFalse;
   errQuiet = gFalse;
+  docIndexDir = NULL;
+  xrefScanThreads = 0;
+  objStrCacheSize = defaultObjStrCacheSize;
+  contentCacheSize = 0;
+  glyphCacheSize = 0;
+  fontFacePoolSize = 0;
+  displayListCacheSize = 0;
 
   cidToUnicodeCache = new CharCodeToUnicodeCache(cidToUnicodeCacheSize);
   unicodeToUnicodeCache =
@@ -808,6 +815,7 @@ GlobalParams::~GlobalParams() {
   deleteGooList(psResidentFonts16, PSFontParam16);
   deleteGooList(psResidentFontsCC, PSFontParam16);
   delete textEncoding;
+  delete docIndexDir;
 
   GooHashIter *iter;
   GooString *key;
@@ -1692,6 +1700,69 @@ GBool GlobalParams::getErrQuiet() {
   return errQuiet;
 }
 
+GooString *GlobalParams::getDocIndexDir() {
+  GooString *s;
+
+  lockGlobalParams;
+  s = docIndexDir ? docIndexDir->copy() : (GooString *)NULL;
+  unlockGlobalParams;
+  return s;
+}
+
+int GlobalParams::getXRefScanThreads() {
+  int n;
+
+  lockGlobalParams;
+  n = xrefScanThreads;
+  unlockGlobalParams;
+  return n;
+}
+
+int GlobalParams::getObjStrCacheSize() {
+  int size;
+
+  lockGlobalParams;
+  size = objStrCacheSize;
+  unlockGlobalParams;
+  return size;
+}
+
+int GlobalParams::getContentCacheSize() {
+  int size;
+
+  lockGlobalParams;
+  size = contentCacheSize;
+  unlockGlobalParams;
+  return size;
+}
+
+int GlobalParams::getGlyphCacheSize() {
+  int size;
+
+  lockGlobalParams;
+  size = glyphCacheSize;
+  unlockGlobalParams;
+  return size;
+}
+
+int GlobalParams::getFontFacePoolSize() {
+  int size;
+
+  lockGlobalParams;
+  size = fontFacePoolSize;
+  unlockGlobalParams;
+  return size;
+}
+
+int GlobalParams::getDisplayListCacheSize() {
+  int size;
+
+  lockGlobalParams;
+  size = displayListCacheSize;
+  unlockGlobalParams;
+  return size;
+}
+
 CharCodeToUnicode *GlobalParams::getCIDToUnicode(GooString *collection) {
   GooString *fileName;
   CharCodeToUnicode *ctu;
@@ -1968,6 +2039,49 @@ void GlobalParams::setErrQuiet(GBool errQuietA) {
   unlockGlobalParams;
 }
 
+void GlobalParams::setDocIndexDir(char *dir) {
+  lockGlobalParams;
+  delete docIndexDir;
+  docIndexDir = dir ? new GooString(dir) : (GooString *)NULL;
+  unlockGlobalParams;
+}
+
+void GlobalParams::setXRefScanThreads(int n) {
+  lockGlobalParams;
+  xrefScanThreads = n;
+  unlockGlobalParams;
+}
+
+void GlobalParams::setObjStrCacheSize(int size) {
+  lockGlobalParams;
+  objStrCacheSize = size;
+  unlockGlobalParams;
+}
+
+void GlobalParams::setContentCacheSize(int size) {
+  lockGlobalParams;
+  contentCacheSize = size;
+  unlockGlobalParams;
+}
+
+void GlobalParams::setGlyphCacheSize(int size) {
+  lockGlobalParams;
+  glyphCacheSize = size;
+  unlockGlobalParams;
+}
+
+void GlobalParams::setFontFacePoolSize(int size) {
+  lockGlobalParams;
+  fontFacePoolSize = size;
+  unlockGlobalParams;
+}
+
+void GlobalParams::setDisplayListCacheSize(int size) {
+  lockGlobalParams;
+  displayListCacheSize = size;
+  unlockGlobalParams;
+}
+
 void GlobalParams::addSecurityHandler(XpdfSecurityHandler *handler) {
 #ifdef ENABLE_PLUGINS
   lockGlobalParams;
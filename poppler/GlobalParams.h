@@ -70,6 +70,9 @@ class SysFontList;
 // The global parameters object.
 extern GlobalParams *globalParams;
 
+// Default size of the object stream cache of each document, in bytes.
+#define defaultObjStrCacheSize (8 << 20)
+
 //------------------------------------------------------------------------
 
 enum SysFontType {
@@ -185,6 +188,13 @@ public:
   GBool getPrintCommands();
   GBool getProfileCommands();
   GBool getErrQuiet();
+  GooString *getDocIndexDir();
+  int getXRefScanThreads();
+  int getObjStrCacheSize();
+  int getContentCacheSize();
+  int getGlyphCacheSize();
+  int getFontFacePoolSize();
+  int getDisplayListCacheSize();
 
   CharCodeToUnicode *getCIDToUnicode(GooString *collection);
   CharCodeToUnicode *getUnicodeToUnicode(GooString *fontName);
@@ -224,6 +234,13 @@ public:
   void setPrintCommands(GBool printCommandsA);
   void setProfileCommands(GBool profileCommandsA);
   void setErrQuiet(GBool errQuietA);
+  void setDocIndexDir(char *dir);
+  void setXRefScanThreads(int n);
+  void setObjStrCacheSize(int size);
+  void setContentCacheSize(int size);
+  void setGlyphCacheSize(int size);
+  void setFontFacePoolSize(int size);
+  void setDisplayListCacheSize(int size);
 
   static GBool parseYesNo2(const char *token, GBool *flag);
 
@@ -311,6 +328,27 @@ private:
   GBool printCommands;		// print the drawing commands
   GBool profileCommands;	// profile the drawing commands
   GBool errQuiet;		// suppress error messages?
+  GooString *docIndexDir;	// directory for document index files
+				//   (DocIndex), or NULL to not use them
+  int xrefScanThreads;		// threads used to reconstruct damaged
+				//   xref tables, or 0 for one per CPU
+  int objStrCacheSize;		// bytes of parsed object streams kept
+				//   per document
+  int contentCacheSize;		// bytes of tokenized page and form
+				//   contents kept per document, or 0 to
+				//   not cache them
+  int glyphCacheSize;		// bytes of glyph bitmaps shared by all
+				//   Splash font engines in the process
+				//   (SplashGlyphCache), or 0 to not share
+				//   them
+  int fontFacePoolSize;		// bytes of embedded font data whose
+				//   FreeType faces are shared by all
+				//   Splash font engines in the process
+				//   (SplashFTFacePool), or 0 to not share
+				//   them
+  int displayListCacheSize;	// display lists kept per page by Page for
+				//   devices that use them, or 0 to not
+				//   record them
   double splashResolution;	// resolution when rasterizing images
 
   CharCodeToUnicodeCache *cidToUnicodeCache;
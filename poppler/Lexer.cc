@@ -38,6 +38,7 @@
 #include "Lexer.h"
 #include "Error.h"
 #include "XRef.h"
+#include "ContentCache.h"
 
 //------------------------------------------------------------------------
 
@@ -65,6 +66,61 @@ static const char specialChars[256] = {
 static const int IntegerSafeLimit = (INT_MAX - 9) / 10;
 static const long long LongLongSafeLimit = (LLONG_MAX - 9) / 10;
 
+//------------------------------------------------------------------------
+// LexerStream
+//------------------------------------------------------------------------
+
+// Reads the chars buffered by a Lexer, then the rest of its current
+// stream, without reading ahead.  This is used to make streams from the
+// lexer's position: inline image data in content streams, and stream
+// objects (through getPos() and getBaseStream()).
+class LexerStream: public Stream {
+public:
+
+  LexerStream(Lexer *lexerA) { lexer = lexerA; }
+  virtual StreamKind getKind() { return strWeird; }
+  virtual void reset() {}
+  virtual int getChar()
+    { return lexer->bufPtr < lexer->bufEnd ? *lexer->bufPtr++
+                                           : getCurStr()->getChar(); }
+  virtual int lookChar()
+    { return lexer->bufPtr < lexer->bufEnd ? *lexer->bufPtr
+                                           : getCurStr()->lookChar(); }
+  virtual int getUnfilteredChar() { return getChar(); }
+  virtual void unfilteredReset() {}
+  virtual Goffset getPos() { return lexer->getPos(); }
+  virtual void setPos(Goffset pos, int dir = 0) { lexer->setPos(pos, dir); }
+  virtual GBool isBinary(GBool last = gTrue)
+    { return getCurStr()->isBinary(last); }
+  virtual BaseStream *getBaseStream() { return getCurStr()->getBaseStream(); }
+  virtual Stream *getUndecodedStream() { return this; }
+  virtual Dict *getDict() { return getCurStr()->getDict(); }
+
+private:
+
+  Stream *getCurStr() { return lexer->curStr.getStream(); }
+
+  virtual GBool hasGetChars() { return true; }
+  virtual int getChars(int nChars, Guchar *buffer);
+
+  Lexer *lexer;
+};
+
+int LexerStream::getChars(int nChars, Guchar *buffer) {
+  int n;
+
+  n = (int)(lexer->bufEnd - lexer->bufPtr);
+  if (n > nChars) {
+    n = nChars;
+  }
+  memcpy(buffer, lexer->bufPtr, n);
+  lexer->bufPtr += n;
+  if (n < nChars) {
+    n += getCurStr()->doGetChars(nChars - n, buffer + n);
+  }
+  return n;
+}
+
 //------------------------------------------------------------------------
 // Lexer
 //------------------------------------------------------------------------
@@ -74,6 +130,10 @@ Lexer::Lexer(XRef *xrefA, Stream *str) {
 
   lookCharLastValueCached = LOOK_VALUE_NOT_CACHED;
   xref = xrefA;
+  clearBuf();
+  bufStr = NULL;
+  recTokens = replayTokens = NULL;
+  replayPos = 0;
 
   curStr.initStream(str);
   streams = new Array(xref);
@@ -88,6 +148,10 @@ Lexer::Lexer(XRef *xrefA, Object *obj) {
 
   lookCharLastValueCached = LOOK_VALUE_NOT_CACHED;
   xref = xrefA;
+  clearBuf();
+  bufStr = NULL;
+  recTokens = replayTokens = NULL;
+  replayPos = 0;
 
   if (obj->isStream()) {
     streams = new Array(xref);
@@ -104,6 +168,21 @@ Lexer::Lexer(XRef *xrefA, Object *obj) {
   }
 }
 
+Lexer::Lexer(XRef *xrefA, ContentTokens *tokens) {
+  lookCharLastValueCached = LOOK_VALUE_NOT_CACHED;
+  xref = xrefA;
+  clearBuf();
+  bufStr = NULL;
+  recTokens = NULL;
+  replayTokens = tokens;
+  replayTokens->incRef();
+  replayPos = 0;
+
+  streams = new Array(xref);
+  freeArray = gTrue;
+  strPtr = 0;
+}
+
 Lexer::~Lexer() {
   if (!curStr.isNone()) {
     curStr.streamClose();
@@ -112,6 +191,74 @@ Lexer::~Lexer() {
   if (freeArray) {
     delete streams;
   }
+  delete bufStr;
+  if (recTokens) {
+    recTokens->decRef();
+  }
+  if (replayTokens) {
+    replayTokens->decRef();
+  }
+}
+
+void Lexer::setRecorder(ContentTokens *tokens) {
+  if (recTokens) {
+    recTokens->decRef();
+  }
+  if ((recTokens = tokens)) {
+    recTokens->incRef();
+  }
+}
+
+void Lexer::spoilRecording() {
+  if (recTokens) {
+    recTokens->spoil();
+  }
+}
+
+Goffset Lexer::getPos() {
+  Stream *str;
+
+  if (!curStr.isStream()) {
+    return -1;
+  }
+  str = curStr.getStream();
+  if (str->getBaseStream() != str) {
+    return str->getPos();
+  }
+  return str->getPos() - (bufEnd - bufPtr);
+}
+
+Stream *Lexer::getStream() {
+  if (!curStr.isStream()) {
+    return NULL;
+  }
+  // the raw data (of an inline image) can't be replayed
+  spoilRecording();
+  if (!bufStr) {
+    bufStr = new LexerStream(this);
+  }
+  return bufStr;
+}
+
+GBool Lexer::fillBuf() {
+  const Guchar *span;
+  int n;
+
+  // streams that already hold their data in memory (memory and mapped
+  // files, decoded flate output) lend it to the lexer, which scans it in
+  // place
+  if ((n = curStr.getStream()->getSpan(INT_MAX, &span)) > 0) {
+    bufPtr = span;
+    bufEnd = span + n;
+    return gTrue;
+  }
+  n = curStr.getStream()->doGetChars(fillSize, buf);
+  bufPtr = buf;
+  bufEnd = buf + (n > 0 ? n : 0);
+  if (fillSize < lexerBufSize) {
+    fillSize *= 2;
+  }
+  return n > 0;
 }
 
 int Lexer::getChar(GBool comesFromLook) {
@@ -124,12 +271,13 @@ int Lexer::getChar(GBool comesFromLook) {
   }
 
   c = EOF;
-  while (!curStr.isNone() && (c = curStr.streamGetChar()) == EOF) {
+  while (!curStr.isNone() && (c = getBufChar()) == EOF) {
     if (comesFromLook == gTrue) {
       return EOF;
     } else {
       curStr.streamClose();
       curStr.free();
+      clearBuf();
       ++strPtr;
       if (strPtr < streams->getLength()) {
         streams->get(strPtr, &curStr);
@@ -155,6 +303,17 @@ int Lexer::lookChar() {
 }
 
 Object *Lexer::getObj(Object *obj, int objNum) {
+  if (replayTokens) {
+    return replayTokens->read(&replayPos, obj);
+  }
+  lexObj(obj, objNum);
+  if (recTokens) {
+    recTokens->add(obj);
+  }
+  return obj;
+}
+
+Object *Lexer::lexObj(Object *obj, int objNum) {
   char *p;
   int c, c2;
   GBool comment, neg, done, overflownInteger, overflownLongLong;
@@ -164,8 +323,14 @@ Object *Lexer::getObj(Object *obj, int objNum) {
   double xf = 0, scale;
   GooString *s;
   int n, m;
+  const Guchar *q;
 
   // skip whitespace and comments
+  if (lookCharLastValueCached == LOOK_VALUE_NOT_CACHED) {
+    while (bufPtr < bufEnd && specialChars[*bufPtr] == 1) {
+      ++bufPtr;
+    }
+  }
   comment = gFalse;
   while (1) {
     if ((c = getChar()) == EOF) {
@@ -188,6 +353,9 @@ Object *Lexer::getObj(Object *obj, int objNum) {
   case '0': case '1': case '2': case '3': case '4':
   case '5': case '6': case '7': case '8': case '9':
   case '+': case '-': case '.':
+    if (getNumberInBuf(c, obj)) {
+      break;
+    }
     overflownInteger = gFalse;
     overflownLongLong = gFalse;
     neg = gFalse;
@@ -279,6 +447,20 @@ Object *Lexer::getObj(Object *obj, int objNum) {
 
   // string
   case '(':
+    // strings without escapes or nested parentheses are copied straight
+    // from the buffer (long ones only when there is no object to check
+    // them against, see below)
+    if (lookCharLastValueCached == LOOK_VALUE_NOT_CACHED) {
+      for (q = bufPtr;
+	   q < bufEnd && *q != ')' && *q != '\\' && *q != '(';
+	   ++q) ;
+      if (q < bufEnd && *q == ')' &&
+	  (q - bufPtr <= tokBufSize || objNum <= 0 || !xref)) {
+	obj->initString(new GooString((const char *)bufPtr, (int)(q - bufPtr)));
+	bufPtr = q + 1;
+	break;
+      }
+    }
     p = tokBuf;
     n = 0;
     numParen = 1;
@@ -382,7 +564,7 @@ Object *Lexer::getObj(Object *obj, int objNum) {
 	  // we are growing see if the document is not malformed and we are growing too much
 	  if (objNum > 0 && xref != NULL)
 	  {
-	    int newObjNum = xref->getNumEntry(curStr.streamGetPos());
+	    int newObjNum = xref->getNumEntry(getPos());
 	    if (newObjNum != objNum)
 	    {
 	      error(errSyntaxError, getPos(), "Unterminated string");
@@ -409,6 +591,15 @@ Object *Lexer::getObj(Object *obj, int objNum) {
 
   // name
   case '/':
+    // names without escapes are interned straight from the buffer
+    if (lookCharLastValueCached == LOOK_VALUE_NOT_CACHED) {
+      for (q = bufPtr; q < bufEnd && !specialChars[*q] && *q != '#'; ++q) ;
+      if (q < bufEnd && *q != '#' && q - bufPtr < tokBufSize) {
+	obj->initName((const char *)bufPtr, (int)(q - bufPtr));
+	bufPtr = q;
+	break;
+      }
+    }
     p = tokBuf;
     n = 0;
     s = NULL;
@@ -557,13 +748,23 @@ Object *Lexer::getObj(Object *obj, int objNum) {
     p = tokBuf;
     *p++ = c;
     n = 1;
-    while ((c = lookChar()) != EOF && !specialChars[c]) {
-      getChar();
-      if (++n == tokBufSize) {
-	error(errSyntaxError, getPos(), "Command token too long");
-	break;
+    q = NULL;
+    if (lookCharLastValueCached == LOOK_VALUE_NOT_CACHED) {
+      for (q = bufPtr; q < bufEnd && !specialChars[*q]; ++q) ;
+    }
+    if (q && q < bufEnd && q - bufPtr < tokBufSize - 1) {
+      memcpy(p, bufPtr, q - bufPtr);
+      p += q - bufPtr;
+      bufPtr = q;
+    } else {
+      while ((c = lookChar()) != EOF && !specialChars[c]) {
+	getChar();
+	if (++n == tokBufSize) {
+	  error(errSyntaxError, getPos(), "Command token too long");
+	  break;
+	}
+	*p++ = c;
       }
-      *p++ = c;
     }
     *p = '\0';
     if (tokBuf[0] == 't' && !strcmp(tokBuf, "true")) {
@@ -581,12 +782,74 @@ Object *Lexer::getObj(Object *obj, int objNum) {
   return obj;
 }
 
+// Finish reading a number starting with <c> in place, if it ends
+// within the buffer.  Returns false, without reading anything, if it
+// doesn't, if the lexer has a char cached by lookChar(), or if the
+// number needs the checks in getObj(): more than 9 digits in the
+// integer part, or a minus sign after the point.  Reals are computed
+// exactly as getObj() does, so both give the same values.
+GBool Lexer::getNumberInBuf(int c, Object *obj) {
+  const Guchar *p;
+  GBool neg, real;
+  int xi, nInt;
+  double xf, scale;
+
+  if (lookCharLastValueCached != LOOK_VALUE_NOT_CACHED) {
+    return gFalse;
+  }
+  p = bufPtr;
+  neg = c == '-';
+  real = c == '.';
+  xi = 0;
+  nInt = 0;
+  if (c >= '0' && c <= '9') {
+    xi = c - '0';
+    nInt = 1;
+  }
+  if (!real) {
+    while (p < bufEnd && *p >= '0' && *p <= '9') {
+      if (++nInt > 9) {
+	return gFalse;
+      }
+      xi = xi * 10 + (*p++ - '0');
+    }
+    if (p < bufEnd && *p == '.') {
+      ++p;
+      real = gTrue;
+    }
+  }
+  xf = xi;
+  if (real) {
+    scale = 0.1;
+    while (p < bufEnd && *p >= '0' && *p <= '9') {
+      xf = xf + scale * (*p++ - '0');
+      scale *= 0.1;
+    }
+    if (p < bufEnd && *p == '-') {
+      return gFalse;
+    }
+  }
+  if (p == bufEnd) {
+    return gFalse;
+  }
+  bufPtr = p;
+
+  if (real) {
+    obj->initReal(neg ? -xf : xf);
+  } else {
+    obj->initInt(neg ? -xi : xi);
+  }
+  return gTrue;
+}
+
 Object *Lexer::getObj(Object *obj, const char *cmdA, int objNum) {
   char *p;
   int c;
   GBool comment;
   int n;
 
+  spoilRecording();
+
   // skip whitespace and comments
   comment = gFalse;
   const char *cmd1 = tokBuf;
@@ -626,6 +889,7 @@ Object *Lexer::getObj(Object *obj, const char *cmdA, int objNum) {
 void Lexer::skipToNextLine() {
   int c;
 
+  spoilRecording();
   while (1) {
     c = getChar();
     if (c == EOF || c == '\n') {
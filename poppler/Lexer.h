@@ -34,8 +34,11 @@
 #include "Stream.h"
 
 class XRef;
+class LexerStream;
+class ContentTokens;
 
 #define tokBufSize 128		// size of token buffer
+#define lexerBufSize 4096	// size of read-ahead buffer
 
 //------------------------------------------------------------------------
 // Lexer
@@ -52,6 +55,10 @@ public:
   // is either a stream or array of streams).
   Lexer(XRef *xrefA, Object *obj);
 
+  // Construct a lexer that replays the recorded tokens of a content
+  // stream.  It has no input stream: getStream() returns NULL.
+  Lexer(XRef *xrefA, ContentTokens *tokens);
+
   // Destructor.
   ~Lexer();
 
@@ -59,24 +66,32 @@ public:
   Object *getObj(Object *obj, int objNum = -1);
   Object *getObj(Object *obj, const char *cmdA, int objNum);
 
+  // Record the tokens returned by getObj() into <tokens>, which gets a
+  // new reference.  Anything that reads the input other than as tokens
+  // spoils the recording.
+  void setRecorder(ContentTokens *tokens);
+
   // Skip to the beginning of the next line in the input stream.
   void skipToNextLine();
 
   // Skip over one character.
-  void skipChar() { getChar(); }
+  void skipChar() { spoilRecording(); getChar(); }
 
-  // Get stream.
-  Stream *getStream()
-    { return curStr.isStream() ? curStr.getStream() : (Stream *)NULL; }
+  // Get stream.  The lexer reads its input in blocks, so this returns
+  // a stream which reads the chars buffered by the lexer, followed by
+  // the rest of the current stream.
+  Stream *getStream();
 
   // Get current position in file.  This is only used for error
-  // messages.
-  Goffset getPos()
-    { return curStr.isStream() ? curStr.streamGetPos() : -1; }
+  // messages.  The chars read ahead are only accounted for when the
+  // current stream isn't filtered: the position of a filtered stream is
+  // that of its encoded data, which can be ahead of the current token.
+  Goffset getPos();
 
   // Set position in file.
   void setPos(Goffset pos, int dir = 0)
-    { if (curStr.isStream()) curStr.streamSetPos(pos, dir); }
+    { if (curStr.isStream()) {
+        spoilRecording(); clearBuf(); curStr.streamSetPos(pos, dir); } }
 
   // Returns true if <c> is a whitespace character.
   static GBool isSpace(int c);
@@ -93,14 +108,35 @@ public:
 
 private:
 
+  friend class LexerStream;
+
   int getChar(GBool comesFromLook = gFalse);
   int lookChar();
+  int getBufChar()
+    { return (bufPtr < bufEnd || fillBuf()) ? *bufPtr++ : EOF; }
+  GBool fillBuf();
+  void clearBuf() { bufPtr = bufEnd = buf; fillSize = 128; }
+  GBool getNumberInBuf(int c, Object *obj);
+  Object *lexObj(Object *obj, int objNum);
+  void spoilRecording();
 
   Array *streams;		// array of input streams
   int strPtr;			// index of current stream
   Object curStr;		// current stream
   GBool freeArray;		// should lexer free the streams array?
   char tokBuf[tokBufSize];	// temporary token buffer
+  Guchar buf[lexerBufSize];	// chars read ahead from <curStr>
+  const Guchar *bufPtr;		// next char to read, in <buf> or in the
+				//   span lent by <curStr>
+  const Guchar *bufEnd;		// end of buffer
+  int fillSize;			// number of chars read by the next fillBuf();
+				//   this starts small so that parsing a
+				//   single object doesn't read far ahead
+  LexerStream *bufStr;		// stream returned by getStream()
+  ContentTokens *recTokens;	// recording of the tokens, or NULL
+  ContentTokens *replayTokens;	// tokens to replay instead of lexing
+				//   <streams>, or NULL
+  int replayPos;		// position in <replayTokens>
 
   XRef *xref;
 };
@@ -12,6 +12,7 @@
 #include <config.h>
 
 #include "LocalPDFDocBuilder.h"
+#include "MmapStream.h"
 
 //------------------------------------------------------------------------
 // LocalPDFDocBuilder
@@ -22,14 +23,21 @@ LocalPDFDocBuilder::buildPDFDoc(
     const GooString &uri, GooString *ownerPassword, GooString
     *userPassword, void *guiDataA)
 {
+  GooString *fileName;
+  MmapStream *str;
+
+  fileName = uri.copy();
   if (uri.cmpN("file://", 7) == 0) {
-     GooString *fileName = uri.copy();
      fileName->del(0, 7);
-     return new PDFDoc(fileName, ownerPassword, userPassword, guiDataA);
-  } else {
-     GooString *fileName = uri.copy();
-     return new PDFDoc(fileName, ownerPassword, userPassword, guiDataA);
   }
+
+  // regular files are mapped into memory; anything else (pipes,
+  // devices, or if mapping fails) is read through a FileStream
+  if ((str = MmapStream::open(fileName))) {
+     delete fileName;
+     return new PDFDoc(str, ownerPassword, userPassword, guiDataA);
+  }
+  return new PDFDoc(fileName, ownerPassword, userPassword, guiDataA);
 }
 
 GBool LocalPDFDocBuilder::supports(const GooString &uri)
@@ -0,0 +1,247 @@
+//========================================================================
+//
+// MmapStream.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+#include "goo/GooString.h"
+#include "MmapStream.h"
+
+//------------------------------------------------------------------------
+// MmapFile
+//------------------------------------------------------------------------
+
+MmapFile::MmapFile(GooString *fileNameA, const char *dataA, Goffset sizeA) {
+  fileName = fileNameA->copy();
+  data = dataA;
+  size = sizeA;
+  refCnt = 1;
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
+}
+
+MmapFile::~MmapFile() {
+#ifdef _WIN32
+  UnmapViewOfFile(data);
+#else
+  munmap((void *)data, (size_t)size);
+#endif
+  delete fileName;
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
+}
+
+void MmapFile::incRefCnt() {
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  ++refCnt;
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+}
+
+void MmapFile::decRefCnt() {
+  GBool done;
+
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  done = --refCnt == 0;
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+  if (done) {
+    delete this;
+  }
+}
+
+#ifdef _WIN32
+
+MmapFile *MmapFile::open(GooString *fileName) {
+  HANDLE handle, mapping;
+  LARGE_INTEGER size;
+  const char *data;
+
+  handle = CreateFile(fileName->getCString(), GENERIC_READ,
+		      FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		      FILE_ATTRIBUTE_NORMAL, NULL);
+  if (handle == INVALID_HANDLE_VALUE) {
+    return NULL;
+  }
+  if (GetFileType(handle) != FILE_TYPE_DISK ||
+      !GetFileSizeEx(handle, &size) || size.QuadPart <= 0 ||
+      (ULONGLONG)size.QuadPart > (ULONGLONG)(SIZE_T)-1) {
+    CloseHandle(handle);
+    return NULL;
+  }
+  mapping = CreateFileMapping(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle(handle);
+  if (!mapping) {
+    return NULL;
+  }
+  data = (const char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if (!data) {
+    return NULL;
+  }
+  return new MmapFile(fileName, data, size.QuadPart);
+}
+
+#else
+
+MmapFile *MmapFile::open(GooString *fileName) {
+  struct stat st;
+  void *data;
+  int fd;
+
+  if ((fd = ::open(fileName->getCString(), O_RDONLY)) < 0) {
+    return NULL;
+  }
+  // empty files cannot be mapped, and files too large for the address
+  // space are left to the caller
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+      (unsigned long long)st.st_size > (size_t)-1) {
+    ::close(fd);
+    return NULL;
+  }
+  data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    return NULL;
+  }
+  return new MmapFile(fileName, (const char *)data, st.st_size);
+}
+
+#endif // _WIN32
+
+//------------------------------------------------------------------------
+// MmapStream
+//------------------------------------------------------------------------
+
+MmapStream *MmapStream::open(GooString *fileName) {
+  MmapFile *file;
+  Object dictObj;
+
+  if (!(file = MmapFile::open(fileName))) {
+    return NULL;
+  }
+  dictObj.initNull();
+  return new MmapStream(file, 0, file->getSize(), &dictObj);
+}
+
+MmapStream::MmapStream(MmapFile *fileA, Goffset startA, Goffset lengthA,
+		       Object *dictA):
+    BaseStream(dictA, lengthA) {
+  file = fileA;
+  buf = file->getData();
+  start = startA;
+  length = lengthA;
+  bufEnd = buf + start + length;
+  bufPtr = buf + start;
+}
+
+MmapStream::~MmapStream() {
+  file->decRefCnt();
+}
+
+BaseStream *MmapStream::copy() {
+  file->incRefCnt();
+  return new MmapStream(file, start, length, &dict);
+}
+
+Stream *MmapStream::makeSubStream(Goffset startA, GBool limitedA,
+				  Goffset lengthA, Object *dictA) {
+  Goffset newLength;
+
+  if (startA < 0) {
+    startA = 0;
+  } else if (startA > start + length) {
+    startA = start + length;
+  }
+  if (!limitedA || lengthA < 0 || startA + lengthA > start + length) {
+    newLength = start + length - startA;
+  } else {
+    newLength = lengthA;
+  }
+  file->incRefCnt();
+  return new MmapStream(file, startA, newLength, dictA);
+}
+
+void MmapStream::setPos(Goffset pos, int dir) {
+  Goffset i;
+
+  if (dir >= 0) {
+    i = pos;
+  } else {
+    i = start + length - pos;
+  }
+  if (i < start) {
+    i = start;
+  } else if (i > start + length) {
+    i = start + length;
+  }
+  bufPtr = buf + i;
+}
+
+void MmapStream::moveStart(Goffset delta) {
+  start += delta;
+  length -= delta;
+  bufPtr = buf + start;
+}
+
+GooString *MmapStream::getFileName() {
+  return file->getFileName();
+}
+
+int MmapStream::getSpan(int nChars, const Guchar **span) {
+  int n;
+
+  if (nChars <= 0) {
+    return 0;
+  }
+  if (bufEnd - bufPtr < nChars) {
+    n = (int)(bufEnd - bufPtr);
+  } else {
+    n = nChars;
+  }
+  *span = (const Guchar *)bufPtr;
+  bufPtr += n;
+  return n;
+}
+
+int MmapStream::getChars(int nChars, Guchar *buffer) {
+  int n;
+
+  if (nChars <= 0) {
+    return 0;
+  }
+  if (bufEnd - bufPtr < nChars) {
+    n = (int)(bufEnd - bufPtr);
+  } else {
+    n = nChars;
+  }
+  memcpy(buffer, bufPtr, n);
+  bufPtr += n;
+  return n;
+}
@@ -0,0 +1,118 @@
+//========================================================================
+//
+// MmapStream.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef MMAPSTREAM_H
+#define MMAPSTREAM_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include "poppler-config.h"
+#include "goo/gtypes.h"
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
+#include "Object.h"
+#include "Stream.h"
+
+class GooString;
+
+//------------------------------------------------------------------------
+// MmapFile
+//
+// A read-only memory mapping of a regular file.  It is reference
+// counted, and unmapped when the last reference is dropped.
+//------------------------------------------------------------------------
+
+class MmapFile {
+public:
+
+  // Map <fileName>.  Returns NULL if it is not a regular file or cannot
+  // be mapped.
+  static MmapFile *open(GooString *fileName);
+
+  void incRefCnt();
+  void decRefCnt();
+
+  const char *getData() { return data; }
+  Goffset getSize() { return size; }
+  GooString *getFileName() { return fileName; }
+
+private:
+
+  MmapFile(GooString *fileNameA, const char *dataA, Goffset sizeA);
+  ~MmapFile();
+
+  GooString *fileName;
+  const char *data;
+  Goffset size;
+  int refCnt;
+#if MULTITHREADED
+  GooMutex mutex;
+#endif
+};
+
+//------------------------------------------------------------------------
+// MmapStream
+//
+// A BaseStream over a regular file that is mapped into memory.  Reads
+// are plain memory accesses, and sub-streams share the mapping, so
+// makeSubStream() and getChars() are pointer arithmetic and each
+// sub-stream keeps its own read position.  The mapping is released when
+// the last stream using it is deleted.
+//
+// The file must not be truncated while it is mapped: reading past the
+// new end of the file raises SIGBUS.
+//------------------------------------------------------------------------
+
+class MmapStream: public BaseStream {
+public:
+
+  // Map <fileName>.  Returns NULL if it is not a regular file or cannot
+  // be mapped, in which case the caller should fall back to FileStream.
+  static MmapStream *open(GooString *fileName);
+
+  virtual ~MmapStream();
+  virtual BaseStream *copy();
+  virtual Stream *makeSubStream(Goffset startA, GBool limitedA,
+				Goffset lengthA, Object *dictA);
+  virtual StreamKind getKind() { return strFile; }
+  virtual void reset() { bufPtr = buf + start; }
+  virtual void close() {}
+  virtual int getChar()
+    { return (bufPtr < bufEnd) ? (*bufPtr++ & 0xff) : EOF; }
+  virtual int lookChar()
+    { return (bufPtr < bufEnd) ? (*bufPtr & 0xff) : EOF; }
+  virtual Goffset getPos() { return bufPtr - buf; }
+  virtual void setPos(Goffset pos, int dir = 0);
+  virtual Goffset getStart() { return start; }
+  virtual void moveStart(Goffset delta);
+  virtual GooString *getFileName();
+  virtual GBool hasIndependentSubStreams() { return gTrue; }
+
+  virtual int getUnfilteredChar () { return getChar(); }
+  virtual void unfilteredReset () { reset(); }
+  virtual int getSpan(int nChars, const Guchar **span);
+
+private:
+
+  MmapStream(MmapFile *fileA, Goffset startA, Goffset lengthA,
+	     Object *dictA);
+
+  virtual GBool hasGetChars() { return true; }
+  virtual int getChars(int nChars, Guchar *buffer);
+
+  MmapFile *file;		// shared mapping
+  const char *buf;		// start of the mapping
+  Goffset start;
+  const char *bufEnd;
+  const char *bufPtr;
+};
+
+#endif
@@ -0,0 +1,254 @@
+//========================================================================
+//
+// NameAtoms.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <string.h>
+#include "goo/gmem.h"
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
+#include "NameAtoms.h"
+
+//------------------------------------------------------------------------
+
+#define nameAtomShardBits 4
+#define nameAtomShards (1 << nameAtomShardBits)
+
+// interned names are packed into blocks of this size
+#define nameAtomBlockSize 16384
+
+// indexed by NameAtomKey
+static const char *predefinedNames[nameAtomKeys] = {
+  "BBox",
+  "BitsPerComponent",
+  "ColorSpace",
+  "Contents",
+  "Count",
+  "CropBox",
+  "Decode",
+  "DecodeParms",
+  "DP",
+  "ExtGState",
+  "F",
+  "Filter",
+  "Font",
+  "Height",
+  "ImageMask",
+  "Kids",
+  "Length",
+  "Mask",
+  "Matrix",
+  "MediaBox",
+  "Page",
+  "Pages",
+  "Parent",
+  "Pattern",
+  "Properties",
+  "Resources",
+  "Rotate",
+  "Shading",
+  "SMask",
+  "Subtype",
+  "Type",
+  "Width",
+  "XObject"
+};
+
+struct NameAtomShard {
+  char **table;			// open addressing hash table of names
+  int tableSize;		// number of slots, a power of two
+  int nNames;
+  char *block;			// free space in the current block
+  int blockLeft;
+  int bytes;			// total size of the names
+#if MULTITHREADED
+  GooMutex mutex;
+#endif
+};
+
+class NameAtomTable {
+public:
+
+  NameAtomTable();
+
+  char *intern(const char *name, int length);
+
+  NameAtomShard shards[nameAtomShards];
+  const char *predefined[nameAtomKeys];
+};
+
+NameAtomTable::NameAtomTable() {
+  int i;
+
+  for (i = 0; i < nameAtomShards; ++i) {
+    shards[i].tableSize = 256;
+    shards[i].table = (char **)gmallocn(shards[i].tableSize, sizeof(char *));
+    memset(shards[i].table, 0, shards[i].tableSize * sizeof(char *));
+    shards[i].nNames = 0;
+    shards[i].block = NULL;
+    shards[i].blockLeft = 0;
+    shards[i].bytes = 0;
+#if MULTITHREADED
+    gInitMutex(&shards[i].mutex);
+#endif
+  }
+  // the predefined names go in first, the table can't be full yet
+  for (i = 0; i < nameAtomKeys; ++i) {
+    predefined[i] = intern(predefinedNames[i],
+			   (int)strlen(predefinedNames[i]));
+  }
+}
+
+// The table is created on first use, and never destroyed: names handed
+// out must stay valid until the process exits.
+static NameAtomTable *getTable() {
+  static NameAtomTable *table = new NameAtomTable();
+
+  return table;
+}
+
+static void growShard(NameAtomShard *shard) {
+  char **oldTable, *name;
+  int oldSize, i, j;
+
+  oldTable = shard->table;
+  oldSize = shard->tableSize;
+  shard->tableSize *= 2;
+  shard->table = (char **)gmallocn(shard->tableSize, sizeof(char *));
+  memset(shard->table, 0, shard->tableSize * sizeof(char *));
+  for (i = 0; i < oldSize; ++i) {
+    if ((name = oldTable[i])) {
+      j = (NameAtoms::getHash(name) >> nameAtomShardBits) &
+	  (shard->tableSize - 1);
+      while (shard->table[j]) {
+	j = (j + 1) & (shard->tableSize - 1);
+      }
+      shard->table[j] = name;
+    }
+  }
+  gfree(oldTable);
+}
+
+char *NameAtomTable::intern(const char *name, int length) {
+  NameAtomShard *shard;
+  NameAtomHeader *hdr;
+  char *p;
+  Guint h;
+  int size, i;
+
+  h = NameAtoms::hash(name, length);
+  if (length > nameAtomMaxLength) {
+    return NameAtoms::makePrivate(name, length, h);
+  }
+  shard = &shards[h & (nameAtomShards - 1)];
+#if MULTITHREADED
+  MutexLocker locker(&shard->mutex);
+#endif
+
+  for (i = (h >> nameAtomShardBits) & (shard->tableSize - 1);
+       (p = shard->table[i]);
+       i = (i + 1) & (shard->tableSize - 1)) {
+    if (NameAtoms::getHash(p) == h && NameAtoms::getLength(p) == length &&
+	!memcmp(p, name, length)) {
+      return p;
+    }
+  }
+
+  size = (int)sizeof(NameAtomHeader) + length + 1;
+  if (shard->bytes + size > nameAtomMaxBytes / nameAtomShards) {
+    return NameAtoms::makePrivate(name, length, h);
+  }
+  // keep the headers aligned
+  size = (size + (int)sizeof(int) - 1) & ~((int)sizeof(int) - 1);
+  if (shard->blockLeft < size) {
+    shard->block = (char *)gmalloc(nameAtomBlockSize);
+    shard->blockLeft = nameAtomBlockSize;
+  }
+  hdr = (NameAtomHeader *)shard->block;
+  shard->block += size;
+  shard->blockLeft -= size;
+  shard->bytes += size;
+
+  hdr->hash = h;
+  hdr->atom = (shard->nNames << nameAtomShardBits) |
+              (int)(h & (nameAtomShards - 1));
+  hdr->length = length;
+  p = (char *)(hdr + 1);
+  memcpy(p, name, length);
+  p[length] = '\0';
+
+  shard->table[i] = p;
+  ++shard->nNames;
+  if (2 * shard->nNames > shard->tableSize) {
+    growShard(shard);
+  }
+  return p;
+}
+
+//------------------------------------------------------------------------
+// NameAtoms
+//------------------------------------------------------------------------
+
+Guint NameAtoms::hash(const char *s, int length) {
+  Guint h;
+  int i;
+
+  // FNV-1a
+  h = 2166136261u;
+  for (i = 0; i < length; ++i) {
+    h = (h ^ (Guchar)s[i]) * 16777619u;
+  }
+  return h;
+}
+
+char *NameAtoms::intern(const char *name) {
+  return intern(name, (int)strlen(name));
+}
+
+char *NameAtoms::intern(const char *name, int length) {
+  return getTable()->intern(name, length);
+}
+
+const char *NameAtoms::get(NameAtomKey key) {
+  return getTable()->predefined[key];
+}
+
+char *NameAtoms::makePrivate(const char *name, int length, Guint h) {
+  NameAtomHeader *hdr;
+  char *p;
+
+  hdr = (NameAtomHeader *)gmalloc(sizeof(NameAtomHeader) + length + 1);
+  hdr->hash = h;
+  hdr->atom = -1;
+  hdr->length = length;
+  p = (char *)(hdr + 1);
+  memcpy(p, name, length);
+  p[length] = '\0';
+  return p;
+}
+
+char *NameAtoms::copy(const char *name) {
+  NameAtomHeader *hdr;
+
+  hdr = header(name);
+  if (hdr->atom >= 0) {
+    return (char *)name;
+  }
+  return makePrivate(name, hdr->length, hdr->hash);
+}
+
+void NameAtoms::release(char *name) {
+  if (name && header(name)->atom < 0) {
+    gfree(header(name));
+  }
+}
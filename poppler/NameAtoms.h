@@ -0,0 +1,130 @@
+//========================================================================
+//
+// NameAtoms.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef NAMEATOMS_H
+#define NAMEATOMS_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include "poppler-config.h"
+#include "goo/gtypes.h"
+
+//------------------------------------------------------------------------
+
+// Header stored in front of the characters of every name returned by
+// NameAtoms.
+struct NameAtomHeader {
+  Guint hash;			// NameAtoms::hash() of the name
+  int atom;			// atom number, or -1 if not interned
+  int length;			// length of the name, without the nul
+};
+
+//------------------------------------------------------------------------
+
+// Names that are looked up often.  They are interned before any other
+// name, so a name is equal to one of them exactly when it is the same
+// pointer.  Keep in sync with predefinedNames in NameAtoms.cc.
+enum NameAtomKey {
+  atomBBox,
+  atomBitsPerComponent,
+  atomColorSpace,
+  atomContents,
+  atomCount,
+  atomCropBox,
+  atomDecode,
+  atomDecodeParms,
+  atomDP,
+  atomExtGState,
+  atomF,
+  atomFilter,
+  atomFont,
+  atomHeight,
+  atomImageMask,
+  atomKids,
+  atomLength,
+  atomMask,
+  atomMatrix,
+  atomMediaBox,
+  atomPage,
+  atomPages,
+  atomParent,
+  atomPattern,
+  atomProperties,
+  atomResources,
+  atomRotate,
+  atomShading,
+  atomSMask,
+  atomSubtype,
+  atomType,
+  atomWidth,
+  atomXObject,
+  nameAtomKeys
+};
+
+//------------------------------------------------------------------------
+// NameAtoms
+//
+// Process-wide table of interned PDF names (and content stream
+// operators).  Each distinct name is stored once, never freed, and
+// numbered with a small integer atom, so that Objects can hold names
+// without allocating and two interned names are equal exactly when
+// their pointers are.
+//
+// The table is split into shards by hash, each with its own lock.
+// Names longer than nameAtomMaxLength, and all new names once the
+// table has reached nameAtomMaxBytes, get a private heap copy with the
+// same header and an atom of -1, which release() frees.  This keeps
+// damaged or hostile files from growing the table without bound.
+//------------------------------------------------------------------------
+
+// the PDF spec limits names to 127 bytes
+#define nameAtomMaxLength 127
+
+// total size of the interned names
+#define nameAtomMaxBytes (8 << 20)
+
+class NameAtoms {
+public:
+
+  // Return the interned copy of <name>, creating it if needed.
+  static char *intern(const char *name);
+  static char *intern(const char *name, int length);
+
+  // Return the interned name of <key>.
+  static const char *get(NameAtomKey key);
+
+  // Return a copy of <name>, which must have been returned by
+  // intern() or copy(): the same pointer for interned names.
+  static char *copy(const char *name);
+
+  // Drop a name returned by intern() or copy().  Interned names stay
+  // alive; private copies are freed.
+  static void release(char *name);
+
+  // Accessors for names returned by intern() or copy().
+  static int getAtom(const char *name) { return header(name)->atom; }
+  static Guint getHash(const char *name) { return header(name)->hash; }
+  static int getLength(const char *name) { return header(name)->length; }
+  static GBool isInterned(const char *name)
+    { return header(name)->atom >= 0; }
+
+  // Hash function used by the table.
+  static Guint hash(const char *s, int length);
+
+private:
+
+  friend class NameAtomTable;
+
+  static NameAtomHeader *header(const char *name)
+    { return (NameAtomHeader *)name - 1; }
+  static char *makePrivate(const char *name, int length, Guint h);
+};
+
+#endif
@@ -74,6 +74,18 @@ Object *Object::initDict(XRef *xref) {
   return this;
 }
 
+Object *Object::initArray(XRef *xref, ObjectArena *arena) {
+  initObj(objArray);
+  array = arena ? new (arena) Array(xref, arena) : new Array(xref);
+  return this;
+}
+
+Object *Object::initDict(XRef *xref, ObjectArena *arena) {
+  initObj(objDict);
+  dict = arena ? new (arena) Dict(xref, arena) : new Dict(xref);
+  return this;
+}
+
 Object *Object::initDict(Dict *dictA) {
   initObj(objDict);
   dict = dictA;
@@ -94,7 +106,7 @@ Object *Object::copy(Object *obj) {
     obj->string = string->copy();
     break;
   case objName:
-    obj->name = copyString(name);
+    obj->name = NameAtoms::copy(name);
     break;
   case objArray:
     array->incRef();
@@ -106,7 +118,7 @@ Object *Object::copy(Object *obj) {
     stream->incRef();
     break;
   case objCmd:
-    obj->cmd = copyString(cmd);
+    obj->cmd = NameAtoms::copy(cmd);
     break;
   default:
     break;
@@ -128,7 +140,7 @@ void Object::free() {
     delete string;
     break;
   case objName:
-    gfree(name);
+    NameAtoms::release(name);
     break;
   case objArray:
     if (!array->decRef()) {
@@ -146,7 +158,7 @@ void Object::free() {
     }
     break;
   case objCmd:
-    gfree(cmd);
+    NameAtoms::release(cmd);
     break;
   default:
     break;
@@ -42,6 +42,7 @@
 #include "goo/GooString.h"
 #include "goo/GooLikely.h"
 #include "Error.h"
+#include "NameAtoms.h"
 
 #define OBJECT_TYPE_CHECK(wanted_type) \
     if (unlikely(type != wanted_type)) { \
@@ -68,6 +69,7 @@ class XRef;
 class Array;
 class Dict;
 class Stream;
+class ObjectArena;
 
 //------------------------------------------------------------------------
 // Ref
@@ -138,17 +140,27 @@ public:
   Object *initString(GooString *stringA)
     { initObj(objString); string = stringA; return this; }
   Object *initName(const char *nameA)
-    { initObj(objName); name = copyString(nameA); return this; }
+    { initObj(objName); name = NameAtoms::intern(nameA); return this; }
+  Object *initName(const char *nameA, int lengthA)
+    { initObj(objName); name = NameAtoms::intern(nameA, lengthA); return this; }
+  Object *initNameAtom(const char *nameA)
+    { initObj(objName); name = NameAtoms::copy(nameA); return this; }
   Object *initNull()
     { initObj(objNull); return this; }
   Object *initArray(XRef *xref);
   Object *initDict(XRef *xref);
+  Object *initArray(XRef *xref, ObjectArena *arena);
+  Object *initDict(XRef *xref, ObjectArena *arena);
   Object *initDict(Dict *dictA);
   Object *initStream(Stream *streamA);
   Object *initRef(int numA, int genA)
     { initObj(objRef); ref.num = numA; ref.gen = genA; return this; }
   Object *initCmd(char *cmdA)
-    { initObj(objCmd); cmd = copyString(cmdA); return this; }
+    { initObj(objCmd); cmd = NameAtoms::intern(cmdA); return this; }
+  Object *initCmd(const char *cmdA, int lengthA)
+    { initObj(objCmd); cmd = NameAtoms::intern(cmdA, lengthA); return this; }
+  Object *initCmdAtom(const char *cmdA)
+    { initObj(objCmd); cmd = NameAtoms::copy(cmdA); return this; }
   Object *initError()
     { initObj(objError); return this; }
   Object *initEOF()
@@ -193,6 +205,8 @@ public:
   // Special type checking.
   GBool isName(const char *nameA)
     { return type == objName && !strcmp(name, nameA); }
+  GBool isName(NameAtomKey nameA)
+    { return type == objName && name == NameAtoms::get(nameA); }
   GBool isDict(const char *dictType);
   GBool isStream(char *dictType);
   GBool isCmd(const char *cmdA)
@@ -238,6 +252,8 @@ public:
   GBool dictIs(const char *dictType);
   Object *dictLookup(const char *key, Object *obj, int recursion = 0);
   Object *dictLookupNF(const char *key, Object *obj);
+  Object *dictLookup(NameAtomKey key, Object *obj, int recursion = 0);
+  Object *dictLookupNF(NameAtomKey key, Object *obj);
   char *dictGetKey(int i);
   Object *dictGetVal(int i, Object *obj);
   Object *dictGetValNF(int i, Object *obj);
@@ -270,12 +286,12 @@ private:
     long long int64g;           //   64-bit integer
     double real;		//   real
     GooString *string;		//   string
-    char *name;			//   name
+    char *name;			//   name, from NameAtoms
     Array *array;		//   array
     Dict *dict;			//   dictionary
     Stream *stream;		//   stream
     Ref ref;			//   indirect reference
-    char *cmd;			//   command
+    char *cmd;			//   command, from NameAtoms
   };
 
 #ifdef DEBUG_MEM
@@ -332,6 +348,12 @@ inline Object *Object::dictLookup(const char *key, Object *obj, int recursion)
 inline Object *Object::dictLookupNF(const char *key, Object *obj)
   { OBJECT_TYPE_CHECK(objDict); return dict->lookupNF(key, obj); }
 
+inline Object *Object::dictLookup(NameAtomKey key, Object *obj, int recursion)
+  { OBJECT_TYPE_CHECK(objDict); return dict->lookup(key, obj, recursion); }
+
+inline Object *Object::dictLookupNF(NameAtomKey key, Object *obj)
+  { OBJECT_TYPE_CHECK(objDict); return dict->lookupNF(key, obj); }
+
 inline char *Object::dictGetKey(int i)
   { OBJECT_TYPE_CHECK(objDict); return dict->getKey(i); }
 
@@ -0,0 +1,198 @@
+//========================================================================
+//
+// ObjectArena.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include "goo/gmem.h"
+#include "ObjectArena.h"
+
+//------------------------------------------------------------------------
+
+// alignment of all allocations
+#define objectArenaAlign 8
+
+// chunks start small, because many content streams (Type 3 glyphs, for
+// example) have no arrays or dictionaries at all, and double up to the
+// maximum size
+#define objectArenaMinChunk 2048
+#define objectArenaMaxChunk 65536
+
+//------------------------------------------------------------------------
+// ObjectArena
+//------------------------------------------------------------------------
+
+ObjectArena::ObjectArena() {
+  chunks = NULL;
+  ptr = end = NULL;
+  nextChunkSize = objectArenaMinChunk;
+  refCnt = 1;
+  open = gTrue;
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
+}
+
+ObjectArena::~ObjectArena() {
+  Chunk *chunk;
+
+  while ((chunk = chunks)) {
+    chunks = chunk->next;
+    gfree(chunk);
+  }
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
+}
+
+ObjectArena::Chunk *ObjectArena::newChunk(size_t size) {
+  Chunk *chunk;
+
+  chunk = (Chunk *)gmalloc(sizeof(Chunk) + size);
+  chunk->size = size;
+  return chunk;
+}
+
+void *ObjectArena::alloc(size_t size) {
+  Chunk *chunk;
+  void *p;
+
+  size = (size + objectArenaAlign - 1) & ~(size_t)(objectArenaAlign - 1);
+  if ((size_t)(end - ptr) < size) {
+    // large blocks get a chunk of their own, behind the current one
+    if (size > nextChunkSize / 4 && chunks) {
+      chunk = newChunk(size);
+      chunk->next = chunks->next;
+      chunks->next = chunk;
+      return (char *)chunk + sizeof(Chunk);
+    }
+    while (nextChunkSize < size) {
+      nextChunkSize *= 2;
+    }
+    chunk = newChunk(nextChunkSize);
+    chunk->next = chunks;
+    chunks = chunk;
+    ptr = (char *)chunk + sizeof(Chunk);
+    end = ptr + chunk->size;
+    if (nextChunkSize < objectArenaMaxChunk) {
+      nextChunkSize *= 2;
+    }
+  }
+  p = ptr;
+  ptr += size;
+  return p;
+}
+
+void *ObjectArena::allocObject(size_t size, ObjectArena *arena) {
+  ObjectHeader *hdr;
+
+  if (arena) {
+    hdr = (ObjectHeader *)arena->alloc(sizeof(ObjectHeader) + size);
+    arena->incRef();
+  } else {
+    hdr = (ObjectHeader *)gmalloc(sizeof(ObjectHeader) + size);
+  }
+  hdr->arena = arena;
+  return hdr + 1;
+}
+
+void ObjectArena::freeObject(void *p) {
+  ObjectHeader *hdr;
+
+  if (!p) {
+    return;
+  }
+  hdr = (ObjectHeader *)p - 1;
+  if (hdr->arena) {
+    hdr->arena->decRef();
+  } else {
+    gfree(hdr);
+  }
+}
+
+GBool ObjectArena::reset() {
+  Chunk *chunk;
+  int n;
+
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  n = refCnt;
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+  if (n > 1) {
+    return gFalse;
+  }
+  if (!chunks) {
+    return gTrue;
+  }
+  // keep the newest chunk, which is the largest
+  while ((chunk = chunks->next)) {
+    chunks->next = chunk->next;
+    gfree(chunk);
+  }
+  ptr = (char *)chunks + sizeof(Chunk);
+  end = ptr + chunks->size;
+  return gTrue;
+}
+
+void ObjectArena::release() {
+  GBool done;
+
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  open = gFalse;
+  done = --refCnt == 0;
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+  if (done) {
+    delete this;
+  }
+}
+
+void ObjectArena::incRef() {
+#if MULTITHREADED
+  if (!open) {
+    MutexLocker locker(&mutex);
+    ++refCnt;
+    return;
+  }
+#endif
+  ++refCnt;
+}
+
+void ObjectArena::decRef() {
+#if MULTITHREADED
+  if (!open) {
+    GBool done;
+
+    gLockMutex(&mutex);
+    done = --refCnt == 0;
+    gUnlockMutex(&mutex);
+    if (done) {
+      delete this;
+    }
+    return;
+  }
+#else
+  if (!open) {
+    if (--refCnt == 0) {
+      delete this;
+    }
+    return;
+  }
+#endif
+  // the creator still holds its reference
+  --refCnt;
+}
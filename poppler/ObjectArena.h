@@ -0,0 +1,102 @@
+//========================================================================
+//
+// ObjectArena.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef OBJECTARENA_H
+#define OBJECTARENA_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include <stddef.h>
+#include "poppler-config.h"
+#include "goo/gtypes.h"
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
+
+//------------------------------------------------------------------------
+// ObjectArena
+//
+// Bump allocator for the dictionaries and arrays built by one Parser:
+// the Dict and Array objects and their entry and element tables come
+// from a few large chunks, which are freed together instead of one
+// malloc block at a time.
+//
+// The arena is reference counted: its creator holds one reference, and
+// every Dict and Array allocated from it holds another, so objects
+// that outlive the parse (cached, or copied into longer lived
+// structures) stay valid.  The memory is freed when the last of them
+// is deleted.  Since a single survivor keeps every chunk alive, arenas
+// are only meant for short lived objects, like the operands of content
+// stream operators; objects a document may keep (the contents of
+// object streams, for example) must not come from one.
+//
+// Only the creator may allocate, and only until it calls release(); no
+// other thread can see the objects until then, so up to that point the
+// reference count isn't locked.  Dict and Array fall back to gmalloc
+// when they are changed after release().
+//------------------------------------------------------------------------
+
+class ObjectArena {
+public:
+
+  ObjectArena();
+
+  // Allocate <size> bytes, aligned for any object.  Must not be called
+  // after release().
+  void *alloc(size_t size);
+
+  // Allocate memory for a Dict or Array from <arena>, or with gmalloc
+  // if <arena> is NULL.  The object holds a reference to the arena
+  // until it is freed with freeObject().
+  static void *allocObject(size_t size, ObjectArena *arena);
+  static void freeObject(void *p);
+
+  // Reuse the arena's memory if nothing allocated from it is still
+  // alive, otherwise return false and leave it alone.  Must not be
+  // called after release().
+  GBool reset();
+
+  // Drop the creator's reference; no more allocations are allowed.
+  void release();
+
+  GBool isOpen() { return open; }
+
+  // Reference counting, for the objects allocated from the arena.
+  void incRef();
+  void decRef();
+
+private:
+
+  struct Chunk {
+    Chunk *next;
+    size_t size;		// usable bytes after the header
+  };
+
+  // header in front of the memory returned by allocObject()
+  union ObjectHeader {
+    ObjectArena *arena;
+    double align;
+  };
+
+  ~ObjectArena();
+  Chunk *newChunk(size_t size);
+
+  Chunk *chunks;		// current chunk first
+  char *ptr;			// next free byte in the current chunk
+  char *end;			// end of the current chunk
+  size_t nextChunkSize;
+  int refCnt;
+  GBool open;
+#if MULTITHREADED
+  GooMutex mutex;
+#endif
+};
+
+#endif
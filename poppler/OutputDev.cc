@@ -98,13 +98,12 @@ GBool OutputDev::beginType3Char(GfxState *state, double x, double y,
 void OutputDev::drawImageMask(GfxState *state, Object *ref, Stream *str,
 			      int width, int height, GBool invert,
 			      GBool interpolate, GBool inlineImg) {
-  int i, j;
+  int j;
 
   if (inlineImg) {
     str->reset();
     j = height * ((width + 7) / 8);
-    for (i = 0; i < j; ++i)
-      str->getChar();
+    str->discardChars(j);
     str->close();
   }
 }
@@ -123,14 +122,13 @@ void OutputDev::unsetSoftMaskFromImageMask(GfxState *state, double *baseMatrix)
 void OutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
 			  int width, int height, GfxImageColorMap *colorMap,
 			  GBool interpolate, int *maskColors, GBool inlineImg) {
-  int i, j;
+  int j;
 
   if (inlineImg) {
     str->reset();
     j = height * ((width * colorMap->getNumPixelComps() *
 		   colorMap->getBits() + 7) / 8);
-    for (i = 0; i < j; ++i)
-      str->getChar();
+    str->discardChars(j);
     str->close();
   }
 }
@@ -194,7 +192,7 @@ GooHash *OutputDev::endProfile() {
 }
 
 #ifdef USE_CMS
-PopplerCache *OutputDev::getIccColorSpaceCache()
+PopplerCache<PopplerCacheRefKey, GfxICCBasedColorSpace> *OutputDev::getIccColorSpaceCache()
 {
   return &iccColorSpaceCache;
 }
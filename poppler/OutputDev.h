@@ -41,6 +41,9 @@
 #include "CharTypes.h"
 #include "Object.h"
 #include "PopplerCache.h"
+#ifdef USE_CMS
+#include "GfxState.h"
+#endif
 
 class Annot;
 class Dict;
@@ -124,6 +127,10 @@ public:
   // box is the crop box?
   virtual GBool needClipToCropBox() { return gFalse; }
 
+  // Can Page draw into this device by replaying a cached display list
+  // (see GlobalParams::setDisplayListCacheSize())?
+  virtual GBool useDisplayListCache() { return gFalse; }
+
   //----- initialization and control
 
   // Set default transform matrix.
@@ -335,7 +342,7 @@ public:
 #endif
 
 #ifdef USE_CMS
-  PopplerCache *getIccColorSpaceCache();
+  PopplerCache<PopplerCacheRefKey, GfxICCBasedColorSpace> *getIccColorSpaceCache();
 #endif
 
 private:
@@ -345,7 +352,7 @@ private:
   GooHash *profileHash;
 
 #ifdef USE_CMS
-  PopplerCache iccColorSpaceCache;
+  PopplerCache<PopplerCacheRefKey, GfxICCBasedColorSpace> iccColorSpaceCache;
 #endif
 };
 
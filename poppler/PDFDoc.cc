@@ -78,6 +78,7 @@
 #endif
 #include "PDFDoc.h"
 #include "Hints.h"
+#include "DocIndex.h"
 
 #if MULTITHREADED
 #  define pdfdocLocker()   MutexLocker locker(&mutex)
@@ -122,6 +123,7 @@ void PDFDoc::init()
   startXRefPos = -1;
   secHdlr = NULL;
   pageCache = NULL;
+  docIndex = NULL;
 }
 
 PDFDoc::PDFDoc()
@@ -240,6 +242,8 @@ PDFDoc::PDFDoc(BaseStream *strA, GooString *ownerPassword,
 }
 
 GBool PDFDoc::setup(GooString *ownerPassword, GooString *userPassword) {
+  GooString *indexDir;
+
   pdfdocLocker();
   str->setPos(0, -1);
   if (str->getPos() < 0)
@@ -259,18 +263,36 @@ GBool PDFDoc::setup(GooString *ownerPassword, GooString *userPassword) {
 
   GBool wasReconstructed = false;
 
-  // read xref table
-  xref = new XRef(str, getStartXRef(), getMainXRefEntriesOffset(), &wasReconstructed);
-  if (!xref->isOk()) {
-    if (wasReconstructed) {
-      delete xref;
-      startXRefPos = -1;
-      xref = new XRef(str, getStartXRef(gTrue), getMainXRefEntriesOffset(gTrue), &wasReconstructed);
+  // read xref table from the document index, if there is one
+  if (fileName && (indexDir = globalParams->getDocIndexDir())) {
+    if ((docIndex = DocIndex::load(indexDir, fileName, str))) {
+      xref = new XRef(str, docIndex);
+      wasReconstructed = docIndex->wasReconstructed();
+      if (!xref->isOk()) {
+	delete xref;
+	xref = NULL;
+	delete docIndex;
+	docIndex = NULL;
+      }
     }
+    delete indexDir;
+  }
+
+  // read xref table
+  if (!xref) {
+    wasReconstructed = false;
+    xref = new XRef(str, getStartXRef(), getMainXRefEntriesOffset(), &wasReconstructed);
     if (!xref->isOk()) {
-      error(errSyntaxError, -1, "Couldn't read xref table");
-      errCode = xref->getErrorCode();
-      return gFalse;
+      if (wasReconstructed) {
+	delete xref;
+	startXRefPos = -1;
+	xref = new XRef(str, getStartXRef(gTrue), getMainXRefEntriesOffset(gTrue), &wasReconstructed);
+      }
+      if (!xref->isOk()) {
+	error(errSyntaxError, -1, "Couldn't read xref table");
+	errCode = xref->getErrorCode();
+	return gFalse;
+      }
     }
   }
 
@@ -288,6 +310,8 @@ GBool PDFDoc::setup(GooString *ownerPassword, GooString *userPassword) {
       // try one more time to contruct the Catalog, maybe the problem is damaged XRef 
       delete catalog;
       delete xref;
+      delete docIndex;
+      docIndex = NULL;
       xref = new XRef(str, 0, 0, NULL, true);
       catalog = new Catalog(this);
     }
@@ -299,10 +323,42 @@ GBool PDFDoc::setup(GooString *ownerPassword, GooString *userPassword) {
     }
   }
 
+  // take the page object IDs from the document index, or write one
+  if (docIndex) {
+    if (docIndex->getNumPages() == getNumPages()) {
+      setPageRefsFromIndex();
+    } else {
+      delete docIndex;
+      docIndex = NULL;
+    }
+  } else if (fileName && (indexDir = globalParams->getDocIndexDir())) {
+    DocIndex::save(indexDir, this);
+    delete indexDir;
+  }
+
   // done
   return gTrue;
 }
 
+void PDFDoc::setPageRefsFromIndex() {
+  DocIndexPage *pageInfo;
+  Ref *refs;
+  int n, i;
+
+  n = docIndex->getNumPages();
+  refs = (Ref *)gmallocn(n, sizeof(Ref));
+  for (i = 0; i < n; ++i) {
+    if ((pageInfo = docIndex->getPage(i + 1))) {
+      refs[i].num = pageInfo->num;
+      refs[i].gen = pageInfo->gen;
+    } else {
+      refs[i].num = refs[i].gen = -1;
+    }
+  }
+  catalog->setPageRefs(refs, n);
+  gfree(refs);
+}
+
 PDFDoc::~PDFDoc() {
   if (pageCache) {
     for (int i = 0; i < getNumPages(); i++) {
@@ -313,6 +369,7 @@ PDFDoc::~PDFDoc() {
     gfree(pageCache);
   }
   delete secHdlr;
+  delete docIndex;
 #ifndef DISABLE_OUTLINE
   if (outline) {
     delete outline;
@@ -1952,6 +2009,51 @@ Goffset PDFDoc::getMainXRefEntriesOffset(GBool tryingToReconstruct)
   return mainXRefEntriesOffset;
 }
 
+double PDFDoc::getPageMediaWidth(int page) {
+  DocIndexPage *pageInfo;
+
+  if (docIndex && (pageInfo = docIndex->getPage(page))) {
+    return pageInfo->mediaBox[2] - pageInfo->mediaBox[0];
+  }
+  return getPage(page) ? getPage(page)->getMediaWidth() : 0.0;
+}
+
+double PDFDoc::getPageMediaHeight(int page) {
+  DocIndexPage *pageInfo;
+
+  if (docIndex && (pageInfo = docIndex->getPage(page))) {
+    return pageInfo->mediaBox[3] - pageInfo->mediaBox[1];
+  }
+  return getPage(page) ? getPage(page)->getMediaHeight() : 0.0;
+}
+
+double PDFDoc::getPageCropWidth(int page) {
+  DocIndexPage *pageInfo;
+
+  if (docIndex && (pageInfo = docIndex->getPage(page))) {
+    return pageInfo->cropBox[2] - pageInfo->cropBox[0];
+  }
+  return getPage(page) ? getPage(page)->getCropWidth() : 0.0;
+}
+
+double PDFDoc::getPageCropHeight(int page) {
+  DocIndexPage *pageInfo;
+
+  if (docIndex && (pageInfo = docIndex->getPage(page))) {
+    return pageInfo->cropBox[3] - pageInfo->cropBox[1];
+  }
+  return getPage(page) ? getPage(page)->getCropHeight() : 0.0;
+}
+
+int PDFDoc::getPageRotate(int page) {
+  DocIndexPage *pageInfo;
+
+  if (docIndex && (pageInfo = docIndex->getPage(page))) {
+    return pageInfo->rotate;
+  }
+  return getPage(page) ? getPage(page)->getRotate() : 0;
+}
+
 int PDFDoc::getNumPages()
 {
   if (isLinearized()) {
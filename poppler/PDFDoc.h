@@ -65,6 +65,7 @@ class Linearization;
 class SecurityHandler;
 class Hints;
 class StructTreeRoot;
+class DocIndex;
 
 enum PDFWriteMode {
   writeStandard,
@@ -125,17 +126,13 @@ public:
   // Get base stream.
   BaseStream *getBaseStream() { return str; }
 
-  // Get page parameters.
-  double getPageMediaWidth(int page)
-    { return getPage(page) ? getPage(page)->getMediaWidth() : 0.0 ; }
-  double getPageMediaHeight(int page)
-    { return getPage(page) ? getPage(page)->getMediaHeight() : 0.0 ; }
-  double getPageCropWidth(int page)
-    { return getPage(page) ? getPage(page)->getCropWidth() : 0.0 ; }
-  double getPageCropHeight(int page)
-    { return getPage(page) ? getPage(page)->getCropHeight() : 0.0 ; }
-  int getPageRotate(int page)
-    { return getPage(page) ? getPage(page)->getRotate() : 0 ; }
+  // Get page parameters.  These come from the document index, if
+  // there is one, without creating the page.
+  double getPageMediaWidth(int page);
+  double getPageMediaHeight(int page);
+  double getPageCropWidth(int page);
+  double getPageCropHeight(int page);
+  int getPageRotate(int page);
 
   // Get number of pages.
   int getNumPages();
@@ -308,6 +305,7 @@ private:
   GBool checkFooter();
   void checkHeader();
   GBool checkEncryption(GooString *ownerPassword, GooString *userPassword);
+  void setPageRefsFromIndex();
   // Get the offset of the start xref table.
   Goffset getStartXRef(GBool tryingToReconstruct = gFalse);
   // Get the offset of the entries in the main XRef table of a
@@ -337,6 +335,7 @@ private:
   Outline *outline;
 #endif
   Page **pageCache;
+  DocIndex *docIndex;
 
   GBool ok;
   int errCode;
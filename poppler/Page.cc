@@ -60,6 +60,7 @@
 #include "Page.h"
 #include "Catalog.h"
 #include "Form.h"
+#include "DisplayListOutputDev.h"
 
 #if MULTITHREADED
 #  define pageLocker()   MutexLocker locker(&mutex)
@@ -158,7 +159,7 @@ PageAttrs::PageAttrs(PageAttrs *attrs, Dict *dict) {
   readBox(dict, "ArtBox", &artBox);
 
   // rotate
-  dict->lookup("Rotate", &obj1);
+  dict->lookup(atomRotate, &obj1);
   if (obj1.isInt()) {
     rotate = obj1.getInt();
   }
@@ -179,7 +180,7 @@ PageAttrs::PageAttrs(PageAttrs *attrs, Dict *dict) {
   dict->lookup("SeparationInfo", &separationInfo);
 
   // resource dictionary
-  dict->lookup("Resources", &obj1);
+  dict->lookup(atomResources, &obj1);
   if (obj1.isDict()) {
     resources.free();
     obj1.copy(&resources);
@@ -275,6 +276,8 @@ Page::Page(PDFDoc *docA, int numA, Dict *pageDict, Ref pageRefA, PageAttrs *attr
   num = numA;
   duration = -1;
   annots = NULL;
+  displayLists = NULL;
+  displayListsChangeCount = 0;
 
   pageObj.initDict(pageDict);
   pageRef = pageRefA;
@@ -311,7 +314,7 @@ Page::Page(PDFDoc *docA, int numA, Dict *pageDict, Ref pageRefA, PageAttrs *attr
   }
 
   // contents
-  pageDict->lookupNF("Contents", &contents);
+  pageDict->lookupNF(atomContents, &contents);
   if (!(contents.isRef() || contents.isArray() ||
 	contents.isNull())) {
     error(errSyntaxError, -1, "Page contents object (page {0:d}) is wrong type ({1:s})",
@@ -349,6 +352,7 @@ Page::Page(PDFDoc *docA, int numA, Dict *pageDict, Ref pageRefA, PageAttrs *attr
 Page::~Page() {
   delete attrs;
   delete annots;
+  delete displayLists;
   pageObj.free();
   annotsObj.free();
   contents.free();
@@ -379,17 +383,17 @@ void Page::replaceXRef(XRef *xrefA) {
   annotsObj.free();
   pageDict->lookupNF("Annots", &annotsObj);
   contents.free();
-  pageDict->lookupNF("Contents", &contents);
+  pageDict->lookupNF(atomContents, &contents);
   if (contents.isArray()) {
     contents.free();
-    pageDict->lookupNF("Contents", &obj1)->getArray()->copy(xrefA, &contents);
+    pageDict->lookupNF(atomContents, &obj1)->getArray()->copy(xrefA, &contents);
     obj1.free();
   }
   thumb.free();
   pageDict->lookupNF("Thumb", &thumb);
   actions.free();
   pageDict->lookupNF("AA", &actions);
-  pageDict->lookup("Resources", &obj1);
+  pageDict->lookup(atomResources, &obj1);
   if (obj1.isDict()) {
     attrs->replaceResource(obj1);
   }
@@ -570,11 +574,8 @@ void Page::displaySlice(OutputDev *out, double hDPI, double vDPI,
                         GBool (*annotDisplayDecideCbk)(Annot *annot, void *user_data),
                         void *annotDisplayDecideCbkData,
                         GBool copyXRef) {
-  Gfx *gfx;
-  Object obj;
-  Annots *annotList;
-  int i;
-  
+  DisplayList *list;
+
   if (!out->checkPageSlice(this, hDPI, vDPI, rotate, useMediaBox, crop,
 			   sliceX, sliceY, sliceW, sliceH,
 			   printing,
@@ -582,6 +583,76 @@ void Page::displaySlice(OutputDev *out, double hDPI, double vDPI,
 			   annotDisplayDecideCbk, annotDisplayDecideCbkData)) {
     return;
   }
+  if (out->useDisplayListCache() && !abortCheckCbk && !annotDisplayDecideCbk &&
+      globalParams->getDisplayListCacheSize() > 0) {
+    list = getDisplayList(out, hDPI, vDPI, rotate, useMediaBox, crop,
+			  printing);
+    if (list->isExact()) {
+      if (sliceW >= 0 && sliceH >= 0) {
+	list->replaySlice(out, sliceX, sliceY, sliceW, sliceH);
+      } else {
+	list->replay(out, hDPI, vDPI);
+      }
+      list->decRefCnt();
+      return;
+    }
+    list->decRefCnt();
+  }
+  drawSlice(out, hDPI, vDPI, rotate, useMediaBox, crop,
+	    sliceX, sliceY, sliceW, sliceH, printing,
+	    abortCheckCbk, abortCheckCbkData,
+	    annotDisplayDecideCbk, annotDisplayDecideCbkData, copyXRef);
+}
+
+// The list is recorded from the whole page, slices of it are replayed
+// from there.  Recording and lookups are done under the page lock, the
+// replays aren't.
+DisplayList *Page::getDisplayList(OutputDev *out, double hDPI, double vDPI,
+				  int rotate, GBool useMediaBox, GBool crop,
+				  GBool printing) {
+  DisplayListCacheKey key(out, hDPI, vDPI, rotate, useMediaBox, crop,
+			  printing);
+  DisplayListOutputDev *recorder;
+  DisplayList *list;
+
+  pageLocker();
+  if (displayLists &&
+      displayListsChangeCount != doc->getXRef()->getChangeCount()) {
+    delete displayLists;
+    displayLists = NULL;
+  }
+  if (!displayLists) {
+    displayLists =
+        new DisplayListCache(globalParams->getDisplayListCacheSize());
+    displayListsChangeCount = doc->getXRef()->getChangeCount();
+  }
+  if ((list = displayLists->lookup(key))) {
+    return list;
+  }
+  recorder = new DisplayListOutputDev(out);
+  drawSlice(recorder, hDPI, vDPI, rotate, useMediaBox, crop,
+	    -1, -1, -1, -1, printing, NULL, NULL, NULL, NULL, gFalse);
+  list = recorder->takeDisplayList();
+  delete recorder;
+  displayLists->put(key, list);
+  return list;
+}
+
+void Page::drawSlice(OutputDev *out, double hDPI, double vDPI,
+		     int rotate, GBool useMediaBox, GBool crop,
+		     int sliceX, int sliceY, int sliceW, int sliceH,
+		     GBool printing,
+		     GBool (*abortCheckCbk)(void *data),
+		     void *abortCheckCbkData,
+		     GBool (*annotDisplayDecideCbk)(Annot *annot,
+						    void *user_data),
+		     void *annotDisplayDecideCbkData,
+		     GBool copyXRef) {
+  Gfx *gfx;
+  Object obj;
+  Annots *annotList;
+  int i;
+
   pageLocker();
   XRef *localXRef = (copyXRef) ? xref->copy() : xref;
   if (copyXRef) {
@@ -596,7 +667,7 @@ void Page::displaySlice(OutputDev *out, double hDPI, double vDPI,
   contents.fetch(localXRef, &obj);
   if (!obj.isNull()) {
     gfx->saveState();
-    gfx->display(&obj);
+    gfx->display(&obj, gTrue, &pageRef);
     gfx->restoreState();
   } else {
     // empty pages need to call dump to do any setup required by the
@@ -636,7 +707,7 @@ void Page::display(Gfx *gfx) {
   contents.fetch(xref, &obj);
   if (!obj.isNull()) {
     gfx->saveState();
-    gfx->display(&obj);
+    gfx->display(&obj, gTrue, &pageRef);
     gfx->restoreState();
   }
   obj.free();
@@ -693,7 +764,7 @@ GBool Page::loadThumb(unsigned char **data_out,
     goto fail1;
   }
 
-  dict->lookup("Decode", &obj1);
+  dict->lookup(atomDecode, &obj1);
   if (obj1.isNull()) {
     obj1.free();
     dict->lookup("D", &obj1);
@@ -51,6 +51,8 @@ class Annot;
 class Gfx;
 class FormPageWidgets;
 class Form;
+class DisplayList;
+class DisplayListCache;
 
 //------------------------------------------------------------------------
 
@@ -237,7 +239,12 @@ public:
                void *annotDisplayDecideCbkData = NULL,
                GBool copyXRef = gFalse);
 
-  // Display part of a page.
+  // Display part of a page.  If GlobalParams::getDisplayListCacheSize()
+  // is not 0 and <out> uses the display list cache, the page is recorded
+  // into a display list once for each resolution, rotation and box, and
+  // the list is replayed into <out>; this is skipped when
+  // <abortCheckCbk> or <annotDisplayDecideCbk> is given, and pages whose
+  // list isn't exact (see DisplayList::isExact()) are drawn directly.
   void displaySlice(OutputDev *out, double hDPI, double vDPI,
 		    int rotate, GBool useMediaBox, GBool crop,
 		    int sliceX, int sliceY, int sliceW, int sliceH,
@@ -265,6 +272,23 @@ private:
   // replace xref
   void replaceXRef(XRef *xrefA);
 
+  // Draw the contents and annotations of the page, see displaySlice().
+  void drawSlice(OutputDev *out, double hDPI, double vDPI,
+		 int rotate, GBool useMediaBox, GBool crop,
+		 int sliceX, int sliceY, int sliceW, int sliceH,
+		 GBool printing,
+		 GBool (*abortCheckCbk)(void *data),
+		 void *abortCheckCbkData,
+		 GBool (*annotDisplayDecideCbk)(Annot *annot, void *user_data),
+		 void *annotDisplayDecideCbkData,
+		 GBool copyXRef);
+
+  // Return the display list of the whole page recorded for <out>, with a
+  // reference the caller must release.
+  DisplayList *getDisplayList(OutputDev *out, double hDPI, double vDPI,
+			      int rotate, GBool useMediaBox, GBool crop,
+			      GBool printing);
+
   PDFDoc *doc;
   XRef *xref;			// the xref table for this PDF file
   Object pageObj;               // page dictionary
@@ -279,6 +303,8 @@ private:
   Object actions;		// page additional actions
   double duration;              // page duration
   GBool ok;			// true if page is valid
+  DisplayListCache *displayLists; // recorded display lists, or NULL
+  Guint displayListsChangeCount; // XRef change count of displayLists
 #if MULTITHREADED
   GooMutex mutex;
 #endif
@@ -45,9 +45,11 @@
 // lots of nested arrays that made us consume all the stack
 #define recursionLimit 500
 
-Parser::Parser(XRef *xrefA, Lexer *lexerA, GBool allowStreamsA) {
+Parser::Parser(XRef *xrefA, Lexer *lexerA, GBool allowStreamsA,
+	       ObjectArena *arenaA) {
   xref = xrefA;
   lexer = lexerA;
+  arena = arenaA;
   inlineImg = 0;
   allowStreams = allowStreamsA;
   lexer->getObj(&buf1);
@@ -70,7 +72,7 @@ Object *Parser::getObj(Object *obj, GBool simpleOnly,
 		       CryptAlgorithm encAlgorithm, int keyLength,
 		       int objNum, int objGen, int recursion,
 		       GBool strict) {
-  char *key;
+  Object key;
   Stream *str;
   Object obj2;
   int num;
@@ -90,7 +92,7 @@ Object *Parser::getObj(Object *obj, GBool simpleOnly,
   // array
   if (!simpleOnly && likely(recursion < recursionLimit) && buf1.isCmd("[")) {
     shift();
-    obj->initArray(xref);
+    obj->initArray(xref, arena);
     while (!buf1.isCmd("]") && !buf1.isEOF())
       obj->arrayAdd(getObj(&obj2, gFalse, fileKey, encAlgorithm, keyLength,
 			   objNum, objGen, recursion + 1));
@@ -103,22 +105,23 @@ Object *Parser::getObj(Object *obj, GBool simpleOnly,
   // dictionary or stream
   } else if (!simpleOnly && likely(recursion < recursionLimit) && buf1.isCmd("<<")) {
     shift(objNum);
-    obj->initDict(xref);
+    obj->initDict(xref, arena);
     while (!buf1.isCmd(">>") && !buf1.isEOF()) {
       if (!buf1.isName()) {
 	error(errSyntaxError, getPos(), "Dictionary key must be a name object");
 	if (strict) goto err;
 	shift();
       } else {
-	// buf1 might go away in shift(), so construct the key
-	key = copyString(buf1.getName());
+	// buf1 goes away in shift(), so take it over as the key
+	buf1.shallowCopy(&key);
+	buf1.initNull();
 	shift();
 	if (buf1.isEOF() || buf1.isError()) {
-	  gfree(key);
+	  key.free();
 	  if (strict && buf1.isError()) goto err;
 	  break;
 	}
-	obj->dictAdd(key, getObj(&obj2, gFalse, fileKey, encAlgorithm, keyLength, objNum, objGen, recursion + 1));
+	obj->getDict()->add(&key, getObj(&obj2, gFalse, fileKey, encAlgorithm, keyLength, objNum, objGen, recursion + 1));
       }
     }
     if (buf1.isEOF()) {
@@ -206,7 +209,7 @@ Stream *Parser::makeStream(Object *dict, Guchar *fileKey,
   pos = str->getPos();
 
   // get length
-  dict->dictLookup("Length", &obj, recursion);
+  dict->dictLookup(atomLength, &obj, recursion);
   if (obj.isInt()) {
     length = obj.getInt();
     obj.free();
@@ -39,8 +39,10 @@
 class Parser {
 public:
 
-  // Constructor.
-  Parser(XRef *xrefA, Lexer *lexerA, GBool allowStreamsA);
+  // Constructor.  Arrays and dictionaries are allocated from <arenaA>
+  // if it isn't NULL.
+  Parser(XRef *xrefA, Lexer *lexerA, GBool allowStreamsA,
+	 ObjectArena *arenaA = NULL);
 
   // Destructor.
   ~Parser();
@@ -62,11 +64,17 @@ public:
   // Get current position in file.
   Goffset getPos() { return lexer->getPos(); }
 
+  ObjectArena *getArena() { return arena; }
+
+  // Allocate the following arrays and dictionaries from <arenaA>.
+  void setArena(ObjectArena *arenaA) { arena = arenaA; }
+
 private:
 
   XRef *xref;			// the xref table for this PDF file
   Lexer *lexer;			// input stream
   GBool allowStreams;		// parse stream objects?
+  ObjectArena *arena;		// arena for arrays and dictionaries, or NULL
   Object buf1, buf2;		// next two tokens
   int inlineImg;		// set when inline image data is encountered
 
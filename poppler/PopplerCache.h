@@ -13,54 +13,305 @@
 #ifndef POPPLER_CACHE_H
 #define POPPLER_CACHE_H
 
+#include <string.h>
+#include "goo/gtypes.h"
+#include "goo/gmem.h"
 #include "Object.h"
 
-class PopplerCacheItem
-{
-  public:
-   virtual ~PopplerCacheItem();
+//------------------------------------------------------------------------
+
+struct PopplerCacheStats {
+  Gulong hits;			// lookups that found their item
+  Gulong misses;		// lookups that didn't
+  Gulong evictions;		// items dropped to stay within the limits
+  Goffset bytes;		// total cost of the cached items
+  int nItems;			// number of cached items
 };
 
-class PopplerCacheKey
-{
-  public:
-    virtual ~PopplerCacheKey();
-    virtual bool operator==(const PopplerCacheKey &key) const = 0;
+//------------------------------------------------------------------------
+// PopplerCacheRefKey
+//
+// Cache key for items belonging to an indirect object.
+//------------------------------------------------------------------------
+
+class PopplerCacheRefKey {
+public:
+
+  PopplerCacheRefKey(int numA, int genA): num(numA), gen(genA) {}
+  PopplerCacheRefKey(const Ref &ref): num(ref.num), gen(ref.gen) {}
+
+  Guint hash() const { return (Guint)num * 2654435761u + (Guint)gen; }
+  bool operator==(const PopplerCacheRefKey &key) const
+    { return num == key.num && gen == key.gen; }
+
+  int num, gen;
 };
 
-class PopplerCache
-{
-  public:
-    PopplerCache(int cacheSizeA);
-    ~PopplerCache();
-    
-    /* The item returned is owned by the cache */
-    PopplerCacheItem *lookup(const PopplerCacheKey &key);
-    
-    /* The key and item pointers ownership is taken by the cache */
-    void put(PopplerCacheKey *key, PopplerCacheItem *item);
-    
-    /* The max size of the cache */
-    int size();
-    
-    /* The number of items in the cache */
-    int numberOfItems();
-    
-    /* The n-th item in the cache */
-    PopplerCacheItem *item(int index);
-    
-    /* The n-th key in the cache */
-    PopplerCacheKey *key(int index);
-  
-  private:
-    PopplerCache(const PopplerCache &cache); // not allowed
-  
-    PopplerCacheKey **keys;
-    PopplerCacheItem **items;
-    int lastValidCacheIndex;
-    int cacheSize;
+//------------------------------------------------------------------------
+// PopplerCache
+//
+// An LRU cache mapping <Key>s to <Item>s.  Keys are copied into the
+// cache and must provide 'Guint hash() const' and operator==; items are
+// owned by the cache and deleted when they are evicted or the cache is
+// destroyed.
+//
+// The cache is limited to <maxItems> items and to <maxBytes> bytes,
+// counting the costs passed to put(); a limit of zero means no limit.
+// The least recently used items are evicted first, but the item
+// put last is always kept, even if it alone is over the limits.
+//
+// The cache does no locking of its own.
+//------------------------------------------------------------------------
+
+template <class Key, class Item>
+class PopplerCache {
+public:
+
+  // Called with each evicted item just before it is deleted.
+  typedef void (*EvictFunc)(const Key &key, Item *item, void *data);
+
+  PopplerCache(int maxItemsA, Goffset maxBytesA = 0);
+  ~PopplerCache();
+
+  // Return the item for <key>, which stays owned by the cache, and make
+  // it the most recently used one, or return NULL.
+  Item *lookup(const Key &key);
+
+  // Return the item for <key>, or NULL, without counting the lookup or
+  // changing the order of the items.
+  Item *find(const Key &key);
+
+  // Add <item> for <key>, taking it over; it replaces an existing item
+  // for <key>.  <cost> is its size in bytes.
+  void put(const Key &key, Item *item, Goffset cost = 0);
+
+  // Delete all items.  The eviction function isn't called.
+  void clear();
+
+  void setEvictFunc(EvictFunc evictFuncA, void *evictDataA)
+    { evictFunc = evictFuncA; evictData = evictDataA; }
+
+  // The maximum number of items, or 0 if unlimited.
+  int size() { return maxItems; }
+
+  // The number of items in the cache.
+  int numberOfItems() { return nEntries; }
+
+  void getStats(PopplerCacheStats *stats);
+
+private:
+
+  PopplerCache(const PopplerCache &cache); // not allowed
+  PopplerCache& operator=(const PopplerCache &cache); // not allowed
+
+  struct Entry {
+    Entry(const Key &keyA): key(keyA) {}
+    Key key;
+    Item *item;
+    Goffset cost;
+    Entry *hashNext;		// next entry in the hash bucket
+    Entry *lruPrev, *lruNext;	// more and less recently used entries
+  };
+
+  Entry **bucket(const Key &key)
+    { return &table[((key.hash() >> 7) ^ key.hash()) & (tableSize - 1)]; }
+  Entry *findEntry(const Key &key);
+  void unlink(Entry *e);
+  void grow();
+
+  Entry **table;		// hash table, tableSize is a power of two
+  int tableSize;
+  int nEntries;
+  Entry *lruFirst;		// most recently used entry
+  Entry *lruLast;		// least recently used entry
+  int maxItems;
+  Goffset maxBytes;
+  Goffset bytes;
+  Gulong hits, misses, evictions;
+  EvictFunc evictFunc;
+  void *evictData;
 };
 
+template <class Key, class Item>
+PopplerCache<Key, Item>::PopplerCache(int maxItemsA, Goffset maxBytesA) {
+  maxItems = maxItemsA;
+  maxBytes = maxBytesA;
+  tableSize = 8;
+  while (tableSize < maxItems && tableSize < 1024) {
+    tableSize *= 2;
+  }
+  table = (Entry **)gmallocn(tableSize, sizeof(Entry *));
+  memset(table, 0, tableSize * sizeof(Entry *));
+  nEntries = 0;
+  lruFirst = lruLast = NULL;
+  bytes = 0;
+  hits = misses = evictions = 0;
+  evictFunc = NULL;
+  evictData = NULL;
+}
+
+template <class Key, class Item>
+PopplerCache<Key, Item>::~PopplerCache() {
+  clear();
+  gfree(table);
+}
+
+template <class Key, class Item>
+typename PopplerCache<Key, Item>::Entry *
+PopplerCache<Key, Item>::findEntry(const Key &key) {
+  Entry *e;
+
+  for (e = *bucket(key); e; e = e->hashNext) {
+    if (e->key == key) {
+      return e;
+    }
+  }
+  return NULL;
+}
+
+template <class Key, class Item>
+Item *PopplerCache<Key, Item>::find(const Key &key) {
+  Entry *e;
+
+  return (e = findEntry(key)) ? e->item : NULL;
+}
+
+template <class Key, class Item>
+Item *PopplerCache<Key, Item>::lookup(const Key &key) {
+  Entry *e;
+
+  if (!(e = findEntry(key))) {
+    ++misses;
+    return NULL;
+  }
+  ++hits;
+  if (e != lruFirst) {
+    e->lruPrev->lruNext = e->lruNext;
+    if (e->lruNext) {
+      e->lruNext->lruPrev = e->lruPrev;
+    } else {
+      lruLast = e->lruPrev;
+    }
+    e->lruPrev = NULL;
+    e->lruNext = lruFirst;
+    lruFirst->lruPrev = e;
+    lruFirst = e;
+  }
+  return e->item;
+}
+
+template <class Key, class Item>
+void PopplerCache<Key, Item>::put(const Key &key, Item *item, Goffset cost) {
+  Entry *e, **p;
+
+  if ((e = findEntry(key))) {
+    unlink(e);
+    delete e->item;
+    delete e;
+  }
+
+  if (nEntries >= tableSize) {
+    grow();
+  }
+  e = new Entry(key);
+  e->item = item;
+  e->cost = cost;
+  p = bucket(key);
+  e->hashNext = *p;
+  *p = e;
+  e->lruPrev = NULL;
+  e->lruNext = lruFirst;
+  if (lruFirst) {
+    lruFirst->lruPrev = e;
+  } else {
+    lruLast = e;
+  }
+  lruFirst = e;
+  ++nEntries;
+  bytes += cost;
+
+  while (lruLast != e &&
+	 ((maxItems > 0 && nEntries > maxItems) || (maxBytes > 0 && bytes > maxBytes))) {
+    Entry *last = lruLast;
+    unlink(last);
+    ++evictions;
+    if (evictFunc) {
+      (*evictFunc)(last->key, last->item, evictData);
+    }
+    delete last->item;
+    delete last;
+  }
+}
+
+template <class Key, class Item>
+void PopplerCache<Key, Item>::clear() {
+  Entry *e, *next;
+
+  for (e = lruFirst; e; e = next) {
+    next = e->lruNext;
+    delete e->item;
+    delete e;
+  }
+  memset(table, 0, tableSize * sizeof(Entry *));
+  nEntries = 0;
+  lruFirst = lruLast = NULL;
+  bytes = 0;
+}
+
+template <class Key, class Item>
+void PopplerCache<Key, Item>::getStats(PopplerCacheStats *stats) {
+  stats->hits = hits;
+  stats->misses = misses;
+  stats->evictions = evictions;
+  stats->bytes = bytes;
+  stats->nItems = nEntries;
+}
+
+// Remove <e> from the hash table and the LRU list.
+template <class Key, class Item>
+void PopplerCache<Key, Item>::unlink(Entry *e) {
+  Entry **p;
+
+  for (p = bucket(e->key); *p != e; p = &(*p)->hashNext) ;
+  *p = e->hashNext;
+  if (e->lruPrev) {
+    e->lruPrev->lruNext = e->lruNext;
+  } else {
+    lruFirst = e->lruNext;
+  }
+  if (e->lruNext) {
+    e->lruNext->lruPrev = e->lruPrev;
+  } else {
+    lruLast = e->lruPrev;
+  }
+  --nEntries;
+  bytes -= e->cost;
+}
+
+template <class Key, class Item>
+void PopplerCache<Key, Item>::grow() {
+  Entry *e, **p;
+
+  gfree(table);
+  tableSize *= 2;
+  table = (Entry **)gmallocn(tableSize, sizeof(Entry *));
+  memset(table, 0, tableSize * sizeof(Entry *));
+  for (e = lruFirst; e; e = e->lruNext) {
+    p = bucket(e->key);
+    e->hashNext = *p;
+    *p = e;
+  }
+}
+
+//------------------------------------------------------------------------
+// PopplerObjectCache
+//
+// Keeps copies of the most recently used indirect objects of a
+// document.
+//------------------------------------------------------------------------
+
+class PopplerObjectCacheItem;
+
 class PopplerObjectCache
 {
   public:
@@ -70,9 +321,11 @@ class PopplerObjectCache
     Object *put(const Ref &ref);
     Object *lookup(const Ref &ref, Object *obj);
 
+    void getStats(PopplerCacheStats *stats) { cache->getStats(stats); }
+
   private:
     XRef *xref;
-    PopplerCache *cache;
+    PopplerCache<PopplerCacheRefKey, PopplerObjectCacheItem> *cache;
 };
 
 #endif
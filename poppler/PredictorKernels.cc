@@ -0,0 +1,296 @@
+//========================================================================
+//
+// PredictorKernels.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <string.h>
+#include "PredictorKernels.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define PREDICTOR_SSE2 1
+#endif
+
+//------------------------------------------------------------------------
+// portable versions
+//------------------------------------------------------------------------
+
+static void subScalar(Guchar *row, Guchar *raw, int len, int bpp) {
+  int i;
+
+  for (i = 0; i < len; ++i) {
+    row[i] = raw[i] + row[i - bpp];
+  }
+}
+
+static void upScalar(Guchar *row, Guchar *raw, int len) {
+  int i;
+
+  for (i = 0; i < len; ++i) {
+    row[i] += raw[i];
+  }
+}
+
+static void averageScalar(Guchar *row, Guchar *raw, int len, int bpp) {
+  int i;
+
+  for (i = 0; i < len; ++i) {
+    row[i] = raw[i] + ((row[i - bpp] + row[i]) >> 1);
+  }
+}
+
+// The previous row is overwritten as the current one is computed, so
+// the upper left bytes are kept in a ring buffer.
+static void paethScalar(Guchar *row, Guchar *raw, int len, int bpp) {
+  Guchar upLeftBuf[predictorMaxPixBytes];
+  int left, up, upLeft, p, pa, pb, pc;
+  int i, j;
+
+  memset(upLeftBuf, 0, bpp);
+  for (i = j = 0; i < len; ++i) {
+    left = row[i - bpp];
+    up = row[i];
+    upLeft = upLeftBuf[j];
+    upLeftBuf[j] = (Guchar)up;
+    if (++j == bpp) {
+      j = 0;
+    }
+    p = left + up - upLeft;
+    if ((pa = p - left) < 0)
+      pa = -pa;
+    if ((pb = p - up) < 0)
+      pb = -pb;
+    if ((pc = p - upLeft) < 0)
+      pc = -pc;
+    if (pa <= pb && pa <= pc)
+      row[i] = left + raw[i];
+    else if (pb <= pc)
+      row[i] = up + raw[i];
+    else
+      row[i] = upLeft + raw[i];
+  }
+}
+
+//------------------------------------------------------------------------
+// SSE2 versions
+//------------------------------------------------------------------------
+
+#ifdef PREDICTOR_SSE2
+
+// Load/store the first <n> (at most 4) bytes of a pixel.  The bytes are
+// assembled by hand, since memcpy() calls with odd sizes are not always
+// inlined.
+static inline __m128i loadPixel(Guchar *p, int n) {
+  int x, i;
+
+  if (n == 4) {
+    memcpy(&x, p, 4);
+  } else {
+    x = 0;
+    for (i = 0; i < n; ++i) {
+      x |= p[i] << (8 * i);
+    }
+  }
+  return _mm_cvtsi32_si128(x);
+}
+
+static inline void storePixel(Guchar *p, __m128i v, int n) {
+  int x, i;
+
+  x = _mm_cvtsi128_si32(v);
+  if (n == 4) {
+    memcpy(p, &x, 4);
+  } else {
+    for (i = 0; i < n; ++i) {
+      p[i] = (Guchar)(x >> (8 * i));
+    }
+  }
+}
+
+// Sixteen bytes at a time, with a prefix sum over the register.
+static void subSSE2x1(Guchar *row, Guchar *raw, int len) {
+  __m128i x, carry;
+  int i;
+
+  carry = _mm_setzero_si128();
+  for (i = 0; i + 16 <= len; i += 16) {
+    x = _mm_loadu_si128((__m128i *)(raw + i));
+    x = _mm_add_epi8(x, _mm_slli_si128(x, 1));
+    x = _mm_add_epi8(x, _mm_slli_si128(x, 2));
+    x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+    x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+    x = _mm_add_epi8(x, carry);
+    _mm_storeu_si128((__m128i *)(row + i), x);
+    carry = _mm_set1_epi8((char)row[i + 15]);
+  }
+  subScalar(row + i, raw + i, len - i, 1);
+}
+
+static void subSSE2x3(Guchar *row, Guchar *raw, int len) {
+  __m128i a;
+  int i;
+
+  a = _mm_setzero_si128();
+  for (i = 0; i + 3 <= len; i += 3) {
+    a = _mm_add_epi8(a, loadPixel(raw + i, 3));
+    storePixel(row + i, a, 3);
+  }
+  subScalar(row + i, raw + i, len - i, 3);
+}
+
+static void subSSE2x4(Guchar *row, Guchar *raw, int len) {
+  __m128i x, carry;
+  int i;
+
+  carry = _mm_setzero_si128();
+  for (i = 0; i + 16 <= len; i += 16) {
+    x = _mm_loadu_si128((__m128i *)(raw + i));
+    x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+    x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+    x = _mm_add_epi8(x, carry);
+    _mm_storeu_si128((__m128i *)(row + i), x);
+    carry = _mm_shuffle_epi32(x, 0xff);
+  }
+  subScalar(row + i, raw + i, len - i, 4);
+}
+
+static void upSSE2(Guchar *row, Guchar *raw, int len) {
+  __m128i x;
+  int i;
+
+  for (i = 0; i + 16 <= len; i += 16) {
+    x = _mm_add_epi8(_mm_loadu_si128((__m128i *)(row + i)),
+		     _mm_loadu_si128((__m128i *)(raw + i)));
+    _mm_storeu_si128((__m128i *)(row + i), x);
+  }
+  upScalar(row + i, raw + i, len - i);
+}
+
+// _mm_avg_epu8 rounds up: (a + b + 1) >> 1, so the low bit of (a ^ b) is
+// subtracted to get the PNG average.
+static inline void averageSSE2(Guchar *row, Guchar *raw, int len, int bpp) {
+  __m128i a, b, avg, one;
+  int i;
+
+  one = _mm_set1_epi8(1);
+  a = _mm_setzero_si128();
+  for (i = 0; i + bpp <= len; i += bpp) {
+    b = loadPixel(row + i, bpp);
+    avg = _mm_sub_epi8(_mm_avg_epu8(a, b),
+		       _mm_and_si128(_mm_xor_si128(a, b), one));
+    a = _mm_add_epi8(loadPixel(raw + i, bpp), avg);
+    storePixel(row + i, a, bpp);
+  }
+  averageScalar(row + i, raw + i, len - i, bpp);
+}
+
+// Undo the Paeth filter on the first <n> bytes of a pixel.  <a> and <b>
+// hold the left and upper left pixels, as 16-bit lanes, and are updated
+// for the next pixel.  With p = a + b - c, |p - a| = |b - c|,
+// |p - b| = |a - c| and |p - c| = |a + b - 2c|.
+static inline void paethPixelSSE2(Guchar *row, Guchar *raw, int n,
+				  __m128i *a, __m128i *b) {
+  __m128i zero, c, d, pa, pb, pc, smallest, nearest, mask;
+
+  zero = _mm_setzero_si128();
+  c = *b;
+  *b = _mm_unpacklo_epi8(loadPixel(row, n), zero);
+  d = _mm_unpacklo_epi8(loadPixel(raw, n), zero);
+  pa = _mm_sub_epi16(*b, c);
+  pb = _mm_sub_epi16(*a, c);
+  pc = _mm_add_epi16(pa, pb);
+  pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+  pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+  pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+  smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+  mask = _mm_cmpeq_epi16(pb, smallest);
+  nearest = _mm_or_si128(_mm_and_si128(mask, *b),
+			 _mm_andnot_si128(mask, c));
+  mask = _mm_cmpeq_epi16(pa, smallest);
+  nearest = _mm_or_si128(_mm_and_si128(mask, *a),
+			 _mm_andnot_si128(mask, nearest));
+  *a = _mm_and_si128(_mm_add_epi16(d, nearest), _mm_set1_epi16(0xff));
+  storePixel(row, _mm_packus_epi16(*a, *a), n);
+}
+
+// A trailing partial pixel goes through the same code, so that the
+// upper left bytes are still available.
+static inline void paethSSE2(Guchar *row, Guchar *raw, int len, int bpp) {
+  __m128i a, b;
+  int i;
+
+  a = b = _mm_setzero_si128();
+  for (i = 0; i + bpp <= len; i += bpp) {
+    paethPixelSSE2(row + i, raw + i, bpp, &a, &b);
+  }
+  if (i < len) {
+    paethPixelSSE2(row + i, raw + i, len - i, &a, &b);
+  }
+}
+
+#endif // PREDICTOR_SSE2
+
+//------------------------------------------------------------------------
+// entry points
+//------------------------------------------------------------------------
+
+void predictorUndoSub(Guchar *row, Guchar *raw, int len, int bpp) {
+#ifdef PREDICTOR_SSE2
+  switch (bpp) {
+  case 1:
+    subSSE2x1(row, raw, len);
+    return;
+  case 3:
+    subSSE2x3(row, raw, len);
+    return;
+  case 4:
+    subSSE2x4(row, raw, len);
+    return;
+  }
+#endif
+  subScalar(row, raw, len, bpp);
+}
+
+void predictorUndoUp(Guchar *row, Guchar *raw, int len) {
+#ifdef PREDICTOR_SSE2
+  upSSE2(row, raw, len);
+#else
+  upScalar(row, raw, len);
+#endif
+}
+
+void predictorUndoAverage(Guchar *row, Guchar *raw, int len, int bpp) {
+#ifdef PREDICTOR_SSE2
+  // constant <bpp> values let the pixel loads be inlined
+  if (bpp == 3) {
+    averageSSE2(row, raw, len, 3);
+    return;
+  } else if (bpp == 4) {
+    averageSSE2(row, raw, len, 4);
+    return;
+  }
+#endif
+  averageScalar(row, raw, len, bpp);
+}
+
+void predictorUndoPaeth(Guchar *row, Guchar *raw, int len, int bpp) {
+#ifdef PREDICTOR_SSE2
+  if (bpp == 3) {
+    paethSSE2(row, raw, len, 3);
+    return;
+  } else if (bpp == 4) {
+    paethSSE2(row, raw, len, 4);
+    return;
+  }
+#endif
+  paethScalar(row, raw, len, bpp);
+}
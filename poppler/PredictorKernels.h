@@ -0,0 +1,40 @@
+//========================================================================
+//
+// PredictorKernels.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef PREDICTORKERNELS_H
+#define PREDICTORKERNELS_H
+
+#include "goo/gtypes.h"
+
+//------------------------------------------------------------------------
+// Row kernels used by StreamPredictor to undo the PNG filters.  <row>
+// holds the previous decoded row on entry and the current one on exit;
+// the <bpp> bytes before <row> must be zero.  <raw> holds the <len>
+// filtered bytes of the current row.  SSE2 versions are used for 1, 3
+// and 4 bytes per pixel when the compiler targets SSE2, with a portable
+// fallback for the other cases.
+//------------------------------------------------------------------------
+
+// Maximum number of bytes per pixel (gfxColorMaxComps components of 16
+// bits).
+#define predictorMaxPixBytes 64
+
+// PNG Sub: row[i] = raw[i] + row[i-bpp].  <raw> may be equal to <row>,
+// which also undoes the TIFF predictor for 8-bit components.
+extern void predictorUndoSub(Guchar *row, Guchar *raw, int len, int bpp);
+
+// PNG Up: row[i] = raw[i] + previous row[i].
+extern void predictorUndoUp(Guchar *row, Guchar *raw, int len);
+
+// PNG Average: row[i] = raw[i] + (row[i-bpp] + previous row[i]) / 2.
+extern void predictorUndoAverage(Guchar *row, Guchar *raw, int len, int bpp);
+
+// PNG Paeth.
+extern void predictorUndoPaeth(Guchar *row, Guchar *raw, int len, int bpp);
+
+#endif
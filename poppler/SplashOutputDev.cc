@@ -68,10 +68,12 @@
 #include "splash/SplashPath.h"
 #include "splash/SplashState.h"
 #include "splash/SplashErrorCodes.h"
+#include "splash/SplashFTFacePool.h"
 #include "splash/SplashFontEngine.h"
 #include "splash/SplashFont.h"
 #include "splash/SplashFontFile.h"
 #include "splash/SplashFontFileID.h"
+#include "splash/SplashGlyphCache.h"
 #include "splash/Splash.h"
 #include "SplashOutputDev.h"
 #include <algorithm>
@@ -497,6 +499,10 @@ GBool SplashAxialPattern::getParameter(double xc, double yc, double *t) {
 #define type3FontCacheMaxSets 8
 #define type3FontCacheSize    (128*1024)
 
+// fonts whose glyphs don't fit in their cache double its number of sets,
+// up to this many, while the whole Type 3 cache stays within its budget
+#define type3FontCacheMaxGrownSets 1024
+
 //------------------------------------------------------------------------
 // Divide a 16-bit value (in [0, 255*255]) by 255, returning an 8-bit result.
 static inline Guchar div255(int x) {
@@ -1238,6 +1244,11 @@ public:
 		double m21A, double m22A)
     { return fontID.num == idA->num && fontID.gen == idA->gen &&
 	     m11 == m11A && m12 == m12A && m21 == m21A && m22 == m22A; }
+  int getBytes()
+    { return cacheTags ? cacheSets * cacheAssoc *
+	                   (glyphSize + (int)sizeof(T3FontCacheTag))
+	               : 0; }
+  GBool grow();
 
   Ref fontID;			// PDF font ID
   double m11, m12, m21, m22;	// transform matrix
@@ -1312,6 +1323,57 @@ T3FontCache::~T3FontCache() {
   gfree(cacheTags);
 }
 
+// Double the number of sets, moving the cached glyphs to their new sets
+// and keeping their MRU order.
+GBool T3FontCache::grow() {
+  Guchar *newData;
+  T3FontCacheTag *newTags, *tag;
+  int newSets, set, newSet, n, i, j, r;
+
+  newSets = 2 * cacheSets;
+  if (!cacheTags || newSets > type3FontCacheMaxGrownSets) {
+    return gFalse;
+  }
+  newData = (Guchar *)gmallocn3_checkoverflow(newSets, cacheAssoc, glyphSize);
+  if (!newData) {
+    return gFalse;
+  }
+  newTags = (T3FontCacheTag *)gmallocn(newSets * cacheAssoc,
+				       sizeof(T3FontCacheTag));
+  for (set = 0; set < cacheSets; ++set) {
+    // the glyphs of each set go to one of two new sets
+    for (newSet = set; newSet < newSets; newSet += cacheSets) {
+      n = 0;
+      for (r = 0; r < cacheAssoc; ++r) {
+	for (i = 0; i < cacheAssoc; ++i) {
+	  tag = &cacheTags[set * cacheAssoc + i];
+	  if ((tag->mru & 0x7fff) == r) {
+	    break;
+	  }
+	}
+	if (i < cacheAssoc && (tag->mru & 0x8000) &&
+	    (tag->code & (newSets - 1)) == newSet) {
+	  j = newSet * cacheAssoc + n;
+	  newTags[j].code = tag->code;
+	  newTags[j].mru = 0x8000 | n;
+	  memcpy(newData + j * glyphSize,
+		 cacheData + (set * cacheAssoc + i) * glyphSize, glyphSize);
+	  ++n;
+	}
+      }
+      for (; n < cacheAssoc; ++n) {
+	newTags[newSet * cacheAssoc + n].mru = n;
+      }
+    }
+  }
+  gfree(cacheData);
+  gfree(cacheTags);
+  cacheData = newData;
+  cacheTags = newTags;
+  cacheSets = newSets;
+  return gTrue;
+}
+
 struct T3GlyphStack {
   Gushort code;			// character code
 
@@ -1369,6 +1431,7 @@ SplashOutputDev::SplashOutputDev(SplashColorMode colorModeA,
   bitmapUpsideDown = gFalse;
   fontAntialias = gTrue;
   vectorAntialias = gTrue;
+  areaAntialias = gFalse;
   overprintPreview = overprintPreviewA;
   enableFreeTypeHinting = gFalse;
   enableSlightHinting = gFalse;
@@ -1390,15 +1453,26 @@ SplashOutputDev::SplashOutputDev(SplashColorMode colorModeA,
   splash = new Splash(bitmap, vectorAntialias, &screenParams);
   splash->setMinLineWidth(globalParams->getMinLineWidth());
   splash->setThinLineMode(thinLineMode);
+  splash->setAreaAntialias(areaAntialias);
   splash->clear(paperColor, 0);
 
   fontEngine = NULL;
 
+  t3FontCacheSize = splashOutT3FontCacheSize;
+  t3FontCache = (T3FontCache **)gmallocn(t3FontCacheSize,
+					 sizeof(T3FontCache *));
   nT3Fonts = 0;
+  t3CacheBytes = 0;
+  t3CacheMaxBytes = splashOutT3CacheBytes;
+  memset(&t3Stats, 0, sizeof(t3Stats));
   t3GlyphStack = NULL;
 
   font = NULL;
   needFontUpdate = gFalse;
+  inString = gFalse;
+  glyphRunX = glyphRunY = NULL;
+  glyphRunC = NULL;
+  glyphRunLen = glyphRunSize = 0;
   textClipPath = NULL;
   transpGroupStack = NULL;
   nestCount = 0;
@@ -1462,6 +1536,10 @@ SplashOutputDev::~SplashOutputDev() {
   for (i = 0; i < nT3Fonts; ++i) {
     delete t3FontCache[i];
   }
+  gfree(t3FontCache);
+  gfree(glyphRunX);
+  gfree(glyphRunY);
+  gfree(glyphRunC);
   if (fontEngine) {
     delete fontEngine;
   }
@@ -1480,6 +1558,11 @@ void SplashOutputDev::startDoc(PDFDoc *docA) {
   if (fontEngine) {
     delete fontEngine;
   }
+  SplashGlyphCache::getCache()->setMaxBytes(globalParams->getGlyphCacheSize());
+#if HAVE_FREETYPE_FREETYPE_H || HAVE_FREETYPE_H
+  SplashFTFacePool::getPool()->setMaxBytes(
+			       globalParams->getFontFacePoolSize());
+#endif
   fontEngine = new SplashFontEngine(
 #if HAVE_T1LIB_H
 				    globalParams->getEnableT1lib(),
@@ -1495,6 +1578,8 @@ void SplashOutputDev::startDoc(PDFDoc *docA) {
     delete t3FontCache[i];
   }
   nT3Fonts = 0;
+  t3CacheBytes = 0;
+  memset(&t3Stats, 0, sizeof(t3Stats));
 }
 
 void SplashOutputDev::startPage(int pageNum, GfxState *state, XRef *xrefA) {
@@ -1539,6 +1624,7 @@ void SplashOutputDev::startPage(int pageNum, GfxState *state, XRef *xrefA) {
   }
   splash = new Splash(bitmap, vectorAntialias, &screenParams);
   splash->setThinLineMode(thinLineMode);
+  splash->setAreaAntialias(areaAntialias);
   splash->setMinLineWidth(globalParams->getMinLineWidth());
   if (state) {
     ctm = state->getCTM();
@@ -2431,6 +2517,7 @@ void SplashOutputDev::drawChar(GfxState *state, double x, double y,
   }
 
   if (needFontUpdate) {
+    flushGlyphRun();
     doUpdateFont(state);
   }
   if (!font) {
@@ -2477,7 +2564,25 @@ void SplashOutputDev::drawChar(GfxState *state, double x, double y,
       splash->stroke(path);
     }
 
-  // fill
+  // fill -- within a string, the chars are collected and drawn as one
+  // run by endString()
+  } else if (doFill && inString) {
+    if (glyphRunLen == 0) {
+      setOverprintMask(state->getFillColorSpace(), state->getFillOverprint(),
+		       state->getOverprintMode(), state->getFillColor());
+    }
+    if (glyphRunLen == glyphRunSize) {
+      glyphRunSize = glyphRunSize ? 2 * glyphRunSize : 64;
+      glyphRunX = (SplashCoord *)greallocn(glyphRunX, glyphRunSize,
+					   sizeof(SplashCoord));
+      glyphRunY = (SplashCoord *)greallocn(glyphRunY, glyphRunSize,
+					   sizeof(SplashCoord));
+      glyphRunC = (int *)greallocn(glyphRunC, glyphRunSize, sizeof(int));
+    }
+    glyphRunX[glyphRunLen] = (SplashCoord)x;
+    glyphRunY[glyphRunLen] = (SplashCoord)y;
+    glyphRunC[glyphRunLen] = code;
+    ++glyphRunLen;
   } else if (doFill) {
     setOverprintMask(state->getFillColorSpace(), state->getFillOverprint(),
 		     state->getOverprintMode(), state->getFillColor());
@@ -2528,7 +2633,7 @@ GBool SplashOutputDev::beginType3Char(GfxState *state, double x, double y,
   double m[4];
   GBool horiz;
   double x1, y1, xMin, yMin, xMax, yMax, xt, yt;
-  int i, j;
+  int i, j, k, mru;
 
   if (skipHorizText || skipRotatedText) {
     state->getFontTransMat(&m[0], &m[1], &m[2], &m[3]);
@@ -2563,8 +2668,16 @@ GBool SplashOutputDev::beginType3Char(GfxState *state, double x, double y,
     }
     if (i >= nT3Fonts) {
 
-      // create new entry in the font cache
-      if (nT3Fonts == splashOutT3FontCacheSize) {
+      // create new entry in the font cache, making room for more fonts
+      // while they fit in the budget
+      if (nT3Fonts == t3FontCacheSize &&
+	  t3FontCacheSize < splashOutT3FontCacheMaxSize &&
+	  t3CacheBytes + type3FontCacheSize <= t3CacheMaxBytes) {
+	t3FontCacheSize *= 2;
+	t3FontCache = (T3FontCache **)greallocn(t3FontCache, t3FontCacheSize,
+						sizeof(T3FontCache *));
+      }
+      if (nT3Fonts == t3FontCacheSize) {
 	t3gs = t3GlyphStack;
 	while (t3gs != NULL) {
 	  if (t3gs->cache == t3FontCache[nT3Fonts - 1]) {
@@ -2573,8 +2686,10 @@ GBool SplashOutputDev::beginType3Char(GfxState *state, double x, double y,
 	  }
 	  t3gs = t3gs->next;
 	}
+	t3CacheBytes -= t3FontCache[nT3Fonts - 1]->getBytes();
 	delete t3FontCache[nT3Fonts - 1];
 	--nT3Fonts;
+	++t3Stats.fontEvictions;
       }
       for (j = nT3Fonts; j > 0; --j) {
 	t3FontCache[j] = t3FontCache[j - 1];
@@ -2634,6 +2749,7 @@ GBool SplashOutputDev::beginType3Char(GfxState *state, double x, double y,
 				       (int)ceil(yMax) - (int)floor(yMin) + 4,
 				       validBBox,
 				       colorMode != splashModeMono1);
+      t3CacheBytes += t3FontCache[0]->getBytes();
     }
   }
   t3Font = t3FontCache[0];
@@ -2644,12 +2760,22 @@ GBool SplashOutputDev::beginType3Char(GfxState *state, double x, double y,
     if (t3Font->cacheTags != NULL) {
       if ((t3Font->cacheTags[i+j].mru & 0x8000) &&
 	t3Font->cacheTags[i+j].code == code) {
+	// make it the most recently used glyph of its set
+	mru = t3Font->cacheTags[i+j].mru & 0x7fff;
+	for (k = 0; k < t3Font->cacheAssoc; ++k) {
+	  if ((t3Font->cacheTags[i+k].mru & 0x7fff) < mru) {
+	    ++t3Font->cacheTags[i+k].mru;
+	  }
+	}
+	t3Font->cacheTags[i+j].mru = 0x8000;
+	++t3Stats.glyphHits;
         drawType3Glyph(state, t3Font, &t3Font->cacheTags[i+j],
 		     t3Font->cacheData + (i+j) * t3Font->glyphSize);
         return gTrue;
       }
     }
   }
+  ++t3Stats.glyphRuns;
 
   // push a new Type 3 glyph record
   t3gs = new T3GlyphStack();
@@ -2683,6 +2809,8 @@ void SplashOutputDev::endType3Char(GfxState *state) {
     updateCTM(state, 0, 0, 0, 0, 0, 0);
     drawType3Glyph(state, t3GlyphStack->cache,
 		   t3GlyphStack->cacheTag, t3GlyphStack->cacheData);
+  } else {
+    ++t3Stats.glyphsNotCached;
   }
   t3gs = t3GlyphStack;
   t3GlyphStack = t3gs->next;
@@ -2697,9 +2825,10 @@ void SplashOutputDev::type3D1(GfxState *state, double wx, double wy,
 			      double llx, double lly, double urx, double ury) {
   double *ctm;
   T3FontCache *t3Font;
+  T3GlyphStack *t3gs;
   SplashColor color;
   double xt, yt, xMin, xMax, yMin, yMax, x1, y1;
-  int i, j;
+  int oldBytes, i, j;
 
   // ignore multiple d0/d1 operators
   if (haveT3Dx) {
@@ -2775,10 +2904,36 @@ void SplashOutputDev::type3D1(GfxState *state, double wx, double wy,
   if (t3Font->cacheTags == NULL)
     return;
 
+  // if the glyph's set is full, try to make room for more glyphs before
+  // replacing one; this moves the font's glyphs, so not while another
+  // glyph of the font is being cached
+  i = (t3GlyphStack->code & (t3Font->cacheSets - 1)) * t3Font->cacheAssoc;
+  for (j = 0; j < t3Font->cacheAssoc; ++j) {
+    if (!(t3Font->cacheTags[i+j].mru & 0x8000)) {
+      break;
+    }
+  }
+  if (j == t3Font->cacheAssoc) {
+    for (t3gs = t3GlyphStack->next; t3gs; t3gs = t3gs->next) {
+      if (t3gs->cache == t3Font && t3gs->cacheTag) {
+	break;
+      }
+    }
+    oldBytes = t3Font->getBytes();
+    if (!t3gs && t3CacheBytes + oldBytes <= t3CacheMaxBytes &&
+	t3Font->grow()) {
+      t3CacheBytes += t3Font->getBytes() - oldBytes;
+      ++t3Stats.cacheGrowths;
+    }
+  }
+
   // allocate a cache entry
   i = (t3GlyphStack->code & (t3Font->cacheSets - 1)) * t3Font->cacheAssoc;
   for (j = 0; j < t3Font->cacheAssoc; ++j) {
     if ((t3Font->cacheTags[i+j].mru & 0x7fff) == t3Font->cacheAssoc - 1) {
+      if (t3Font->cacheTags[i+j].mru & 0x8000) {
+	++t3Stats.glyphEvictions;
+      }
       t3Font->cacheTags[i+j].mru = 0x8000;
       t3Font->cacheTags[i+j].code = t3GlyphStack->code;
       t3GlyphStack->cacheTag = &t3Font->cacheTags[i+j];
@@ -2815,6 +2970,7 @@ void SplashOutputDev::type3D1(GfxState *state, double wx, double wy,
   }
   splash->setMinLineWidth(globalParams->getMinLineWidth());
   splash->setThinLineMode(splashThinLineDefault);
+  splash->setAreaAntialias(areaAntialias);
   splash->setFillPattern(new SplashSolidColor(color));
   splash->setStrokePattern(new SplashSolidColor(color));
   //~ this should copy other state from t3GlyphStack->origSplash?
@@ -2840,6 +2996,22 @@ void SplashOutputDev::drawType3Glyph(GfxState *state, T3FontCache *t3Font,
   splash->fillGlyph(0, 0, &glyph);
 }
 
+void SplashOutputDev::beginString(GfxState *state, GooString *s) {
+  inString = gTrue;
+}
+
+void SplashOutputDev::endString(GfxState *state) {
+  flushGlyphRun();
+  inString = gFalse;
+}
+
+void SplashOutputDev::flushGlyphRun() {
+  if (glyphRunLen > 0) {
+    splash->fillGlyphRun(glyphRunX, glyphRunY, glyphRunC, glyphRunLen, font);
+    glyphRunLen = 0;
+  }
+}
+
 void SplashOutputDev::beginTextObject(GfxState *state) {
 }
 
@@ -4263,6 +4435,7 @@ void SplashOutputDev::beginTransparencyGroup(GfxState *state, double *bbox,
 #endif
   }
   splash->setThinLineMode(transpGroup->origSplash->getThinLineMode());
+  splash->setAreaAntialias(areaAntialias);
   splash->setMinLineWidth(globalParams->getMinLineWidth());
   //~ Acrobat apparently copies at least the fill and stroke colors, and
   //~ maybe other state(?) -- but not the clipping path (and not sure
@@ -4529,12 +4702,23 @@ void SplashOutputDev::setVectorAntialias(GBool vaa) {
 }
 #endif
 
+void SplashOutputDev::setAreaAntialias(GBool aaa) {
+  areaAntialias = aaa;
+  splash->setAreaAntialias(aaa);
+}
+
 void SplashOutputDev::setFreeTypeHinting(GBool enable, GBool enableSlightHintingA)
 {
   enableFreeTypeHinting = enable;
   enableSlightHinting = enableSlightHintingA;
 }
 
+void SplashOutputDev::getType3Stats(SplashOutType3Stats *stats) {
+  *stats = t3Stats;
+  stats->nFonts = nT3Fonts;
+  stats->bytes = t3CacheBytes;
+}
+
 GBool SplashOutputDev::tilingPatternFill(GfxState *state, Gfx *gfxA, Catalog *catalog, Object *str,
 					double *ptm, int paintType, int /*tilingType*/, Dict *resDict,
 					double *mat, double *bbox,
@@ -4678,6 +4862,7 @@ GBool SplashOutputDev::tilingPatternFill(GfxState *state, Gfx *gfxA, Catalog *ca
     splash->clear(paperColor, 0);
   }
   splash->setThinLineMode(formerSplash->getThinLineMode());
+  splash->setAreaAntialias(areaAntialias);
   splash->setMinLineWidth(globalParams->getMinLineWidth());
 
   box.x1 = bbox[0]; box.y1 = bbox[1];
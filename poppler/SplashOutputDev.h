@@ -185,8 +185,25 @@ private:
 
 //------------------------------------------------------------------------
 
-// number of Type 3 fonts to cache
+// number of Type 3 fonts to cache initially; the cache grows, up to
+// splashOutT3FontCacheMaxSize fonts, while it stays within its byte
+// budget (splashOutT3CacheBytes by default)
 #define splashOutT3FontCacheSize 8
+#define splashOutT3FontCacheMaxSize 256
+#define splashOutT3CacheBytes (8*1024*1024)
+
+struct SplashOutType3Stats {
+  Gulong glyphHits;		// glyphs drawn from the cache
+  Gulong glyphRuns;		// glyph procedures run, i.e., misses
+  Gulong glyphsNotCached;	// glyph procedures run whose result
+				//   couldn't be cached (d0 glyphs, bad
+				//   bboxes, etc.)
+  Gulong glyphEvictions;	// cached glyphs replaced by others
+  Gulong fontEvictions;		// fonts dropped from the cache
+  Gulong cacheGrowths;		// font glyph caches enlarged
+  int nFonts;			// number of cached fonts
+  Goffset bytes;		// size of the cached glyphs, in bytes
+};
 
 //------------------------------------------------------------------------
 // SplashOutputDev
@@ -222,6 +239,9 @@ public:
   // (Upside-down means (0,0) is the top left corner of the page.)
   virtual GBool upsideDown() { return bitmapTopDown ^ bitmapUpsideDown; }
 
+  // Can Page replay cached display lists into this device?
+  virtual GBool useDisplayListCache() { return gTrue; }
+
   // Does this device use drawChar() or drawString()?
   virtual GBool useDrawChar() { return gTrue; }
 
@@ -289,6 +309,8 @@ public:
   virtual void clipToStrokePath(GfxState *state);
 
   //----- text drawing
+  virtual void beginString(GfxState *state, GooString *s);
+  virtual void endString(GfxState *state);
   virtual void drawChar(GfxState *state, double x, double y,
 			double dx, double dy,
 			double originX, double originY,
@@ -393,10 +415,24 @@ public:
   GBool getFontAntialias() { return fontAntialias; }
   void setFontAntialias(GBool anti) { fontAntialias = anti; }
 
+  // If <aaa> is true, anti-aliased paths are rendered with the exact
+  // pixel coverage instead of 4x4 supersampling.
+  GBool getAreaAntialias() { return areaAntialias; }
+  void setAreaAntialias(GBool aaa);
+
   void setFreeTypeHinting(GBool enable, GBool enableSlightHinting);
 
+  // Set the byte budget of the Type 3 glyph cache, which is shared by
+  // all cached Type 3 fonts.  With a budget of 0, the cache keeps
+  // splashOutT3FontCacheSize fonts, and doesn't grow.
+  void setType3CacheSize(int bytes) { t3CacheMaxBytes = bytes; }
+
+  // Get the Type 3 glyph cache counters, which are reset by startDoc().
+  void getType3Stats(SplashOutType3Stats *stats);
+
 protected:
   void doUpdateFont(GfxState *state);
+  void flushGlyphRun();
 
 private:
   GBool univariateShadedFill(GfxState *state, SplashUnivariatePattern *pattern, double tMin, double tMax);
@@ -439,6 +475,7 @@ private:
   GBool bitmapUpsideDown;
   GBool fontAntialias;
   GBool vectorAntialias;
+  GBool areaAntialias;
   GBool overprintPreview;
   GBool enableFreeTypeHinting;
   GBool enableSlightHinting;
@@ -455,13 +492,21 @@ private:
   Splash *splash;
   SplashFontEngine *fontEngine;
 
-  T3FontCache *			// Type 3 font cache
-    t3FontCache[splashOutT3FontCacheSize];
+  T3FontCache **t3FontCache;	// Type 3 font cache, MRU first
+  int t3FontCacheSize;		// size of t3FontCache
   int nT3Fonts;			// number of valid entries in t3FontCache
+  Goffset t3CacheBytes;		// size of the fonts in t3FontCache
+  int t3CacheMaxBytes;		// budget for t3CacheBytes
+  SplashOutType3Stats t3Stats;	// Type 3 glyph cache counters
   T3GlyphStack *t3GlyphStack;	// Type 3 glyph context stack
   GBool haveT3Dx;		// set after seeing a d0/d1 operator
 
   SplashFont *font;		// current font
+  GBool inString;		// between beginString() and endString()
+  SplashCoord *glyphRunX,	// filled chars of the current string,
+              *glyphRunY;	//   drawn by endString() with
+  int *glyphRunC;		//   Splash::fillGlyphRun()
+  int glyphRunLen, glyphRunSize;
   GBool needFontUpdate;		// set when the font needs to be updated
   SplashPath *textClipPath;	// clipping path built with text object
 
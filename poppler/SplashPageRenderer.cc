@@ -0,0 +1,401 @@
+//========================================================================
+//
+// SplashPageRenderer.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#include "SplashPageRenderer.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "goo/gmem.h"
+#include "splash/SplashBitmap.h"
+#include "Error.h"
+#include "PDFDoc.h"
+#include "SplashOutputDev.h"
+#include "DisplayListOutputDev.h"
+
+#if MULTITHREADED && defined(HAVE_PTHREAD)
+#include <pthread.h>
+#include <deque>
+#define SPLASH_PAGE_RENDERER_THREADS 1
+#endif
+
+// Number of pages per worker that may be rendered ahead of the page
+// being delivered.  This bounds the number of bitmaps held in memory.
+#define pagesAheadPerWorker 2
+
+//------------------------------------------------------------------------
+
+struct SplashPageRenderer::Job {
+  const std::vector<int> *pages;
+  CreateOutputDevFunc createOutputDev;
+  RenderPageFunc renderPage;
+  PageDoneFunc pageDone;
+  void *data;
+
+#ifdef SPLASH_PAGE_RENDERER_THREADS
+  Worker *workers;
+  int nThreads;
+  std::vector<SplashBitmap *> bitmaps;	// indexed like pages
+  std::vector<char> done;
+  int nextToDeliver;			// index of the next page to hand out
+  int maxAhead;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+#endif
+};
+
+struct SplashPageRenderer::Band {
+  DisplayList *list;
+  SplashOutputDev *out;
+  int sliceX, sliceY, sliceW, sliceH;
+  SplashBitmap *bitmap;
+#ifdef SPLASH_PAGE_RENDERER_THREADS
+  pthread_t thread;
+  GBool started;
+#endif
+};
+
+struct SplashPageRenderer::Worker {
+  SplashPageRenderer *renderer;
+  Job *job;
+  SplashOutputDev *out;
+#ifdef SPLASH_PAGE_RENDERER_THREADS
+  std::deque<int> queue;		// indices into job->pages, ascending
+  pthread_t thread;
+#endif
+};
+
+//------------------------------------------------------------------------
+// SplashPageRenderer
+//------------------------------------------------------------------------
+
+SplashPageRenderer::SplashPageRenderer(PDFDoc *docA, int nWorkersA) {
+  doc = docA;
+  nWorkers = nWorkersA < 1 ? 1 : nWorkersA;
+#ifndef SPLASH_PAGE_RENDERER_THREADS
+  nWorkers = 1;
+#endif
+}
+
+SplashPageRenderer::~SplashPageRenderer() {
+}
+
+void SplashPageRenderer::render(const std::vector<int> &pages,
+			       CreateOutputDevFunc createOutputDev,
+			       RenderPageFunc renderPage,
+			       PageDoneFunc pageDone, void *data) {
+  Job job;
+
+  job.pages = &pages;
+  job.createOutputDev = createOutputDev;
+  job.renderPage = renderPage;
+  job.pageDone = pageDone;
+  job.data = data;
+  if (nWorkers == 1 || pages.size() <= 1) {
+    renderSerial(&job);
+  } else {
+    renderParallel(&job);
+  }
+}
+
+void SplashPageRenderer::renderSerial(Job *job) {
+  SplashOutputDev *out;
+  size_t i;
+
+  out = (*job->createOutputDev)(doc, job->data);
+  for (i = 0; i < job->pages->size(); ++i) {
+    int pg = (*job->pages)[i];
+    (*job->renderPage)(doc, out, pg, job->data);
+    (*job->pageDone)(pg, out->getBitmap(), job->data);
+  }
+  delete out;
+}
+
+SplashBitmap *SplashPageRenderer::renderBands(int pg, double hDPI,
+					      double vDPI, int rotate,
+					      GBool useMediaBox, GBool crop,
+					      GBool printing,
+					      int sliceX, int sliceY,
+					      int sliceW, int sliceH,
+					      int minBandHeight,
+					      CreateOutputDevFunc createOutputDev,
+					      void *data) {
+  SplashOutputDev *proto;
+  DisplayListOutputDev *recorder;
+  DisplayList *list;
+  Band *bands;
+  SplashBitmap *bitmap, *band;
+  int nBands, bandH, y, i, j;
+
+  if (sliceW < 1 || sliceH < 1) {
+    return NULL;
+  }
+  if (minBandHeight < 1) {
+    minBandHeight = 1;
+  }
+
+  // record the page once, the bands are replayed from the list
+  proto = (*createOutputDev)(doc, data);
+  recorder = new DisplayListOutputDev(proto);
+  doc->displayPage(recorder, pg, hDPI, vDPI, rotate, useMediaBox, crop,
+		   printing);
+  list = recorder->takeDisplayList();
+  delete recorder;
+  delete proto;
+
+  // the band height is rounded up, so the number of bands is recomputed
+  // from it to keep the last band from being empty
+  nBands = nWorkers;
+  if (sliceH / nBands < minBandHeight) {
+    nBands = sliceH / minBandHeight;
+  }
+  if (nBands < 1) {
+    nBands = 1;
+  }
+  bandH = (sliceH + nBands - 1) / nBands;
+  nBands = (sliceH + bandH - 1) / bandH;
+
+  bands = new Band[nBands];
+  for (i = 0, y = sliceY; i < nBands; ++i, y += bandH) {
+    bands[i].list = list;
+    bands[i].out = (*createOutputDev)(doc, data);
+    bands[i].sliceX = sliceX;
+    bands[i].sliceY = y;
+    bands[i].sliceW = sliceW;
+    bands[i].sliceH = (i == nBands - 1) ? sliceY + sliceH - y : bandH;
+    bands[i].bitmap = NULL;
+  }
+
+#ifdef SPLASH_PAGE_RENDERER_THREADS
+  // the first band is rendered in the caller thread, so are the bands
+  // whose thread could not be started
+  for (i = 1; i < nBands; ++i) {
+    bands[i].started = pthread_create(&bands[i].thread, NULL,
+				      &SplashPageRenderer::bandMain,
+				      &bands[i]) == 0;
+  }
+  bandMain(&bands[0]);
+  for (i = 1; i < nBands; ++i) {
+    if (bands[i].started) {
+      pthread_join(bands[i].thread, NULL);
+    } else {
+      bandMain(&bands[i]);
+    }
+  }
+#else
+  for (i = 0; i < nBands; ++i) {
+    bandMain(&bands[i]);
+  }
+#endif
+  list->decRefCnt();
+
+  // stitch the bands together, the rows are addressed through the row
+  // size so that bottom-up bitmaps work too
+  bitmap = NULL;
+  band = bands[0].bitmap;
+  if (band) {
+    bitmap = new SplashBitmap(band->getWidth(), sliceH, band->getRowPad(),
+			      band->getMode(), band->getAlphaPtr() != NULL,
+			      band->getRowSize() >= 0,
+			      band->getSeparationList());
+    if (!bitmap->getDataPtr()) {
+      delete bitmap;
+      bitmap = NULL;
+    }
+  }
+  for (i = 0, y = 0; bitmap && i < nBands; ++i) {
+    band = bands[i].bitmap;
+    if (!band ||
+	band->getWidth() != bitmap->getWidth() ||
+	band->getRowSize() != bitmap->getRowSize() ||
+	(band->getAlphaPtr() != NULL) != (bitmap->getAlphaPtr() != NULL) ||
+	y + band->getHeight() > sliceH) {
+      error(errInternal, -1, "Page bands don't match");
+      delete bitmap;
+      bitmap = NULL;
+      break;
+    }
+    for (j = 0; j < band->getHeight(); ++j, ++y) {
+      memcpy(bitmap->getDataPtr() + y * bitmap->getRowSize(),
+	     band->getDataPtr() + j * band->getRowSize(),
+	     abs(band->getRowSize()));
+      if (band->getAlphaPtr()) {
+	memcpy(bitmap->getAlphaPtr() + y * bitmap->getAlphaRowSize(),
+	       band->getAlphaPtr() + j * band->getAlphaRowSize(),
+	       band->getAlphaRowSize());
+      }
+    }
+  }
+
+  for (i = 0; i < nBands; ++i) {
+    delete bands[i].bitmap;
+    delete bands[i].out;
+  }
+  delete[] bands;
+  return bitmap;
+}
+
+void *SplashPageRenderer::bandMain(void *arg) {
+  Band *band;
+
+  band = (Band *)arg;
+  band->list->replaySlice(band->out, band->sliceX, band->sliceY,
+			  band->sliceW, band->sliceH);
+  band->bitmap = band->out->takeBitmap();
+  return NULL;
+}
+
+#ifdef SPLASH_PAGE_RENDERER_THREADS
+
+void SplashPageRenderer::renderParallel(Job *job) {
+  int nPages, nThreads, nStarted, i;
+  GBool ok;
+
+  nPages = (int)job->pages->size();
+  nThreads = nWorkers < nPages ? nWorkers : nPages;
+  job->bitmaps.assign(nPages, (SplashBitmap *)NULL);
+  job->done.assign(nPages, 0);
+  job->nextToDeliver = 0;
+  job->nThreads = nThreads;
+  job->maxAhead = nThreads * pagesAheadPerWorker;
+  pthread_mutex_init(&job->mutex, NULL);
+  pthread_cond_init(&job->cond, NULL);
+
+  job->workers = new Worker[nThreads];
+  for (i = 0; i < nThreads; ++i) {
+    job->workers[i].renderer = this;
+    job->workers[i].job = job;
+    job->workers[i].out = (*job->createOutputDev)(doc, job->data);
+  }
+  for (i = 0; i < nPages; ++i) {
+    job->workers[i % nThreads].queue.push_back(i);
+  }
+
+  // a worker that failed to start leaves its queue behind, the running
+  // workers steal those pages
+  nStarted = 0;
+  for (i = 0; i < nThreads; ++i) {
+    if (pthread_create(&job->workers[i].thread, NULL,
+		       &SplashPageRenderer::workerMain,
+		       &job->workers[i]) != 0) {
+      error(errInternal, -1, "Failed to start page rendering thread");
+      break;
+    }
+    ++nStarted;
+  }
+  ok = nStarted > 0;
+
+  // hand the bitmaps to the caller in page order
+  for (i = 0; ok && i < nPages; ++i) {
+    SplashBitmap *bitmap;
+
+    pthread_mutex_lock(&job->mutex);
+    while (!job->done[i]) {
+      pthread_cond_wait(&job->cond, &job->mutex);
+    }
+    bitmap = job->bitmaps[i];
+    job->bitmaps[i] = NULL;
+    job->nextToDeliver = i + 1;
+    pthread_cond_broadcast(&job->cond);
+    pthread_mutex_unlock(&job->mutex);
+
+    (*job->pageDone)((*job->pages)[i], bitmap, job->data);
+    delete bitmap;
+  }
+
+  for (i = 0; i < nStarted; ++i) {
+    pthread_join(job->workers[i].thread, NULL);
+  }
+  for (i = 0; i < nThreads; ++i) {
+    delete job->workers[i].out;
+  }
+  delete[] job->workers;
+  pthread_cond_destroy(&job->cond);
+  pthread_mutex_destroy(&job->mutex);
+  if (!ok) {
+    renderSerial(job);
+  }
+}
+
+// Pick the next page for <worker>: the front of its own queue, or else
+// the lowest page queued by any worker.  Returns -1 when there is nothing
+// left to render, or -2 when all candidates are too far ahead of the
+// delivery.  Must be called with the job mutex held.
+int SplashPageRenderer::nextPage(Worker *worker) {
+  Job *job;
+  std::deque<int> *queue;
+  int limit, i, idx;
+
+  job = worker->job;
+  limit = job->nextToDeliver + job->maxAhead;
+  queue = NULL;
+  if (!worker->queue.empty() && worker->queue.front() < limit) {
+    queue = &worker->queue;
+  } else {
+    for (i = 0; i < job->nThreads; ++i) {
+      std::deque<int> *q = &job->workers[i].queue;
+      if (!q->empty() && (!queue || q->front() < queue->front())) {
+	queue = q;
+      }
+    }
+  }
+  if (!queue) {
+    return -1;
+  }
+  idx = queue->front();
+  if (idx >= limit) {
+    return -2;
+  }
+  queue->pop_front();
+  return idx;
+}
+
+void *SplashPageRenderer::workerMain(void *arg) {
+  Worker *worker;
+  Job *job;
+  int idx, pg;
+
+  worker = (Worker *)arg;
+  job = worker->job;
+  pthread_mutex_lock(&job->mutex);
+  while ((idx = worker->renderer->nextPage(worker)) != -1) {
+    if (idx == -2) {
+      pthread_cond_wait(&job->cond, &job->mutex);
+      continue;
+    }
+    pthread_mutex_unlock(&job->mutex);
+
+    pg = (*job->pages)[idx];
+    (*job->renderPage)(worker->renderer->doc, worker->out, pg, job->data);
+    SplashBitmap *bitmap = worker->out->takeBitmap();
+
+    pthread_mutex_lock(&job->mutex);
+    job->bitmaps[idx] = bitmap;
+    job->done[idx] = 1;
+    pthread_cond_broadcast(&job->cond);
+  }
+  pthread_mutex_unlock(&job->mutex);
+  return NULL;
+}
+
+#else // SPLASH_PAGE_RENDERER_THREADS
+
+void SplashPageRenderer::renderParallel(Job *job) {
+  renderSerial(job);
+}
+
+void *SplashPageRenderer::workerMain(void *arg) {
+  return NULL;
+}
+
+int SplashPageRenderer::nextPage(Worker *worker) {
+  return -1;
+}
+
+#endif // SPLASH_PAGE_RENDERER_THREADS
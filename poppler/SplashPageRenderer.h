@@ -0,0 +1,97 @@
+//========================================================================
+//
+// SplashPageRenderer.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef SPLASHPAGERENDERER_H
+#define SPLASHPAGERENDERER_H
+
+#include "poppler-config.h"
+#include "goo/gtypes.h"
+
+#include <vector>
+
+class PDFDoc;
+class SplashBitmap;
+class SplashOutputDev;
+
+//------------------------------------------------------------------------
+// SplashPageRenderer
+//
+// Renders a list of pages of one PDFDoc with a pool of worker threads.
+// Every worker owns its own SplashOutputDev and all of them share the
+// PDFDoc.  Pages are dealt round-robin to per-worker queues; a worker
+// whose queue is empty steals the lowest pending page from the other
+// queues.  The rendered bitmaps are handed back to the caller thread in
+// the order of the page list, workers never run more than a few pages
+// ahead of the page being delivered.
+//
+// A single large page can also be split into horizontal bands: the page
+// is recorded once, the bands are replayed from the recording in
+// parallel and stitched back together.
+//
+// Without thread support, or with a single worker, pages are rendered
+// one after the other in the caller thread.
+//------------------------------------------------------------------------
+
+class SplashPageRenderer {
+public:
+
+  // Creates the output device of a worker; called in the caller thread
+  // before rendering starts.  startDoc() must have been called on the
+  // returned device.
+  typedef SplashOutputDev *(*CreateOutputDevFunc)(PDFDoc *doc, void *data);
+
+  // Renders page <pg> into <out>; called in a worker thread.
+  typedef void (*RenderPageFunc)(PDFDoc *doc, SplashOutputDev *out,
+				 int pg, void *data);
+
+  // Receives the bitmap of page <pg>; called in the caller thread in page
+  // list order.  The bitmap is deleted when the callback returns.
+  typedef void (*PageDoneFunc)(int pg, SplashBitmap *bitmap, void *data);
+
+  SplashPageRenderer(PDFDoc *docA, int nWorkersA);
+  ~SplashPageRenderer();
+
+  int getNumWorkers() { return nWorkers; }
+
+  // Render all pages in <pages> and deliver them in order.  If the
+  // worker threads can't be started, the pages are rendered in the
+  // caller thread.
+  void render(const std::vector<int> &pages,
+	      CreateOutputDevFunc createOutputDev,
+	      RenderPageFunc renderPage,
+	      PageDoneFunc pageDone, void *data);
+
+  // Render the device area (<sliceX>, <sliceY>, <sliceW>, <sliceH>) of
+  // page <pg> as one band per worker, each band at least <minBandHeight>
+  // pixels high.  The page is recorded into a DisplayList once and each
+  // band replays its part of the list, so the bands line up exactly.
+  // Returns the stitched bitmap, which the caller owns, or NULL if it
+  // could not be allocated.
+  SplashBitmap *renderBands(int pg, double hDPI, double vDPI, int rotate,
+			    GBool useMediaBox, GBool crop, GBool printing,
+			    int sliceX, int sliceY, int sliceW, int sliceH,
+			    int minBandHeight,
+			    CreateOutputDevFunc createOutputDev, void *data);
+
+private:
+
+  struct Worker;
+  struct Job;
+  struct Band;
+
+  void renderSerial(Job *job);
+  void renderParallel(Job *job);
+  static void *workerMain(void *arg);
+  static void *bandMain(void *arg);
+  int nextPage(Worker *worker);
+
+  PDFDoc *doc;
+  int nWorkers;
+};
+
+#endif
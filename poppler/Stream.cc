@@ -61,6 +61,7 @@
 #include "Lexer.h"
 #include "GfxState.h"
 #include "Stream.h"
+#include "PredictorKernels.h"
 #include "XRef.h"
 #include "JBIG2Stream.h"
 #include "Stream-CCITT.h"
@@ -70,7 +71,7 @@
 #include "DCTStream.h"
 #endif
 
-#ifdef ENABLE_ZLIB_UNCOMPRESS
+#if ENABLE_ZLIB_UNCOMPRESS
 #include "FlateStream.h"
 #endif
 
@@ -134,6 +135,22 @@ int Stream::getRawChar() {
   return EOF;
 }
 
+Goffset Stream::discardChars(Goffset nChars) {
+  Guchar buf[4096];
+  Goffset n;
+  int m;
+
+  n = 0;
+  while (n < nChars) {
+    m = nChars - n < (Goffset)sizeof(buf) ? (int)(nChars - n) : (int)sizeof(buf);
+    if ((m = doGetChars(m, buf)) == 0) {
+      break;
+    }
+    n += m;
+  }
+  return n;
+}
+
 int Stream::getChars(int nChars, Guchar *buffer) {
   error(errInternal, -1, "Internal: called getChars() on non-predictor stream");
   return 0;
@@ -143,6 +160,18 @@ void Stream::getRawChars(int nChars, int *buffer) {
   error(errInternal, -1, "Internal: called getRawChars() on non-predictor stream");
 }
 
+int Stream::getRawBlock(int nChars, Guchar *buffer) {
+  int c, i;
+
+  for (i = 0; i < nChars; ++i) {
+    if ((c = getRawChar()) == EOF) {
+      break;
+    }
+    buffer[i] = (Guchar)c;
+  }
+  return i;
+}
+
 char *Stream::getLine(char *buf, int size) {
   int i;
   int c;
@@ -175,15 +204,15 @@ Stream *Stream::addFilters(Object *dict, int recursion) {
   int i;
 
   str = this;
-  dict->dictLookup("Filter", &obj, recursion);
+  dict->dictLookup(atomFilter, &obj, recursion);
   if (obj.isNull()) {
     obj.free();
-    dict->dictLookup("F", &obj);
+    dict->dictLookup(atomF, &obj);
   }
-  dict->dictLookup("DecodeParms", &params, recursion);
+  dict->dictLookup(atomDecodeParms, &params, recursion);
   if (params.isNull()) {
     params.free();
-    dict->dictLookup("DP", &params);
+    dict->dictLookup(atomDP, &params);
   }
   if (obj.isName()) {
     str = makeFilter(obj.getName(), str, &params, recursion, dict);
@@ -246,7 +275,7 @@ Stream *Stream::makeFilter(char *name, Stream *str, Object *params, int recursio
       if (obj.isInt())
 	colors = obj.getInt();
       obj.free();
-      params->dictLookup("BitsPerComponent", &obj, recursion);
+      params->dictLookup(atomBitsPerComponent, &obj, recursion);
       if (obj.isInt())
 	bits = obj.getInt();
       obj.free();
@@ -332,12 +361,16 @@ Stream *Stream::makeFilter(char *name, Stream *str, Object *params, int recursio
       if (obj.isInt())
 	colors = obj.getInt();
       obj.free();
-      params->dictLookup("BitsPerComponent", &obj, recursion);
+      params->dictLookup(atomBitsPerComponent, &obj, recursion);
       if (obj.isInt())
 	bits = obj.getInt();
       obj.free();
     }
+#if ENABLE_ZLIB_UNCOMPRESS
+    str = new ZlibFlateStream(str, pred, columns, colors, bits);
+#else
     str = new FlateStream(str, pred, columns, colors, bits);
+#endif
   } else if (!strcmp(name, "JBIG2Decode")) {
     if (params->isDict()) {
       XRef *xref = params->getDict()->getXRef();
@@ -580,6 +613,7 @@ StreamPredictor::StreamPredictor(Stream *strA, int predictorA,
   nComps = nCompsA;
   nBits = nBitsA;
   predLine = NULL;
+  rawLine = NULL;
   ok = gFalse;
 
   nVals = width * nComps;
@@ -595,12 +629,15 @@ StreamPredictor::StreamPredictor(Stream *strA, int predictorA,
   predLine = (Guchar *)gmalloc(rowBytes);
   memset(predLine, 0, rowBytes);
   predIdx = rowBytes;
+  rawBytes = rowBytes - pixBytes + (predictor >= 10 ? 1 : 0);
+  rawLine = (Guchar *)gmalloc(rawBytes);
 
   ok = gTrue;
 }
 
 StreamPredictor::~StreamPredictor() {
   gfree(predLine);
+  gfree(rawLine);
 }
 
 int StreamPredictor::lookChar() {
@@ -645,77 +682,51 @@ int StreamPredictor::getChars(int nChars, Guchar *buffer) {
 GBool StreamPredictor::getNextLine() {
   int curPred;
   Guchar upLeftBuf[gfxColorMaxComps * 2 + 1];
-  int left, up, upLeft, p, pa, pb, pc;
-  int c;
+  Guchar *raw;
+  int n;
   Gulong inBuf, outBuf, bitMask;
   int inBits, outBits;
   int i, j, k, kk;
 
-  // get PNG optimum predictor number
+  // read the raw line, with the PNG optimum predictor number
+  n = str->getRawBlock(rawBytes, rawLine);
   if (predictor >= 10) {
-    if ((curPred = str->getRawChar()) == EOF) {
+    if (n < 1) {
       return gFalse;
     }
-    curPred += 10;
+    curPred = rawLine[0] + 10;
+    raw = rawLine + 1;
+    --n;
   } else {
     curPred = predictor;
+    raw = rawLine;
   }
-
-  // read the raw line, apply PNG (byte) predictor
-  int *rawCharLine = new int[rowBytes - pixBytes];
-  str->getRawChars(rowBytes - pixBytes, rawCharLine);
-  memset(upLeftBuf, 0, pixBytes + 1);
-  for (i = pixBytes; i < rowBytes; ++i) {
-    for (j = pixBytes; j > 0; --j) {
-      upLeftBuf[j] = upLeftBuf[j-1];
-    }
-    upLeftBuf[0] = predLine[i];
-    if ((c = rawCharLine[i - pixBytes]) == EOF) {
-      if (i > pixBytes) {
-	// this ought to return false, but some (broken) PDF files
-	// contain truncated image data, and Adobe apparently reads the
-	// last partial line
-	break;
-      }
-      delete[] rawCharLine;
-      return gFalse;
-    }
-    switch (curPred) {
-    case 11:			// PNG sub
-      predLine[i] = predLine[i - pixBytes] + (Guchar)c;
-      break;
-    case 12:			// PNG up
-      predLine[i] = predLine[i] + (Guchar)c;
-      break;
-    case 13:			// PNG average
-      predLine[i] = ((predLine[i - pixBytes] + predLine[i]) >> 1) +
-	            (Guchar)c;
-      break;
-    case 14:			// PNG Paeth
-      left = predLine[i - pixBytes];
-      up = predLine[i];
-      upLeft = upLeftBuf[pixBytes];
-      p = left + up - upLeft;
-      if ((pa = p - left) < 0)
-	pa = -pa;
-      if ((pb = p - up) < 0)
-	pb = -pb;
-      if ((pc = p - upLeft) < 0)
-	pc = -pc;
-      if (pa <= pb && pa <= pc)
-	predLine[i] = left + (Guchar)c;
-      else if (pb <= pc)
-	predLine[i] = up + (Guchar)c;
-      else
-	predLine[i] = upLeft + (Guchar)c;
-      break;
-    case 10:			// PNG none
-    default:			// no predictor or TIFF predictor
-      predLine[i] = (Guchar)c;
-      break;
-    }
+  if (n == 0) {
+    return gFalse;
+  }
+  // if n < rowBytes - pixBytes, the line is truncated: this ought to
+  // return false, but some (broken) PDF files contain truncated image
+  // data, and Adobe apparently reads the last partial line
+
+  // apply PNG (byte) predictor
+  switch (curPred) {
+  case 11:			// PNG sub
+    predictorUndoSub(predLine + pixBytes, raw, n, pixBytes);
+    break;
+  case 12:			// PNG up
+    predictorUndoUp(predLine + pixBytes, raw, n);
+    break;
+  case 13:			// PNG average
+    predictorUndoAverage(predLine + pixBytes, raw, n, pixBytes);
+    break;
+  case 14:			// PNG Paeth
+    predictorUndoPaeth(predLine + pixBytes, raw, n, pixBytes);
+    break;
+  case 10:			// PNG none
+  default:			// no predictor or TIFF predictor
+    memcpy(predLine + pixBytes, raw, n);
+    break;
   }
-  delete[] rawCharLine;
 
   // apply TIFF (component) predictor
   if (predictor == 2) {
@@ -727,9 +738,8 @@ GBool StreamPredictor::getNextLine() {
 	predLine[i] ^= inBuf >> nComps;
       }
     } else if (nBits == 8) {
-      for (i = pixBytes; i < rowBytes; ++i) {
-	predLine[i] += predLine[i - nComps];
-      }
+      predictorUndoSub(predLine + pixBytes, predLine + pixBytes,
+		       rowBytes - pixBytes, nComps);
     } else {
       memset(upLeftBuf, 0, nComps + 1);
       bitMask = (1 << nBits) - 1;
@@ -933,6 +943,27 @@ GBool CachedFileStream::fillBuf()
   return gTrue;
 }
 
+int CachedFileStream::getChars(int nChars, Guchar *buffer) {
+  int n, m;
+
+  n = 0;
+  while (n < nChars) {
+    if (bufPtr >= bufEnd) {
+      if (!fillBuf()) {
+	break;
+      }
+    }
+    m = (int)(bufEnd - bufPtr);
+    if (m > nChars - n) {
+      m = nChars - n;
+    }
+    memcpy(buffer + n, bufPtr, m);
+    bufPtr += m;
+    n += m;
+  }
+  return n;
+}
+
 void CachedFileStream::setPos(Goffset pos, int dir)
 {
   Guint size;
@@ -1022,6 +1053,22 @@ int MemStream::getChars(int nChars, Guchar *buffer) {
   return n;
 }
 
+int MemStream::getSpan(int nChars, const Guchar **span) {
+  int n;
+
+  if (nChars <= 0) {
+    return 0;
+  }
+  if (bufEnd - bufPtr < nChars) {
+    n = (int)(bufEnd - bufPtr);
+  } else {
+    n = nChars;
+  }
+  *span = (const Guchar *)bufPtr;
+  bufPtr += n;
+  return n;
+}
+
 void MemStream::setPos(Goffset pos, int dir) {
   Guint i;
 
@@ -1086,13 +1133,17 @@ int EmbedStream::lookChar() {
 }
 
 int EmbedStream::getChars(int nChars, Guchar *buffer) {
+  int n;
+
   if (nChars <= 0) {
     return 0;
   }
   if (limited && length < nChars) {
     nChars = length;
   }
-  return str->doGetChars(nChars, buffer);
+  n = str->doGetChars(nChars, buffer);
+  length -= n;
+  return n;
 }
 
 void EmbedStream::setPos(Goffset pos, int dir) {
@@ -1183,6 +1234,21 @@ int ASCIIHexStream::lookChar() {
   return buf;
 }
 
+// The input is still read a char at a time, since this filter is used
+// for inline images, which must not be read past their end.
+int ASCIIHexStream::getChars(int nChars, Guchar *buffer) {
+  int c, i;
+
+  for (i = 0; i < nChars; ++i) {
+    if ((c = ASCIIHexStream::lookChar()) == EOF) {
+      break;
+    }
+    buffer[i] = (Guchar)c;
+    buf = EOF;
+  }
+  return i;
+}
+
 GooString *ASCIIHexStream::getPSFilter(int psLevel, const char *indent) {
   GooString *s;
 
@@ -1264,6 +1330,19 @@ int ASCII85Stream::lookChar() {
   return b[index];
 }
 
+int ASCII85Stream::getChars(int nChars, Guchar *buffer) {
+  int c, i;
+
+  for (i = 0; i < nChars; ++i) {
+    if ((c = ASCII85Stream::lookChar()) == EOF) {
+      break;
+    }
+    buffer[i] = (Guchar)c;
+    ++index;
+  }
+  return i;
+}
+
 GooString *ASCII85Stream::getPSFilter(int psLevel, const char *indent) {
   GooString *s;
 
@@ -1345,16 +1424,9 @@ void LZWStream::getRawChars(int nChars, int *buffer) {
     buffer[i] = doGetRawChar();
 }
 
-int LZWStream::getRawChar() {
-  return doGetRawChar();
-}
-
-int LZWStream::getChars(int nChars, Guchar *buffer) {
+int LZWStream::getRawBlock(int nChars, Guchar *buffer) {
   int n, m;
 
-  if (pred) {
-    return pred->getChars(nChars, buffer);
-  }
   if (eof) {
     return 0;
   }
@@ -1376,6 +1448,17 @@ int LZWStream::getChars(int nChars, Guchar *buffer) {
   return n;
 }
 
+int LZWStream::getRawChar() {
+  return doGetRawChar();
+}
+
+int LZWStream::getChars(int nChars, Guchar *buffer) {
+  if (pred) {
+    return pred->getChars(nChars, buffer);
+  }
+  return getRawBlock(nChars, buffer);
+}
+
 void LZWStream::reset() {
   str->reset();
   eof = gFalse;
@@ -2640,6 +2723,79 @@ int DCTStream::getChar() {
   return c;
 }
 
+// Copy the rest of the current row at a time, straight from the frame
+// buffer or the MCU row buffer.
+int DCTStream::getChars(int nChars, Guchar *buffer) {
+  int *q;
+  int n, m, i;
+
+  n = 0;
+  while (n < nChars && y < height) {
+    if (progressive || !interleaved) {
+      m = (width - x) * numComps - comp;
+      if (m > nChars - n) {
+	m = nChars - n;
+      }
+      if (numComps == 1) {
+	q = &frameBuf[0][y * bufWidth + x];
+	for (i = 0; i < m; ++i) {
+	  buffer[n + i] = (Guchar)q[i];
+	}
+	x += m;
+      } else {
+	for (i = 0; i < m; ++i) {
+	  buffer[n + i] = (Guchar)frameBuf[comp][y * bufWidth + x];
+	  if (++comp == numComps) {
+	    comp = 0;
+	    ++x;
+	  }
+	}
+      }
+      n += m;
+      if (x == width) {
+	x = 0;
+	++y;
+      }
+    } else {
+      if (dy >= mcuHeight) {
+	if (!readMCURow()) {
+	  y = height;
+	  break;
+	}
+	comp = 0;
+	x = 0;
+	dy = 0;
+      }
+      m = (width - x) * numComps - comp;
+      if (m > nChars - n) {
+	m = nChars - n;
+      }
+      if (numComps == 1) {
+	memcpy(buffer + n, &rowBuf[0][dy][x], m);
+	x += m;
+      } else {
+	for (i = 0; i < m; ++i) {
+	  buffer[n + i] = rowBuf[comp][dy][x];
+	  if (++comp == numComps) {
+	    comp = 0;
+	    ++x;
+	  }
+	}
+      }
+      n += m;
+      if (x == width) {
+	x = 0;
+	++y;
+	++dy;
+	if (y == height) {
+	  readTrailer();
+	}
+      }
+    }
+  }
+  return n;
+}
+
 int DCTStream::lookChar() {
   if (y >= height) {
     return EOF;
@@ -3865,7 +4021,6 @@ GBool DCTStream::isBinary(GBool last) {
 
 #endif
 
-#ifndef ENABLE_ZLIB_UNCOMPRESS
 //------------------------------------------------------------------------
 // FlateStream
 //------------------------------------------------------------------------
@@ -4586,14 +4741,8 @@ int FlateStream::getChar() {
 int FlateStream::getChars(int nChars, Guchar *buffer) {
   if (pred) {
     return pred->getChars(nChars, buffer);
-  } else {
-    for (int i = 0; i < nChars; ++i) {
-      const int c = doGetRawChar();
-      if (likely(c != EOF)) buffer[i] = c;
-      else return i;
-    }
-    return nChars;
   }
+  return getRawBlock(nChars, buffer);
 }
 
 int FlateStream::lookChar() {
@@ -4616,6 +4765,32 @@ void FlateStream::getRawChars(int nChars, int *buffer) {
     buffer[i] = doGetRawChar();
 }
 
+int FlateStream::getRawBlock(int nChars, Guchar *buffer) {
+  int n, m;
+
+  n = 0;
+  while (n < nChars) {
+    while (remain == 0) {
+      if (endOfBlock && eof)
+	return n;
+      readSome();
+    }
+    m = remain;
+    if (m > nChars - n) {
+      m = nChars - n;
+    }
+    // the output window is circular
+    if (m > flateWindow - index) {
+      m = flateWindow - index;
+    }
+    memcpy(buffer + n, buf + index, m);
+    index = (index + m) & flateMask;
+    remain -= m;
+    n += m;
+  }
+  return n;
+}
+
 int FlateStream::getRawChar() {
   return doGetRawChar();
 }
@@ -4960,7 +5135,6 @@ int FlateStream::getCodeWord(int bits) {
   codeSize -= bits;
   return c;
 }
-#endif
 
 //------------------------------------------------------------------------
 // EOFStream
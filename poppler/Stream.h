@@ -154,8 +154,10 @@ public:
       *length += readChars;
       if (readChars == charsToRead) {
         if (lookChar() != EOF) {
-          size += sizeIncrement;
-          charsToRead = sizeIncrement;
+          // grow geometrically, so large streams (e.g. fonts) are read
+          // in a few large blocks
+          charsToRead = size > sizeIncrement ? size : sizeIncrement;
+          size += charsToRead;
           buf = (Guchar *)grealloc(buf, size);
         } else {
           continueReading = false;
@@ -167,6 +169,18 @@ public:
     return buf;
   }
 
+  // Skip over <nChars> chars.  Returns the number of chars skipped,
+  // which is less than <nChars> only at the end of the stream.
+  Goffset discardChars(Goffset nChars);
+
+  // Read up to <nChars> chars without copying them: sets <span> to the
+  // stream's own copy of the next chars and skips over them.  The chars
+  // stay valid until the stream is read, reset or repositioned again.
+  // Returns the number of chars, which is 0 at the end of the stream or
+  // if the stream's data isn't in memory; getChars() has to be used
+  // then.
+  virtual int getSpan(int /*nChars*/, const Guchar ** /*span*/) { return 0; }
+
   // Get next char from stream.
   virtual int getChar() = 0;
 
@@ -178,6 +192,11 @@ public:
   virtual int getRawChar();
   virtual void getRawChars(int nChars, int *buffer);
 
+  // Read up to <nChars> bytes without using the predictor.  Returns the
+  // number of bytes read, which is less than <nChars> only at the end of
+  // the stream.  This is only used by StreamPredictor.
+  virtual int getRawBlock(int nChars, Guchar *buffer);
+
   // Get next char directly from stream source, without filtering it
   virtual int getUnfilteredChar () = 0;
 
@@ -318,6 +337,11 @@ public:
   virtual GooString *getFileName() { return NULL; }
   virtual Goffset getLength() { return length; }
 
+  // Returns true if the sub-streams returned by makeSubStream() keep
+  // their own read position and can be read from different threads
+  // at the same time.
+  virtual GBool hasIndependentSubStreams() { return gFalse; }
+
   // Get/set position of first byte of stream within the file.
   virtual Goffset getStart() = 0;
   virtual void moveStart(Goffset delta) = 0;
@@ -433,6 +457,8 @@ private:
   int rowBytes;			// bytes per line
   Guchar *predLine;		// line buffer
   int predIdx;			// current index in predLine
+  Guchar *rawLine;		// undecoded line, with the PNG tag byte
+  int rawBytes;			// bytes per undecoded line
   GBool ok;
 };
 
@@ -462,6 +488,7 @@ public:
   virtual void setPos(Goffset pos, int dir = 0);
   virtual Goffset getStart() { return start; }
   virtual void moveStart(Goffset delta);
+  virtual GBool hasIndependentSubStreams() { return gTrue; }
 
   virtual int getUnfilteredChar () { return getChar(); }
   virtual void unfilteredReset () { reset(); }
@@ -540,6 +567,9 @@ private:
 
   GBool fillBuf();
 
+  virtual GBool hasGetChars() { return true; }
+  virtual int getChars(int nChars, Guchar *buffer);
+
   CachedFile *cc;
   Goffset start;
   GBool limited;
@@ -575,6 +605,7 @@ public:
   virtual void setPos(Goffset pos, int dir = 0);
   virtual Goffset getStart() { return start; }
   virtual void moveStart(Goffset delta);
+  virtual GBool hasIndependentSubStreams() { return gTrue; }
 
   //if needFree = true, the stream will delete buf when it is destroyed
   //otherwise it will not touch it. Default value is false
@@ -582,6 +613,7 @@ public:
 
   virtual int getUnfilteredChar () { return getChar(); }
   virtual void unfilteredReset () { reset (); } 
+  virtual int getSpan(int nChars, const Guchar **span);
 
 private:
 
@@ -654,6 +686,9 @@ public:
 
 private:
 
+  virtual GBool hasGetChars() { return true; }
+  virtual int getChars(int nChars, Guchar *buffer);
+
   int buf;
   GBool eof;
 };
@@ -677,6 +712,9 @@ public:
 
 private:
 
+  virtual GBool hasGetChars() { return true; }
+  virtual int getChars(int nChars, Guchar *buffer);
+
   int c[5];
   int b[4];
   int index, n;
@@ -699,6 +737,7 @@ public:
   virtual int lookChar();
   virtual int getRawChar();
   virtual void getRawChars(int nChars, int *buffer);
+  virtual int getRawBlock(int nChars, Guchar *buffer);
   virtual GooString *getPSFilter(int psLevel, const char *indent);
   virtual GBool isBinary(GBool last = gTrue);
 
@@ -881,6 +920,9 @@ public:
 
 private:
 
+  virtual GBool hasGetChars() { return true; }
+  virtual int getChars(int nChars, Guchar *buffer);
+
   void dctReset(GBool unfiltered);  
   GBool progressive;		// set if in progressive mode
   GBool interleaved;		// set if in interleaved mode
@@ -942,7 +984,6 @@ private:
 
 #endif
 
-#ifndef ENABLE_ZLIB_UNCOMPRESS
 //------------------------------------------------------------------------
 // FlateStream
 //------------------------------------------------------------------------
@@ -983,6 +1024,7 @@ public:
   virtual int lookChar();
   virtual int getRawChar();
   virtual void getRawChars(int nChars, int *buffer);
+  virtual int getRawBlock(int nChars, Guchar *buffer);
   virtual GooString *getPSFilter(int psLevel, const char *indent);
   virtual GBool isBinary(GBool last = gTrue);
   virtual void unfilteredReset ();
@@ -1040,7 +1082,6 @@ private:
   int getHuffmanCodeWord(FlateHuffmanTab *tab);
   int getCodeWord(int bits);
 };
-#endif
 
 //------------------------------------------------------------------------
 // EOFStream
@@ -1057,6 +1098,11 @@ public:
   virtual int lookChar() { return EOF; }
   virtual GooString *getPSFilter(int /*psLevel*/, const char * /*indent*/)  { return NULL; }
   virtual GBool isBinary(GBool /*last = gTrue*/) { return gFalse; }
+
+private:
+
+  virtual GBool hasGetChars() { return true; }
+  virtual int getChars(int /*nChars*/, Guchar * /*buffer*/) { return 0; }
 };
 
 //------------------------------------------------------------------------
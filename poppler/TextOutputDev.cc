@@ -51,6 +51,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stddef.h>
+#include <string.h>
 #include <math.h>
 #include <float.h>
 #include <ctype.h>
@@ -180,6 +181,10 @@
 #define combMaxMidDelta 0.3
 #define combMaxBaseDelta 0.4
 
+// Max number of columns and rows in the grid used to find the blocks
+// near a point.
+#define maxIndexGridSize 64
+
 static int reorderText(Unicode *text, int len, UnicodeMap *uMap, GBool primaryLR, GooString *s, Unicode* u) {
   char lre[8], rle[8], popdf[8], buf[8];
   int lreLen = 0, rleLen = 0, popdfLen = 0, n;
@@ -298,6 +303,390 @@ public:
   AnnotLink *link;
 };
 
+//------------------------------------------------------------------------
+// TextIndex
+//------------------------------------------------------------------------
+
+// A line, as seen by TextPage::findText().
+struct TextIndexLine {
+  TextLine *line;
+  int blkIdx;			// index of the line's block in
+				//   TextPage::blocks
+  int lineIdx;			// index of the line in its block
+  double yLo, yHi;		// range of the yMin of a match found in
+				//   this line
+};
+
+// Spatial index of the text of a page, built by TextPage::coalesce().
+// The blocks are bucketed in a grid over their bounding box, so that
+// selection and region queries only look at the blocks near a point
+// or a rectangle.  The lines are sorted by vertical position, so that
+// a search can stop as soon as no line left can hold a better match
+// than the one it found.
+class TextIndex {
+public:
+
+  TextIndex(TextPage *pageA);
+  ~TextIndex();
+
+  // Fill <blks> with the indices, in increasing order, of the blocks
+  // (in TextPage::blocks) whose bounding boxes may intersect the
+  // rectangle, and return their number.  <blks> needs room for
+  // TextPage::nBlocks entries.
+  int findBlocks(double xMinA, double yMinA, double xMaxA, double yMaxA,
+		 int *blks);
+
+  // Return the index of the block nearest to (<x>,<y>), using the
+  // manhattan distance; if several are nearest, return the first one
+  // in reading order.
+  int findNearestBlock(double x, double y);
+
+  // Returns true if findText() used to look at the line <il1> before
+  // <il2>, walking the blocks forward (or backward) and the lines of
+  // each block forward.  Ties between matches go to the first one it
+  // found.
+  static GBool isBefore(TextIndexLine *il1, TextIndexLine *il2,
+			GBool backward);
+
+private:
+
+  static int getCell(double v, double vMin, double cellSize, int n);
+  static int cmpLinesDown(const void *p1, const void *p2);
+  static int cmpLinesUp(const void *p1, const void *p2);
+
+  TextPage *page;
+  double xMin, xMax;		// bounding box of all blocks
+  double yMin, yMax;
+  int nx, ny;			// number of grid columns and rows
+  double cellW, cellH;		// size of a grid cell
+  int *cells;			// cell (cx,cy) holds the blocks
+  int *cellBlks;		//   cellBlks[cells[i] .. cells[i+1]-1],
+				//   with i = cy * nx + cx
+  TextFlow **flows;		// flow of each block
+  TextIndexLine *linesDown;	// lines sorted top to bottom by yLo
+  TextIndexLine *linesUp;	// lines sorted bottom to top by yHi
+  int nLines;			// number of lines
+
+  friend class TextPage;
+};
+
+TextIndex::TextIndex(TextPage *pageA) {
+  TextFlow *flow;
+  TextBlock *blk;
+  TextLine *line;
+  TextIndexLine *il;
+  int *cellPos;
+  double w, h, side;
+  int nBlocks, cx, cy, cx0, cy0, cx1, cy1, i, j, k, e;
+
+  page = pageA;
+  nBlocks = page->nBlocks;
+
+  // the blocks array is in reading order, and each flow is a run of it
+  flows = (TextFlow **)gmallocn(nBlocks, sizeof(TextFlow *));
+  i = 0;
+  for (flow = page->flows; flow; flow = flow->next) {
+    for (blk = flow->blocks; blk; blk = blk->next) {
+      flows[i++] = flow;
+    }
+  }
+
+  xMin = yMin = xMax = yMax = 0;
+  nLines = 0;
+  for (i = 0; i < nBlocks; ++i) {
+    blk = page->blocks[i];
+    if (i == 0 || blk->xMin < xMin) {
+      xMin = blk->xMin;
+    }
+    if (i == 0 || blk->yMin < yMin) {
+      yMin = blk->yMin;
+    }
+    if (i == 0 || blk->xMax > xMax) {
+      xMax = blk->xMax;
+    }
+    if (i == 0 || blk->yMax > yMax) {
+      yMax = blk->yMax;
+    }
+    for (line = blk->lines; line; line = line->next) {
+      ++nLines;
+    }
+  }
+
+  // build the grid, aiming for about one block per cell
+  nx = ny = 1;
+  w = xMax - xMin;
+  h = yMax - yMin;
+  if (nBlocks > 1 && w > 0 && h > 0) {
+    side = sqrt(w * h / nBlocks);
+    nx = w / side < maxIndexGridSize ? (int)(w / side) + 1
+                                     : maxIndexGridSize;
+    ny = h / side < maxIndexGridSize ? (int)(h / side) + 1
+                                     : maxIndexGridSize;
+  }
+  cellW = w > 0 ? w / nx : 1;
+  cellH = h > 0 ? h / ny : 1;
+  cells = (int *)gmallocn(nx * ny + 1, sizeof(int));
+  for (i = 0; i <= nx * ny; ++i) {
+    cells[i] = 0;
+  }
+  for (i = 0; i < nBlocks; ++i) {
+    blk = page->blocks[i];
+    cx0 = getCell(blk->xMin, xMin, cellW, nx);
+    cx1 = getCell(blk->xMax, xMin, cellW, nx);
+    cy0 = getCell(blk->yMin, yMin, cellH, ny);
+    cy1 = getCell(blk->yMax, yMin, cellH, ny);
+    for (cy = cy0; cy <= cy1; ++cy) {
+      for (cx = cx0; cx <= cx1; ++cx) {
+	++cells[cy * nx + cx + 1];
+      }
+    }
+  }
+  for (i = 0; i < nx * ny; ++i) {
+    cells[i + 1] += cells[i];
+  }
+  cellBlks = (int *)gmallocn(cells[nx * ny], sizeof(int));
+  cellPos = (int *)gmallocn(nx * ny, sizeof(int));
+  for (i = 0; i < nx * ny; ++i) {
+    cellPos[i] = cells[i];
+  }
+  for (i = 0; i < nBlocks; ++i) {
+    blk = page->blocks[i];
+    cx0 = getCell(blk->xMin, xMin, cellW, nx);
+    cx1 = getCell(blk->xMax, xMin, cellW, nx);
+    cy0 = getCell(blk->yMin, yMin, cellH, ny);
+    cy1 = getCell(blk->yMax, yMin, cellH, ny);
+    for (cy = cy0; cy <= cy1; ++cy) {
+      for (cx = cx0; cx <= cx1; ++cx) {
+	cellBlks[cellPos[cy * nx + cx]++] = i;
+      }
+    }
+  }
+  gfree(cellPos);
+
+  // sort the lines; a match in a line starts on one of its edges
+  // if the line is vertical, or at its top otherwise
+  linesDown = (TextIndexLine *)gmallocn(nLines, sizeof(TextIndexLine));
+  k = 0;
+  for (i = 0; i < nBlocks; ++i) {
+    for (line = page->blocks[i]->lines, j = 0; line; line = line->next, ++j) {
+      il = &linesDown[k++];
+      il->line = line;
+      il->blkIdx = i;
+      il->lineIdx = j;
+      if (line->rot == 0 || line->rot == 2) {
+	il->yLo = il->yHi = line->yMin;
+      } else {
+	il->yLo = il->yHi = line->edge[0];
+	for (e = 1; e <= line->len; ++e) {
+	  if (line->edge[e] < il->yLo) {
+	    il->yLo = line->edge[e];
+	  } else if (line->edge[e] > il->yHi) {
+	    il->yHi = line->edge[e];
+	  }
+	}
+      }
+    }
+  }
+  linesUp = (TextIndexLine *)gmallocn(nLines, sizeof(TextIndexLine));
+  if (nLines > 0) {
+    memcpy(linesUp, linesDown, nLines * sizeof(TextIndexLine));
+  }
+  qsort(linesDown, nLines, sizeof(TextIndexLine), &cmpLinesDown);
+  qsort(linesUp, nLines, sizeof(TextIndexLine), &cmpLinesUp);
+}
+
+TextIndex::~TextIndex() {
+  gfree(cells);
+  gfree(cellBlks);
+  gfree(flows);
+  gfree(linesDown);
+  gfree(linesUp);
+}
+
+// Return the cell, along one axis, which holds the coordinate <v>:
+// cell i spans [vMin + i * cellSize, vMin + (i+1) * cellSize), and the
+// first and last cells extend to infinity.  This is computed with the
+// same expressions as findNearestBlock() uses for the cell edges, so
+// that rounding can't put a block on the wrong side of them.
+int TextIndex::getCell(double v, double vMin, double cellSize, int n) {
+  int i;
+
+  if (!(v >= vMin + cellSize)) {
+    return 0;
+  }
+  if (v >= vMin + (n - 1) * cellSize) {
+    return n - 1;
+  }
+  i = (int)((v - vMin) / cellSize);
+  if (i < 1) {
+    i = 1;
+  } else if (i > n - 2) {
+    i = n - 2;
+  }
+  while (v < vMin + i * cellSize) {
+    --i;
+  }
+  while (v >= vMin + (i + 1) * cellSize) {
+    ++i;
+  }
+  return i;
+}
+
+// Lines in the order findText() looks at them when searching forward:
+// by yLo, then in the order it used to visit them.
+int TextIndex::cmpLinesDown(const void *p1, const void *p2) {
+  TextIndexLine *il1 = (TextIndexLine *)p1;
+  TextIndexLine *il2 = (TextIndexLine *)p2;
+
+  if (il1->yLo != il2->yLo) {
+    return il1->yLo < il2->yLo ? -1 : 1;
+  }
+  if (il1->blkIdx != il2->blkIdx) {
+    return il1->blkIdx < il2->blkIdx ? -1 : 1;
+  }
+  return il1->lineIdx - il2->lineIdx;
+}
+
+// Lines in the order findText() looks at them when searching backward:
+// by decreasing yHi, then in the order it used to visit them.
+int TextIndex::cmpLinesUp(const void *p1, const void *p2) {
+  TextIndexLine *il1 = (TextIndexLine *)p1;
+  TextIndexLine *il2 = (TextIndexLine *)p2;
+
+  if (il1->yHi != il2->yHi) {
+    return il1->yHi > il2->yHi ? -1 : 1;
+  }
+  if (il1->blkIdx != il2->blkIdx) {
+    return il1->blkIdx > il2->blkIdx ? -1 : 1;
+  }
+  return il1->lineIdx - il2->lineIdx;
+}
+
+GBool TextIndex::isBefore(TextIndexLine *il1, TextIndexLine *il2,
+			  GBool backward) {
+  if (il1->blkIdx != il2->blkIdx) {
+    return backward ? il1->blkIdx > il2->blkIdx : il1->blkIdx < il2->blkIdx;
+  }
+  return il1->lineIdx < il2->lineIdx;
+}
+
+static int cmpInts(const void *p1, const void *p2) {
+  return *(const int *)p1 - *(const int *)p2;
+}
+
+int TextIndex::findBlocks(double xMinA, double yMinA,
+			  double xMaxA, double yMaxA, int *blks) {
+  int cx0, cy0, cx1, cy1, cx, cy, n;
+  int *p, *end;
+
+  if (page->nBlocks == 0 ||
+      xMaxA < xMin || xMinA > xMax || yMaxA < yMin || yMinA > yMax) {
+    return 0;
+  }
+  cx0 = getCell(xMinA, xMin, cellW, nx);
+  cx1 = getCell(xMaxA, xMin, cellW, nx);
+  cy0 = getCell(yMinA, yMin, cellH, ny);
+  cy1 = getCell(yMaxA, yMin, cellH, ny);
+  n = 0;
+  for (cy = cy0; cy <= cy1; ++cy) {
+    for (cx = cx0; cx <= cx1; ++cx) {
+      end = cellBlks + cells[cy * nx + cx + 1];
+      for (p = cellBlks + cells[cy * nx + cx]; p < end; ++p) {
+	// a block spanning several cells is reported by the first of
+	// them in the rectangle
+	if ((cx == cx0 ||
+	     getCell(page->blocks[*p]->xMin, xMin, cellW, nx) == cx) &&
+	    (cy == cy0 ||
+	     getCell(page->blocks[*p]->yMin, yMin, cellH, ny) == cy)) {
+	  blks[n++] = *p;
+	}
+      }
+    }
+  }
+  qsort(blks, n, sizeof(int), &cmpInts);
+  return n;
+}
+
+int TextIndex::findNearestBlock(double x, double y) {
+  TextBlock *blk;
+  double d, bestD, bound;
+  int cx, cy, cx0, cy0, cx1, cy1, cx2, cy2, r, best;
+  int *p, *end;
+  GBool more;
+
+  if (page->nBlocks == 0) {
+    return -1;
+  }
+  cx = getCell(x, xMin, cellW, nx);
+  cy = getCell(y, yMin, cellH, ny);
+  best = -1;
+  bestD = 0;
+  for (r = 0; ; ++r) {
+
+    // look at the cells on the square ring at distance r from (cx,cy)
+    cx0 = cx - r;
+    cx1 = cx + r;
+    cy0 = cy - r;
+    cy1 = cy + r;
+    for (cy2 = cy0 < 0 ? 0 : cy0; cy2 <= cy1 && cy2 < ny; ++cy2) {
+      for (cx2 = cx0 < 0 ? 0 : cx0; cx2 <= cx1 && cx2 < nx; ++cx2) {
+	if (cx2 > cx0 && cx2 < cx1 && cy2 > cy0 && cy2 < cy1) {
+	  continue;
+	}
+	end = cellBlks + cells[cy2 * nx + cx2 + 1];
+	for (p = cellBlks + cells[cy2 * nx + cx2]; p < end; ++p) {
+	  blk = page->blocks[*p];
+	  d = fmax(blk->xMin - x, 0.0) +
+	    fmax(x - blk->xMax, 0.0) +
+	    fmax(blk->yMin - y, 0.0) +
+	    fmax(y - blk->yMax, 0.0);
+	  if (best < 0 || d < bestD || (d == bestD && *p < best)) {
+	    best = *p;
+	    bestD = d;
+	  }
+	}
+      }
+    }
+
+    // the blocks in the cells outside the ring are at least <bound>
+    // away
+    more = gFalse;
+    bound = 0;
+    if (cx0 > 0) {
+      d = x - (xMin + cx0 * cellW);
+      if (!more || d < bound) {
+	bound = d;
+      }
+      more = gTrue;
+    }
+    if (cx1 < nx - 1) {
+      d = (xMin + (cx1 + 1) * cellW) - x;
+      if (!more || d < bound) {
+	bound = d;
+      }
+      more = gTrue;
+    }
+    if (cy0 > 0) {
+      d = y - (yMin + cy0 * cellH);
+      if (!more || d < bound) {
+	bound = d;
+      }
+      more = gTrue;
+    }
+    if (cy1 < ny - 1) {
+      d = (yMin + (cy1 + 1) * cellH) - y;
+      if (!more || d < bound) {
+	bound = d;
+      }
+      more = gTrue;
+    }
+    if (!more || (best >= 0 && bound > bestD)) {
+      break;
+    }
+  }
+  return best;
+}
+
 //------------------------------------------------------------------------
 // TextFontInfo
 //------------------------------------------------------------------------
@@ -2355,6 +2744,8 @@ TextPage::TextPage(GBool rawOrderA) {
   }
   flows = NULL;
   blocks = NULL;
+  nBlocks = 0;
+  index = NULL;
   rawWords = NULL;
   rawLastWord = NULL;
   fonts = new GooList();
@@ -2429,6 +2820,7 @@ void TextPage::clear() {
       delete flow;
     }
     gfree(blocks);
+    delete index;
   }
   deleteGooList(fonts, TextFontInfo);
   deleteGooList(underlines, TextUnderline);
@@ -2447,6 +2839,8 @@ void TextPage::clear() {
   }
   flows = NULL;
   blocks = NULL;
+  nBlocks = 0;
+  index = NULL;
   rawWords = NULL;
   rawLastWord = NULL;
   fonts = new GooList();
@@ -3821,6 +4215,9 @@ void TextPage::coalesce(GBool physLayout, double fixedPitch, GBool doHTML) {
   printf("\n");
 #endif
 
+  delete index;
+  index = new TextIndex(this);
+
   if (uMap) {
     uMap->decRefCnt();
   }
@@ -3835,16 +4232,17 @@ GBool TextPage::findText(Unicode *s, int len,
 			 double *xMax, double *yMax) {
   TextBlock *blk;
   TextLine *line;
+  TextIndexLine *lines, *il, *il0;
   Unicode *s2, *txt, *reordered;
   Unicode *p;
-  int txtSize, m, i, j, k;
+  int txtSize, m, i, j, k, stopBlk;
   double xStart, yStart, xStop, yStop;
   double xMin0, yMin0, xMax0, yMax0;
   double xMin1, yMin1, xMax1, yMax1;
   GBool found;
 
 
-  if (rawOrder) {
+  if (rawOrder || !index) {
     return gFalse;
   }
 
@@ -3884,11 +4282,43 @@ GBool TextPage::findText(Unicode *s, int len,
   found = gFalse;
   xMin0 = xMax0 = yMin0 = yMax0 = 0; // make gcc happy
   xMin1 = xMax1 = yMin1 = yMax1 = 0; // make gcc happy
+  il0 = NULL;
+
+  // find the first block below the bottom limit: the search stops
+  // there
+  // (this only works if the page's primary rotation is zero --
+  // otherwise the blocks won't be sorted in the useful order)
+  stopBlk = backward ? -1 : nBlocks;
+  if (!stopAtBottom && primaryRot == 0) {
+    for (i = backward ? nBlocks - 1 : 0;
+	 backward ? i >= 0 : i < nBlocks;
+	 i += backward ? -1 : 1) {
+      blk = blocks[i];
+      if (!startAtTop &&
+	  (backward ? blk->yMin > yStart : blk->yMax < yStart)) {
+	continue;
+      }
+      if (backward ? blk->yMax < yStop : blk->yMin > yStop) {
+	stopBlk = i;
+	break;
+      }
+    }
+  }
 
-  for (i = backward ? nBlocks - 1 : 0;
-       backward ? i >= 0 : i < nBlocks;
-       i += backward ? -1 : 1) {
-    blk = blocks[i];
+  // look at the lines from the top of the page down (or from the
+  // bottom up, if searching backward), until no line left can hold a
+  // match before the one found so far
+  lines = backward ? index->linesUp : index->linesDown;
+  for (i = 0; i < index->nLines; ++i) {
+    il = &lines[i];
+    if (found && (backward ? il->yHi < yMin0 : il->yLo > yMin0)) {
+      break;
+    }
+    if (backward ? il->blkIdx <= stopBlk : il->blkIdx >= stopBlk) {
+      continue;
+    }
+    blk = blocks[il->blkIdx];
+    line = il->line;
 
     // check: is the block above the top limit?
     // (this only works if the page's primary rotation is zero --
@@ -3898,138 +4328,133 @@ GBool TextPage::findText(Unicode *s, int len,
       continue;
     }
 
-    // check: is the block below the bottom limit?
+    // check: is the line above the top limit?
     // (this only works if the page's primary rotation is zero --
-    // otherwise the blocks won't be sorted in the useful order)
-    if (!stopAtBottom && primaryRot == 0 &&
-	(backward ? blk->yMax < yStop : blk->yMin > yStop)) {
-      break;
+    // otherwise the lines won't be sorted in the useful order)
+    if (!startAtTop && primaryRot == 0 &&
+	(backward ? line->yMin > yStart : line->yMin < yStart)) {
+      continue;
     }
 
-    for (line = blk->lines; line; line = line->next) {
-
-      // check: is the line above the top limit?
-      // (this only works if the page's primary rotation is zero --
-      // otherwise the lines won't be sorted in the useful order)
-      if (!startAtTop && primaryRot == 0 &&
-	  (backward ? line->yMin > yStart : line->yMin < yStart)) {
-	continue;
-      }
+    // check: is the line below the bottom limit?
+    // (this only works if the page's primary rotation is zero --
+    // otherwise the lines won't be sorted in the useful order)
+    if (!stopAtBottom && primaryRot == 0 &&
+	(backward ? line->yMin < yStop : line->yMin > yStop)) {
+      continue;
+    }
 
-      // check: is the line below the bottom limit?
-      // (this only works if the page's primary rotation is zero --
-      // otherwise the lines won't be sorted in the useful order)
-      if (!stopAtBottom && primaryRot == 0 &&
-	  (backward ? line->yMin < yStop : line->yMin > yStop)) {
-	continue;
+    if (!line->normalized)
+      line->normalized = unicodeNormalizeNFKC(line->text, line->len, 
+					      &line->normalized_len, 
+					      &line->normalized_idx,
+					      true);
+    // convert the line to uppercase
+    m = line->normalized_len;
+    if (!caseSensitive) {
+      if (m > txtSize) {
+	txt = (Unicode *)greallocn(txt, m, sizeof(Unicode));
+	txtSize = m;
       }
-
-      if (!line->normalized)
-	line->normalized = unicodeNormalizeNFKC(line->text, line->len, 
-						&line->normalized_len, 
-						&line->normalized_idx,
-						true);
-      // convert the line to uppercase
-      m = line->normalized_len;
-      if (!caseSensitive) {
-	if (m > txtSize) {
-	  txt = (Unicode *)greallocn(txt, m, sizeof(Unicode));
-	  txtSize = m;
+      for (k = 0; k < m; ++k) {
+	txt[k] = unicodeToUpper(line->normalized[k]);
 	}
-	for (k = 0; k < m; ++k) {
-	  txt[k] = unicodeToUpper(line->normalized[k]);
-	  }
-      } else {
-	txt = line->normalized;
-      }
+    } else {
+      txt = line->normalized;
+    }
 
-      // search each position in this line
-      j = backward ? m - len : 0;
-      p = txt + j;
-      while (backward ? j >= 0 : j <= m - len) {
-        if (!wholeWord ||
-            ((j == 0 || !unicodeTypeAlphaNum(txt[j - 1])) &&
-             (j + len == m || !unicodeTypeAlphaNum(txt[j + len])))) {
-
-          // compare the strings
-          for (k = 0; k < len; ++k) {
-            if (p[k] != s2[k]) {
-              break;
-            }
-          }
+    // search each position in this line
+    j = backward ? m - len : 0;
+    p = txt + j;
+    while (backward ? j >= 0 : j <= m - len) {
+      if (!wholeWord ||
+	  ((j == 0 || !unicodeTypeAlphaNum(txt[j - 1])) &&
+	   (j + len == m || !unicodeTypeAlphaNum(txt[j + len])))) {
 
-          // found it
-          if (k == len) {
-            // where s2 matches a subsequence of a compatibility equivalence
-            // decomposition, highlight the entire glyph, since we don't know
-            // the internal layout of subglyph components
-            int normStart = line->normalized_idx[j];
-            int normAfterEnd = line->normalized_idx[j + len - 1] + 1;
-            switch (line->rot) {
-            case 0:
-              xMin1 = line->edge[normStart];
-              xMax1 = line->edge[normAfterEnd];
-              yMin1 = line->yMin;
-              yMax1 = line->yMax;
-              break;
-            case 1:
-              xMin1 = line->xMin;
-              xMax1 = line->xMax;
-              yMin1 = line->edge[normStart];
-              yMax1 = line->edge[normAfterEnd];
-              break;
-            case 2:
-              xMin1 = line->edge[normAfterEnd];
-              xMax1 = line->edge[normStart];
-              yMin1 = line->yMin;
-              yMax1 = line->yMax;
-              break;
-            case 3:
-              xMin1 = line->xMin;
-              xMax1 = line->xMax;
-              yMin1 = line->edge[normAfterEnd];
-              yMax1 = line->edge[normStart];
-              break;
-            }
-            if (backward) {
-              if ((startAtTop ||
-                   yMin1 < yStart || (yMin1 == yStart && xMin1 < xStart)) &&
-                  (stopAtBottom ||
-                   yMin1 > yStop || (yMin1 == yStop && xMin1 > xStop))) {
-                if (!found ||
-                    yMin1 > yMin0 || (yMin1 == yMin0 && xMin1 > xMin0)) {
-                  xMin0 = xMin1;
-                  xMax0 = xMax1;
-                  yMin0 = yMin1;
-                  yMax0 = yMax1;
-                  found = gTrue;
-                }
-              }
-            } else {
-              if ((startAtTop ||
-                   yMin1 > yStart || (yMin1 == yStart && xMin1 > xStart)) &&
-                  (stopAtBottom ||
-                   yMin1 < yStop || (yMin1 == yStop && xMin1 < xStop))) {
-                if (!found ||
-                    yMin1 < yMin0 || (yMin1 == yMin0 && xMin1 < xMin0)) {
-                  xMin0 = xMin1;
-                  xMax0 = xMax1;
-                  yMin0 = yMin1;
-                  yMax0 = yMax1;
-                  found = gTrue;
-                }
-              }
-            }
-          }
+	// compare the strings
+	for (k = 0; k < len; ++k) {
+	  if (p[k] != s2[k]) {
+	    break;
+	  }
 	}
-	if (backward) {
-	  --j;
-	  --p;
-	} else {
-	  ++j;
-	  ++p;
+
+	// found it
+	if (k == len) {
+	  // where s2 matches a subsequence of a compatibility equivalence
+	  // decomposition, highlight the entire glyph, since we don't know
+	  // the internal layout of subglyph components
+	  int normStart = line->normalized_idx[j];
+	  int normAfterEnd = line->normalized_idx[j + len - 1] + 1;
+	  switch (line->rot) {
+	  case 0:
+	    xMin1 = line->edge[normStart];
+	    xMax1 = line->edge[normAfterEnd];
+	    yMin1 = line->yMin;
+	    yMax1 = line->yMax;
+	    break;
+	  case 1:
+	    xMin1 = line->xMin;
+	    xMax1 = line->xMax;
+	    yMin1 = line->edge[normStart];
+	    yMax1 = line->edge[normAfterEnd];
+	    break;
+	  case 2:
+	    xMin1 = line->edge[normAfterEnd];
+	    xMax1 = line->edge[normStart];
+	    yMin1 = line->yMin;
+	    yMax1 = line->yMax;
+	    break;
+	  case 3:
+	    xMin1 = line->xMin;
+	    xMax1 = line->xMax;
+	    yMin1 = line->edge[normAfterEnd];
+	    yMax1 = line->edge[normStart];
+	    break;
+	  }
+	  if (backward) {
+	    if ((startAtTop ||
+		 yMin1 < yStart || (yMin1 == yStart && xMin1 < xStart)) &&
+		(stopAtBottom ||
+		 yMin1 > yStop || (yMin1 == yStop && xMin1 > xStop))) {
+	      if (!found ||
+		  yMin1 > yMin0 || (yMin1 == yMin0 && xMin1 > xMin0) ||
+		  (yMin1 == yMin0 && xMin1 == xMin0 &&
+		   TextIndex::isBefore(il, il0, backward))) {
+		xMin0 = xMin1;
+		xMax0 = xMax1;
+		yMin0 = yMin1;
+		yMax0 = yMax1;
+		il0 = il;
+		found = gTrue;
+	      }
+	    }
+	  } else {
+	    if ((startAtTop ||
+		 yMin1 > yStart || (yMin1 == yStart && xMin1 > xStart)) &&
+		(stopAtBottom ||
+		 yMin1 < yStop || (yMin1 == yStop && xMin1 < xStop))) {
+	      if (!found ||
+		  yMin1 < yMin0 || (yMin1 == yMin0 && xMin1 < xMin0) ||
+		  (yMin1 == yMin0 && xMin1 == xMin0 &&
+		   TextIndex::isBefore(il, il0, backward))) {
+		xMin0 = xMin1;
+		xMax0 = xMax1;
+		yMin0 = yMin1;
+		yMax0 = yMax1;
+		il0 = il;
+		found = gTrue;
+	      }
+	    }
+	  }
 	}
       }
+      if (backward) {
+	--j;
+	--p;
+      } else {
+	++j;
+	++p;
+      }
     }
   }
 
@@ -4066,7 +4491,8 @@ GooString *TextPage::getText(double xMin, double yMin,
   int spaceLen, eolLen;
   int lastRot;
   double x, y, delta;
-  int col, idx0, idx1, i, j;
+  int *blks;
+  int nBlks, col, idx0, idx1, i, j;
   GBool multiLine, oneRot;
 
   s = new GooString();
@@ -4112,14 +4538,17 @@ GooString *TextPage::getText(double xMin, double yMin,
 
   //~ writing mode (horiz/vert)
 
-  // collect the line fragments that are in the rectangle
+  // collect the line fragments that are in the rectangle, looking
+  // only at the blocks near it
   fragsSize = 256;
   frags = (TextLineFrag *)gmallocn(fragsSize, sizeof(TextLineFrag));
   nFrags = 0;
   lastRot = -1;
   oneRot = gTrue;
-  for (i = 0; i < nBlocks; ++i) {
-    blk = blocks[i];
+  blks = (int *)gmallocn(nBlocks, sizeof(int));
+  nBlks = index ? index->findBlocks(xMin, yMin, xMax, yMax, blks) : 0;
+  for (i = 0; i < nBlks; ++i) {
+    blk = blocks[blks[i]];
     if (xMin < blk->xMax && blk->xMin < xMax &&
 	yMin < blk->yMax && blk->yMin < yMax) {
       for (line = blk->lines; line; line = line->next) {
@@ -4229,6 +4658,7 @@ GooString *TextPage::getText(double xMin, double yMin,
       }
     }
   }
+  gfree(blks);
 
   // sort the fragments and generate the string
   if (nFrags > 0) {
@@ -4917,13 +5347,13 @@ void TextPage::visitSelection(TextSelectionVisitor *visitor,
 			      SelectionStyle style)
 {
   PDFRectangle child_selection;
-  double x[2], y[2], d, best_d[2];
+  double x[2], y[2];
   double xMin, yMin, xMax, yMax;
   TextFlow *flow, *best_flow[2];
   TextBlock *blk, *best_block[2];
-  int i, count = 0, best_count[2], start, stop;
+  int i, j, best_count[2], start, stop;
 
-  if (!flows)
+  if (!flows || !index)
     return;
 
   x[0] = selection->x1;
@@ -4931,49 +5361,27 @@ void TextPage::visitSelection(TextSelectionVisitor *visitor,
   x[1] = selection->x2;
   y[1] = selection->y2;
 
-  xMin = pageWidth;
-  yMin = pageHeight;
-  xMax = 0.0;
-  yMax = 0.0;
-
-  for (i = 0; i < 2; i++) {
-    best_block[i] = NULL;
-    best_flow[i] = NULL;
-    best_count[i] = 0;
-    best_d[i] = 0;
-  }
+  // the first/last blocks in reading order are
+  // often not the closest to the page corners;
+  // track the corners, force those blocks to
+  // be selected if the selection runs across
+  // multiple pages.
+  xMin = fmin(pageWidth, index->xMin);
+  yMin = fmin(pageHeight, index->yMin);
+  xMax = fmax(0.0, index->xMax);
+  yMax = fmax(0.0, index->yMax);
 
   // find the nearest blocks to the selection points
   // using the manhattan distance.
-  for (flow = flows; flow; flow = flow->next) {
-    for (blk = flow->blocks; blk; blk = blk->next) {
-      count++;
-      // the first/last blocks in reading order are
-      // often not the closest to the page corners;
-      // track the corners, force those blocks to
-      // be selected if the selection runs across
-      // multiple pages.
-      xMin = fmin(xMin, blk->xMin);
-      yMin = fmin(yMin, blk->yMin);
-      xMax = fmax(xMax, blk->xMax);
-      yMax = fmax(yMax, blk->yMax);
-      for (i = 0; i < 2; i++) {
-	d = fmax(blk->xMin - x[i], 0.0) +
-	  fmax(x[i] - blk->xMax, 0.0) +
-	  fmax(blk->yMin - y[i], 0.0) +
-	  fmax(y[i] - blk->yMax, 0.0);
-	if (!best_block[i] ||
-	    d < best_d[i] ||
-	    (!blk->next && !flow->next &&
-	     x[i] >= fmin(xMax, pageWidth) &&
-	     y[i] >= fmin(yMax, pageHeight))) {
-	  best_block[i] = blk;
-	  best_flow[i] = flow;
-	  best_count[i] = count;
-	  best_d[i] = d;
-	}
-      }
-    }
+  for (i = 0; i < 2; i++) {
+    j = index->findNearestBlock(x[i], y[i]);
+    if (x[i] >= fmin(xMax, pageWidth) &&
+	y[i] >= fmin(yMax, pageHeight)) {
+      j = nBlocks - 1;
+    }
+    best_block[i] = blocks[j];
+    best_flow[i] = index->flows[j];
+    best_count[i] = j + 1;
   }
   for (i = 0; i < 2; i++) {
     if (primaryLR) {
@@ -56,6 +56,7 @@ class TextLineFrag;
 class TextBlock;
 class TextFlow;
 class TextWordList;
+class TextIndex;
 class TextPage;
 class TextSelectionVisitor;
 
@@ -337,6 +338,7 @@ private:
   friend class TextFlow;
   friend class TextWordList;
   friend class TextPage;
+  friend class TextIndex;
 
   friend class TextSelectionPainter;
   friend class TextSelectionSizer;
@@ -428,6 +430,7 @@ private:
   friend class TextFlow;
   friend class TextWordList;
   friend class TextPage;
+  friend class TextIndex;
   friend class TextSelectionPainter;
   friend class TextSelectionDumper;
 };
@@ -469,6 +472,7 @@ private:
 
   friend class TextWordList;
   friend class TextPage;
+  friend class TextIndex;
 };
 
 #if TEXTOUT_WORD_LIST
@@ -664,6 +668,8 @@ private:
   TextFlow *flows;		// linked list of flows
   TextBlock **blocks;		// array of blocks, in yx order
   int nBlocks;			// number of blocks
+  TextIndex *index;		// spatial index of the blocks and lines
+				//   (built by coalesce)
   int primaryRot;		// primary rotation
   GBool primaryLR;		// primary direction (true means L-to-R,
 				//   false means R-to-L)
@@ -688,6 +694,7 @@ private:
   friend class TextBlock;
   friend class TextFlow;
   friend class TextWordList;
+  friend class TextIndex;
   friend class TextSelectionPainter;
   friend class TextSelectionDumper;
 };
@@ -53,7 +53,16 @@
 #include "Error.h"
 #include "ErrorCodes.h"
 #include "XRef.h"
+#include "DocIndex.h"
 #include "PopplerCache.h"
+#include "ContentCache.h"
+#include "GlobalParams.h"
+
+#if MULTITHREADED && defined(HAVE_PTHREAD)
+#include <pthread.h>
+#include <unistd.h>
+#define XREF_SCAN_THREADS 1
+#endif
 
 //------------------------------------------------------------------------
 // Permission bits
@@ -100,46 +109,19 @@ public:
   // object number <objNum>, generation 0.
   Object *getObject(int objIdx, int objNum, Object *obj);
 
+  // Estimated memory used by the parsed objects, in bytes.
+  Goffset getCost() { return cost; }
+
 private:
 
   int objStrNum;		// object number of the object stream
   int nObjects;			// number of objects in the stream
+  Goffset cost;
   Object *objs;			// the objects (length = nObjects)
   int *objNums;			// the object numbers (length = nObjects)
   GBool ok;
 };
 
-class ObjectStreamKey : public PopplerCacheKey
-{
-  public:
-    ObjectStreamKey(int num) : objStrNum(num)
-    {
-    }
-
-    bool operator==(const PopplerCacheKey &key) const
-    {
-      const ObjectStreamKey *k = static_cast<const ObjectStreamKey*>(&key);
-      return objStrNum == k->objStrNum;
-    }
-
-    const int objStrNum;
-};
-
-class ObjectStreamItem : public PopplerCacheItem
-{
-  public:
-    ObjectStreamItem(ObjectStream *objStr) : objStream(objStr)
-    {
-    }
-
-    ~ObjectStreamItem()
-    {
-      delete objStream;
-    }
-
-    ObjectStream *objStream;
-};
-
 ObjectStream::ObjectStream(XRef *xref, int objStrNumA, int recursion) {
   Stream *str;
   Parser *parser;
@@ -150,6 +132,7 @@ ObjectStream::ObjectStream(XRef *xref, int objStrNumA, int recursion) {
 
   objStrNum = objStrNumA;
   nObjects = 0;
+  cost = sizeof(ObjectStream);
   objs = NULL;
   objNums = NULL;
   ok = gFalse;
@@ -232,7 +215,9 @@ ObjectStream::ObjectStream(XRef *xref, int objStrNumA, int recursion) {
     objStr.getStream()->getChar();
   }
 
-  // parse the objects
+  // parse the objects; they are heap allocated rather than taken from
+  // an ObjectArena, a single object kept by the document (a page dict,
+  // say) would otherwise pin the whole stream after its eviction
   for (i = 0; i < nObjects; ++i) {
     obj1.initNull();
     if (i == nObjects - 1) {
@@ -247,6 +232,10 @@ ObjectStream::ObjectStream(XRef *xref, int objStrNumA, int recursion) {
     delete parser;
   }
 
+  // the objects take roughly as much memory as their text
+  cost += nObjects * (sizeof(Object) + sizeof(int)) +
+          first + offsets[nObjects - 1];
+
   gfree(offsets);
   ok = gTrue;
 
@@ -273,6 +262,139 @@ Object *ObjectStream::getObject(int objIdx, int objNum, Object *obj) {
   return objs[objIdx].copy(obj);
 }
 
+//------------------------------------------------------------------------
+// ObjectStreamCache
+//------------------------------------------------------------------------
+
+// The cache is split into shards by object stream number, each with its
+// own lock, so that threads using different object streams don't wait
+// for each other.
+#define objStrCacheShards 8
+
+class ObjectStreamKey {
+public:
+
+  ObjectStreamKey(int objStrNumA): objStrNum(objStrNumA) {}
+
+  Guint hash() const { return (Guint)objStrNum * 2654435761u; }
+  bool operator==(const ObjectStreamKey &key) const
+    { return objStrNum == key.objStrNum; }
+
+  int objStrNum;
+};
+
+class ObjectStreamCache {
+public:
+
+  // Create a cache holding up to <maxBytesA> bytes of parsed objects.
+  ObjectStreamCache(Goffset maxBytesA);
+  ~ObjectStreamCache();
+
+  // If object stream <objStrNum> is cached, get its <objIdx>th object,
+  // which should be object number <objNum>, and return true.
+  GBool getObject(int objStrNum, int objIdx, int objNum, Object *obj);
+
+  // Add <objStr>, which is taken over by the cache, and get its
+  // <objIdx>th object.  If another thread added the same object stream
+  // in the meantime, that one is used and <objStr> is deleted.
+  void putAndGetObject(ObjectStream *objStr, int objIdx, int objNum,
+		       Object *obj);
+
+  void getStats(PopplerCacheStats *stats);
+
+private:
+
+  struct Shard {
+    PopplerCache<ObjectStreamKey, ObjectStream> *cache;
+#if MULTITHREADED
+    GooMutex mutex;
+#endif
+  };
+
+  Shard *getShard(int objStrNum)
+    { return &shards[(ObjectStreamKey(objStrNum).hash() >> 16) %
+		     objStrCacheShards]; }
+
+  Shard shards[objStrCacheShards];
+};
+
+ObjectStreamCache::ObjectStreamCache(Goffset maxBytesA) {
+  int i;
+
+  for (i = 0; i < objStrCacheShards; ++i) {
+    shards[i].cache = new PopplerCache<ObjectStreamKey, ObjectStream>(
+			      0, maxBytesA / objStrCacheShards);
+#if MULTITHREADED
+    gInitMutex(&shards[i].mutex);
+#endif
+  }
+}
+
+ObjectStreamCache::~ObjectStreamCache() {
+  int i;
+
+  for (i = 0; i < objStrCacheShards; ++i) {
+    delete shards[i].cache;
+#if MULTITHREADED
+    gDestroyMutex(&shards[i].mutex);
+#endif
+  }
+}
+
+GBool ObjectStreamCache::getObject(int objStrNum, int objIdx, int objNum,
+				   Object *obj) {
+  Shard *shard;
+  ObjectStream *objStr;
+
+  shard = getShard(objStrNum);
+#if MULTITHREADED
+  MutexLocker locker(&shard->mutex);
+#endif
+  if (!(objStr = shard->cache->lookup(objStrNum))) {
+    return gFalse;
+  }
+  objStr->getObject(objIdx, objNum, obj);
+  return gTrue;
+}
+
+void ObjectStreamCache::putAndGetObject(ObjectStream *objStr, int objIdx,
+					int objNum, Object *obj) {
+  Shard *shard;
+  ObjectStream *cached;
+
+  shard = getShard(objStr->getObjStrNum());
+#if MULTITHREADED
+  MutexLocker locker(&shard->mutex);
+#endif
+  if ((cached = shard->cache->find(objStr->getObjStrNum()))) {
+    delete objStr;
+    objStr = cached;
+  } else {
+    shard->cache->put(objStr->getObjStrNum(), objStr, objStr->getCost());
+  }
+  objStr->getObject(objIdx, objNum, obj);
+}
+
+void ObjectStreamCache::getStats(PopplerCacheStats *stats) {
+  PopplerCacheStats shardStats;
+  int i;
+
+  stats->hits = stats->misses = stats->evictions = 0;
+  stats->bytes = 0;
+  stats->nItems = 0;
+  for (i = 0; i < objStrCacheShards; ++i) {
+#if MULTITHREADED
+    MutexLocker locker(&shards[i].mutex);
+#endif
+    shards[i].cache->getStats(&shardStats);
+    stats->hits += shardStats.hits;
+    stats->misses += shardStats.misses;
+    stats->evictions += shardStats.evictions;
+    stats->bytes += shardStats.bytes;
+    stats->nItems += shardStats.nItems;
+  }
+}
+
 //------------------------------------------------------------------------
 // XRef
 //------------------------------------------------------------------------
@@ -288,7 +410,15 @@ void XRef::init() {
   size = 0;
   streamEnds = NULL;
   streamEndsLen = 0;
-  objStrs = new PopplerCache(5);
+  objStrs = new ObjectStreamCache(globalParams ?
+				    globalParams->getObjStrCacheSize() :
+				    defaultObjStrCacheSize);
+  if (globalParams && globalParams->getContentCacheSize() > 0) {
+    contentCache = new ContentCache(globalParams->getContentCacheSize());
+  } else {
+    contentCache = NULL;
+  }
+  changeCount = 0;
   mainXRefEntriesOffset = 0;
   xRefStream = gFalse;
   scannedSpecialFlags = gFalse;
@@ -388,6 +518,59 @@ XRef::XRef(BaseStream *strA, Goffset pos, Goffset mainXRefEntriesOffsetA, GBool
   trailerDict.getDict()->setXRef(this);
 }
 
+XRef::XRef(BaseStream *strA, DocIndex *index) {
+  Parser *parser;
+  Object obj;
+  const char *trailerText;
+  int trailerLen, type, i;
+
+  init();
+  str = strA;
+  start = str->getStart();
+
+  // the index holds the whole table, so nothing is read from the file
+  prevXRefOffset = 0;
+  mainXRefEntriesOffset = 0;
+  mainXRefOffset = index->getMainXRefOffset();
+  xRefStream = index->isXRefStream();
+  xrefReconstructed = index->wasReconstructed();
+  rootNum = index->getRootNum();
+  rootGen = index->getRootGen();
+
+  if (resize(index->getNumEntries()) != index->getNumEntries()) {
+    ok = gFalse;
+    errCode = errDamaged;
+    return;
+  }
+  for (i = 0; i < size; ++i) {
+    index->getEntry(i, &entries[i].offset, &entries[i].gen, &type);
+    entries[i].type = (XRefEntryType)type;
+  }
+
+  if (index->getNumStreamEnds() > 0) {
+    streamEndsLen = index->getNumStreamEnds();
+    streamEnds = (Goffset *)gmallocn(streamEndsLen, sizeof(Goffset));
+    for (i = 0; i < streamEndsLen; ++i) {
+      streamEnds[i] = index->getStreamEnd(i);
+    }
+  }
+
+  trailerText = index->getTrailer(&trailerLen);
+  obj.initNull();
+  parser = new Parser(NULL,
+		      new Lexer(NULL, new MemStream((char *)trailerText, 0,
+						    trailerLen, &obj)),
+		      gFalse);
+  parser->getObj(&trailerDict);
+  delete parser;
+  if (!trailerDict.isDict()) {
+    ok = gFalse;
+    errCode = errDamaged;
+    return;
+  }
+  trailerDict.getDict()->setXRef(this);
+}
+
 XRef::~XRef() {
   for(int i=0; i<size; i++) {
       entries[i].obj.free ();
@@ -401,6 +584,9 @@ XRef::~XRef() {
   if (objStrs) {
     delete objStrs;
   }
+  if (contentCache) {
+    contentCache->decRef();
+  }
   if (strOwner) {
     delete str;
   }
@@ -410,6 +596,7 @@ XRef::~XRef() {
 }
 
 XRef *XRef::copy() {
+  xrefLocker();
   XRef *xref = new XRef();
   xref->str = str->copy();
   xref->strOwner = gTrue;
@@ -433,6 +620,12 @@ XRef *XRef::copy() {
   for (int i = 0; i < 32; i++) {
     xref->fileKey[i] = fileKey[i];
   }
+  if (xref->contentCache) {
+    xref->contentCache->decRef();
+  }
+  if ((xref->contentCache = contentCache)) {
+    contentCache->incRef();
+  }
 
   if (xref->reserve(size) == 0) {
     error(errSyntaxError, -1, "unable to allocate {0:d} entries", size);
@@ -891,20 +1084,361 @@ GBool XRef::readXRefStreamSection(Stream *xrefStr, int *w, int first, int n) {
   return gTrue;
 }
 
+//------------------------------------------------------------------------
+// xref reconstruction
+//------------------------------------------------------------------------
+
+// Damaged files are scanned in chunks of at least this many bytes, each
+// in its own thread.
+#define xrefScanMinChunk (4 << 20)
+#define xrefScanMaxThreads 16
+#define xrefScanBufSize 65536
+
+// Length of the lines the scanner looks at; longer lines are split, as
+// Stream::getLine() does with a buffer of this size.
+#define xrefScanLineSize 256
+
+enum XRefScanRecordKind {
+  xrefScanObj,			// "<num> <gen> obj"
+  xrefScanTrailer,		// "trailer"
+  xrefScanEndstream		// "endstream"
+};
+
+struct XRefScanRecord {
+  Goffset pos;
+  XRefScanRecordKind kind;
+  int num, gen;
+};
+
+// Reads a stream in blocks and splits it into lines exactly like
+// repeated calls to Stream::getLine(buf, xrefScanLineSize), without a
+// virtual call per byte.
+class XRefLineReader {
+public:
+
+  XRefLineReader(Stream *strA, Goffset posA);
+  ~XRefLineReader();
+
+  // Return the next line, which is not null-terminated and stays valid
+  // until the next call.  <lineStart> is set unless the line is the
+  // continuation of a line too long for the buffer.  Returns false at
+  // the end of the stream.
+  GBool getLine(const char **line, int *lineLen, Goffset *linePos,
+		GBool *lineStart);
+
+  // Skip to the start of the next line.
+  void skipLine();
+
+private:
+
+  void fill();
+  void consume(int n) { bufIdx += n; pos += n; }
+
+  Stream *str;
+  char *buf;
+  int bufLen;
+  int bufIdx;
+  GBool eof;
+  Goffset pos;			// position of buf[bufIdx]
+  GBool atLineStart;
+};
+
+XRefLineReader::XRefLineReader(Stream *strA, Goffset posA) {
+  str = strA;
+  buf = (char *)gmalloc(xrefScanBufSize);
+  bufLen = bufIdx = 0;
+  eof = gFalse;
+  pos = posA;
+  atLineStart = gTrue;
+}
+
+XRefLineReader::~XRefLineReader() {
+  gfree(buf);
+}
+
+// Make sure that a whole line and the byte following it are in the
+// buffer, unless the stream ends first.
+void XRefLineReader::fill() {
+  int n;
+
+  if (eof || bufLen - bufIdx > xrefScanLineSize) {
+    return;
+  }
+  memmove(buf, buf + bufIdx, bufLen - bufIdx);
+  bufLen -= bufIdx;
+  bufIdx = 0;
+  while (bufLen < xrefScanBufSize) {
+    if ((n = str->doGetChars(xrefScanBufSize - bufLen,
+			     (Guchar *)buf + bufLen)) <= 0) {
+      eof = gTrue;
+      break;
+    }
+    bufLen += n;
+  }
+}
+
+GBool XRefLineReader::getLine(const char **line, int *lineLen,
+			      Goffset *linePos, GBool *lineStart) {
+  const char *p, *q;
+  int n, maxLen, len;
+
+  fill();
+  if ((n = bufLen - bufIdx) == 0) {
+    return gFalse;
+  }
+  p = buf + bufIdx;
+  maxLen = n < xrefScanLineSize - 1 ? n : xrefScanLineSize - 1;
+  len = maxLen;
+  if ((q = (const char *)memchr(p, '\n', len))) {
+    len = (int)(q - p);
+  }
+  if ((q = (const char *)memchr(p, '\r', len))) {
+    len = (int)(q - p);
+  }
+  *line = p;
+  *lineLen = len;
+  *linePos = pos;
+  *lineStart = atLineStart;
+
+  if (len < maxLen) {
+    // the end-of-line marker is consumed with the line
+    if (p[len] == '\r' && len + 1 < n && p[len + 1] == '\n') {
+      consume(len + 2);
+    } else {
+      consume(len + 1);
+    }
+    atLineStart = gTrue;
+  } else {
+    consume(len);
+    atLineStart = len < xrefScanLineSize - 1;
+  }
+  return gTrue;
+}
+
+void XRefLineReader::skipLine() {
+  const char *p, *q;
+  int n, len;
+
+  while (1) {
+    fill();
+    if ((n = bufLen - bufIdx) == 0) {
+      return;
+    }
+    p = buf + bufIdx;
+    len = n;
+    if ((q = (const char *)memchr(p, '\n', len))) {
+      len = (int)(q - p);
+    }
+    if ((q = (const char *)memchr(p, '\r', len))) {
+      len = (int)(q - p);
+    }
+    if (len == n) {
+      consume(n);
+      continue;
+    }
+    consume(len + 1);
+    if (p[len] == '\r') {
+      fill();
+      if (bufIdx < bufLen && buf[bufIdx] == '\n') {
+	consume(1);
+      }
+    }
+    atLineStart = gTrue;
+    return;
+  }
+}
+
+// A part of the file scanned by one thread.
+struct XRefScanChunk {
+  Stream *str;
+  Goffset pos;			// position of the first byte
+  GBool skipFirst;		// starts in the middle of a line
+  Goffset end;			// stop at the first line starting here or
+				//   later, or -1 to scan to the end
+  std::vector<XRefScanRecord> records;
+#ifdef XREF_SCAN_THREADS
+  pthread_t thread;
+  GBool started;
+#endif
+};
+
+// Find the objects, trailers and stream ends in one line, as read by
+// Stream::getLine().  This doesn't touch the XRef, so lines can be
+// scanned in parallel; the records are applied in file order by
+// constructXRef().
+static void scanXRefLine(char *buf, Goffset pos,
+			 std::vector<XRefScanRecord> *records) {
+  XRefScanRecord rec;
+  int num, gen;
+  char *p;
+  char* token = NULL;
+  bool oneCycle = true;
+  int offset = 0;
+
+  p = buf;
+
+  // skip whitespace
+  while (*p && Lexer::isSpace(*p & 0xff)) ++p;
+
+  oneCycle = true;
+  offset = 0;
+
+  while( ( token = strstr( p, "endobj" ) ) || oneCycle ) {
+    oneCycle = false;
+
+    if( token ) {
+      oneCycle = true;
+      token[0] = '\0'; 
+      offset = token - p;
+    }
+
+    // got trailer dictionary
+    if (!strncmp(p, "trailer", 7)) {
+      rec.pos = pos;
+      rec.kind = xrefScanTrailer;
+      rec.num = rec.gen = 0;
+      records->push_back(rec);
+
+    // look for object
+    } else if (isdigit(*p & 0xff)) {
+      num = atoi(p);
+      if (num > 0) {
+	do {
+	  ++p;
+	} while (*p && isdigit(*p & 0xff));
+	if (isspace(*p & 0xff)) {
+	  do {
+	    ++p;
+	  } while (*p && isspace(*p & 0xff));
+	  if (isdigit(*p & 0xff)) {
+	    gen = atoi(p);
+	    do {
+	      ++p;
+	    } while (*p && isdigit(*p & 0xff));
+	    if (isspace(*p & 0xff)) {
+	      do {
+		++p;
+	      } while (*p && isspace(*p & 0xff));
+	      if (!strncmp(p, "obj", 3)) {
+		rec.pos = pos;
+		rec.kind = xrefScanObj;
+		rec.num = num;
+		rec.gen = gen;
+		records->push_back(rec);
+	      }
+	    }
+	  }
+	}
+      }
+
+    } else if (!strncmp(p, "endstream", 9)) {
+      rec.pos = pos;
+      rec.kind = xrefScanEndstream;
+      rec.num = rec.gen = 0;
+      records->push_back(rec);
+    }
+    if( token ) {
+      p = token + 6;// strlen( "endobj" ) = 6
+      pos += offset + 6;// strlen( "endobj" ) = 6
+      while (*p && Lexer::isSpace(*p & 0xff)) {
+        ++p;
+        ++pos;
+      }
+    }
+  }
+}
+
+// Returns false if scanXRefLine() would find nothing in <line>: after
+// any whitespace, it must start with a digit, "trailer" or "endstream",
+// or contain "endobj".  This is checked without copying the line.
+static inline GBool mayHaveXRefRecord(const char *line, int len) {
+  const char *p, *end;
+
+  end = line + len;
+  for (p = line; p < end && *p && Lexer::isSpace(*p & 0xff); ++p) ;
+  if (p < end && (isdigit(*p & 0xff) || *p == 't' || *p == 'e')) {
+    return gTrue;
+  }
+  // look for "endobj" with memchr, which is vectorized, rather than
+  // strstr, which would stop at a null byte anyway
+  if (len < 6) {
+    return gFalse;
+  }
+  end = line + len - 5;
+  for (p = line; p < end; ++p) {
+    if (!(p = (const char *)memchr(p, 'e', end - p))) {
+      break;
+    }
+    if (!memcmp(p, "endobj", 6)) {
+      return gTrue;
+    }
+  }
+  return gFalse;
+}
+
+static void scanXRefChunk(XRefScanChunk *chunk) {
+  XRefLineReader reader(chunk->str, chunk->pos);
+  char buf[xrefScanLineSize];
+  const char *line;
+  Goffset pos;
+  GBool lineStart;
+  int len;
+
+  if (chunk->skipFirst) {
+    reader.skipLine();
+  }
+  while (reader.getLine(&line, &len, &pos, &lineStart)) {
+    if (lineStart && chunk->end >= 0 && pos >= chunk->end) {
+      break;
+    }
+    if (mayHaveXRefRecord(line, len)) {
+      memcpy(buf, line, len);
+      buf[len] = '\0';
+      scanXRefLine(buf, pos, &chunk->records);
+    }
+  }
+}
+
+#ifdef XREF_SCAN_THREADS
+
+static void *scanXRefChunkMain(void *arg) {
+  scanXRefChunk((XRefScanChunk *)arg);
+  return NULL;
+}
+
+#endif
+
+// Number of threads used to scan a damaged file.
+static int getXRefScanThreads() {
+  int n;
+
+  n = globalParams ? globalParams->getXRefScanThreads() : 1;
+#ifdef XREF_SCAN_THREADS
+  if (n <= 0) {
+    n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  }
+#endif
+  if (n < 1) {
+    n = 1;
+  } else if (n > xrefScanMaxThreads) {
+    n = xrefScanMaxThreads;
+  }
+  return n;
+}
+
 // Attempt to construct an xref table for a damaged file.
 GBool XRef::constructXRef(GBool *wasReconstructed, GBool needCatalogDict) {
   Parser *parser;
   Object newTrailerDict, obj;
-  char buf[256];
-  Goffset pos;
+  XRefScanChunk *chunks;
+  XRefScanRecord *rec;
+  Goffset scanStart, chunkLen;
   int num, gen;
   int newSize;
   int streamEndsSize;
-  char *p;
-  GBool gotRoot;
-  char* token = NULL;
-  bool oneCycle = true;
-  int offset = 0;
+  int nChunks, i;
+  size_t j;
+  GBool gotRoot, scanOk;
 
   gfree(entries);
   capacity = 0;
@@ -919,35 +1453,72 @@ GBool XRef::constructXRef(GBool *wasReconstructed, GBool needCatalogDict) {
     *wasReconstructed = true;
   }
 
+  // split the file into chunks that can be scanned at the same time;
+  // each chunk but the first starts at the first line beginning at or
+  // after its nominal start, which is where the previous one stops
   str->reset();
-  while (1) {
-    pos = str->getPos();
-    if (!str->getLine(buf, 256)) {
-      break;
+  scanStart = str->getPos();
+  nChunks = 1;
+  if (str->hasIndependentSubStreams()) {
+    nChunks = getXRefScanThreads();
+    if (str->getLength() / xrefScanMinChunk < nChunks) {
+      nChunks = (int)(str->getLength() / xrefScanMinChunk);
+      if (nChunks < 1) {
+	nChunks = 1;
+      }
     }
-    p = buf;
-
-    // skip whitespace
-    while (*p && Lexer::isSpace(*p & 0xff)) ++p;
-
-    oneCycle = true;
-    offset = 0;
-
-    while( ( token = strstr( p, "endobj" ) ) || oneCycle ) {
-      oneCycle = false;
+  }
+  chunkLen = str->getLength() / nChunks;
+  chunks = new XRefScanChunk[nChunks];
+  for (i = 0; i < nChunks; ++i) {
+    if (i == 0) {
+      chunks[i].str = str;
+      chunks[i].pos = scanStart;
+      chunks[i].skipFirst = gFalse;
+    } else {
+      obj.initNull();
+      chunks[i].pos = scanStart + i * chunkLen - 1;
+      chunks[i].str = str->makeSubStream(chunks[i].pos, gFalse, 0, &obj);
+      chunks[i].str->reset();
+      chunks[i].skipFirst = gTrue;
+    }
+    chunks[i].end = i < nChunks - 1 ? scanStart + (i + 1) * chunkLen : -1;
+  }
+
+#ifdef XREF_SCAN_THREADS
+  // the first chunk is scanned in the caller thread, so are the chunks
+  // whose thread could not be started
+  for (i = 1; i < nChunks; ++i) {
+    chunks[i].started = pthread_create(&chunks[i].thread, NULL,
+				       &scanXRefChunkMain, &chunks[i]) == 0;
+  }
+  scanXRefChunk(&chunks[0]);
+  for (i = 1; i < nChunks; ++i) {
+    if (chunks[i].started) {
+      pthread_join(chunks[i].thread, NULL);
+    } else {
+      scanXRefChunk(&chunks[i]);
+    }
+  }
+#else
+  for (i = 0; i < nChunks; ++i) {
+    scanXRefChunk(&chunks[i]);
+  }
+#endif
 
-      if( token ) {
-        oneCycle = true;
-        token[0] = '\0'; 
-        offset = token - p;
-      }
+  // apply the records in file order
+  scanOk = gTrue;
+  for (i = 0; scanOk && i < nChunks; ++i) {
+    for (j = 0; scanOk && j < chunks[i].records.size(); ++j) {
+      rec = &chunks[i].records[j];
+      switch (rec->kind) {
 
       // got trailer dictionary
-      if (!strncmp(p, "trailer", 7)) {
+      case xrefScanTrailer:
         obj.initNull();
         parser = new Parser(NULL,
 		 new Lexer(NULL,
-		   str->makeSubStream(pos + 7, gFalse, 0, &obj)),
+		   str->makeSubStream(rec->pos + 7, gFalse, 0, &obj)),
 		 gFalse);
         parser->getObj(&newTrailerDict);
         if (newTrailerDict.isDict()) {
@@ -965,74 +1536,58 @@ GBool XRef::constructXRef(GBool *wasReconstructed, GBool needCatalogDict) {
         }
         newTrailerDict.free();
         delete parser;
+	break;
 
-      // look for object
-    } else if (isdigit(*p & 0xff)) {
-      num = atoi(p);
-      if (num > 0) {
-	do {
-	  ++p;
-	} while (*p && isdigit(*p & 0xff));
-	if (isspace(*p & 0xff)) {
-	  do {
-	    ++p;
-	  } while (*p && isspace(*p & 0xff));
-	  if (isdigit(*p & 0xff)) {
-	    gen = atoi(p);
-	    do {
-	      ++p;
-	    } while (*p && isdigit(*p & 0xff));
-	    if (isspace(*p & 0xff)) {
-	      do {
-		++p;
-	      } while (*p && isspace(*p & 0xff));
-	      if (!strncmp(p, "obj", 3)) {
-		if (num >= size) {
-		  newSize = (num + 1 + 255) & ~255;
-		  if (newSize < 0) {
-		    error(errSyntaxError, -1, "Bad object number");
-		    return gFalse;
-		  }
-		    if (resize(newSize) != newSize) {
-		      error(errSyntaxError, -1, "Invalid 'obj' parameters");
-		      return gFalse;
-		    }
-		  }
-		  if (entries[num].type == xrefEntryFree ||
-		      gen >= entries[num].gen) {
-		    entries[num].offset = pos - start;
-		    entries[num].gen = gen;
-		    entries[num].type = xrefEntryUncompressed;
-		}
-	        }
-	      }
-	    }
+      // got object
+      case xrefScanObj:
+	num = rec->num;
+	gen = rec->gen;
+	if (num >= size) {
+	  newSize = (num + 1 + 255) & ~255;
+	  if (newSize < 0) {
+	    error(errSyntaxError, -1, "Bad object number");
+	    scanOk = gFalse;
+	    break;
 	  }
-        }
+	  if (resize(newSize) != newSize) {
+	    error(errSyntaxError, -1, "Invalid 'obj' parameters");
+	    scanOk = gFalse;
+	    break;
+	  }
+	}
+	if (entries[num].type == xrefEntryFree ||
+	    gen >= entries[num].gen) {
+	  entries[num].offset = rec->pos - start;
+	  entries[num].gen = gen;
+	  entries[num].type = xrefEntryUncompressed;
+	}
+	break;
 
-      } else if (!strncmp(p, "endstream", 9)) {
+      case xrefScanEndstream:
         if (streamEndsLen == streamEndsSize) {
 	  streamEndsSize += 64;
           if (streamEndsSize >= INT_MAX / (int)sizeof(int)) {
             error(errSyntaxError, -1, "Invalid 'endstream' parameter.");
-            return gFalse;
+	    scanOk = gFalse;
+	    break;
           }
 	  streamEnds = (Goffset *)greallocn(streamEnds,
 					streamEndsSize, sizeof(Goffset));
         }
-        streamEnds[streamEndsLen++] = pos;
-      }
-      if( token ) {
-        p = token + 6;// strlen( "endobj" ) = 6
-        pos += offset + 6;// strlen( "endobj" ) = 6
-        while (*p && Lexer::isSpace(*p & 0xff)) {
-          ++p;
-          ++pos;
-        }
+        streamEnds[streamEndsLen++] = rec->pos;
+	break;
       }
     }
   }
 
+  for (i = 1; i < nChunks; ++i) {
+    delete chunks[i].str;
+  }
+  delete[] chunks;
+  if (!scanOk) {
+    return gFalse;
+  }
+
   if (gotRoot)
     return gTrue;
 
@@ -1134,31 +1689,49 @@ Object *XRef::getCatalog(Object *catalog) {
 
 Object *XRef::fetch(int num, int gen, Object *obj, int recursion) {
   XRefEntry *e;
+  XRefEntryType type;
+  Goffset offset;
+  int entryGen;
+  GBool decrypt, reconstructed;
   Parser *parser;
   Object obj1, obj2, obj3;
 
-  xrefLocker();
-  // check for bogus ref - this can happen in corrupted PDF files
-  if (num < 0 || num >= size) {
-    goto err;
-  }
+  // take a copy of the entry while holding the lock: the entries array
+  // may be reallocated by lazy xref reading or by a reconstruction
+  // running in another thread
+  {
+    xrefLocker();
+    reconstructed = xrefReconstructed;
+    // check for bogus ref - this can happen in corrupted PDF files
+    if (num < 0 || num >= size) {
+      goto err;
+    }
 
-  e = getEntry(num);
-  if(!e->obj.isNull ()) { //check for updated object
-    obj = e->obj.copy(obj);
-    return obj;
+    e = getEntry(num);
+    if(!e->obj.isNull ()) { //check for updated object
+      obj = e->obj.copy(obj);
+      return obj;
+    }
+    type = e->type;
+    offset = e->offset;
+    entryGen = e->gen;
+    decrypt = encrypted && !e->getFlag(XRefEntry::Unencrypted);
   }
 
-  switch (e->type) {
+  switch (type) {
 
   case xrefEntryUncompressed:
-    if (e->gen != gen) {
+  {
+    if (entryGen != gen) {
       goto err;
     }
+    // the object is parsed without holding the lock when the sub-streams
+    // of the base stream have their own file position
+    xrefCondLocker(!str->hasIndependentSubStreams());
     obj1.initNull();
     parser = new Parser(this,
 	       new Lexer(this,
-		 str->makeSubStream(start + e->offset, gFalse, 0, &obj1)),
+		 str->makeSubStream(start + offset, gFalse, 0, &obj1)),
 	       gTrue);
     parser->getObj(&obj1, recursion);
     parser->getObj(&obj2, recursion);
@@ -1196,13 +1769,14 @@ Object *XRef::fetch(int num, int gen, Object *obj, int recursion) {
       delete parser;
       goto err;
     }
-    parser->getObj(obj, gFalse, (encrypted && !e->getFlag(XRefEntry::Unencrypted)) ? fileKey : NULL,
+    parser->getObj(obj, gFalse, decrypt ? fileKey : NULL,
 		   encAlgorithm, keyLength, num, gen, recursion);
     obj1.free();
     obj2.free();
     obj3.free();
     delete parser;
     break;
+  }
 
   case xrefEntryCompressed:
   {
@@ -1211,35 +1785,35 @@ Object *XRef::fetch(int num, int gen, Object *obj, int recursion) {
       goto err;
     }
 #endif
-    if (e->offset >= (Guint)size ||
-	entries[e->offset].type != xrefEntryUncompressed) {
-      error(errSyntaxError, -1, "Invalid object stream");
-      goto err;
+    {
+      xrefLocker();
+      if (offset >= (Guint)size ||
+	  entries[offset].type != xrefEntryUncompressed) {
+	error(errSyntaxError, -1, "Invalid object stream");
+	goto err;
+      }
     }
 
-    ObjectStream *objStr = NULL;
-    ObjectStreamKey key(e->offset);
-    PopplerCacheItem *item = objStrs->lookup(key);
-    if (item) {
-      ObjectStreamItem *it = static_cast<ObjectStreamItem *>(item);
-      objStr = it->objStream;
+    if (objStrs->getObject((int)offset, entryGen, num, obj)) {
+      break;
     }
 
-    if (!objStr) {
-      objStr = new ObjectStream(this, e->offset, recursion + 1);
-      if (!objStr->isOk()) {
-	delete objStr;
-	objStr = NULL;
-	goto err;
-      } else {
-	// XRef could be reconstructed in constructor of ObjectStream:
-	e = getEntry(num);
-	ObjectStreamKey *newkey = new ObjectStreamKey(e->offset);
-	ObjectStreamItem *newitem = new ObjectStreamItem(objStr);
-	objStrs->put(newkey, newitem);
-      }
+    // the object stream is decoded without holding any lock, if another
+    // thread was faster the copy in the cache is used
+    ObjectStream *objStr = new ObjectStream(this, offset, recursion + 1);
+    if (!objStr->isOk()) {
+      delete objStr;
+      objStr = NULL;
+      goto err;
     }
-    objStr->getObject(e->gen, num, obj);
+    {
+      // XRef could be reconstructed in constructor of ObjectStream:
+      xrefLocker();
+      e = getEntry(num);
+      offset = e->offset;
+      entryGen = e->gen;
+    }
+    objStrs->putAndGetObject(objStr, entryGen, num, obj);
   }
   break;
 
@@ -1250,9 +1824,21 @@ Object *XRef::fetch(int num, int gen, Object *obj, int recursion) {
   return obj;
 
  err:
-  if (!xRefStream && !xrefReconstructed) {
-    rootNum = -1;
-    constructXRef(&xrefReconstructed);
+  {
+    xrefLocker();
+    if (xrefReconstructed != reconstructed) {
+      // the xref was reconstructed by another thread while the object
+      // was being parsed, try again with the new entries
+      reconstructed = gTrue;
+    } else if (!xRefStream && !xrefReconstructed) {
+      rootNum = -1;
+      constructXRef(&xrefReconstructed);
+      reconstructed = gTrue;
+    } else {
+      reconstructed = gFalse;
+    }
+  }
+  if (reconstructed) {
     return fetch(num, gen, obj, ++recursion);
   }
   return obj->initNull();
@@ -1279,9 +1865,14 @@ Object *XRef::getDocInfoNF(Object *obj) {
   return trailerDict.dictLookupNF("Info", obj);
 }
 
+void XRef::getObjStrCacheStats(PopplerCacheStats *stats) {
+  objStrs->getStats(stats);
+}
+
 GBool XRef::getStreamEnd(Goffset streamStart, Goffset *streamEnd) {
   int a, b, m;
 
+  xrefLocker();
   if (streamEndsLen == 0 ||
       streamStart > streamEnds[streamEndsLen - 1]) {
     return gFalse;
@@ -1304,6 +1895,7 @@ GBool XRef::getStreamEnd(Goffset streamStart, Goffset *streamEnd) {
 
 int XRef::getNumEntry(Goffset offset)
 {
+  xrefLocker();
   if (size > 0)
   {
     int res = 0;
@@ -1362,6 +1954,10 @@ void XRef::setModifiedObject (Object* o, Ref r) {
   e->obj.free();
   o->copy(&(e->obj));
   e->setFlag(XRefEntry::Updated, gTrue);
+  ++changeCount;
+  if (contentCache) {
+    contentCache->clear();
+  }
 }
 
 Ref XRef::addIndirectObject (Object* o) {
@@ -1387,6 +1983,10 @@ Ref XRef::addIndirectObject (Object* o) {
   e->type = xrefEntryUncompressed;
   o->copy(&e->obj);
   e->setFlag(XRefEntry::Updated, gTrue);
+  ++changeCount;
+  if (contentCache) {
+    contentCache->clear();
+  }
 
   Ref r;
   r.num = entryIndexToUse;
@@ -1408,6 +2008,10 @@ void XRef::removeIndirectObject(Ref r) {
   e->type = xrefEntryFree;
   e->gen++;
   e->setFlag(XRefEntry::Updated, gTrue);
+  ++changeCount;
+  if (contentCache) {
+    contentCache->clear();
+  }
 }
 
 void XRef::writeXRef(XRef::XRefWriter *writer, GBool writeAllEntries) {
@@ -46,7 +46,10 @@
 class Dict;
 class Stream;
 class Parser;
-class PopplerCache;
+class ObjectStreamCache;
+class ContentCache;
+struct PopplerCacheStats;
+class DocIndex;
 
 //------------------------------------------------------------------------
 // XRef
@@ -100,6 +103,9 @@ public:
   // Constructor.  Read xref table from stream.
   XRef(BaseStream *strA, Goffset pos, Goffset mainXRefEntriesOffsetA = 0, GBool *wasReconstructed = NULL, GBool reconstruct = false);
 
+  // Constructor, for a document whose xref table was saved in <index>.
+  XRef(BaseStream *strA, DocIndex *index);
+
   // Destructor.
   ~XRef();
 
@@ -142,7 +148,9 @@ public:
   // Get catalog object.
   Object *getCatalog(Object *obj);
 
-  // Fetch an indirect reference.
+  // Fetch an indirect reference.  This can be called from several
+  // threads at the same time, objects are parsed without holding the
+  // xref lock if the base stream has independent sub-streams.
   Object *fetch(int num, int gen, Object *obj, int recursion = 0);
 
   // Return the document's Info dictionary (if any).
@@ -156,6 +164,18 @@ public:
   int getRootNum() { return rootNum; }
   int getRootGen() { return rootGen; }
 
+  // Get the statistics of the object stream cache.
+  void getObjStrCacheStats(PopplerCacheStats *stats);
+
+  // Return the cache of tokenized content streams, or NULL if it is
+  // disabled.
+  ContentCache *getContentCache() { return contentCache; }
+
+  // Number of objects set, added or removed through the write access
+  // functions so far.  Data derived from the objects (e.g., Page's
+  // display lists) is stale when the count has changed.
+  Guint getChangeCount() { return changeCount; }
+
   // Get end position for a stream in a damaged file.
   // Returns false if unknown or file is not damaged.
   GBool getStreamEnd(Goffset streamStart, Goffset *streamEnd);
@@ -192,6 +212,8 @@ public:
 
 private:
 
+  friend class DocIndex;
+
   BaseStream *str;		// input stream
   Goffset start;		// offset in file (to allow for garbage
 				//   at beginning of file)
@@ -206,7 +228,10 @@ private:
   Goffset *streamEnds;		// 'endstream' positions - only used in
 				//   damaged files
   int streamEndsLen;		// number of valid entries in streamEnds
-  PopplerCache *objStrs;	// cached object streams
+  ObjectStreamCache *objStrs;	// cached object streams
+  ContentCache *contentCache;	// tokenized content streams, shared
+				//   with copies of this XRef
+  Guint changeCount;		// see getChangeCount()
   GBool encrypted;		// true if file is encrypted
   int encRevision;		
   int encVersion;		// encryption algorithm
@@ -222,7 +247,7 @@ private:
   GBool scannedSpecialFlags;	// true if scanSpecialFlags has been called
   GBool strOwner;     // true if str is owned by the instance
 #if MULTITHREADED
-  GooMutex mutex;
+  GooMutex mutex;		// protects the entries and the xref state
 #endif
 
   void init();
@@ -47,10 +47,12 @@
 #include "SplashPath.h"
 #include "SplashXPath.h"
 #include "SplashXPathScanner.h"
+#include "SplashXPathRasterizer.h"
 #include "SplashPattern.h"
 #include "SplashScreen.h"
 #include "SplashFont.h"
 #include "SplashGlyphBitmap.h"
+#include "SplashSpanKernels.h"
 #include "Splash.h"
 #include <algorithm>
 
@@ -123,6 +125,9 @@ struct ImageSection {
 
 #define splashPipeMaxStages 9
 
+// Maximum number of pixels handed to a span function at once.
+#define splashPipeSpanSize 256
+
 struct SplashPipe {
   // pixel coordinates
   int x, y;
@@ -163,6 +168,11 @@ struct SplashPipe {
 
   // the "run" function
   void (Splash::*run)(SplashPipe *pipe);
+
+  // the span function, which draws the pixels [x0, x1] of row y with
+  // shape values <shape> (pipe->shape for all if NULL), or NULL
+  void (Splash::*runSpan)(SplashPipe *pipe, int x0, int x1, int y,
+			  Guchar *shape);
 };
 
 SplashPipeResultColorCtrl Splash::pipeResultColorNoAlphaBlend[] = {
@@ -340,6 +350,17 @@ inline void Splash::pipeInit(SplashPipe *pipe, int x, int y,
 #endif
     }
   }
+
+  // select the span function
+  pipe->runSpan = NULL;
+  if (!pipe->pattern && !pipe->noTransparency && !state->blendFunc &&
+      !pipe->nonIsolatedGroup &&
+      !(state->inNonIsolatedGroup && alpha0Bitmap->alpha) &&
+      pipe->destAlphaPtr &&
+      (bitmap->mode == splashModeMono8 || bitmap->mode == splashModeRGB8 ||
+       bitmap->mode == splashModeXBGR8 || bitmap->mode == splashModeBGR8)) {
+    pipe->runSpan = &Splash::pipeRunSpanAlpha;
+  }
 }
 
 // general case
@@ -1321,6 +1342,131 @@ void Splash::pipeRunAADeviceN8(SplashPipe *pipe) {
 }
 #endif
 
+// span function:
+// !pipe->pattern && !pipe->noTransparency && !state->blendFunc &&
+// !pipe->nonIsolatedGroup && !pipe->alpha0Ptr &&
+// bitmap->mode == splashModeMono8, RGB8, XBGR8 or BGR8 && pipe->destAlphaPtr
+// This gives the same results as pipeRun or the pipeRunAA* functions,
+// with or without a soft mask.
+void Splash::pipeRunSpanAlpha(SplashPipe *pipe, int x0, int x1, int y,
+			      Guchar *shape) {
+  Guchar aSrc[splashPipeSpanSize], shapeBuf[splashPipeSpanSize];
+  Guchar cBuf[3][splashPipeSpanSize];
+  Guchar *comps[3], *sh, *p, *aRes;
+  int x, n, i;
+
+  pipeSetXY(pipe, x0, y);
+  for (x = x0; x <= x1; x += n) {
+    n = x1 - x + 1;
+    if (n > splashPipeSpanSize) {
+      n = splashPipeSpanSize;
+    }
+
+    //----- source alpha
+    sh = NULL;
+    if (pipe->usesShape) {
+      if (shape) {
+	sh = shape + (x - x0);
+      } else {
+	memset(shapeBuf, pipe->shape, n);
+	sh = shapeBuf;
+      }
+    }
+    splashSpanSourceAlpha(pipe->aInput,
+			  state->softMask ? pipe->softMaskPtr : (Guchar *)NULL,
+			  sh, aSrc, n);
+
+    //----- result alpha and color
+    // (the transfer functions aren't applied where the result alpha is
+    // 0: the pixel is left black, as in the per-pixel pipes)
+    p = pipe->destColorPtr;
+    aRes = pipe->destAlphaPtr;
+    switch (bitmap->mode) {
+    case splashModeMono8:
+      comps[0] = p;
+      splashSpanComposite(aSrc, pipe->destAlphaPtr, comps, pipe->cSrc, 1, n);
+      for (i = 0; i < n; ++i) {
+	p[i] = aRes[i] ? state->grayTransfer[p[i]] : 0;
+      }
+      p += n;
+      break;
+    case splashModeRGB8:
+      for (i = 0; i < n; ++i, p += 3) {
+	cBuf[0][i] = p[0];
+	cBuf[1][i] = p[1];
+	cBuf[2][i] = p[2];
+      }
+      comps[0] = cBuf[0];
+      comps[1] = cBuf[1];
+      comps[2] = cBuf[2];
+      splashSpanComposite(aSrc, pipe->destAlphaPtr, comps, pipe->cSrc, 3, n);
+      for (i = 0, p = pipe->destColorPtr; i < n; ++i, p += 3) {
+	if (aRes[i]) {
+	  p[0] = state->rgbTransferR[cBuf[0][i]];
+	  p[1] = state->rgbTransferG[cBuf[1][i]];
+	  p[2] = state->rgbTransferB[cBuf[2][i]];
+	} else {
+	  p[0] = p[1] = p[2] = 0;
+	}
+      }
+      break;
+    case splashModeXBGR8:
+      for (i = 0; i < n; ++i, p += 4) {
+	cBuf[0][i] = p[2];
+	cBuf[1][i] = p[1];
+	cBuf[2][i] = p[0];
+      }
+      comps[0] = cBuf[0];
+      comps[1] = cBuf[1];
+      comps[2] = cBuf[2];
+      splashSpanComposite(aSrc, pipe->destAlphaPtr, comps, pipe->cSrc, 3, n);
+      for (i = 0, p = pipe->destColorPtr; i < n; ++i, p += 4) {
+	if (aRes[i]) {
+	  p[0] = state->rgbTransferB[cBuf[2][i]];
+	  p[1] = state->rgbTransferG[cBuf[1][i]];
+	  p[2] = state->rgbTransferR[cBuf[0][i]];
+	} else {
+	  p[0] = p[1] = p[2] = 0;
+	}
+	p[3] = 255;
+      }
+      break;
+    case splashModeBGR8:
+      for (i = 0; i < n; ++i, p += 3) {
+	cBuf[0][i] = p[2];
+	cBuf[1][i] = p[1];
+	cBuf[2][i] = p[0];
+      }
+      comps[0] = cBuf[0];
+      comps[1] = cBuf[1];
+      comps[2] = cBuf[2];
+      splashSpanComposite(aSrc, pipe->destAlphaPtr, comps, pipe->cSrc, 3, n);
+      for (i = 0, p = pipe->destColorPtr; i < n; ++i, p += 3) {
+	if (aRes[i]) {
+	  p[0] = state->rgbTransferB[cBuf[2][i]];
+	  p[1] = state->rgbTransferG[cBuf[1][i]];
+	  p[2] = state->rgbTransferR[cBuf[0][i]];
+	} else {
+	  p[0] = p[1] = p[2] = 0;
+	}
+      }
+      break;
+    default:
+      break;
+    }
+
+    pipe->destColorPtr = p;
+    pipe->destAlphaPtr += n;
+    if (state->softMask) {
+      pipe->softMaskPtr += n;
+    }
+  }
+  pipe->x = x1 + 1;
+  updateModX(x0);
+  updateModX(x1);
+  updateModY(y);
+}
+
 inline void Splash::pipeSetXY(SplashPipe *pipe, int x, int y) {
   pipe->x = x;
   pipe->y = y;
@@ -1481,9 +1627,13 @@ inline void Splash::drawAAPixel(SplashPipe *pipe, int x, int y) {
 
 inline void Splash::drawSpan(SplashPipe *pipe, int x0, int x1, int y,
 			     GBool noClip) {
-  int x;
+  int x, xx;
 
   if (noClip) {
+    if (pipe->runSpan) {
+      (this->*pipe->runSpan)(pipe, x0, x1, y, NULL);
+      return;
+    }
     pipeSetXY(pipe, x0, y);
     for (x = x0; x <= x1; ++x) {
       (this->*pipe->run)(pipe);
@@ -1498,6 +1648,17 @@ inline void Splash::drawSpan(SplashPipe *pipe, int x0, int x1, int y,
     if (x1 > state->clip->getXMaxI()) {
       x1 = state->clip->getXMaxI();
     }
+    if (pipe->runSpan) {
+      // draw the runs of pixels inside the clip region
+      for (x = x0; x <= x1; x = xx + 1) {
+	for (; x <= x1 && !state->clip->test(x, y); ++x) ;
+	for (xx = x; xx + 1 <= x1 && state->clip->test(xx + 1, y); ++xx) ;
+	if (x <= x1) {
+	  (this->*pipe->runSpan)(pipe, x, xx, y, NULL);
+	}
+      }
+      return;
+    }
     pipeSetXY(pipe, x0, y);
     for (x = x0; x <= x1; ++x) {
       if (state->clip->test(x, y)) {
@@ -1521,7 +1682,8 @@ inline void Splash::drawAALine(SplashPipe *pipe, int x0, int x1, int y, GBool ad
   SplashColorPtr p;
   int xx, yy, t;
 #endif
-  int x;
+  Guchar shape[splashPipeSpanSize];
+  int x, spanX0, n;
 
 #if splashAASize == 4
   p0 = aaBuf->getDataPtr() + (x0 >> 1);
@@ -1530,6 +1692,8 @@ inline void Splash::drawAALine(SplashPipe *pipe, int x0, int x1, int y, GBool ad
   p3 = p2 + aaBuf->getRowSize();
 #endif
   pipeSetXY(pipe, x0, y);
+  spanX0 = x0;
+  n = 0;
   for (x = x0; x <= x1; ++x) {
 
     // compute the shape value
@@ -1553,7 +1717,19 @@ inline void Splash::drawAALine(SplashPipe *pipe, int x0, int x1, int y, GBool ad
     }
 #endif
 
-    if (t != 0) {
+    if (pipe->runSpan) {
+      // collect the runs of covered pixels
+      if (t != 0) {
+	if (n == 0) {
+	  spanX0 = x;
+	}
+	shape[n++] = (adjustLine) ? div255((int) lineOpacity * (double)aaGamma[t]) : (double)aaGamma[t];
+      }
+      if (n > 0 && (t == 0 || n == splashPipeSpanSize || x == x1)) {
+	(this->*pipe->runSpan)(pipe, spanX0, spanX0 + n - 1, y, shape);
+	n = 0;
+      }
+    } else if (t != 0) {
       pipe->shape = (adjustLine) ? div255((int) lineOpacity * (double)aaGamma[t]) : (double)aaGamma[t];
       (this->*pipe->run)(pipe);
       updateModX(x);
@@ -1564,6 +1740,41 @@ inline void Splash::drawAALine(SplashPipe *pipe, int x0, int x1, int y, GBool ad
   }
 }
 
+// Draw a line of exact coverage values computed by SplashXPathRasterizer,
+// where <line>[0] is the coverage of pixel <x0>.
+inline void Splash::drawAreaLine(SplashPipe *pipe, Guchar *line,
+				 int x0, int x1, int y) {
+  Guchar shape[splashPipeSpanSize];
+  int x, spanX0, n, t;
+
+  pipeSetXY(pipe, x0, y);
+  spanX0 = x0;
+  n = 0;
+  for (x = x0; x <= x1; ++x) {
+    t = line[x - x0];
+    if (pipe->runSpan) {
+      // collect the runs of covered pixels
+      if (t != 0) {
+	if (n == 0) {
+	  spanX0 = x;
+	}
+	shape[n++] = aaAreaGamma[t];
+      }
+      if (n > 0 && (t == 0 || n == splashPipeSpanSize || x == x1)) {
+	(this->*pipe->runSpan)(pipe, spanX0, spanX0 + n - 1, y, shape);
+	n = 0;
+      }
+    } else if (t != 0) {
+      pipe->shape = aaAreaGamma[t];
+      (this->*pipe->run)(pipe);
+      updateModX(x);
+      updateModY(y);
+    } else {
+      pipeIncX(pipe);
+    }
+  }
+}
+
 //------------------------------------------------------------------------
 
 // Transform a point from user space to device space.
@@ -1604,6 +1815,7 @@ Splash::Splash(SplashBitmap *bitmapA, GBool vectorAntialiasA,
   }
   minLineWidth = 0;
   thinLineMode = splashThinLineDefault;
+  areaAntialias = gFalse;
   clearModRegion();
   debugMode = gFalse;
   alpha0Bitmap = NULL;
@@ -1632,6 +1844,7 @@ Splash::Splash(SplashBitmap *bitmapA, GBool vectorAntialiasA,
   }
   minLineWidth = 0;
   thinLineMode = splashThinLineDefault;
+  areaAntialias = gFalse;
   clearModRegion();
   debugMode = gFalse;
   alpha0Bitmap = NULL;
@@ -1647,6 +1860,18 @@ Splash::~Splash() {
   }
 }
 
+void Splash::setAreaAntialias(GBool areaAntialiasA) {
+  int i;
+
+  if (areaAntialiasA && !areaAntialias) {
+    for (i = 0; i < 256; ++i) {
+      aaAreaGamma[i] = (Guchar)splashRound(
+			   splashPow((SplashCoord)i / 255, splashAAGamma) * 255);
+    }
+  }
+  areaAntialias = areaAntialiasA;
+}
+
 //------------------------------------------------------------------------
 // state read
 //------------------------------------------------------------------------
@@ -2469,6 +2694,7 @@ SplashError Splash::fillWithPattern(SplashPath *path, GBool eo,
   SplashClipResult clipRes, clipRes2;
   GBool adjustLine = gFalse; 
   int linePosI = 0;
+  GBool areaAA;
 
   if (path->length == 0) {
     return splashErrEmptyPath;
@@ -2517,8 +2743,15 @@ SplashError Splash::fillWithPattern(SplashPath *path, GBool eo,
     }
   }
 
+  areaAA = vectorAntialias && areaAntialias && !inShading &&
+           thinLineMode == splashThinLineDefault;
   xPath = new SplashXPath(path, state->matrix, state->flatness, gTrue, 
-    adjustLine, linePosI);
+    adjustLine, linePosI, areaAA);
+  if (areaAA) {
+    fillArea(xPath, eo, pattern, alpha);
+    delete xPath;
+    return splashOk;
+  }
   if (vectorAntialias && !inShading) {
     xPath->aaScale();
   }
@@ -2606,6 +2839,63 @@ SplashError Splash::fillWithPattern(SplashPath *path, GBool eo,
   return splashOk;
 }
 
+// Anti-aliased fill using the exact pixel coverage of <xPath>.
+void Splash::fillArea(SplashXPath *xPath, GBool eo,
+		      SplashPattern *pattern, SplashCoord alpha) {
+  SplashPipe pipe;
+  SplashXPathRasterizer *rasterizer;
+  SplashClipResult clipRes;
+  Guchar *line;
+  int xMinI, yMinI, xMaxI, yMaxI, x0, x1, y;
+  GBool partialClip;
+
+  xPath->sort();
+  rasterizer = new SplashXPathRasterizer(xPath, eo, 1,
+					 state->clip->getXMinI(),
+					 state->clip->getXMaxI());
+
+  // get the min and max x and y values
+  rasterizer->getBBox(&xMinI, &yMinI, &xMaxI, &yMaxI);
+  partialClip = gFalse;
+  if (yMinI < state->clip->getYMinI()) {
+    yMinI = state->clip->getYMinI();
+    partialClip = gTrue;
+  }
+  if (yMaxI > state->clip->getYMaxI()) {
+    yMaxI = state->clip->getYMaxI();
+    partialClip = gTrue;
+  }
+
+  // check clipping
+  if (yMinI <= yMaxI &&
+      (clipRes = state->clip->testRect(xMinI, yMinI, xMaxI, yMaxI))
+      != splashClipAllOutside) {
+    if (partialClip) {
+      clipRes = splashClipPartial;
+    }
+
+    pipeInit(&pipe, 0, yMinI, pattern, NULL, (Guchar)splashRound(alpha * 255),
+	     gTrue, gFalse);
+
+    // draw the lines
+    for (y = yMinI; y <= yMaxI; ++y) {
+      if (!(line = rasterizer->renderLine(y, &x0, &x1))) {
+	continue;
+      }
+      if (clipRes != splashClipAllInside &&
+	  !state->clip->clipAreaLine(line, &x0, &x1, y)) {
+	continue;
+      }
+      drawAreaLine(&pipe, line, x0, x1, y);
+    }
+  } else {
+    clipRes = splashClipAllOutside;
+  }
+  opClipRes = clipRes;
+
+  delete rasterizer;
+}
+
 GBool Splash::pathAllOutside(SplashPath *path) {
   SplashCoord xMin1, yMin1, xMax1, yMax1;
   SplashCoord xMin2, yMin2, xMax2, yMax2;
@@ -2759,6 +3049,110 @@ SplashError Splash::fillChar(SplashCoord x, SplashCoord y,
   return splashOk;
 }
 
+// The run is tested against the clip once, with a box around the
+// glyph origins made from the font's bounding box.  If it is all inside,
+// the glyphs are looked up without a clip test, and only those whose
+// bitmap sticks out of the box (fonts with a wrong bounding box) are
+// tested on their own.  Otherwise each glyph is tested as in fillChar().
+SplashError Splash::fillGlyphRun(SplashCoord *x, SplashCoord *y, int *c,
+				  int n, SplashFont *font) {
+  SplashPipe pipe;
+  SplashGlyphBitmap glyph;
+  SplashCoord xt, yt;
+  int x0, y0, xFrac, yFrac, pipeAA, i;
+  int fxMin, fyMin, fxMax, fyMax, margin;
+  int runXMin, runYMin, runXMax, runYMax, gxMin, gyMin, gxMax, gyMax;
+  SplashClipResult runClipRes, clipRes;
+  SplashError err;
+  GBool inside, outside;
+
+  if (debugMode) {
+    printf("fillGlyphRun: n=%d\n", n);
+  }
+  if (n <= 0) {
+    return splashOk;
+  }
+
+  // the glyph bitmaps are placed relative to the origin, in either
+  // direction depending on the text matrix, so the box is made
+  // symmetric around it
+  font->getBBox(&fxMin, &fyMin, &fxMax, &fyMax);
+  margin = abs(fxMin);
+  margin = std::max(margin, abs(fxMax));
+  margin = std::max(margin, abs(fyMin));
+  margin = std::max(margin, abs(fyMax));
+  margin += 2;
+  runXMin = runYMin = INT_MAX;
+  runXMax = runYMax = INT_MIN;
+  for (i = 0; i < n; ++i) {
+    transform(state->matrix, x[i], y[i], &xt, &yt);
+    x0 = splashFloor(xt);
+    y0 = splashFloor(yt);
+    runXMin = std::min(runXMin, x0);
+    runYMin = std::min(runYMin, y0);
+    runXMax = std::max(runXMax, x0);
+    runYMax = std::max(runYMax, y0);
+  }
+  runXMin -= margin;
+  runYMin -= margin;
+  runXMax += margin;
+  runYMax += margin;
+  runClipRes = state->clip->testRect(runXMin, runYMin, runXMax, runYMax);
+
+  err = splashOk;
+  pipeAA = -1;
+  inside = outside = gTrue;
+  for (i = 0; i < n; ++i) {
+    transform(state->matrix, x[i], y[i], &xt, &yt);
+    x0 = splashFloor(xt);
+    xFrac = splashFloor((xt - x0) * splashFontFraction);
+    y0 = splashFloor(yt);
+    yFrac = splashFloor((yt - y0) * splashFontFraction);
+    if (runClipRes == splashClipAllInside) {
+      if (!font->getGlyph(c[i], xFrac, yFrac, &glyph, x0, y0, NULL,
+			  &clipRes)) {
+	err = splashErrNoGlyph;
+	continue;
+      }
+      gxMin = x0 - glyph.x;
+      gyMin = y0 - glyph.y;
+      gxMax = gxMin + glyph.w - 1;
+      gyMax = gyMin + glyph.h - 1;
+      if (gxMin < runXMin || gyMin < runYMin ||
+	  gxMax > runXMax || gyMax > runYMax) {
+	clipRes = state->clip->testRect(gxMin, gyMin, gxMax, gyMax);
+      }
+    } else if (!font->getGlyph(c[i], xFrac, yFrac, &glyph, x0, y0,
+			       state->clip, &clipRes)) {
+      err = splashErrNoGlyph;
+      continue;
+    }
+    if (clipRes != splashClipAllOutside) {
+      // the pipe only depends on the fill state and on whether the
+      // glyphs are anti-aliased, so one serves the whole run
+      if (pipeAA != (int)glyph.aa) {
+	pipeInit(&pipe, 0, 0, state->fillPattern, NULL,
+		 (Guchar)splashRound(state->fillAlpha * 255), glyph.aa,
+		 gFalse);
+	pipeAA = (int)glyph.aa;
+      }
+      fillGlyph2(x0, y0, &glyph, clipRes == splashClipAllInside, &pipe);
+    }
+    if (clipRes != splashClipAllInside) {
+      inside = gFalse;
+    }
+    if (clipRes != splashClipAllOutside) {
+      outside = gFalse;
+    }
+    if (glyph.freeData) {
+      gfree(glyph.data);
+    }
+  }
+  opClipRes = inside ? splashClipAllInside
+                     : outside ? splashClipAllOutside : splashClipPartial;
+  return err;
+}
+
 void Splash::fillGlyph(SplashCoord x, SplashCoord y,
 			      SplashGlyphBitmap *glyph) {
   SplashCoord xt, yt;
@@ -2777,8 +3171,9 @@ void Splash::fillGlyph(SplashCoord x, SplashCoord y,
   opClipRes = clipRes;
 }
 
-void Splash::fillGlyph2(int x0, int y0, SplashGlyphBitmap *glyph, GBool noClip) {
-  SplashPipe pipe;
+void Splash::fillGlyph2(int x0, int y0, SplashGlyphBitmap *glyph, GBool noClip,
+			SplashPipe *pipe) {
+  SplashPipe pipeBuf;
   int alpha0;
   Guchar alpha;
   Guchar *p;
@@ -2815,19 +3210,37 @@ void Splash::fillGlyph2(int x0, int y0, SplashGlyphBitmap *glyph, GBool noClip)
 
   if (noClip) {
     if (glyph->aa) {
-      pipeInit(&pipe, xStart, yStart,
-               state->fillPattern, NULL, (Guchar)splashRound(state->fillAlpha * 255), gTrue, gFalse);
+      if (!pipe) {
+        pipe = &pipeBuf;
+        pipeInit(pipe, xStart, yStart,
+                 state->fillPattern, NULL, (Guchar)splashRound(state->fillAlpha * 255), gTrue, gFalse);
+      }
+      if (pipe->runSpan) {
+        // draw the runs of covered pixels, the glyph supplies the shape
+        for (yy = 0, y1 = yStart; yy < yyLimit; ++yy, ++y1) {
+          for (xx = 0; xx < xxLimit; xx = xx1) {
+            for (; xx < xxLimit && p[xx] == 0; ++xx) ;
+            for (xx1 = xx; xx1 < xxLimit && p[xx1] != 0; ++xx1) ;
+            if (xx < xx1) {
+              (this->*pipe->runSpan)(pipe, xStart + xx, xStart + xx1 - 1,
+                                    y1, p + xx);
+            }
+          }
+          p += glyph->w;
+        }
+        return;
+      }
       for (yy = 0, y1 = yStart; yy < yyLimit; ++yy, ++y1) {
-        pipeSetXY(&pipe, xStart, y1);
+        pipeSetXY(pipe, xStart, y1);
         for (xx = 0, x1 = xStart; xx < xxLimit; ++xx, ++x1) {
           alpha = p[xx];
           if (alpha != 0) {
-            pipe.shape = alpha;
-            (this->*pipe.run)(&pipe);
+            pipe->shape = alpha;
+            (this->*pipe->run)(pipe);
             updateModX(x1);
             updateModY(y1);
           } else {
-            pipeIncX(&pipe);
+            pipeIncX(pipe);
           }
         }
         p += glyph->w;
@@ -2835,19 +3248,22 @@ void Splash::fillGlyph2(int x0, int y0, SplashGlyphBitmap *glyph, GBool noClip)
     } else {
       const int widthEight = splashCeil(glyph->w / 8.0);
 
-      pipeInit(&pipe, xStart, yStart,
-               state->fillPattern, NULL, (Guchar)splashRound(state->fillAlpha * 255), gFalse, gFalse);
+      if (!pipe) {
+        pipe = &pipeBuf;
+        pipeInit(pipe, xStart, yStart,
+                 state->fillPattern, NULL, (Guchar)splashRound(state->fillAlpha * 255), gFalse, gFalse);
+      }
       for (yy = 0, y1 = yStart; yy < yyLimit; ++yy, ++y1) {
-        pipeSetXY(&pipe, xStart, y1);
+        pipeSetXY(pipe, xStart, y1);
         for (xx = 0, x1 = xStart; xx < xxLimit; xx += 8) {
           alpha0 = (xShift > 0 ? (p[xx / 8] << xShift) | (p[xx / 8 + 1] >> (8 - xShift)) : p[xx / 8]);
           for (xx1 = 0; xx1 < 8 && xx + xx1 < xxLimit; ++xx1, ++x1) {
             if (alpha0 & 0x80) {
-              (this->*pipe.run)(&pipe);
+              (this->*pipe->run)(pipe);
               updateModX(x1);
               updateModY(y1);
             } else {
-              pipeIncX(&pipe);
+              pipeIncX(pipe);
             }
             alpha0 <<= 1;
           }
@@ -2857,23 +3273,43 @@ void Splash::fillGlyph2(int x0, int y0, SplashGlyphBitmap *glyph, GBool noClip)
     }
   } else {
     if (glyph->aa) {
-      pipeInit(&pipe, xStart, yStart,
-               state->fillPattern, NULL, (Guchar)splashRound(state->fillAlpha * 255), gTrue, gFalse);
+      if (!pipe) {
+        pipe = &pipeBuf;
+        pipeInit(pipe, xStart, yStart,
+                 state->fillPattern, NULL, (Guchar)splashRound(state->fillAlpha * 255), gTrue, gFalse);
+      }
+      if (pipe->runSpan) {
+        // draw the runs of covered pixels inside the clip region
+        for (yy = 0, y1 = yStart; yy < yyLimit; ++yy, ++y1) {
+          for (xx = 0; xx < xxLimit; xx = xx1) {
+            for (; xx < xxLimit &&
+                   (p[xx] == 0 || !state->clip->test(xStart + xx, y1)); ++xx) ;
+            for (xx1 = xx; xx1 < xxLimit && p[xx1] != 0 &&
+                   state->clip->test(xStart + xx1, y1); ++xx1) ;
+            if (xx < xx1) {
+              (this->*pipe->runSpan)(pipe, xStart + xx, xStart + xx1 - 1,
+                                    y1, p + xx);
+            }
+          }
+          p += glyph->w;
+        }
+        return;
+      }
       for (yy = 0, y1 = yStart; yy < yyLimit; ++yy, ++y1) {
-        pipeSetXY(&pipe, xStart, y1);
+        pipeSetXY(pipe, xStart, y1);
         for (xx = 0, x1 = xStart; xx < xxLimit; ++xx, ++x1) {
           if (state->clip->test(x1, y1)) {
             alpha = p[xx];
             if (alpha != 0) {
-              pipe.shape = alpha;
-              (this->*pipe.run)(&pipe);
+              pipe->shape = alpha;
+              (this->*pipe->run)(pipe);
               updateModX(x1);
               updateModY(y1);
             } else {
-              pipeIncX(&pipe);
+              pipeIncX(pipe);
             }
           } else {
-            pipeIncX(&pipe);
+            pipeIncX(pipe);
           }
         }
         p += glyph->w;
@@ -2881,23 +3317,26 @@ void Splash::fillGlyph2(int x0, int y0, SplashGlyphBitmap *glyph, GBool noClip)
     } else {
       const int widthEight = splashCeil(glyph->w / 8.0);
 
-      pipeInit(&pipe, xStart, yStart,
-               state->fillPattern, NULL, (Guchar)splashRound(state->fillAlpha * 255), gFalse, gFalse);
+      if (!pipe) {
+        pipe = &pipeBuf;
+        pipeInit(pipe, xStart, yStart,
+                 state->fillPattern, NULL, (Guchar)splashRound(state->fillAlpha * 255), gFalse, gFalse);
+      }
       for (yy = 0, y1 = yStart; yy < yyLimit; ++yy, ++y1) {
-        pipeSetXY(&pipe, xStart, y1);
+        pipeSetXY(pipe, xStart, y1);
         for (xx = 0, x1 = xStart; xx < xxLimit; xx += 8) {
           alpha0 = (xShift > 0 ? (p[xx / 8] << xShift) | (p[xx / 8 + 1] >> (8 - xShift)) : p[xx / 8]);
           for (xx1 = 0; xx1 < 8 && xx + xx1 < xxLimit; ++xx1, ++x1) {
             if (state->clip->test(x1, y1)) {
               if (alpha0 & 0x80) {
-                (this->*pipe.run)(&pipe);
+                (this->*pipe->run)(pipe);
                 updateModX(x1);
                 updateModY(y1);
               } else {
-                pipeIncX(&pipe);
+                pipeIncX(pipe);
               }
             } else {
-              pipeIncX(&pipe);
+              pipeIncX(pipe);
             }
             alpha0 <<= 1;
           }
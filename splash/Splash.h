@@ -179,6 +179,14 @@ public:
   // Draw a character, using the current fill pattern.
   SplashError fillChar(SplashCoord x, SplashCoord y, int c, SplashFont *font);
 
+  // Draw a run of <n> characters of <font>, using the current fill
+  // pattern: character <c>[i] at (<x>[i], <y>[i]).  This draws the same
+  // as calling fillChar() for each of them, but sets up the pipe once
+  // for the whole run and, when the run is inside the clip region,
+  // tests it against the clip once.
+  SplashError fillGlyphRun(SplashCoord *x, SplashCoord *y, int *c, int n,
+			   SplashFont *font);
+
   // Draw a glyph, using the current fill pattern.  This function does
   // not free any data, i.e., it ignores glyph->freeData.
   void fillGlyph(SplashCoord x, SplashCoord y,
@@ -258,6 +266,12 @@ public:
   void setThinLineMode(SplashThinLineMode thinLineModeA) { thinLineMode = thinLineModeA; }
   SplashThinLineMode getThinLineMode() { return thinLineMode; }
 
+  // If <areaAntialiasA> is true, anti-aliased fills compute the exact
+  // area of each pixel covered by the path, instead of sampling 4x4
+  // points per pixel.
+  void setAreaAntialias(GBool areaAntialiasA);
+  GBool getAreaAntialias() { return areaAntialias; }
+
   // Get a bounding box which includes all modifications since the
   // last call to clearModRegion.
   void getModRegion(int *xMin, int *yMin, int *xMax, int *yMax)
@@ -311,6 +325,8 @@ private:
   void pipeRunAACMYK8(SplashPipe *pipe);
   void pipeRunAADeviceN8(SplashPipe *pipe);
 #endif
+  void pipeRunSpanAlpha(SplashPipe *pipe, int x0, int x1, int y,
+			Guchar *shape);
   void pipeSetXY(SplashPipe *pipe, int x, int y);
   void pipeIncX(SplashPipe *pipe);
   void drawPixel(SplashPipe *pipe, int x, int y, GBool noClip);
@@ -318,6 +334,7 @@ private:
   void drawAAPixel(SplashPipe *pipe, int x, int y);
   void drawSpan(SplashPipe *pipe, int x0, int x1, int y, GBool noClip);
   void drawAALine(SplashPipe *pipe, int x0, int x1, int y, GBool adjustLine = gFalse, Guchar lineOpacity = 0);
+  void drawAreaLine(SplashPipe *pipe, Guchar *line, int x0, int x1, int y);
   void transform(SplashCoord *matrix, SplashCoord xi, SplashCoord yi,
 		 SplashCoord *xo, SplashCoord *yo);
   void updateModX(int x);
@@ -336,8 +353,11 @@ private:
   void getBBoxFP(SplashPath *path, SplashCoord *xMinA, SplashCoord *yMinA, SplashCoord *xMaxA, SplashCoord *yMaxA);
   SplashError fillWithPattern(SplashPath *path, GBool eo,
 			      SplashPattern *pattern, SplashCoord alpha);
+  void fillArea(SplashXPath *xPath, GBool eo,
+		SplashPattern *pattern, SplashCoord alpha);
   GBool pathAllOutside(SplashPath *path);
-  void fillGlyph2(int x0, int y0, SplashGlyphBitmap *glyph, GBool noclip);
+  void fillGlyph2(int x0, int y0, SplashGlyphBitmap *glyph, GBool noclip,
+		  SplashPipe *pipe = NULL);
   void arbitraryTransformMask(SplashImageMaskSource src, void *srcData,
 			      int srcWidth, int srcHeight,
 			      SplashCoord *mat, GBool glyphMode);
@@ -419,11 +439,13 @@ private:
 				//   bitmap containing the alpha0 values
   int alpha0X, alpha0Y;		// offset within alpha0Bitmap
   SplashCoord aaGamma[splashAASize * splashAASize + 1];
+  Guchar aaAreaGamma[256];	// gamma for exact coverage values
   SplashCoord minLineWidth;
   SplashThinLineMode thinLineMode;
   int modXMin, modYMin, modXMax, modYMax;
   SplashClipResult opClipRes;
   GBool vectorAntialias;
+  GBool areaAntialias;
   GBool inShading;
   GBool debugMode;
 };
@@ -32,6 +32,7 @@
 #include "SplashPath.h"
 #include "SplashXPath.h"
 #include "SplashXPathScanner.h"
+#include "SplashXPathRasterizer.h"
 #include "SplashBitmap.h"
 #include "SplashClip.h"
 
@@ -70,6 +71,7 @@ SplashClip::SplashClip(SplashCoord x0, SplashCoord y0,
   paths = NULL;
   flags = NULL;
   scanners = NULL;
+  rasterizers = NULL;
   length = size = 0;
 }
 
@@ -92,9 +94,12 @@ SplashClip::SplashClip(SplashClip *clip) {
   flags = (Guchar *)gmallocn(size, sizeof(Guchar));
   scanners = (SplashXPathScanner **)
                  gmallocn(size, sizeof(SplashXPathScanner *));
+  rasterizers = (SplashXPathRasterizer **)
+                    gmallocn(size, sizeof(SplashXPathRasterizer *));
   for (i = 0; i < length; ++i) {
     paths[i] = clip->paths[i]->copy();
     flags[i] = clip->flags[i];
+    rasterizers[i] = NULL;
     if (antialias) {
       yMinAA = yMinI * splashAASize;
       yMaxAA = (yMaxI + 1) * splashAASize - 1;
@@ -113,10 +118,12 @@ SplashClip::~SplashClip() {
   for (i = 0; i < length; ++i) {
     delete paths[i];
     delete scanners[i];
+    delete rasterizers[i];
   }
   gfree(paths);
   gfree(flags);
   gfree(scanners);
+  gfree(rasterizers);
 }
 
 void SplashClip::grow(int nPaths) {
@@ -131,6 +138,9 @@ void SplashClip::grow(int nPaths) {
     flags = (Guchar *)greallocn(flags, size, sizeof(Guchar));
     scanners = (SplashXPathScanner **)
                    greallocn(scanners, size, sizeof(SplashXPathScanner *));
+    rasterizers = (SplashXPathRasterizer **)
+                      greallocn(rasterizers, size,
+				sizeof(SplashXPathRasterizer *));
   }
 }
 
@@ -141,13 +151,16 @@ void SplashClip::resetToRect(SplashCoord x0, SplashCoord y0,
   for (i = 0; i < length; ++i) {
     delete paths[i];
     delete scanners[i];
+    delete rasterizers[i];
   }
   gfree(paths);
   gfree(flags);
   gfree(scanners);
+  gfree(rasterizers);
   paths = NULL;
   flags = NULL;
   scanners = NULL;
+  rasterizers = NULL;
   length = size = 0;
 
   if (x0 < x1) {
@@ -274,6 +287,7 @@ SplashError SplashClip::clipToPath(SplashPath *path, SplashCoord *matrix,
       yMaxAA = yMaxI;
     }
     scanners[length] = new SplashXPathScanner(xPath, eo, yMinAA, yMaxAA);
+    rasterizers[length] = NULL;
     ++length;
   }
 
@@ -409,3 +423,68 @@ void SplashClip::clipAALine(SplashBitmap *aaBuf, int *x0, int *x1, int y, GBool
     }
   }
 }
+
+// Return the length of the part of [<i>, <i>+1] inside [<lo>, <hi>].
+static inline SplashCoord coverage(int i, SplashCoord lo, SplashCoord hi) {
+  return ((i + 1 < hi) ? (SplashCoord)(i + 1) : hi) -
+         ((i > lo) ? (SplashCoord)i : lo);
+}
+
+GBool SplashClip::clipAreaLine(Guchar *line, int *x0, int *x1, int y) {
+  SplashCoord f, fy;
+  Guchar *cline;
+  int cx0, cx1, x, i;
+
+  // clip to the rectangle
+  if (*x0 < xMinI) {
+    for (x = *x0; x < xMinI && x <= *x1; ++x) {
+      line[x - *x0] = 0;
+    }
+  }
+  if (*x1 > xMaxI) {
+    *x1 = xMaxI;
+  }
+  if (*x0 > *x1 || y < yMinI || y > yMaxI) {
+    return gFalse;
+  }
+
+  // scale the pixels partially covered by the rectangle
+  fy = coverage(y, yMin, yMax);
+  for (x = *x0; x <= *x1; ++x) {
+    if (fy >= 1 && x > xMinI && x < xMaxI) {
+      x = xMaxI - 1;
+      continue;
+    }
+    f = fy;
+    if (x == xMinI || x == xMaxI) {
+      f *= coverage(x, xMin, xMax);
+    }
+    if (f < 1) {
+      line[x - *x0] = (Guchar)splashRound(line[x - *x0] * f);
+    }
+  }
+
+  // clip to the paths
+  for (i = 0; i < length; ++i) {
+    if (!rasterizers[i]) {
+      rasterizers[i] = new SplashXPathRasterizer(paths[i],
+						 flags[i] & splashClipEO,
+						 antialias ? (SplashCoord)1 / splashAASize : 1,
+						 xMinI, xMaxI);
+    }
+    if (!(cline = rasterizers[i]->renderLine(y, &cx0, &cx1)) ||
+	cx0 > *x1 || cx1 < *x0) {
+      return gFalse;
+    }
+    for (x = *x0; x < cx0; ++x) {
+      line[x - *x0] = 0;
+    }
+    if (*x1 > cx1) {
+      *x1 = cx1;
+    }
+    for (x = cx0 > *x0 ? cx0 : *x0; x <= *x1; ++x) {
+      line[x - *x0] = (Guchar)((line[x - *x0] * cline[x - cx0] + 127) / 255);
+    }
+  }
+  return gTrue;
+}
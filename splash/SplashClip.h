@@ -32,6 +32,7 @@
 
 class SplashPath;
 class SplashXPath;
+class SplashXPathRasterizer;
 class SplashBitmap;
 
 //------------------------------------------------------------------------
@@ -120,6 +121,13 @@ public:
   void clipAALine(SplashBitmap *aaBuf, int *x0, int *x1, int y,
     GBool adjustVertLine = gFalse);
 
+  // Clips a line of exact coverage values, as computed by
+  // SplashXPathRasterizer: <line>[0] is the coverage of pixel <x0>, and
+  // <line> goes on up to <x1>.  Coverage values are multiplied by the
+  // coverage of the clip region.  This function may lower <x1>, and
+  // returns false if the whole line is clipped.
+  GBool clipAreaLine(Guchar *line, int *x0, int *x1, int y);
+
   // Get the rectangle part of the clip region.
   SplashCoord getXMin() { return xMin; }
   SplashCoord getXMax() { return xMax; }
@@ -146,6 +154,7 @@ protected:
   SplashXPath **paths;
   Guchar *flags;
   SplashXPathScanner **scanners;
+  SplashXPathRasterizer **rasterizers;	// created by clipAreaLine
   int length, size;
 };
 
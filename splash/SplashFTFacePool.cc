@@ -0,0 +1,245 @@
+//========================================================================
+//
+// SplashFTFacePool.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#if HAVE_FREETYPE_FREETYPE_H || HAVE_FREETYPE_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <string.h>
+#include "goo/gmem.h"
+#include "SplashFTFacePool.h"
+
+//------------------------------------------------------------------------
+
+// number of hash buckets; documents rarely embed more than a few hundred
+// fonts, so the table doesn't grow
+#define splashFTFacePoolTableSize 256
+
+//------------------------------------------------------------------------
+// SplashFTSharedFace
+//------------------------------------------------------------------------
+
+SplashFTSharedFace::SplashFTSharedFace(unsigned long long hashA,
+				       int faceIndexA,
+				       char *bufA, int lenA, FT_Face faceA) {
+  hash = hashA;
+  faceIndex = faceIndexA;
+  buf = bufA;
+  len = lenA;
+  face = faceA;
+  refCnt = 1;
+  hashNext = lruPrev = lruNext = NULL;
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
+}
+
+// Must be called with the pool locked.
+SplashFTSharedFace::~SplashFTSharedFace() {
+  FT_Done_Face(face);
+  gfree(buf);
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
+}
+
+//------------------------------------------------------------------------
+// SplashFTFacePool
+//------------------------------------------------------------------------
+
+// The pool is created on first use, and never destroyed: font engines
+// in any thread may use it until the process exits.
+SplashFTFacePool *SplashFTFacePool::getPool() {
+  static SplashFTFacePool *pool = new SplashFTFacePool();
+
+  return pool;
+}
+
+SplashFTFacePool::SplashFTFacePool() {
+  if (FT_Init_FreeType(&lib)) {
+    lib = NULL;
+  }
+  table = (SplashFTSharedFace **)gmallocn(splashFTFacePoolTableSize,
+					  sizeof(SplashFTSharedFace *));
+  memset(table, 0, splashFTFacePoolTableSize * sizeof(SplashFTSharedFace *));
+  lruFirst = lruLast = NULL;
+  maxBytes = 0;
+  bytes = 0;
+  nFaces = nUsed = 0;
+  hits = misses = evictions = 0;
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
+}
+
+SplashFTSharedFace **SplashFTFacePool::getBucket(unsigned long long hash,
+						 int faceIndex) {
+  return &table[(Guint)(hash ^ (hash >> 32) ^ faceIndex) &
+		(splashFTFacePoolTableSize - 1)];
+}
+
+void SplashFTFacePool::setMaxBytes(Goffset maxBytesA) {
+#if MULTITHREADED
+  MutexLocker locker(&mutex);
+#endif
+  maxBytes = maxBytesA > 0 ? maxBytesA : 0;
+  evict(maxBytes);
+}
+
+SplashFTSharedFace *SplashFTFacePool::getFace(const char *buf, int len,
+					      unsigned long long hash,
+					      int faceIndex) {
+  SplashFTSharedFace *f, **p;
+  FT_Face face;
+  char *bufCopy;
+
+#if MULTITHREADED
+  MutexLocker locker(&mutex);
+#endif
+  if (!isEnabled()) {
+    return NULL;
+  }
+
+  p = getBucket(hash, faceIndex);
+  for (f = *p; f; f = f->hashNext) {
+    if (f->hash == hash && f->faceIndex == faceIndex && f->len == len &&
+	!memcmp(f->buf, buf, len)) {
+      break;
+    }
+  }
+  if (f) {
+    ++hits;
+    if (f->refCnt++ == 0) {
+      // take it off the list of unused faces
+      if (f->lruPrev) {
+	f->lruPrev->lruNext = f->lruNext;
+      } else {
+	lruFirst = f->lruNext;
+      }
+      if (f->lruNext) {
+	f->lruNext->lruPrev = f->lruPrev;
+      } else {
+	lruLast = f->lruPrev;
+      }
+      f->lruPrev = f->lruNext = NULL;
+      ++nUsed;
+    }
+    return f;
+  }
+  ++misses;
+
+  if (len <= 0 || (Goffset)len > maxBytes) {
+    return NULL;
+  }
+  evict(maxBytes - len);
+  if (bytes + len > maxBytes) {
+    // the faces in use take up the budget
+    return NULL;
+  }
+
+  // FreeType reads memory faces in place, so they get a copy of the
+  // data that lives as long as they do
+  bufCopy = (char *)gmalloc(len);
+  memcpy(bufCopy, buf, len);
+  if (FT_New_Memory_Face(lib, (const FT_Byte *)bufCopy, len, faceIndex,
+			 &face)) {
+    gfree(bufCopy);
+    return NULL;
+  }
+  f = new SplashFTSharedFace(hash, faceIndex, bufCopy, len, face);
+  f->hashNext = *p;
+  *p = f;
+  bytes += len;
+  ++nFaces;
+  ++nUsed;
+  return f;
+}
+
+void SplashFTFacePool::releaseFace(SplashFTSharedFace *face) {
+#if MULTITHREADED
+  MutexLocker locker(&mutex);
+#endif
+  if (--face->refCnt > 0) {
+    return;
+  }
+  --nUsed;
+  face->lruPrev = NULL;
+  face->lruNext = lruFirst;
+  if (lruFirst) {
+    lruFirst->lruPrev = face;
+  } else {
+    lruLast = face;
+  }
+  lruFirst = face;
+  evict(maxBytes);
+}
+
+// Remove the unused face <face> from the hash table and the LRU list,
+// without deleting it.
+void SplashFTFacePool::unlink(SplashFTSharedFace *face) {
+  SplashFTSharedFace **p;
+
+  for (p = getBucket(face->hash, face->faceIndex);
+       *p != face;
+       p = &(*p)->hashNext) ;
+  *p = face->hashNext;
+  if (face->lruPrev) {
+    face->lruPrev->lruNext = face->lruNext;
+  } else {
+    lruFirst = face->lruNext;
+  }
+  if (face->lruNext) {
+    face->lruNext->lruPrev = face->lruPrev;
+  } else {
+    lruLast = face->lruPrev;
+  }
+  bytes -= face->len;
+  --nFaces;
+}
+
+// Drop the least recently used unused faces until the pool uses at most
+// <limit> bytes, or there are no unused faces left.
+void SplashFTFacePool::evict(Goffset limit) {
+  SplashFTSharedFace *face;
+
+  while (bytes > limit && (face = lruLast)) {
+    unlink(face);
+    delete face;
+    ++evictions;
+  }
+}
+
+void SplashFTFacePool::clear() {
+  SplashFTSharedFace *face;
+
+#if MULTITHREADED
+  MutexLocker locker(&mutex);
+#endif
+  while ((face = lruLast)) {
+    unlink(face);
+    delete face;
+  }
+}
+
+void SplashFTFacePool::getStats(SplashFTFacePoolStats *stats) {
+#if MULTITHREADED
+  MutexLocker locker(&mutex);
+#endif
+  stats->hits = hits;
+  stats->misses = misses;
+  stats->evictions = evictions;
+  stats->bytes = bytes;
+  stats->nFaces = nFaces;
+  stats->nUsed = nUsed;
+}
+
+#endif // HAVE_FREETYPE_FREETYPE_H || HAVE_FREETYPE_H
@@ -0,0 +1,179 @@
+//========================================================================
+//
+// SplashFTFacePool.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef SPLASHFTFACEPOOL_H
+#define SPLASHFTFACEPOOL_H
+
+#if HAVE_FREETYPE_FREETYPE_H || HAVE_FREETYPE_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include "poppler-config.h"
+#include "goo/gtypes.h"
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
+
+class SplashFTFacePool;
+
+//------------------------------------------------------------------------
+
+struct SplashFTFacePoolStats {
+  Gulong hits;			// requests that found their face
+  Gulong misses;		// requests that didn't
+  Gulong evictions;		// unused faces dropped to stay within
+				//   the budget
+  Goffset bytes;		// total size of the pooled font data
+  int nFaces;			// number of pooled faces
+  int nUsed;			// number of them in use
+};
+
+//------------------------------------------------------------------------
+// SplashFTSharedFace
+//------------------------------------------------------------------------
+
+class SplashFTSharedFace {
+public:
+
+  FT_Face getFace() { return face; }
+
+  // The face may be used by several font files, in any thread: callers
+  // must hold this lock while they use it (set its size or transform,
+  // load glyphs, etc.).
+#if MULTITHREADED
+  void lock() { gLockMutex(&mutex); }
+  void unlock() { gUnlockMutex(&mutex); }
+#endif
+
+private:
+
+  SplashFTSharedFace(unsigned long long hashA, int faceIndexA,
+		     char *bufA, int lenA, FT_Face faceA);
+  ~SplashFTSharedFace();
+
+  unsigned long long hash;	// SplashFontSrc::getHash() of the data
+  int faceIndex;
+  char *buf;			// copy of the font data
+  int len;
+  FT_Face face;
+  int refCnt;			// number of users
+  SplashFTSharedFace *hashNext;	// next face in the hash bucket
+  SplashFTSharedFace *lruPrev;	// more recently released unused face
+  SplashFTSharedFace *lruNext;	// less recently released unused face
+#if MULTITHREADED
+  GooMutex mutex;
+#endif
+
+  friend class SplashFTFacePool;
+};
+
+//------------------------------------------------------------------------
+// SplashFTFaceLocker
+//
+// Holds the lock of a shared face for the lifetime of the object; does
+// nothing for a NULL face.
+//------------------------------------------------------------------------
+
+class SplashFTFaceLocker {
+public:
+
+#if MULTITHREADED
+  SplashFTFaceLocker(SplashFTSharedFace *faceA): face(faceA)
+    { if (face) { face->lock(); } }
+  ~SplashFTFaceLocker() { if (face) { face->unlock(); } }
+#else
+  SplashFTFaceLocker(SplashFTSharedFace *faceA) {}
+#endif
+
+private:
+
+  SplashFTFaceLocker(const SplashFTFaceLocker &);
+  SplashFTFaceLocker& operator=(const SplashFTFaceLocker &);
+
+#if MULTITHREADED
+  SplashFTSharedFace *face;
+#endif
+};
+
+//------------------------------------------------------------------------
+// SplashFTFacePool
+//
+// Process-wide pool of FreeType faces for embedded fonts, shared by all
+// SplashFTFontEngines.  Documents that embed the same font program (the
+// same subset of a standard font, a company font on every page of a
+// batch of invoices, etc.) get the same face, instead of each engine
+// parsing the font data into a face of its own.
+//
+// Faces are found by the hash of the font data, and the data itself is
+// compared, so that a collision can't hand out the wrong font.  The pool
+// loads them into its own FT_Library, from its own copy of the data.
+//
+// Faces are refcounted; unused faces are kept for the next document
+// that needs them, and dropped least recently used first.  The pool is
+// limited to a number of bytes of font data, counting faces in use: a
+// font that doesn't fit gets a private face, as if the pool were
+// disabled.  It is disabled while the limit is 0, which is the default.
+//------------------------------------------------------------------------
+
+class SplashFTFacePool {
+public:
+
+  // Return the process-wide pool.
+  static SplashFTFacePool *getPool();
+
+  // Set the size limit, in bytes, dropping unused faces as needed.  A
+  // limit of 0 disables the pool; faces in use are dropped when they're
+  // released.
+  void setMaxBytes(Goffset maxBytesA);
+
+  GBool isEnabled() { return maxBytes > 0 && lib; }
+
+  // Return a new reference to the face <faceIndex> of the font data
+  // <buf>, whose SplashFontSrc::getHash() is <hash>, loading it if
+  // needed.  Return NULL if the pool is disabled or full, or if FreeType
+  // can't load the face.
+  SplashFTSharedFace *getFace(const char *buf, int len,
+			      unsigned long long hash, int faceIndex);
+
+  // Drop a reference returned by getFace().
+  void releaseFace(SplashFTSharedFace *face);
+
+  // Drop all unused faces.
+  void clear();
+
+  void getStats(SplashFTFacePoolStats *stats);
+
+private:
+
+  SplashFTFacePool();
+  SplashFTSharedFace **getBucket(unsigned long long hash, int faceIndex);
+  void unlink(SplashFTSharedFace *face);
+  void evict(Goffset limit);
+
+  FT_Library lib;		// library the faces are loaded into
+  SplashFTSharedFace **table;	// hash table
+  SplashFTSharedFace *lruFirst;	// most recently released unused face
+  SplashFTSharedFace *lruLast;	// least recently released unused face
+  Goffset maxBytes;		// limit, 0 if disabled
+  Goffset bytes;
+  int nFaces, nUsed;
+  Gulong hits, misses, evictions;
+#if MULTITHREADED
+  // guards the pool, and the library: FreeType doesn't allow faces of
+  // one library to be created or destroyed concurrently
+  GooMutex mutex;
+#endif
+};
+
+#endif // HAVE_FREETYPE_FREETYPE_H || HAVE_FREETYPE_H
+
+#endif
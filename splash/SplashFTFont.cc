@@ -39,6 +39,7 @@
 #include "SplashMath.h"
 #include "SplashGlyphBitmap.h"
 #include "SplashPath.h"
+#include "SplashFTFacePool.h"
 #include "SplashFTFontEngine.h"
 #include "SplashFTFontFile.h"
 #include "SplashFTFont.h"
@@ -70,7 +71,9 @@ SplashFTFont::SplashFTFont(SplashFTFontFile *fontFileA, SplashCoord *matA,
 #endif
 
   face = fontFileA->face;
+  SplashFTFaceLocker locker(fontFileA->sharedFace);
   if (FT_New_Size(face, &sizeObj)) {
+    sizeObj = NULL;
     return;
   }
   face->size = sizeObj;
@@ -226,6 +229,15 @@ SplashFTFont::SplashFTFont(SplashFTFontFile *fontFileA, SplashCoord *matA,
 }
 
 SplashFTFont::~SplashFTFont() {
+  SplashFTFontFile *ff;
+
+  // the face may outlive this font when it's shared, so drop its size
+  // now, rather than with the face
+  ff = (SplashFTFontFile *)fontFile;
+  if (sizeObj) {
+    SplashFTFaceLocker locker(ff->sharedFace);
+    FT_Done_Size(sizeObj);
+  }
 }
 
 GBool SplashFTFont::getGlyph(int c, int xFrac, int yFrac,
@@ -274,6 +286,7 @@ GBool SplashFTFont::makeGlyph(int c, int xFrac, int yFrac,
 
   ff = (SplashFTFontFile *)fontFile;
 
+  SplashFTFaceLocker locker(ff->sharedFace);
   ff->face->size = sizeObj;
   offset.x = (FT_Pos)(int)((SplashCoord)xFrac * splashFontFractionMul * 64);
   offset.y = 0;
@@ -299,10 +312,11 @@ GBool SplashFTFont::makeGlyph(int c, int xFrac, int yFrac,
   bitmap->w = ((cbox.xMax - cbox.xMin) / 64) + 4;
   bitmap->h = ((cbox.yMax - cbox.yMin) / 64) + 4;
 
-  *clipRes = clip->testRect(x0 - bitmap->x,
-                            y0 - bitmap->y,
-                            x0 - bitmap->x + bitmap->w,
-                            y0 - bitmap->y + bitmap->h);
+  *clipRes = clip ? clip->testRect(x0 - bitmap->x,
+                                   y0 - bitmap->y,
+                                   x0 - bitmap->x + bitmap->w,
+                                   y0 - bitmap->y + bitmap->h)
+                  : splashClipAllInside;
   if (*clipRes == splashClipAllOutside) {
     bitmap->freeData = gFalse;
     return gTrue;
@@ -362,6 +376,7 @@ double SplashFTFont::getGlyphAdvance(int c)
   offset.x = 0;
   offset.y = 0;
 
+  SplashFTFaceLocker locker(ff->sharedFace);
   ff->face->size = sizeObj;
   FT_Set_Transform(ff->face, &identityMatrix, &offset);
 
@@ -407,6 +422,7 @@ SplashPath *SplashFTFont::getGlyphPath(int c) {
   FT_Glyph glyph;
 
   ff = (SplashFTFontFile *)fontFile;
+  SplashFTFaceLocker locker(ff->sharedFace);
   ff->face->size = sizeObj;
   FT_Set_Transform(ff->face, &textMatrix, NULL);
   slot = ff->face->glyph;
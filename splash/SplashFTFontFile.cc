@@ -27,12 +27,15 @@
 #pragma implementation
 #endif
 
+#include <string.h>
 #include "goo/gmem.h"
 #include "goo/GooString.h"
 #include "poppler/GfxFont.h"
+#include "SplashFTFacePool.h"
 #include "SplashFTFontEngine.h"
 #include "SplashFTFont.h"
 #include "SplashFTFontFile.h"
+#include "SplashGlyphCache.h"
 
 //------------------------------------------------------------------------
 // SplashFTFontFile
@@ -43,33 +46,34 @@ SplashFontFile *SplashFTFontFile::loadType1Font(SplashFTFontEngine *engineA,
 						SplashFontSrc *src,
 						const char **encA) {
   FT_Face faceA;
+  SplashFTSharedFace *sharedFaceA;
   int *codeToGIDA;
   const char *name;
   int i;
 
-  if (src->isFile) {
-    if (FT_New_Face(engineA->lib, src->fileName->getCString(), 0, &faceA))
-      return NULL;
-  } else {
-    if (FT_New_Memory_Face(engineA->lib, (const FT_Byte *)src->buf, src->bufLen, 0, &faceA))
-      return NULL;
+  if (!loadFace(engineA, src, 0, &faceA, &sharedFaceA)) {
+    return NULL;
   }
   codeToGIDA = (int *)gmallocn(256, sizeof(int));
-  for (i = 0; i < 256; ++i) {
-    codeToGIDA[i] = 0;
-    if ((name = encA[i])) {
-      codeToGIDA[i] = (int)FT_Get_Name_Index(faceA, (char *)name);
-      if (codeToGIDA[i] == 0) {
-	name = GfxFont::getAlternateName(name);
-	if (name) {
-	  codeToGIDA[i] = FT_Get_Name_Index(faceA, (char *)name);
+  {
+    SplashFTFaceLocker locker(sharedFaceA);
+    for (i = 0; i < 256; ++i) {
+      codeToGIDA[i] = 0;
+      if ((name = encA[i])) {
+	codeToGIDA[i] = (int)FT_Get_Name_Index(faceA, (char *)name);
+	if (codeToGIDA[i] == 0) {
+	  name = GfxFont::getAlternateName(name);
+	  if (name) {
+	    codeToGIDA[i] = FT_Get_Name_Index(faceA, (char *)name);
+	  }
 	}
       }
     }
   }
 
   return new SplashFTFontFile(engineA, idA, src,
-			      faceA, codeToGIDA, 256, gFalse, gTrue);
+			      faceA, sharedFaceA, codeToGIDA, 256,
+			      gFalse, gTrue);
 }
 
 SplashFontFile *SplashFTFontFile::loadCIDFont(SplashFTFontEngine *engineA,
@@ -78,17 +82,15 @@ SplashFontFile *SplashFTFontFile::loadCIDFont(SplashFTFontEngine *engineA,
 					      int *codeToGIDA,
 					      int codeToGIDLenA) {
   FT_Face faceA;
+  SplashFTSharedFace *sharedFaceA;
 
-  if (src->isFile) {
-    if (FT_New_Face(engineA->lib, src->fileName->getCString(), 0, &faceA))
-      return NULL;
-  } else {
-    if (FT_New_Memory_Face(engineA->lib, (const FT_Byte *)src->buf, src->bufLen, 0, &faceA))
-      return NULL;
+  if (!loadFace(engineA, src, 0, &faceA, &sharedFaceA)) {
+    return NULL;
   }
 
   return new SplashFTFontFile(engineA, idA, src,
-			      faceA, codeToGIDA, codeToGIDLenA, gFalse, gFalse);
+			      faceA, sharedFaceA, codeToGIDA, codeToGIDLenA,
+			      gFalse, gFalse);
 }
 
 SplashFontFile *SplashFTFontFile::loadTrueTypeFont(SplashFTFontEngine *engineA,
@@ -98,37 +100,89 @@ SplashFontFile *SplashFTFontFile::loadTrueTypeFont(SplashFTFontEngine *engineA,
 						   int codeToGIDLenA,
 						   int faceIndexA) {
   FT_Face faceA;
+  SplashFTSharedFace *sharedFaceA;
 
-  if (src->isFile) {
-    if (FT_New_Face(engineA->lib, src->fileName->getCString(), faceIndexA, &faceA))
-      return NULL;
-  } else {
-    if (FT_New_Memory_Face(engineA->lib, (const FT_Byte *)src->buf, src->bufLen, faceIndexA, &faceA))
-      return NULL;
+  if (!loadFace(engineA, src, faceIndexA, &faceA, &sharedFaceA)) {
+    return NULL;
   }
 
   return new SplashFTFontFile(engineA, idA, src,
-			      faceA, codeToGIDA, codeToGIDLenA, gTrue, gFalse);
+			      faceA, sharedFaceA, codeToGIDA, codeToGIDLenA,
+			      gTrue, gFalse);
+}
+
+// Load the face <faceIndex> of <src>: embedded fonts come from the
+// SplashFTFacePool when it is enabled, everything else is loaded into
+// the engine's library.
+GBool SplashFTFontFile::loadFace(SplashFTFontEngine *engineA,
+				 SplashFontSrc *src, int faceIndex,
+				 FT_Face *faceA,
+				 SplashFTSharedFace **sharedFaceA) {
+  SplashFTFacePool *pool;
+
+  *sharedFaceA = NULL;
+  if (src->isFile) {
+    return !FT_New_Face(engineA->lib, src->fileName->getCString(), faceIndex,
+			faceA);
+  }
+  pool = SplashFTFacePool::getPool();
+  if (pool->isEnabled() &&
+      (*sharedFaceA = pool->getFace(src->buf, src->bufLen, src->getHash(),
+				    faceIndex))) {
+    *faceA = (*sharedFaceA)->getFace();
+    return gTrue;
+  }
+  return !FT_New_Memory_Face(engineA->lib, (const FT_Byte *)src->buf,
+			     src->bufLen, faceIndex, faceA);
 }
 
 SplashFTFontFile::SplashFTFontFile(SplashFTFontEngine *engineA,
 				   SplashFontFileID *idA,
 				   SplashFontSrc *src,
 				   FT_Face faceA,
+				   SplashFTSharedFace *sharedFaceA,
 				   int *codeToGIDA, int codeToGIDLenA,
 				   GBool trueTypeA, GBool type1A):
   SplashFontFile(idA, src)
 {
   engine = engineA;
   face = faceA;
+  sharedFace = sharedFaceA;
   codeToGID = codeToGIDA;
   codeToGIDLen = codeToGIDLenA;
   trueType = trueTypeA;
   type1 = type1A;
+  if (SplashGlyphCache::getCache()->isEnabled()) {
+    registerGlyphCacheFont();
+  }
+}
+
+// The glyphs depend on the font data, the face in it, the mapping from
+// char codes to glyph IDs, and the FreeType load flags.
+void SplashFTFontFile::registerGlyphCacheFont() {
+  int *params;
+  int nParams;
+
+  nParams = 6 + (codeToGID ? codeToGIDLen : 0);
+  params = (int *)gmallocn(nParams, sizeof(int));
+  params[0] = (int)face->face_index;
+  params[1] = trueType;
+  params[2] = type1;
+  params[3] = engine->enableFreeTypeHinting;
+  params[4] = engine->enableSlightHinting;
+  params[5] = codeToGID ? codeToGIDLen : -1;
+  if (codeToGID) {
+    memcpy(params + 6, codeToGID, codeToGIDLen * sizeof(int));
+  }
+  glyphCacheFont = SplashGlyphCache::getCache()->getFont(
+		       src, params, nParams * (int)sizeof(int));
+  gfree(params);
 }
 
 SplashFTFontFile::~SplashFTFontFile() {
-  if (face) {
+  if (sharedFace) {
+    SplashFTFacePool::getPool()->releaseFace(sharedFace);
+  } else if (face) {
     FT_Done_Face(face);
   }
   if (codeToGID) {
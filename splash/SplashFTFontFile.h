@@ -33,6 +33,7 @@
 
 class SplashFontFileID;
 class SplashFTFontEngine;
+class SplashFTSharedFace;
 
 //------------------------------------------------------------------------
 // SplashFTFontFile
@@ -67,12 +68,18 @@ private:
   SplashFTFontFile(SplashFTFontEngine *engineA,
 		   SplashFontFileID *idA,
 		   SplashFontSrc *src,
-		   FT_Face faceA,
+		   FT_Face faceA, SplashFTSharedFace *sharedFaceA,
 		   int *codeToGIDA, int codeToGIDLenA,
 		   GBool trueTypeA, GBool type1A);
+  static GBool loadFace(SplashFTFontEngine *engineA, SplashFontSrc *src,
+			int faceIndex, FT_Face *faceA,
+			SplashFTSharedFace **sharedFaceA);
+  void registerGlyphCacheFont();
 
   SplashFTFontEngine *engine;
   FT_Face face;
+  SplashFTSharedFace *sharedFace;	// pooled face, or NULL if face is
+					//   private to this font file
   int *codeToGID;
   int codeToGIDLen;
   GBool trueType;
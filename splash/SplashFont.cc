@@ -29,6 +29,7 @@
 #include "goo/gmem.h"
 #include "SplashMath.h"
 #include "SplashGlyphBitmap.h"
+#include "SplashGlyphCache.h"
 #include "SplashFontFile.h"
 #include "SplashFont.h"
 
@@ -122,6 +123,8 @@ SplashFont::~SplashFont() {
 GBool SplashFont::getGlyph(int c, int xFrac, int yFrac,
 			   SplashGlyphBitmap *bitmap, int x0, int y0, SplashClip *clip, SplashClipResult *clipRes) {
   SplashGlyphBitmap bitmap2;
+  SplashGlyphCache *sharedCache;
+  SplashGlyphCacheKey key;
   int size;
   Guchar *p;
   int i, j, k;
@@ -155,18 +158,46 @@ GBool SplashFont::getGlyph(int c, int xFrac, int yFrac,
       bitmap->data = cache + (i+j) * glyphSize;
       bitmap->freeData = gFalse;
 
-      *clipRes = clip->testRect(x0 - bitmap->x,
-                                y0 - bitmap->y,
-                                x0 - bitmap->x + bitmap->w - 1,
-                                y0 - bitmap->y + bitmap->h - 1);
+      *clipRes = clip ? clip->testRect(x0 - bitmap->x,
+                                       y0 - bitmap->y,
+                                       x0 - bitmap->x + bitmap->w - 1,
+                                       y0 - bitmap->y + bitmap->h - 1)
+                      : splashClipAllInside;
 
       return gTrue;
     }
   }
 
+  // check the process-wide cache
+  sharedCache = NULL;
+  if (fontFile->getGlyphCacheID() &&
+      SplashGlyphCache::getCache()->isEnabled()) {
+    sharedCache = SplashGlyphCache::getCache();
+    key.fontID = fontFile->getGlyphCacheID();
+    key.mat[0] = mat[0];
+    key.mat[1] = mat[1];
+    key.mat[2] = mat[2];
+    key.mat[3] = mat[3];
+    key.c = c;
+    key.xFrac = (short)xFrac;
+    key.yFrac = (short)yFrac;
+    key.aa = aa;
+  }
+  if (sharedCache && sharedCache->lookup(&key, &bitmap2)) {
+    *clipRes = clip ? clip->testRect(x0 - bitmap2.x,
+                                     y0 - bitmap2.y,
+                                     x0 - bitmap2.x + bitmap2.w - 1,
+                                     y0 - bitmap2.y + bitmap2.h - 1)
+                    : splashClipAllInside;
+
   // generate the glyph bitmap
-  if (!makeGlyph(c, xFrac, yFrac, &bitmap2, x0, y0, clip, clipRes)) {
-    return gFalse;
+  } else {
+    if (!makeGlyph(c, xFrac, yFrac, &bitmap2, x0, y0, clip, clipRes)) {
+      return gFalse;
+    }
+    if (sharedCache && *clipRes != splashClipAllOutside) {
+      sharedCache->put(&key, &bitmap2);
+    }
   }
 
   if (*clipRes == splashClipAllOutside)
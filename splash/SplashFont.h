@@ -77,7 +77,9 @@ public:
   // the numerators of fractions in [0, 1), where the denominator is
   // splashFontFraction = 1 << splashFontFractionBits.  Subclasses
   // should override this to zero out xFrac and/or yFrac if they don't
-  // support fractional coordinates.
+  // support fractional coordinates.  The glyph is tested against <clip>,
+  // unless it is NULL: then <clipRes> is set to splashClipAllInside and
+  // the caller does the clipping.
   virtual GBool getGlyph(int c, int xFrac, int yFrac,
 			 SplashGlyphBitmap *bitmap, int x0, int y0, SplashClip *clip, SplashClipResult *clipRes);
 
@@ -26,13 +26,17 @@
 #endif
 
 #include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
 #include "goo/gmem.h"
+#include "goo/gfile.h"
 #include "goo/GooString.h"
 #include "SplashFontFile.h"
 #include "SplashFontFileID.h"
+#include "SplashGlyphCache.h"
 
 #ifdef VMS
 #if (__VMS_VER < 70000000)
@@ -49,14 +53,22 @@ SplashFontFile::SplashFontFile(SplashFontFileID *idA, SplashFontSrc *srcA) {
   src = srcA;
   src->ref();
   refCnt = 0;
+  glyphCacheFont = NULL;
   doAdjustMatrix = gFalse;
 }
 
 SplashFontFile::~SplashFontFile() {
+  if (glyphCacheFont) {
+    SplashGlyphCache::getCache()->releaseFont(glyphCacheFont);
+  }
   src->unref();
   delete id;
 }
 
+unsigned long long SplashFontFile::getGlyphCacheID() {
+  return glyphCacheFont ? SplashGlyphCache::getFontID(glyphCacheFont) : 0;
+}
+
 void SplashFontFile::incRefCnt() {
   ++refCnt;
 }
@@ -75,6 +87,8 @@ SplashFontSrc::SplashFontSrc() {
   fileName = NULL;
   buf = NULL;
   refcnt = 1;
+  hash = 0;
+  hashOk = gFalse;
 }
 
 SplashFontSrc::~SplashFontSrc() {
@@ -122,3 +136,41 @@ void SplashFontSrc::setBuf(char *bufA, int bufLenA, GBool del)
   bufLen = bufLenA;
   deleteSrc = del;
 }
+
+unsigned long long SplashFontSrc::getHash() {
+  GooString *ident;
+
+  if (hashOk) {
+    return hash;
+  }
+  hash = splashFontHashInit;
+  if (isFile) {
+    ident = new GooString();
+    if (!getFileIdent(ident)) {
+      ident->append(fileName);
+    }
+    hash = splashFontHash(hash, ident->getCString(), ident->getLength());
+    delete ident;
+  } else if (buf) {
+    hash = splashFontHash(hash, buf, bufLen);
+  }
+  hashOk = gTrue;
+  return hash;
+}
+
+GBool SplashFontSrc::getFileIdent(GooString *ident) {
+  struct stat st;
+  long long stamp[4];
+
+  if (!isFile || deleteSrc || stat(fileName->getCString(), &st) != 0) {
+    return gFalse;
+  }
+  stamp[0] = (long long)st.st_size;
+  stamp[1] = (long long)st.st_mtime;
+  stamp[2] = (long long)st.st_dev;
+  stamp[3] = (long long)st.st_ino;
+  ident->append(fileName);
+  ident->append('\0');
+  ident->append((const char *)stamp, sizeof(stamp));
+  return gTrue;
+}
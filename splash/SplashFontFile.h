@@ -33,6 +33,24 @@ class GooString;
 class SplashFontEngine;
 class SplashFont;
 class SplashFontFileID;
+struct SplashGlyphCacheFont;
+
+//------------------------------------------------------------------------
+
+// 64-bit FNV-1a, used to identify font data and font files.
+#define splashFontHashInit 14695981039346656037ULL
+
+static inline unsigned long long splashFontHash(unsigned long long h,
+						const void *data, int len) {
+  const Guchar *p;
+  int i;
+
+  p = (const Guchar *)data;
+  for (i = 0; i < len; ++i) {
+    h = (h ^ p[i]) * 1099511628211ULL;
+  }
+  return h;
+}
 
 //------------------------------------------------------------------------
 // SplashFontFile
@@ -49,6 +67,16 @@ public:
   void ref();
   void unref();
 
+  // Return a hash identifying the font data, computed on the first
+  // call: a hash of the buffer, or of the file identity (see
+  // getFileIdent()) for files, whose contents aren't read.
+  unsigned long long getHash();
+
+  // Append the identity of the font file to <ident>: its path, size and
+  // modification time.  Returns false for buffers, for temporary files,
+  // whose names get reused, and for files that can't be stat'ed.
+  GBool getFileIdent(GooString *ident);
+
   GBool isFile;
   GooString *fileName;
   char *buf;
@@ -58,6 +86,8 @@ private:
   ~SplashFontSrc();
   int refcnt;
   GBool deleteSrc;
+  unsigned long long hash;
+  GBool hashOk;
 };
 
 class SplashFontFile {
@@ -72,6 +102,11 @@ public:
   // Get the font file ID.
   SplashFontFileID *getID() { return id; }
 
+  // Get the ID identifying the glyphs of this font file in the
+  // SplashGlyphCache, or 0 if they aren't shared there.  Font files with
+  // the same ID rasterize every glyph identically.
+  unsigned long long getGlyphCacheID();
+
   // Increment the reference count.
   void incRefCnt();
 
@@ -88,6 +123,8 @@ protected:
   SplashFontFileID *id;
   SplashFontSrc *src;
   int refCnt;
+  SplashGlyphCacheFont *glyphCacheFont;	// identity in the
+					//   SplashGlyphCache, or NULL
 
   friend class SplashFontEngine;
 };
@@ -0,0 +1,518 @@
+//========================================================================
+//
+// SplashGlyphCache.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <string.h>
+#include "goo/gmem.h"
+#include "goo/GooString.h"
+#include "SplashFontFile.h"
+#include "SplashGlyphBitmap.h"
+#include "SplashGlyphCache.h"
+
+//------------------------------------------------------------------------
+
+#define splashGlyphCacheShardBits 4
+#define splashGlyphCacheShards (1 << splashGlyphCacheShardBits)
+
+#define splashGlyphCacheFontTableSize 256
+
+struct SplashGlyphCacheEntry {
+  SplashGlyphCacheKey key;
+  Guint hash;
+  int x, y, w, h;		// offset and size of the glyph
+  int size;			// size of the glyph data, in bytes
+  SplashGlyphCacheEntry *hashNext;	// next entry in the hash bucket
+  SplashGlyphCacheEntry *lruPrev;	// more recently used entry
+  SplashGlyphCacheEntry *lruNext;	// less recently used entry
+  // followed by the glyph data
+
+  Guchar *getData() { return (Guchar *)(this + 1); }
+  Goffset getCost() { return (Goffset)sizeof(SplashGlyphCacheEntry) + size; }
+};
+
+struct SplashGlyphCacheFont {
+  unsigned long long hash;
+  unsigned long long id;
+  char *params;			// copy of the rasterizer parameters
+  int paramsLen;
+  char *data;			// copy of the font data, or the identity
+				//   of the font file
+  int dataLen;
+  int refCnt;			// number of font files using it
+  SplashGlyphCacheFont *hashNext;	// next identity in the hash bucket
+  SplashGlyphCacheFont *lruPrev;	// more recently released unused
+					//   identity
+  SplashGlyphCacheFont *lruNext;	// less recently released unused
+					//   identity
+};
+
+//------------------------------------------------------------------------
+// SplashGlyphCache
+//------------------------------------------------------------------------
+
+// The cache is created on first use, and never destroyed: font engines
+// in any thread may use it until the process exits.
+SplashGlyphCache *SplashGlyphCache::getCache() {
+  static SplashGlyphCache *cache = new SplashGlyphCache();
+
+  return cache;
+}
+
+SplashGlyphCache::SplashGlyphCache() {
+  Shard *shard;
+  int i;
+
+  shards = (Shard *)gmallocn(splashGlyphCacheShards, sizeof(Shard));
+  for (i = 0; i < splashGlyphCacheShards; ++i) {
+    shard = &shards[i];
+    shard->tableSize = 64;
+    shard->table = (SplashGlyphCacheEntry **)
+                       gmallocn(shard->tableSize,
+				sizeof(SplashGlyphCacheEntry *));
+    memset(shard->table, 0,
+	   shard->tableSize * sizeof(SplashGlyphCacheEntry *));
+    shard->nEntries = 0;
+    shard->lruFirst = shard->lruLast = NULL;
+    shard->bytes = 0;
+    shard->hits = shard->misses = shard->evictions = 0;
+#if MULTITHREADED
+    gInitMutex(&shard->mutex);
+#endif
+  }
+  maxBytes = 0;
+
+  fontTable = (SplashGlyphCacheFont **)
+                  gmallocn(splashGlyphCacheFontTableSize,
+			   sizeof(SplashGlyphCacheFont *));
+  memset(fontTable, 0,
+	 splashGlyphCacheFontTableSize * sizeof(SplashGlyphCacheFont *));
+  fontLruFirst = fontLruLast = NULL;
+  unusedFontBytes = 0;
+  nFonts = 0;
+  nextFontID = 1;
+#if MULTITHREADED
+  gInitMutex(&fontMutex);
+#endif
+}
+
+Guint SplashGlyphCache::hashKey(SplashGlyphCacheKey *key) {
+  Guchar buf[sizeof(key->fontID) + sizeof(key->mat) + 3 * sizeof(int)];
+  Guint h;
+  int n, i;
+
+  // hash the fields rather than the struct, which has padding
+  n = 0;
+  memcpy(buf + n, &key->fontID, sizeof(key->fontID));
+  n += sizeof(key->fontID);
+  memcpy(buf + n, key->mat, sizeof(key->mat));
+  n += sizeof(key->mat);
+  memcpy(buf + n, &key->c, sizeof(int));
+  n += sizeof(int);
+  i = (key->xFrac << 16) | (key->yFrac << 1) | (key->aa ? 1 : 0);
+  memcpy(buf + n, &i, sizeof(int));
+  n += sizeof(int);
+
+  // FNV-1a
+  h = 2166136261u;
+  for (i = 0; i < n; ++i) {
+    h = (h ^ buf[i]) * 16777619u;
+  }
+  return h;
+}
+
+GBool SplashGlyphCache::keysMatch(SplashGlyphCacheKey *key1,
+				  SplashGlyphCacheKey *key2) {
+  return key1->fontID == key2->fontID &&
+         key1->c == key2->c &&
+         key1->xFrac == key2->xFrac && key1->yFrac == key2->yFrac &&
+         key1->aa == key2->aa &&
+         key1->mat[0] == key2->mat[0] && key1->mat[1] == key2->mat[1] &&
+         key1->mat[2] == key2->mat[2] && key1->mat[3] == key2->mat[3];
+}
+
+SplashGlyphCache::Shard *SplashGlyphCache::getShard(Guint h) {
+  return &shards[h & (splashGlyphCacheShards - 1)];
+}
+
+void SplashGlyphCache::setMaxBytes(Goffset maxBytesA) {
+  int i;
+
+  maxBytes = maxBytesA > 0 ? maxBytesA : 0;
+  for (i = 0; i < splashGlyphCacheShards; ++i) {
+#if MULTITHREADED
+    MutexLocker locker(&shards[i].mutex);
+#endif
+    evict(&shards[i], maxBytes / splashGlyphCacheShards);
+  }
+#if MULTITHREADED
+  MutexLocker locker(&fontMutex);
+#endif
+  evictFonts(maxBytes / 4);
+}
+
+GBool SplashGlyphCache::lookup(SplashGlyphCacheKey *key,
+			       SplashGlyphBitmap *bitmap) {
+  SplashGlyphCacheEntry *e;
+  Shard *shard;
+  Guint h;
+
+  h = hashKey(key);
+  shard = getShard(h);
+#if MULTITHREADED
+  MutexLocker locker(&shard->mutex);
+#endif
+  for (e = shard->table[(h >> splashGlyphCacheShardBits) &
+			(shard->tableSize - 1)];
+       e;
+       e = e->hashNext) {
+    if (e->hash == h && keysMatch(&e->key, key)) {
+      break;
+    }
+  }
+  if (!e) {
+    ++shard->misses;
+    return gFalse;
+  }
+  ++shard->hits;
+
+  // move it to the front of the LRU list
+  if (e != shard->lruFirst) {
+    e->lruPrev->lruNext = e->lruNext;
+    if (e->lruNext) {
+      e->lruNext->lruPrev = e->lruPrev;
+    } else {
+      shard->lruLast = e->lruPrev;
+    }
+    e->lruPrev = NULL;
+    e->lruNext = shard->lruFirst;
+    shard->lruFirst->lruPrev = e;
+    shard->lruFirst = e;
+  }
+
+  bitmap->x = e->x;
+  bitmap->y = e->y;
+  bitmap->w = e->w;
+  bitmap->h = e->h;
+  bitmap->aa = key->aa;
+  bitmap->data = (Guchar *)gmalloc(e->size);
+  memcpy(bitmap->data, e->getData(), e->size);
+  bitmap->freeData = gTrue;
+  return gTrue;
+}
+
+void SplashGlyphCache::put(SplashGlyphCacheKey *key,
+			   SplashGlyphBitmap *bitmap) {
+  SplashGlyphCacheEntry *e, **p;
+  Shard *shard;
+  Goffset limit;
+  Guint h;
+  int size;
+
+  if (bitmap->aa) {
+    size = bitmap->w * bitmap->h;
+  } else {
+    size = ((bitmap->w + 7) >> 3) * bitmap->h;
+  }
+  limit = maxBytes / splashGlyphCacheShards;
+  if (size <= 0 ||
+      (Goffset)sizeof(SplashGlyphCacheEntry) + size > limit) {
+    return;
+  }
+
+  h = hashKey(key);
+  shard = getShard(h);
+#if MULTITHREADED
+  MutexLocker locker(&shard->mutex);
+#endif
+
+  // another thread may have added it in the meantime
+  p = &shard->table[(h >> splashGlyphCacheShardBits) &
+		    (shard->tableSize - 1)];
+  for (e = *p; e; e = e->hashNext) {
+    if (e->hash == h && keysMatch(&e->key, key)) {
+      return;
+    }
+  }
+
+  evict(shard, limit - ((Goffset)sizeof(SplashGlyphCacheEntry) + size));
+
+  e = (SplashGlyphCacheEntry *)gmalloc(sizeof(SplashGlyphCacheEntry) + size);
+  e->key = *key;
+  e->hash = h;
+  e->x = bitmap->x;
+  e->y = bitmap->y;
+  e->w = bitmap->w;
+  e->h = bitmap->h;
+  e->size = size;
+  memcpy(e->getData(), bitmap->data, size);
+  p = &shard->table[(h >> splashGlyphCacheShardBits) &
+		    (shard->tableSize - 1)];
+  e->hashNext = *p;
+  *p = e;
+  e->lruPrev = NULL;
+  e->lruNext = shard->lruFirst;
+  if (shard->lruFirst) {
+    shard->lruFirst->lruPrev = e;
+  } else {
+    shard->lruLast = e;
+  }
+  shard->lruFirst = e;
+  shard->bytes += e->getCost();
+  if (++shard->nEntries > shard->tableSize) {
+    grow(shard);
+  }
+}
+
+// Remove <e> from the hash table and the LRU list of <shard>, without
+// freeing it.
+void SplashGlyphCache::unlink(Shard *shard, SplashGlyphCacheEntry *e) {
+  SplashGlyphCacheEntry **p;
+
+  for (p = &shard->table[(e->hash >> splashGlyphCacheShardBits) &
+			 (shard->tableSize - 1)];
+       *p != e;
+       p = &(*p)->hashNext) ;
+  *p = e->hashNext;
+  if (e->lruPrev) {
+    e->lruPrev->lruNext = e->lruNext;
+  } else {
+    shard->lruFirst = e->lruNext;
+  }
+  if (e->lruNext) {
+    e->lruNext->lruPrev = e->lruPrev;
+  } else {
+    shard->lruLast = e->lruPrev;
+  }
+  shard->bytes -= e->getCost();
+  --shard->nEntries;
+}
+
+// Evict the least recently used glyphs of <shard> until it uses at most
+// <limit> bytes.
+void SplashGlyphCache::evict(Shard *shard, Goffset limit) {
+  SplashGlyphCacheEntry *e;
+
+  while (shard->bytes > limit && (e = shard->lruLast)) {
+    unlink(shard, e);
+    gfree(e);
+    ++shard->evictions;
+  }
+}
+
+void SplashGlyphCache::grow(Shard *shard) {
+  SplashGlyphCacheEntry **oldTable, *e, *next, **p;
+  int oldSize, i;
+
+  oldTable = shard->table;
+  oldSize = shard->tableSize;
+  shard->tableSize *= 2;
+  shard->table = (SplashGlyphCacheEntry **)
+                     gmallocn(shard->tableSize,
+			      sizeof(SplashGlyphCacheEntry *));
+  memset(shard->table, 0,
+	 shard->tableSize * sizeof(SplashGlyphCacheEntry *));
+  for (i = 0; i < oldSize; ++i) {
+    for (e = oldTable[i]; e; e = next) {
+      next = e->hashNext;
+      p = &shard->table[(e->hash >> splashGlyphCacheShardBits) &
+			(shard->tableSize - 1)];
+      e->hashNext = *p;
+      *p = e;
+    }
+  }
+  gfree(oldTable);
+}
+
+SplashGlyphCacheFont *SplashGlyphCache::getFont(SplashFontSrc *src,
+						const void *params,
+						int paramsLen) {
+  SplashGlyphCacheFont *font, **p;
+  GooString *fileIdent;
+  const char *data;
+  unsigned long long h;
+  int dataLen;
+
+  if (!isEnabled()) {
+    return NULL;
+  }
+  fileIdent = NULL;
+  if (src->isFile) {
+    fileIdent = new GooString();
+    if (!src->getFileIdent(fileIdent)) {
+      delete fileIdent;
+      return NULL;
+    }
+    data = fileIdent->getCString();
+    dataLen = fileIdent->getLength();
+  } else if (src->buf) {
+    data = src->buf;
+    dataLen = src->bufLen;
+  } else {
+    return NULL;
+  }
+  h = splashFontHash(src->getHash(), params, paramsLen);
+
+#if MULTITHREADED
+  gLockMutex(&fontMutex);
+#endif
+  p = &fontTable[h & (splashGlyphCacheFontTableSize - 1)];
+  for (font = *p; font; font = font->hashNext) {
+    if (font->hash == h &&
+	font->paramsLen == paramsLen && font->dataLen == dataLen &&
+	!memcmp(font->params, params, paramsLen) &&
+	!memcmp(font->data, data, dataLen)) {
+      break;
+    }
+  }
+  if (font) {
+    if (font->refCnt++ == 0) {
+      // it was unused, take it off the LRU list
+      if (font->lruPrev) {
+	font->lruPrev->lruNext = font->lruNext;
+      } else {
+	fontLruFirst = font->lruNext;
+      }
+      if (font->lruNext) {
+	font->lruNext->lruPrev = font->lruPrev;
+      } else {
+	fontLruLast = font->lruPrev;
+      }
+      unusedFontBytes -= font->dataLen;
+    }
+  } else {
+    font = (SplashGlyphCacheFont *)gmalloc(sizeof(SplashGlyphCacheFont));
+    font->hash = h;
+    font->id = nextFontID++;
+    font->params = (char *)gmalloc(paramsLen > 0 ? paramsLen : 1);
+    memcpy(font->params, params, paramsLen);
+    font->paramsLen = paramsLen;
+    font->data = (char *)gmalloc(dataLen > 0 ? dataLen : 1);
+    memcpy(font->data, data, dataLen);
+    font->dataLen = dataLen;
+    font->refCnt = 1;
+    font->lruPrev = font->lruNext = NULL;
+    font->hashNext = *p;
+    *p = font;
+    ++nFonts;
+  }
+#if MULTITHREADED
+  gUnlockMutex(&fontMutex);
+#endif
+
+  delete fileIdent;
+  return font;
+}
+
+void SplashGlyphCache::releaseFont(SplashGlyphCacheFont *font) {
+#if MULTITHREADED
+  MutexLocker locker(&fontMutex);
+#endif
+  if (--font->refCnt == 0) {
+    font->lruPrev = NULL;
+    font->lruNext = fontLruFirst;
+    if (fontLruFirst) {
+      fontLruFirst->lruPrev = font;
+    } else {
+      fontLruLast = font;
+    }
+    fontLruFirst = font;
+    unusedFontBytes += font->dataLen;
+    evictFonts(maxBytes / 4);
+  }
+}
+
+unsigned long long SplashGlyphCache::getFontID(SplashGlyphCacheFont *font) {
+  return font->id;
+}
+
+// Remove the unused identity <font> from the hash table and the LRU
+// list, without freeing it.  Must be called with the font lock held.
+void SplashGlyphCache::unlinkFont(SplashGlyphCacheFont *font) {
+  SplashGlyphCacheFont **p;
+
+  for (p = &fontTable[font->hash & (splashGlyphCacheFontTableSize - 1)];
+       *p != font;
+       p = &(*p)->hashNext) ;
+  *p = font->hashNext;
+  if (font->lruPrev) {
+    font->lruPrev->lruNext = font->lruNext;
+  } else {
+    fontLruFirst = font->lruNext;
+  }
+  if (font->lruNext) {
+    font->lruNext->lruPrev = font->lruPrev;
+  } else {
+    fontLruLast = font->lruPrev;
+  }
+  unusedFontBytes -= font->dataLen;
+  --nFonts;
+}
+
+// Drop the least recently released unused identities until their data
+// takes at most <limit> bytes.  Must be called with the font lock held.
+void SplashGlyphCache::evictFonts(Goffset limit) {
+  SplashGlyphCacheFont *font;
+
+  while (unusedFontBytes > limit && (font = fontLruLast)) {
+    unlinkFont(font);
+    gfree(font->params);
+    gfree(font->data);
+    gfree(font);
+  }
+}
+
+void SplashGlyphCache::clear() {
+  SplashGlyphCacheEntry *e;
+  int i;
+
+  for (i = 0; i < splashGlyphCacheShards; ++i) {
+#if MULTITHREADED
+    MutexLocker locker(&shards[i].mutex);
+#endif
+    while ((e = shards[i].lruFirst)) {
+      shards[i].lruFirst = e->lruNext;
+      gfree(e);
+    }
+    shards[i].lruLast = NULL;
+    memset(shards[i].table, 0,
+	   shards[i].tableSize * sizeof(SplashGlyphCacheEntry *));
+    shards[i].nEntries = 0;
+    shards[i].bytes = 0;
+  }
+#if MULTITHREADED
+  MutexLocker locker(&fontMutex);
+#endif
+  evictFonts(0);
+}
+
+void SplashGlyphCache::getStats(SplashGlyphCacheStats *stats) {
+  int i;
+
+  stats->hits = stats->misses = stats->evictions = 0;
+  stats->bytes = 0;
+  stats->nGlyphs = 0;
+  for (i = 0; i < splashGlyphCacheShards; ++i) {
+#if MULTITHREADED
+    MutexLocker locker(&shards[i].mutex);
+#endif
+    stats->hits += shards[i].hits;
+    stats->misses += shards[i].misses;
+    stats->evictions += shards[i].evictions;
+    stats->bytes += shards[i].bytes;
+    stats->nGlyphs += shards[i].nEntries;
+  }
+#if MULTITHREADED
+  MutexLocker locker(&fontMutex);
+#endif
+  stats->nFonts = nFonts;
+}
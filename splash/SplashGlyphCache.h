@@ -0,0 +1,153 @@
+//========================================================================
+//
+// SplashGlyphCache.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef SPLASHGLYPHCACHE_H
+#define SPLASHGLYPHCACHE_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include "poppler-config.h"
+#include "goo/gtypes.h"
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
+#include "SplashTypes.h"
+
+class SplashFontSrc;
+struct SplashGlyphBitmap;
+struct SplashGlyphCacheEntry;
+struct SplashGlyphCacheFont;
+
+//------------------------------------------------------------------------
+
+struct SplashGlyphCacheStats {
+  Gulong hits;			// lookups that found their glyph
+  Gulong misses;		// lookups that didn't
+  Gulong evictions;		// glyphs dropped to stay within the budget
+  Goffset bytes;		// total size of the cached glyphs
+  int nGlyphs;			// number of cached glyphs
+  int nFonts;			// number of font identities
+};
+
+// Identifies a rasterized glyph.
+struct SplashGlyphCacheKey {
+  unsigned long long fontID;	// SplashGlyphCache::getFontID()
+  SplashCoord mat[4];		// font transform matrix
+  int c;			// char code
+  short xFrac, yFrac;		// fractional position
+  GBool aa;			// anti-aliasing
+};
+
+//------------------------------------------------------------------------
+// SplashGlyphCache
+//
+// Process-wide cache of glyph bitmaps, shared by all SplashFontEngines.
+// Each SplashFont keeps a small cache of its own; this one is consulted
+// when a glyph isn't there, before rasterizing it, so that threads and
+// output devices rendering the same fonts rasterize each glyph once.
+//
+// Font files register their identity with the cache: the font data and
+// everything else that affects how their glyphs are rasterized.  Fonts
+// with equal identities get the same ID, and share their glyphs.  The
+// identities are compared in full, not only by hash: embedded font data
+// byte for byte, font files on disk by path, size and modification
+// time.  The cache keeps a copy of the data of embedded fonts for this;
+// identities no font file uses any more are kept, so that documents
+// opened later find their glyphs, and dropped least recently released
+// first when their data exceeds a quarter of the limit.  IDs are never
+// reused, the glyphs of a dropped identity just age out.
+//
+// The cache is limited to a number of bytes of glyph data, evicting the
+// least recently used glyphs first, and is disabled while the limit is
+// 0, which is the default.  It is split into shards by key, each with
+// its own lock and a share of the budget.
+//------------------------------------------------------------------------
+
+class SplashGlyphCache {
+public:
+
+  // Return the process-wide cache.
+  static SplashGlyphCache *getCache();
+
+  // Set the size limit, in bytes, evicting glyphs as needed.  A limit
+  // of 0 disables the cache and empties it.
+  void setMaxBytes(Goffset maxBytesA);
+
+  GBool isEnabled() { return maxBytes > 0; }
+
+  // Look up the glyph for <key>.  On a hit, fill in <bitmap> with a
+  // copy of the glyph, which the caller must free (bitmap->freeData is
+  // set).
+  GBool lookup(SplashGlyphCacheKey *key, SplashGlyphBitmap *bitmap);
+
+  // Add a copy of <bitmap> for <key>.
+  void put(SplashGlyphCacheKey *key, SplashGlyphBitmap *bitmap);
+
+  // Return a reference to the identity of a font file whose glyphs are
+  // determined by <src> and the <paramsLen> bytes at <params> (face
+  // index, char code mapping, rasterizer flags, ...).  Returns NULL if
+  // the cache is disabled or the font file can't be identified.
+  SplashGlyphCacheFont *getFont(SplashFontSrc *src,
+				const void *params, int paramsLen);
+
+  // Drop a reference returned by getFont().
+  void releaseFont(SplashGlyphCacheFont *font);
+
+  // Return the ID of <font>, for SplashGlyphCacheKey::fontID.
+  static unsigned long long getFontID(SplashGlyphCacheFont *font);
+
+  // Drop all glyphs, and the identities no font file uses.
+  void clear();
+
+  void getStats(SplashGlyphCacheStats *stats);
+
+private:
+
+  struct Shard {
+    SplashGlyphCacheEntry **table;	// hash table, a power of two
+    int tableSize;
+    int nEntries;
+    SplashGlyphCacheEntry *lruFirst;	// most recently used glyph
+    SplashGlyphCacheEntry *lruLast;	// least recently used glyph
+    Goffset bytes;
+    Gulong hits, misses, evictions;
+#if MULTITHREADED
+    GooMutex mutex;
+#endif
+  };
+
+  SplashGlyphCache();
+  static Guint hashKey(SplashGlyphCacheKey *key);
+  static GBool keysMatch(SplashGlyphCacheKey *key1,
+			 SplashGlyphCacheKey *key2);
+  Shard *getShard(Guint h);
+  void unlink(Shard *shard, SplashGlyphCacheEntry *e);
+  void evict(Shard *shard, Goffset limit);
+  void grow(Shard *shard);
+  void unlinkFont(SplashGlyphCacheFont *font);
+  void evictFonts(Goffset limit);
+
+  Shard *shards;
+  Goffset maxBytes;		// total limit, 0 if disabled
+
+  SplashGlyphCacheFont **fontTable;	// hash table of font identities
+  SplashGlyphCacheFont *fontLruFirst;	// most recently released unused
+					//   identity
+  SplashGlyphCacheFont *fontLruLast;	// least recently released unused
+					//   identity
+  Goffset unusedFontBytes;	// data size of the unused identities
+  int nFonts;
+  unsigned long long nextFontID;
+#if MULTITHREADED
+  GooMutex fontMutex;		// guards the font identities
+#endif
+};
+
+#endif
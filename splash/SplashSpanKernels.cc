@@ -0,0 +1,334 @@
+//========================================================================
+//
+// SplashSpanKernels.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include "SplashSpanKernels.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define SPLASH_SPAN_SSE2 1
+#endif
+
+// AVX2 code is compiled with a target attribute and only used when the
+// CPU supports it
+#if defined(SPLASH_SPAN_SSE2) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#include <immintrin.h>
+#define SPLASH_SPAN_AVX2 1
+#define avx2Target __attribute__((target("avx2")))
+#endif
+
+// Divide a 16-bit value (in [0, 255*255]) by 255, returning an 8-bit result.
+static inline int div255(int x) {
+  return (x + (x >> 8) + 0x80) >> 8;
+}
+
+//------------------------------------------------------------------------
+// portable versions
+//------------------------------------------------------------------------
+
+static void sourceAlphaScalar(Guchar aInput, Guchar *softMask,
+			      Guchar *shape, Guchar *aSrc, int n) {
+  int a, i;
+
+  for (i = 0; i < n; ++i) {
+    a = aInput;
+    if (softMask) {
+      a = div255(a * softMask[i]);
+    }
+    if (shape) {
+      a = div255(a * shape[i]);
+    }
+    aSrc[i] = (Guchar)a;
+  }
+}
+
+static void compositeScalar(Guchar *aSrc, Guchar *aDest, Guchar **comps,
+			    Guchar *cSrc, int nComps, int n) {
+  int a, d, aResult, c, i;
+
+  for (i = 0; i < n; ++i) {
+    a = aSrc[i];
+    d = aDest[i];
+    aResult = a + d - div255(a * d);
+    for (c = 0; c < nComps; ++c) {
+      if (aResult == 0) {
+	comps[c][i] = 0;
+      } else {
+	comps[c][i] = (Guchar)(((aResult - a) * comps[c][i] + a * cSrc[c]) /
+			       aResult);
+      }
+    }
+    aDest[i] = (Guchar)aResult;
+  }
+}
+
+//------------------------------------------------------------------------
+// SSE2 versions
+//------------------------------------------------------------------------
+
+#ifdef SPLASH_SPAN_SSE2
+
+// div255() on eight 16-bit lanes
+static inline __m128i div255x8(__m128i x) {
+  x = _mm_add_epi16(x, _mm_srli_epi16(x, 8));
+  x = _mm_add_epi16(x, _mm_set1_epi16(0x80));
+  return _mm_srli_epi16(x, 8);
+}
+
+static inline __m128i load8x8(Guchar *p) {
+  return _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *)p),
+			   _mm_setzero_si128());
+}
+
+static inline void store8x8(Guchar *p, __m128i x) {
+  _mm_storel_epi64((__m128i *)p, _mm_packus_epi16(x, x));
+}
+
+static void sourceAlphaSSE2(Guchar aInput, Guchar *softMask,
+			    Guchar *shape, Guchar *aSrc, int n) {
+  __m128i a;
+  int i;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    a = _mm_set1_epi16(aInput);
+    if (softMask) {
+      a = div255x8(_mm_mullo_epi16(a, load8x8(softMask + i)));
+    }
+    if (shape) {
+      a = div255x8(_mm_mullo_epi16(a, load8x8(shape + i)));
+    }
+    store8x8(aSrc + i, a);
+  }
+  if (i < n) {
+    sourceAlphaScalar(aInput, softMask ? softMask + i : (Guchar *)NULL,
+		      shape ? shape + i : (Guchar *)NULL, aSrc + i, n - i);
+  }
+}
+
+// The result color components are computed with single precision
+// divisions: the dividends are below 2^16 and the divisors below 256,
+// so truncating the rounded quotient gives the exact integer quotient.
+static void compositeSSE2(Guchar *aSrc, Guchar *aDest, Guchar **comps,
+			  Guchar *cSrc, int nComps, int n) {
+  __m128i zero, a, d, aResult, aRemain, isZero, num, qLo, qHi;
+  __m128 rLo, rHi;
+  int c, i;
+
+  zero = _mm_setzero_si128();
+  for (i = 0; i + 8 <= n; i += 8) {
+    a = load8x8(aSrc + i);
+    d = load8x8(aDest + i);
+    aResult = _mm_sub_epi16(_mm_add_epi16(a, d),
+			    div255x8(_mm_mullo_epi16(a, d)));
+    store8x8(aDest + i, aResult);
+    aRemain = _mm_sub_epi16(aResult, a);
+    isZero = _mm_cmpeq_epi16(aResult, zero);
+    rLo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(aResult, zero));
+    rHi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(aResult, zero));
+    for (c = 0; c < nComps; ++c) {
+      num = _mm_add_epi16(_mm_mullo_epi16(aRemain, load8x8(comps[c] + i)),
+			  _mm_mullo_epi16(a, _mm_set1_epi16(cSrc[c])));
+      qLo = _mm_cvttps_epi32(
+		_mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(num, zero)),
+			   rLo));
+      qHi = _mm_cvttps_epi32(
+		_mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(num, zero)),
+			   rHi));
+      store8x8(comps[c] + i,
+	       _mm_andnot_si128(isZero, _mm_packs_epi32(qLo, qHi)));
+    }
+  }
+  if (i < n) {
+    Guchar *tail[splashMaxColorComps];
+    for (c = 0; c < nComps; ++c) {
+      tail[c] = comps[c] + i;
+    }
+    compositeScalar(aSrc + i, aDest + i, tail, cSrc, nComps, n - i);
+  }
+}
+
+#endif // SPLASH_SPAN_SSE2
+
+//------------------------------------------------------------------------
+// AVX2 versions
+//------------------------------------------------------------------------
+
+#ifdef SPLASH_SPAN_AVX2
+
+// div255() on sixteen 16-bit lanes
+static inline avx2Target __m256i div255x16(__m256i x) {
+  x = _mm256_add_epi16(x, _mm256_srli_epi16(x, 8));
+  x = _mm256_add_epi16(x, _mm256_set1_epi16(0x80));
+  return _mm256_srli_epi16(x, 8);
+}
+
+// div255() on eight 32-bit lanes
+static inline avx2Target __m256i div255x8x32(__m256i x) {
+  x = _mm256_add_epi32(x, _mm256_srli_epi32(x, 8));
+  x = _mm256_add_epi32(x, _mm256_set1_epi32(0x80));
+  return _mm256_srli_epi32(x, 8);
+}
+
+static inline avx2Target __m256i load16x16(Guchar *p) {
+  return _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *)p));
+}
+
+static inline avx2Target void store16x16(Guchar *p, __m256i x) {
+  _mm_storeu_si128((__m128i *)p,
+		   _mm_packus_epi16(_mm256_castsi256_si128(x),
+				    _mm256_extracti128_si256(x, 1)));
+}
+
+static inline avx2Target __m256i load8x32(Guchar *p) {
+  return _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i *)p));
+}
+
+static inline avx2Target void store8x32(Guchar *p, __m256i x) {
+  __m128i x16;
+
+  x16 = _mm_packus_epi32(_mm256_castsi256_si128(x),
+			 _mm256_extracti128_si256(x, 1));
+  _mm_storel_epi64((__m128i *)p, _mm_packus_epi16(x16, x16));
+}
+
+static avx2Target void sourceAlphaAVX2(Guchar aInput, Guchar *softMask,
+				       Guchar *shape, Guchar *aSrc, int n) {
+  __m256i a;
+  int i;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    a = _mm256_set1_epi16(aInput);
+    if (softMask) {
+      a = div255x16(_mm256_mullo_epi16(a, load16x16(softMask + i)));
+    }
+    if (shape) {
+      a = div255x16(_mm256_mullo_epi16(a, load16x16(shape + i)));
+    }
+    store16x16(aSrc + i, a);
+  }
+  if (i < n) {
+    sourceAlphaSSE2(aInput, softMask ? softMask + i : (Guchar *)NULL,
+		    shape ? shape + i : (Guchar *)NULL, aSrc + i, n - i);
+  }
+}
+
+// Same as compositeSSE2, with eight single precision divisions at once.
+static avx2Target void compositeAVX2(Guchar *aSrc, Guchar *aDest,
+				     Guchar **comps, Guchar *cSrc,
+				     int nComps, int n) {
+  __m256i zero, a, d, aResult, aRemain, isZero, num, q;
+  __m256 r;
+  int c, i;
+
+  zero = _mm256_setzero_si256();
+  for (i = 0; i + 8 <= n; i += 8) {
+    a = load8x32(aSrc + i);
+    d = load8x32(aDest + i);
+    aResult = _mm256_sub_epi32(_mm256_add_epi32(a, d),
+			       div255x8x32(_mm256_mullo_epi32(a, d)));
+    store8x32(aDest + i, aResult);
+    aRemain = _mm256_sub_epi32(aResult, a);
+    isZero = _mm256_cmpeq_epi32(aResult, zero);
+    r = _mm256_cvtepi32_ps(aResult);
+    for (c = 0; c < nComps; ++c) {
+      num = _mm256_add_epi32(
+		_mm256_mullo_epi32(aRemain, load8x32(comps[c] + i)),
+		_mm256_mullo_epi32(a, _mm256_set1_epi32(cSrc[c])));
+      q = _mm256_cvttps_epi32(_mm256_div_ps(_mm256_cvtepi32_ps(num), r));
+      store8x32(comps[c] + i, _mm256_andnot_si256(isZero, q));
+    }
+  }
+  if (i < n) {
+    Guchar *tail[splashMaxColorComps];
+    for (c = 0; c < nComps; ++c) {
+      tail[c] = comps[c] + i;
+    }
+    compositeScalar(aSrc + i, aDest + i, tail, cSrc, nComps, n - i);
+  }
+}
+
+#endif // SPLASH_SPAN_AVX2
+
+//------------------------------------------------------------------------
+// dispatch
+//------------------------------------------------------------------------
+
+static GBool cpuHasAVX2() {
+#ifdef SPLASH_SPAN_AVX2
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") != 0;
+#else
+  return gFalse;
+#endif
+}
+
+GBool splashSpanGetKernels(SplashSpanKernelLevel level,
+			   SplashSpanSourceAlphaFunc *sourceAlpha,
+			   SplashSpanCompositeFunc *composite) {
+  switch (level) {
+  case splashSpanScalar:
+    *sourceAlpha = &sourceAlphaScalar;
+    *composite = &compositeScalar;
+    return gTrue;
+#ifdef SPLASH_SPAN_SSE2
+  case splashSpanSSE2:
+    *sourceAlpha = &sourceAlphaSSE2;
+    *composite = &compositeSSE2;
+    return gTrue;
+#endif
+#ifdef SPLASH_SPAN_AVX2
+  case splashSpanAVX2:
+    if (!cpuHasAVX2()) {
+      return gFalse;
+    }
+    *sourceAlpha = &sourceAlphaAVX2;
+    *composite = &compositeAVX2;
+    return gTrue;
+#endif
+  default:
+    return gFalse;
+  }
+}
+
+struct SplashSpanKernels {
+  SplashSpanKernels();
+  SplashSpanSourceAlphaFunc sourceAlpha;
+  SplashSpanCompositeFunc composite;
+};
+
+// Pick the best version the CPU supports.
+SplashSpanKernels::SplashSpanKernels() {
+  if (!splashSpanGetKernels(splashSpanAVX2, &sourceAlpha, &composite) &&
+      !splashSpanGetKernels(splashSpanSSE2, &sourceAlpha, &composite)) {
+    splashSpanGetKernels(splashSpanScalar, &sourceAlpha, &composite);
+  }
+}
+
+// The kernels are picked once, on first use; the compiler guards the
+// initialization of the static, so threads can race to get here.
+static SplashSpanKernels *getSpanKernels() {
+  static SplashSpanKernels kernels;
+
+  return &kernels;
+}
+
+void splashSpanSourceAlpha(Guchar aInput, Guchar *softMask, Guchar *shape,
+			   Guchar *aSrc, int n) {
+  (*getSpanKernels()->sourceAlpha)(aInput, softMask, shape, aSrc, n);
+}
+
+void splashSpanComposite(Guchar *aSrc, Guchar *aDest, Guchar **comps,
+			 Guchar *cSrc, int nComps, int n) {
+  (*getSpanKernels()->composite)(aSrc, aDest, comps, cSrc, nComps, n);
+}
@@ -0,0 +1,56 @@
+//========================================================================
+//
+// SplashSpanKernels.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef SPLASHSPANKERNELS_H
+#define SPLASHSPANKERNELS_H
+
+#include "SplashTypes.h"
+
+//------------------------------------------------------------------------
+// Span kernels used by the Splash compositing pipes.  They process a run
+// of pixels at once and give exactly the same results as the per-pixel
+// pipe functions.  SSE2 and AVX2 versions are picked at run time when the
+// CPU supports them, with a portable fallback.
+//------------------------------------------------------------------------
+
+// Compute the source alpha of <n> pixels:
+//   aSrc = aInput * softMask * shape
+// with each product rounded like div255() does.  <softMask> and <shape>
+// may be NULL.
+extern void splashSpanSourceAlpha(Guchar aInput, Guchar *softMask,
+				  Guchar *shape, Guchar *aSrc, int n);
+
+// Composite a solid color <cSrc> with source alpha <aSrc> onto <n>
+// destination pixels, using the Normal blend mode.  <aDest> is updated
+// with the result alpha.  <comps> holds <nComps> planar arrays with the
+// destination color components, which are replaced by the result color
+// components (before the transfer functions are applied).
+extern void splashSpanComposite(Guchar *aSrc, Guchar *aDest,
+				Guchar **comps, Guchar *cSrc, int nComps,
+				int n);
+
+// The versions of the kernels.
+enum SplashSpanKernelLevel {
+  splashSpanScalar,
+  splashSpanSSE2,
+  splashSpanAVX2
+};
+
+typedef void (*SplashSpanSourceAlphaFunc)(Guchar aInput, Guchar *softMask,
+					  Guchar *shape, Guchar *aSrc, int n);
+typedef void (*SplashSpanCompositeFunc)(Guchar *aSrc, Guchar *aDest,
+					Guchar **comps, Guchar *cSrc,
+					int nComps, int n);
+
+// Get the kernels of one version, for testing.  Returns false if
+// <level> isn't compiled in or isn't supported by the CPU.
+extern GBool splashSpanGetKernels(SplashSpanKernelLevel level,
+				  SplashSpanSourceAlphaFunc *sourceAlpha,
+				  SplashSpanCompositeFunc *composite);
+
+#endif
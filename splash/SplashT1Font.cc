@@ -225,10 +225,11 @@ GBool SplashT1Font::makeGlyph(int c, int xFrac, int yFrac,
     bitmap->freeData = gTrue;
   }
 
-  *clipRes = clip->testRect(x0 - bitmap->x,
-                            y0 - bitmap->y,
-                            x0 - bitmap->x + bitmap->w - 1,
-                            y0 - bitmap->y + bitmap->h - 1);
+  *clipRes = clip ? clip->testRect(x0 - bitmap->x,
+                                   y0 - bitmap->y,
+                                   x0 - bitmap->x + bitmap->w - 1,
+                                   y0 - bitmap->y + bitmap->h - 1)
+                  : splashClipAllInside;
 
   return gTrue;
 }
@@ -68,7 +68,8 @@ inline void SplashXPath::transform(SplashCoord *matrix,
 
 SplashXPath::SplashXPath(SplashPath *path, SplashCoord *matrix,
 			 SplashCoord flatness, GBool closeSubpaths,
-			 GBool adjustLines, int linePosI) {
+			 GBool adjustLines, int linePosI,
+			 GBool exactAdjust) {
   SplashPathHint *hint;
   SplashXPathPoint *pts;
   SplashXPathAdjust *adjusts, *adjust;
@@ -140,7 +141,7 @@ SplashXPath::SplashXPath(SplashPath *path, SplashCoord *matrix,
         }
       }
       adjusts[i].x0 = (SplashCoord)x0;
-      adjusts[i].x1 = (SplashCoord)x1 - 0.01;
+      adjusts[i].x1 = exactAdjust ? (SplashCoord)x1 : (SplashCoord)x1 - 0.01;
       adjusts[i].xm = (SplashCoord)0.5 * (adjusts[i].x0 + adjusts[i].x1);
       adjusts[i].firstPt = hint->firstPt;
       adjusts[i].lastPt = hint->lastPt;
@@ -62,10 +62,13 @@ public:
   // Expands (converts to segments) and flattens (converts curves to
   // lines) <path>.  Transforms all points from user space to device
   // space, via <matrix>.  If <closeSubpaths> is true, closes all open
-  // subpaths.
+  // subpaths.  Stroke adjusted edges are moved just inside the pixel
+  // boundaries, unless <exactAdjust> is true, which puts them on the
+  // boundaries (for SplashXPathRasterizer).
   SplashXPath(SplashPath *path, SplashCoord *matrix,
 	      SplashCoord flatness, GBool closeSubpaths,
-	      GBool adjustLines = gFalse, int linePosI = 0);
+	      GBool adjustLines = gFalse, int linePosI = 0,
+	      GBool exactAdjust = gFalse);
 
   // Copy an expanded path.
   SplashXPath *copy() { return new SplashXPath(this); }
@@ -100,6 +103,7 @@ protected:
   int length, size;		// length and size of segs array
 
   friend class SplashXPathScanner;
+  friend class SplashXPathRasterizer;
   friend class SplashClip;
   friend class Splash;
 };
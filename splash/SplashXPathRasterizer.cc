@@ -0,0 +1,294 @@
+//========================================================================
+//
+// SplashXPathRasterizer.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include "goo/gmem.h"
+#include "SplashMath.h"
+#include "SplashXPath.h"
+#include "SplashXPathRasterizer.h"
+
+//------------------------------------------------------------------------
+// SplashXPathRasterizer
+//------------------------------------------------------------------------
+
+SplashXPathRasterizer::SplashXPathRasterizer(SplashXPath *xPathA, GBool eoA,
+					     SplashCoord scaleA,
+					     int clipXMin, int clipXMax) {
+  SplashXPathSeg *seg;
+  SplashCoord xMinFP, yMinFP, xMaxFP, yMaxFP;
+  int i;
+
+  xPath = xPathA;
+  eo = eoA;
+  scale = scaleA;
+
+  // compute the bbox
+  if (xPath->length == 0) {
+    xMin = yMin = 1;
+    xMax = yMax = 0;
+  } else {
+    seg = &xPath->segs[0];
+    xMinFP = xMaxFP = seg->x0;
+    yMinFP = yMaxFP = seg->y0;
+    for (i = 0; i < xPath->length; ++i) {
+      seg = &xPath->segs[i];
+      if (seg->x0 < xMinFP) {
+	xMinFP = seg->x0;
+      } else if (seg->x0 > xMaxFP) {
+	xMaxFP = seg->x0;
+      }
+      if (seg->x1 < xMinFP) {
+	xMinFP = seg->x1;
+      } else if (seg->x1 > xMaxFP) {
+	xMaxFP = seg->x1;
+      }
+      if (seg->y0 < yMinFP) {
+	yMinFP = seg->y0;
+      } else if (seg->y0 > yMaxFP) {
+	yMaxFP = seg->y0;
+      }
+      if (seg->y1 < yMinFP) {
+	yMinFP = seg->y1;
+      } else if (seg->y1 > yMaxFP) {
+	yMaxFP = seg->y1;
+      }
+    }
+    xMin = splashFloor(xMinFP * scale);
+    xMax = splashFloor(xMaxFP * scale);
+    yMin = splashFloor(yMinFP * scale);
+    yMax = splashFloor(yMaxFP * scale);
+  }
+
+  accX0 = xMin > clipXMin ? xMin : clipXMin;
+  accX1 = xMax < clipXMax ? xMax : clipXMax;
+  if (accX0 <= accX1) {
+    acc = (SplashCoord *)gmallocn(accX1 - accX0 + 3, sizeof(SplashCoord));
+    for (i = 0; i < accX1 - accX0 + 3; ++i) {
+      acc[i] = 0;
+    }
+    line = (Guchar *)gmalloc(accX1 - accX0 + 1);
+    active = (int *)gmallocn(xPath->length, sizeof(int));
+  } else {
+    acc = NULL;
+    line = NULL;
+    active = NULL;
+  }
+  activeLen = 0;
+  nextSeg = 0;
+  curY = yMin - 1;
+}
+
+SplashXPathRasterizer::~SplashXPathRasterizer() {
+  gfree(acc);
+  gfree(line);
+  gfree(active);
+}
+
+Guchar *SplashXPathRasterizer::renderLine(int y, int *x0, int *x1) {
+  SplashXPathSeg *seg;
+  SplashCoord xu, yu, yl, ya, yb, dir, sum, a;
+  int w, first, last, i, j, c;
+
+  if (!acc || y < yMin || y > yMax) {
+    return NULL;
+  }
+  w = accX1 - accX0 + 1;
+
+  // update the list of segments crossing [y, y+1)
+  if (y <= curY) {
+    activeLen = 0;
+    nextSeg = 0;
+  }
+  curY = y;
+  for (i = j = 0; i < activeLen; ++i) {
+    seg = &xPath->segs[active[i]];
+    yl = (seg->flags & splashXPathFlip) ? seg->y0 : seg->y1;
+    if (yl * scale > y) {
+      active[j++] = active[i];
+    }
+  }
+  activeLen = j;
+  for (; nextSeg < xPath->length; ++nextSeg) {
+    seg = &xPath->segs[nextSeg];
+    if (seg->flags & splashXPathFlip) {
+      yu = seg->y1;
+      yl = seg->y0;
+    } else {
+      yu = seg->y0;
+      yl = seg->y1;
+    }
+    if (yu * scale >= y + 1) {
+      break;
+    }
+    if (!(seg->flags & splashXPathHoriz) && yl * scale > y) {
+      active[activeLen++] = nextSeg;
+    }
+  }
+  if (activeLen == 0) {
+    return NULL;
+  }
+
+  // accumulate the signed area of each segment piece in the row
+  touchMin = w + 2;
+  touchMax = -1;
+  for (i = 0; i < activeLen; ++i) {
+    seg = &xPath->segs[active[i]];
+    if (seg->flags & splashXPathFlip) {
+      xu = seg->x1 * scale;
+      yu = seg->y1 * scale;
+      yl = seg->y0 * scale;
+      dir = -1;
+    } else {
+      xu = seg->x0 * scale;
+      yu = seg->y0 * scale;
+      yl = seg->y1 * scale;
+      dir = 1;
+    }
+    ya = yu > y ? yu : (SplashCoord)y;
+    yb = yl < y + 1 ? yl : (SplashCoord)(y + 1);
+    if (yb <= ya) {
+      continue;
+    }
+    addPiece(xu + (ya - yu) * seg->dxdy - accX0,
+	     xu + (yb - yu) * seg->dxdy - accX0,
+	     dir * (yb - ya));
+  }
+  if (touchMin > touchMax) {
+    return NULL;
+  }
+
+  // the running sum of the accumulation buffer is the winding number,
+  // weighted by coverage
+  first = last = -1;
+  sum = 0;
+  for (i = touchMin; i < w; ++i) {
+    sum += acc[i];
+    acc[i] = 0;
+    a = splashAbs(sum);
+    if (eo) {
+      a -= 2 * splashFloor(a * 0.5);
+      if (a > 1) {
+	a = 2 - a;
+      }
+    } else if (a > 1) {
+      a = 1;
+    }
+    c = (int)(a * 255 + 0.5);
+    line[i] = (Guchar)c;
+    if (c) {
+      if (first < 0) {
+	first = i;
+      }
+      last = i;
+    } else if (i >= touchMax) {
+      // nothing further right
+      ++i;
+      break;
+    }
+  }
+  for (; i <= touchMax; ++i) {
+    acc[i] = 0;
+  }
+  if (first < 0) {
+    return NULL;
+  }
+  *x0 = accX0 + first;
+  *x1 = accX0 + last;
+  return line + first;
+}
+
+// Add the piece of a segment going from <xa> to <xb> (relative to
+// <accX0>), over a height <d> (negative for upward segments) within the
+// current row.  Parts left of the computed range are moved onto its left
+// edge, which gives the same coverage inside the range; parts right of
+// it don't affect any computed pixel.
+void SplashXPathRasterizer::addPiece(SplashCoord xa, SplashCoord xb,
+				     SplashCoord d) {
+  SplashCoord w, t;
+
+  w = accX1 - accX0 + 1;
+  if ((xa < 0 && xb > 0) || (xa > 0 && xb < 0)) {
+    t = -xa / (xb - xa);
+    addPiece(xa, 0, d * t);
+    addPiece(0, xb, d - d * t);
+    return;
+  }
+  if ((xa < w && xb > w) || (xa > w && xb < w)) {
+    t = (w - xa) / (xb - xa);
+    addPiece(xa, w, d * t);
+    addPiece(w, xb, d - d * t);
+    return;
+  }
+  if (xa <= 0 && xb <= 0) {
+    acc[0] += d;
+    if (touchMin > 0) {
+      touchMin = 0;
+    }
+    if (touchMax < 0) {
+      touchMax = 0;
+    }
+  } else if (xa >= 0 && xb >= 0 && xa <= w && xb <= w) {
+    addCells(xa, xb, d);
+  }
+}
+
+// Add the area contributions of a piece of segment lying in [0, w].
+void SplashXPathRasterizer::addCells(SplashCoord xa, SplashCoord xb,
+				     SplashCoord d) {
+  SplashCoord x0, x1, x0f, x1f, s, a0, a1, a2, am;
+  int x0i, x1i, xi;
+
+  if (xa < xb) {
+    x0 = xa;
+    x1 = xb;
+  } else {
+    x0 = xb;
+    x1 = xa;
+  }
+  x0i = splashFloor(x0);
+  x1i = splashCeil(x1);
+  if (x1i <= x0i + 1) {
+    // the piece lies in a single cell
+    am = (SplashCoord)0.5 * (xa + xb) - x0i;
+    acc[x0i] += d - d * am;
+    acc[x0i + 1] += d * am;
+  } else {
+    s = 1 / (x1 - x0);
+    x0f = x0 - x0i;
+    a0 = (SplashCoord)0.5 * s * (1 - x0f) * (1 - x0f);
+    x1f = x1 - x1i + 1;
+    am = (SplashCoord)0.5 * s * x1f * x1f;
+    acc[x0i] += d * a0;
+    if (x1i == x0i + 2) {
+      acc[x0i + 1] += d * (1 - a0 - am);
+    } else {
+      a1 = s * ((SplashCoord)1.5 - x0f);
+      acc[x0i + 1] += d * (a1 - a0);
+      for (xi = x0i + 2; xi < x1i - 1; ++xi) {
+	acc[xi] += d * s;
+      }
+      a2 = a1 + (x1i - x0i - 3) * s;
+      acc[x1i - 1] += d * (1 - a2 - am);
+    }
+    acc[x1i] += d * am;
+  }
+  if (x0i < touchMin) {
+    touchMin = x0i;
+  }
+  if (x0i + 1 > touchMax) {
+    touchMax = x0i + 1;
+  }
+  if (x1i > touchMax) {
+    touchMax = x1i;
+  }
+}
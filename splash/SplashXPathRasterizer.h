@@ -0,0 +1,73 @@
+//========================================================================
+//
+// SplashXPathRasterizer.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef SPLASHXPATHRASTERIZER_H
+#define SPLASHXPATHRASTERIZER_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include "SplashTypes.h"
+
+class SplashXPath;
+
+//------------------------------------------------------------------------
+// SplashXPathRasterizer
+//
+// Computes the exact area of each pixel covered by a path, one row at a
+// time.  Every segment adds its signed area contributions to an
+// accumulation buffer, and a running sum over the row gives the
+// coverage.  This is an alternative to the 4x4 supersampling done with
+// SplashXPathScanner::renderAALine, which only sees 17 coverage levels.
+//------------------------------------------------------------------------
+
+class SplashXPathRasterizer {
+public:
+
+  // Create a new rasterizer for <xPathA>, which must be sorted.  All
+  // coordinates are multiplied by <scaleA> (so a path scaled by aaScale
+  // can be used with a scale of 1 / splashAASize).  Only the pixels in
+  // [<clipXMin>, <clipXMax>] are computed.
+  SplashXPathRasterizer(SplashXPath *xPathA, GBool eoA, SplashCoord scaleA,
+			int clipXMin, int clipXMax);
+
+  ~SplashXPathRasterizer();
+
+  // Return the path's bounding box, in pixels.
+  void getBBox(int *xMinA, int *yMinA, int *xMaxA, int *yMaxA)
+    { *xMinA = xMin; *yMinA = yMin; *xMaxA = xMax; *yMaxA = yMax; }
+
+  // Computes the coverage of the pixels on row <y>, as values in [0,
+  // 255].  Returns a pointer to the coverage of pixel <x0>, followed by
+  // the ones up to <x1>, or NULL if no pixel is covered.  The buffer
+  // belongs to the rasterizer and is overwritten by the next call.
+  // Rows are expected in increasing order; going back restarts the
+  // scan from the top of the path.
+  Guchar *renderLine(int y, int *x0, int *x1);
+
+private:
+
+  void addPiece(SplashCoord xa, SplashCoord xb, SplashCoord d);
+  void addCells(SplashCoord xa, SplashCoord xb, SplashCoord d);
+
+  SplashXPath *xPath;
+  GBool eo;
+  SplashCoord scale;
+  int xMin, yMin, xMax, yMax;	// bounding box
+  int accX0, accX1;		// range of pixels computed
+  SplashCoord *acc;		// accumulation buffer, for [accX0, accX1+2)
+  Guchar *line;			// coverage of the current row
+  int touchMin, touchMax;	// range of <acc> entries touched by the row
+  int *active;			// segments crossing the current row
+  int activeLen;
+  int nextSeg;			// next segment to add to <active>
+  int curY;			// last row rendered
+};
+
+#endif
@@ -0,0 +1,360 @@
+//========================================================================
+//
+// display-list-test.cc
+//
+// Checks that replaying a DisplayList into a SplashOutputDev gives the
+// same bitmap as displaying the page directly: whole pages, slices
+// replayed as bands, the bands of SplashPageRenderer, and pages
+// displayed through the Page display list cache.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "goo/gmem.h"
+#include "GlobalParams.h"
+#include "PDFDoc.h"
+#include "SplashOutputDev.h"
+#include "DisplayListOutputDev.h"
+#include "SplashPageRenderer.h"
+#include "splash/SplashBitmap.h"
+#include "test-pdf.h"
+
+static int failures = 0;
+
+static void check(GBool ok, const char *what) {
+  if (!ok) {
+    fprintf(stderr, "FAIL: %s\n", what);
+    ++failures;
+  }
+}
+
+// The first page draws paths with dashes and clips, an axial shading, a
+// shading pattern, an indexed image, an image mask, constant and soft
+// mask transparency and Type 3 text.  The second one fills a tiling
+// pattern, which SplashOutputDev fills with a tile bitmap.
+static PDFDoc *makeDoc(TestPDF *pdf) {
+  std::string hex, content;
+  int catalog, pages, page, image, mask, shading, radial, tile, group;
+  int gs1, gs2, charA, charB, font, contents, tilePage, tileContents;
+  std::string resources;
+  int x, y;
+
+  catalog = pdf->reserve();
+  pages = pdf->reserve();
+  page = pdf->reserve();
+  tilePage = pdf->reserve();
+
+  for (y = 0; y < 8; ++y) {
+    for (x = 0; x < 8; ++x) {
+      hex += '0';
+      hex += "0123"[(x * 3 + y * 5) & 3];
+    }
+  }
+  image = pdf->addStream("/Type /XObject /Subtype /Image /Width 8 /Height 8"
+			 " /ColorSpace [/Indexed /DeviceRGB 3"
+			 " <FF000000C0000000FFFFFF00>]"
+			 " /BitsPerComponent 8 /Filter /ASCIIHexDecode",
+			 hex + ">");
+  mask = pdf->addStream("/Type /XObject /Subtype /Image /Width 16"
+			" /Height 4 /ImageMask true /BitsPerComponent 1"
+			" /Filter /ASCIIHexDecode",
+			"F0F0 0F0F 3C3C C3C3>");
+  shading = pdf->add("<< /ShadingType 2 /ColorSpace /DeviceRGB"
+		     " /Coords [30 30 170 170] /Extend [true true]"
+		     " /Function << /FunctionType 2 /Domain [0 1]"
+		     " /C0 [1 1 0] /C1 [0 0.5 1] /N 1 >> >>");
+  radial = pdf->add("<< /PatternType 2 /Shading << /ShadingType 3"
+		    " /ColorSpace /DeviceRGB /Coords [50 150 5 50 150 40]"
+		    " /Function << /FunctionType 2 /Domain [0 1]"
+		    " /C0 [1 0 0] /C1 [0 1 0] /N 2 >> >> >>");
+  tile = pdf->addStream("/Type /Pattern /PatternType 1 /PaintType 1"
+			" /TilingType 1 /BBox [0 0 10 10] /XStep 10"
+			" /YStep 10 /Resources << >>",
+			"0 0 1 rg 0 0 5 5 re f 1 0.5 0 rg 5 5 5 5 re f");
+  group = pdf->addStream("/Type /XObject /Subtype /Form /BBox [0 0 200 250]"
+			 " /Group << /S /Transparency /CS /DeviceGray >>",
+			 "1 g 0 0 100 250 re f 0.3 g 100 0 100 250 re f");
+  gs1 = pdf->add("<< /Type /ExtGState /CA 0.5 /ca 0.6 >>");
+  gs2 = pdf->add("<< /Type /ExtGState /SMask << /Type /Mask"
+		 " /S /Luminosity /G " + TestPDF::ref(group) + " >> >>");
+  charA = pdf->addStream("",
+			 "600 0 0 0 500 700 d1 0 0 m 500 0 l 250 700 l f");
+  charB = pdf->addStream("",
+			 "600 0 d0 1 0 0 rg 0 0 500 350 re f"
+			 " 0 0 1 rg 0 350 500 350 re f");
+  font = pdf->add("<< /Type /Font /Subtype /Type3 /FontBBox [0 0 1000 1000]"
+		  " /FontMatrix [0.001 0 0 0.001 0 0]"
+		  " /CharProcs << /a " + TestPDF::ref(charA) +
+		  " /b " + TestPDF::ref(charB) + " >>"
+		  " /Encoding << /Type /Encoding /Differences [97 /a /b] >>"
+		  " /FirstChar 97 /LastChar 98 /Widths [600 600] >>");
+
+  content =
+    "q 1 0 0 rg 10 10 80 60 re f Q\n"
+    "q 0 0 1 RG 3 w [6 3] 0 d 1 J 20 100 m 180 150 l"
+    " 60 190 180 20 120 110 c S Q\n"
+    "q 30 30 m 170 40 l 100 170 l h W n /Sh1 sh Q\n"
+    "q /Pattern cs /P2 scn 10 120 80 70 re f Q\n"
+    "q 60 0 0 60 120 120 cm /Im1 Do Q\n"
+    "q 0 0.5 0 rg 80 20 0 0 120 190 cm /Im2 Do Q\n"
+    "q /GS1 gs 0 1 0 rg 50 50 100 100 re f Q\n"
+    "q /GS2 gs 0.5 0 0.5 rg 0 200 200 40 re f Q\n"
+    "BT /F1 24 Tf 20 80 Td (abab) Tj 0.7 0 0.7 1 40 215 Tm (ba) Tj ET\n";
+  contents = pdf->addStream("", content);
+  tileContents = pdf->addStream("", "q /Pattern cs /P1 scn 20 20 160 200 re f"
+				" Q 0 0 1 RG 30 30 m 170 230 l S\n");
+
+  pdf->set(catalog, "<< /Type /Catalog /Pages " + TestPDF::ref(pages) +
+	   " >>");
+  resources = " /Resources << /XObject << /Im1 " + TestPDF::ref(image) +
+	      " /Im2 " + TestPDF::ref(mask) + " >>"
+	      " /Shading << /Sh1 " + TestPDF::ref(shading) + " >>"
+	      " /Pattern << /P1 " + TestPDF::ref(tile) +
+	      " /P2 " + TestPDF::ref(radial) + " >>"
+	      " /ExtGState << /GS1 " + TestPDF::ref(gs1) +
+	      " /GS2 " + TestPDF::ref(gs2) + " >>"
+	      " /Font << /F1 " + TestPDF::ref(font) + " >> >>";
+  pdf->set(pages, "<< /Type /Pages /Kids [" + TestPDF::ref(page) + " " +
+	   TestPDF::ref(tilePage) + "] /Count 2 >>");
+  pdf->set(page, "<< /Type /Page /Parent " + TestPDF::ref(pages) +
+	   " /MediaBox [0 0 200 250] /Contents " + TestPDF::ref(contents) +
+	   resources + " >>");
+  pdf->set(tilePage, "<< /Type /Page /Parent " + TestPDF::ref(pages) +
+	   " /MediaBox [0 0 200 250] /Contents " +
+	   TestPDF::ref(tileContents) + resources + " >>");
+  return pdf->open(catalog);
+}
+
+static SplashOutputDev *makeOutputDev(PDFDoc *doc) {
+  SplashColor paperColor;
+  SplashOutputDev *out;
+
+  paperColor[0] = paperColor[1] = paperColor[2] = 0xff;
+  out = new SplashOutputDev(splashModeRGB8, 4, gFalse, paperColor);
+  out->startDoc(doc);
+  return out;
+}
+
+static SplashOutputDev *createOutputDev(PDFDoc *doc, void *data) {
+  return makeOutputDev(doc);
+}
+
+// Count the pixels of <bitmap> that differ from the (<x>, <y>) area of
+// <ref>, or return -1 if it doesn't fit there.
+static int countDiffs(SplashBitmap *ref, int x, int y, SplashBitmap *bitmap) {
+  SplashColorPtr p, q;
+  int n, row, col;
+
+  if (!bitmap || x + bitmap->getWidth() > ref->getWidth() ||
+      y + bitmap->getHeight() > ref->getHeight()) {
+    return -1;
+  }
+  n = 0;
+  for (row = 0; row < bitmap->getHeight(); ++row) {
+    p = ref->getDataPtr() + (y + row) * ref->getRowSize() + x * 3;
+    q = bitmap->getDataPtr() + row * bitmap->getRowSize();
+    for (col = 0; col < bitmap->getWidth(); ++col, p += 3, q += 3) {
+      if (p[0] != q[0] || p[1] != q[1] || p[2] != q[2]) {
+	++n;
+      }
+    }
+  }
+  return n;
+}
+
+static GBool sameBitmap(SplashBitmap *ref, SplashBitmap *bitmap) {
+  return bitmap && bitmap->getWidth() == ref->getWidth() &&
+         bitmap->getHeight() == ref->getHeight() &&
+         countDiffs(ref, 0, 0, bitmap) == 0;
+}
+
+// Slices are cut out of the page by moving the device space by whole
+// pixels.  Coordinates that fall exactly on a pixel boundary may round
+// the other way there, which moves an edge by one pixel, so a slice
+// only has to match its area of the page but for a few pixels.
+static GBool closeArea(SplashBitmap *ref, int x, int y, SplashBitmap *bitmap) {
+  int n;
+
+  n = countDiffs(ref, x, y, bitmap);
+  return n >= 0 && n <= bitmap->getWidth() * bitmap->getHeight() / 100;
+}
+
+static SplashBitmap *displayDirect(PDFDoc *doc, int pg, double dpi,
+				   int rotate, GBool crop) {
+  SplashOutputDev *out;
+  SplashBitmap *bitmap;
+
+  out = makeOutputDev(doc);
+  doc->displayPage(out, pg, dpi, dpi, rotate, gFalse, crop, gFalse);
+  bitmap = out->takeBitmap();
+  delete out;
+  return bitmap;
+}
+
+static DisplayList *record(PDFDoc *doc, int pg, double dpi,
+			   int rotate, GBool crop) {
+  SplashOutputDev *proto;
+  DisplayListOutputDev *recorder;
+  DisplayList *list;
+
+  proto = makeOutputDev(doc);
+  recorder = new DisplayListOutputDev(proto);
+  doc->displayPage(recorder, pg, dpi, dpi, rotate, gFalse, crop, gFalse);
+  list = recorder->takeDisplayList();
+  delete recorder;
+  delete proto;
+  return list;
+}
+
+static void testPage(PDFDoc *doc, double dpi, int rotate, GBool crop) {
+  SplashOutputDev *out;
+  SplashPageRenderer *renderer;
+  SplashBitmap *ref, *bitmap;
+  DisplayList *list;
+  char what[128];
+  int w, h, nBands, bandH, x, y, i;
+
+  globalParams->setDisplayListCacheSize(0);
+  ref = displayDirect(doc, 1, dpi, rotate, crop);
+  w = ref->getWidth();
+  h = ref->getHeight();
+
+  // record, then replay the whole page
+  list = record(doc, 1, dpi, rotate, crop);
+  snprintf(what, sizeof(what), "record %g dpi, rotate %d, crop %d",
+	   dpi, rotate, crop);
+  check(list != NULL && list->getNumOps() > 0 && list->isExact(), what);
+  if (!list) {
+    delete ref;
+    return;
+  }
+
+  out = makeOutputDev(doc);
+  list->replay(out, dpi, dpi);
+  snprintf(what, sizeof(what), "replay %g dpi, rotate %d, crop %d",
+	   dpi, rotate, crop);
+  check(sameBitmap(ref, out->getBitmap()), what);
+  delete out;
+
+  // replay in bands, the last one shorter, and in a slice that doesn't
+  // start at the left edge
+  nBands = 7;
+  bandH = (h + nBands - 1) / nBands;
+  for (i = 0, y = 0; y < h; ++i, y += bandH) {
+    out = makeOutputDev(doc);
+    list->replaySlice(out, 0, y, w, y + bandH > h ? h - y : bandH);
+    snprintf(what, sizeof(what), "band %d at %g dpi, rotate %d, crop %d",
+	     i, dpi, rotate, crop);
+    check(closeArea(ref, 0, y, out->getBitmap()), what);
+    delete out;
+  }
+  x = w / 3;
+  y = h / 4;
+  out = makeOutputDev(doc);
+  list->replaySlice(out, x, y, w / 2, h / 2);
+  snprintf(what, sizeof(what), "slice at %g dpi, rotate %d, crop %d",
+	   dpi, rotate, crop);
+  check(closeArea(ref, x, y, out->getBitmap()), what);
+  delete out;
+  list->decRefCnt();
+
+  // the same through SplashPageRenderer, whose last band would be empty
+  // with 9 rows split for 6 workers
+  renderer = new SplashPageRenderer(doc, 6);
+  bitmap = renderer->renderBands(1, dpi, dpi, rotate, gFalse, crop, gFalse,
+				 x, y, w / 2, 9, 1, &createOutputDev, NULL);
+  snprintf(what, sizeof(what), "renderBands at %g dpi, rotate %d, crop %d",
+	   dpi, rotate, crop);
+  check(bitmap && bitmap->getHeight() == 9 &&
+	closeArea(ref, x, y, bitmap), what);
+  delete bitmap;
+  delete renderer;
+
+  // display through the Page cache, the second display is a cache hit
+  globalParams->setDisplayListCacheSize(4);
+  for (i = 0; i < 2; ++i) {
+    out = makeOutputDev(doc);
+    doc->displayPage(out, 1, dpi, dpi, rotate, gFalse, crop, gFalse);
+    snprintf(what, sizeof(what), "cached display %d at %g dpi, rotate %d,"
+	     " crop %d", i, dpi, rotate, crop);
+    check(sameBitmap(ref, out->getBitmap()), what);
+    delete out;
+  }
+  out = makeOutputDev(doc);
+  doc->displayPageSlice(out, 1, dpi, dpi, rotate, gFalse, crop, gFalse,
+			x, y, w / 2, h / 2);
+  snprintf(what, sizeof(what), "cached slice at %g dpi, rotate %d, crop %d",
+	   dpi, rotate, crop);
+  check(closeArea(ref, x, y, out->getBitmap()), what);
+  delete out;
+  globalParams->setDisplayListCacheSize(0);
+
+  delete ref;
+}
+
+// The list of the tiling pattern page isn't exact, the Page cache must
+// display it directly.
+static void testTilePage(PDFDoc *doc, double dpi) {
+  SplashOutputDev *out;
+  SplashBitmap *ref;
+  DisplayList *list;
+  char what[128];
+
+  globalParams->setDisplayListCacheSize(0);
+  ref = displayDirect(doc, 2, dpi, 0, gFalse);
+
+  list = record(doc, 2, dpi, 0, gFalse);
+  snprintf(what, sizeof(what), "tiling pattern list at %g dpi isn't exact",
+	   dpi);
+  check(list != NULL && !list->isExact(), what);
+  if (list) {
+    list->decRefCnt();
+  }
+
+  globalParams->setDisplayListCacheSize(4);
+  out = makeOutputDev(doc);
+  doc->displayPage(out, 2, dpi, dpi, 0, gFalse, gFalse, gFalse);
+  snprintf(what, sizeof(what), "cached tiling pattern display at %g dpi",
+	   dpi);
+  check(sameBitmap(ref, out->getBitmap()), what);
+  delete out;
+  globalParams->setDisplayListCacheSize(0);
+
+  delete ref;
+}
+
+int main(int argc, char *argv[]) {
+  TestPDF pdf;
+  PDFDoc *doc;
+
+  globalParams = new GlobalParams();
+  globalParams->setErrQuiet(gTrue);
+
+  doc = makeDoc(&pdf);
+  if (!doc->isOk()) {
+    fprintf(stderr, "FAIL: test document doesn't open\n");
+    return 1;
+  }
+  testPage(doc, 72, 0, gFalse);
+  testPage(doc, 110, 0, gTrue);
+  testPage(doc, 96, 90, gFalse);
+  testPage(doc, 150, 270, gTrue);
+  testTilePage(doc, 72);
+  testTilePage(doc, 150);
+  delete doc;
+
+  delete globalParams;
+
+  if (failures) {
+    fprintf(stderr, "%d checks failed\n", failures);
+    return 1;
+  }
+  printf("display-list-test: all checks passed\n");
+  return 0;
+}
@@ -0,0 +1,380 @@
+//========================================================================
+//
+// docindex-test.cc
+//
+// Checks the document index (DocIndex): a document opened through its
+// index must have the same xref entries, trailer, page objects and page
+// boxes as when it is opened normally, and the index must be rejected
+// once the document is changed, including a change of the document ID
+// alone, with the size and modification time kept.  The documents have
+// a classic xref table or an xref stream; in the latter the ID is not
+// near the end of the file.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#include <sys/utime.h>
+#else
+#include <unistd.h>
+#include <utime.h>
+#endif
+#include "goo/gfile.h"
+#include "goo/GooString.h"
+#include "GlobalParams.h"
+#include "PDFDoc.h"
+#include "XRef.h"
+#include "Catalog.h"
+#include "Page.h"
+#include "DocIndex.h"
+#include "test-pdf.h"
+
+#define indexDir "docindex-test.d"
+#define nFillers 300
+
+static int failures = 0;
+
+static void check(GBool ok, const char *what, const char *file) {
+  if (!ok) {
+    fprintf(stderr, "FAIL: %s (%s)\n", what, file);
+    ++failures;
+  }
+}
+
+//------------------------------------------------------------------------
+
+static const char *fileID0 = "<00112233445566778899aabbccddeeff>";
+static const char *fileID1 = "<0123456789abcdef0123456789abcdef>";
+
+// A document with an inherited MediaBox, CropBox and Rotate, pages that
+// override them, and enough objects for the xref stream to be longer
+// than the part of the file at its end that is checked.
+static std::string makeFile(GBool xrefStream, const char *fileID) {
+  TestPDF pdf;
+  std::string kids;
+  char buf[256];
+  int catalog, pages, node, info, i;
+
+  catalog = pdf.reserve();
+  pages = pdf.reserve();
+  node = pdf.reserve();
+  info = pdf.add("<< /Title (docindex-test) >>");
+  for (i = 0; i < nFillers; ++i) {
+    snprintf(buf, sizeof(buf), "<< /Filler %d >>", i);
+    pdf.add(buf);
+  }
+  for (i = 0; i < 5; ++i) {
+    snprintf(buf, sizeof(buf), "<< /Type /Page /Parent %d 0 R%s%s >>",
+	     i < 3 ? node : pages,
+	     i == 1 ? " /MediaBox [10 20 300.5 400.25]" : "",
+	     i == 2 ? " /CropBox [50 60 200 300] /Rotate 270" : "");
+    kids += " " + TestPDF::ref(pdf.add(buf));
+    if (i == 2) {
+      snprintf(buf, sizeof(buf),
+	       "<< /Type /Pages /Parent %d 0 R /Kids [%s ] /Count 3"
+	       " /CropBox [0 0 500 700] /Rotate 90 >>", pages, kids.c_str());
+      pdf.set(node, buf);
+      kids = " " + TestPDF::ref(node);
+    }
+  }
+  snprintf(buf, sizeof(buf),
+	   "<< /Type /Pages /Kids [%s ] /Count 5 /MediaBox [0 0 612 792] >>",
+	   kids.c_str());
+  pdf.set(pages, buf);
+  pdf.set(catalog, "<< /Type /Catalog /Pages " + TestPDF::ref(pages) + " >>");
+  snprintf(buf, sizeof(buf), " /Info %d 0 R /ID [%s %s]",
+	   info, fileID0, fileID);
+  pdf.setTrailer(buf);
+  return pdf.write(catalog, xrefStream);
+}
+
+static void writeFile(const char *name, const std::string &data,
+		      time_t modTime) {
+  FILE *f;
+  struct utimbuf times;
+
+  if (!(f = fopen(name, "wb"))) {
+    check(gFalse, "can't write the document", name);
+    return;
+  }
+  fwrite(data.data(), 1, data.size(), f);
+  fclose(f);
+  if (modTime) {
+    times.actime = modTime;
+    times.modtime = modTime;
+    utime(name, &times);
+  }
+}
+
+static PDFDoc *openDoc(const char *name, GBool useIndex) {
+  globalParams->setDocIndexDir(useIndex ? (char *)indexDir : (char *)NULL);
+  return new PDFDoc(new GooString(name));
+}
+
+// Is there a valid index for the document <name>?
+static GBool hasIndex(const char *name) {
+  PDFDoc *doc;
+  GooString *dir, *fileName;
+  DocIndex *index;
+  GBool ok;
+
+  doc = openDoc(name, gFalse);
+  dir = new GooString(indexDir);
+  fileName = new GooString(name);
+  index = DocIndex::load(dir, fileName, doc->getBaseStream());
+  ok = index != NULL;
+  delete index;
+  delete fileName;
+  delete dir;
+  delete doc;
+  return ok;
+}
+
+static GBool sameBox(PDFRectangle *box, double *coords) {
+  return box->x1 == coords[0] && box->y1 == coords[1] &&
+         box->x2 == coords[2] && box->y2 == coords[3];
+}
+
+static GBool sameBox(PDFRectangle *box1, PDFRectangle *box2) {
+  return box1->x1 == box2->x1 && box1->y1 == box2->y1 &&
+         box1->x2 == box2->x2 && box1->y2 == box2->y2;
+}
+
+static GBool sameEntry(Object *dict1, Object *dict2, const char *key) {
+  Object obj1, obj2, item1, item2;
+  GBool same;
+  int i;
+
+  dict1->dictLookupNF(key, &obj1);
+  dict2->dictLookupNF(key, &obj2);
+  if (obj1.isRef() && obj2.isRef()) {
+    same = obj1.getRefNum() == obj2.getRefNum() &&
+           obj1.getRefGen() == obj2.getRefGen();
+  } else if (obj1.isInt() && obj2.isInt()) {
+    same = obj1.getInt() == obj2.getInt();
+  } else if (obj1.isArray() && obj2.isArray()) {
+    same = obj1.arrayGetLength() == obj2.arrayGetLength();
+    for (i = 0; same && i < obj1.arrayGetLength(); ++i) {
+      obj1.arrayGet(i, &item1);
+      obj2.arrayGet(i, &item2);
+      same = item1.isString() && item2.isString() &&
+             !item1.getString()->cmp(item2.getString());
+      item1.free();
+      item2.free();
+    }
+  } else {
+    same = gFalse;
+  }
+  obj1.free();
+  obj2.free();
+  return same;
+}
+
+//------------------------------------------------------------------------
+
+// Check the index of <name> and a document opened through it against
+// <ref>, which was opened without an index.
+static void checkIndexed(const char *name, PDFDoc *ref) {
+  PDFDoc *doc;
+  GooString *dir, *fileName;
+  DocIndex *index;
+  DocIndexPage *pageInfo;
+  XRefEntry *e1, *e2;
+  Page *page1, *page2;
+  Ref *ref1, *ref2;
+  Goffset offset;
+  int gen, type, i;
+
+  // the index itself
+  dir = new GooString(indexDir);
+  fileName = new GooString(name);
+  index = DocIndex::load(dir, fileName, ref->getBaseStream());
+  delete fileName;
+  delete dir;
+  check(index != NULL, "index saved", name);
+  if (!index) {
+    return;
+  }
+  check(index->getNumEntries() == ref->getXRef()->getNumObjects(),
+	"index entries", name);
+  for (i = 0; i < index->getNumEntries() &&
+	      i < ref->getXRef()->getNumObjects(); ++i) {
+    index->getEntry(i, &offset, &gen, &type);
+    e1 = ref->getXRef()->getEntry(i, gFalse);
+    check(offset == e1->offset && gen == e1->gen && type == e1->type,
+	  "index entry", name);
+  }
+  check(index->getRootNum() == ref->getXRef()->getRootNum() &&
+	index->getRootGen() == ref->getXRef()->getRootGen(),
+	"index root", name);
+  check(index->getNumPages() == ref->getNumPages(), "index pages", name);
+  for (i = 1; i <= index->getNumPages() && i <= ref->getNumPages(); ++i) {
+    pageInfo = index->getPage(i);
+    page1 = ref->getPage(i);
+    ref1 = ref->getCatalog()->getPageRef(i);
+    check(pageInfo && page1 && ref1 &&
+	  pageInfo->num == ref1->num && pageInfo->gen == ref1->gen &&
+	  pageInfo->rotate == page1->getRotate() &&
+	  sameBox(page1->getMediaBox(), pageInfo->mediaBox) &&
+	  sameBox(page1->getCropBox(), pageInfo->cropBox),
+	  "index page", name);
+  }
+  delete index;
+
+  // a document opened through it
+  doc = openDoc(name, gTrue);
+  check(doc->isOk(), "open through the index", name);
+  if (!doc->isOk()) {
+    delete doc;
+    return;
+  }
+  check(doc->getXRef()->getNumObjects() == ref->getXRef()->getNumObjects(),
+	"xref size", name);
+  for (i = 0; i < doc->getXRef()->getNumObjects() &&
+	      i < ref->getXRef()->getNumObjects(); ++i) {
+    e1 = ref->getXRef()->getEntry(i, gFalse);
+    e2 = doc->getXRef()->getEntry(i, gFalse);
+    check(e1->offset == e2->offset && e1->gen == e2->gen &&
+	  e1->type == e2->type, "xref entry", name);
+  }
+  check(sameEntry(doc->getXRef()->getTrailerDict(),
+		  ref->getXRef()->getTrailerDict(), "Size") &&
+	sameEntry(doc->getXRef()->getTrailerDict(),
+		  ref->getXRef()->getTrailerDict(), "Root") &&
+	sameEntry(doc->getXRef()->getTrailerDict(),
+		  ref->getXRef()->getTrailerDict(), "Info") &&
+	sameEntry(doc->getXRef()->getTrailerDict(),
+		  ref->getXRef()->getTrailerDict(), "ID"),
+	"trailer", name);
+  check(doc->getNumPages() == ref->getNumPages(), "pages", name);
+  for (i = 1; i <= doc->getNumPages() && i <= ref->getNumPages(); ++i) {
+    page1 = ref->getPage(i);
+    ref1 = ref->getCatalog()->getPageRef(i);
+    ref2 = doc->getCatalog()->getPageRef(i);
+    check(ref1 && ref2 && ref1->num == ref2->num && ref1->gen == ref2->gen,
+	  "page ref", name);
+    check(doc->getPageMediaWidth(i) == page1->getMediaWidth() &&
+	  doc->getPageMediaHeight(i) == page1->getMediaHeight() &&
+	  doc->getPageCropWidth(i) == page1->getCropWidth() &&
+	  doc->getPageCropHeight(i) == page1->getCropHeight() &&
+	  doc->getPageRotate(i) == page1->getRotate(),
+	  "page size", name);
+    page2 = doc->getPage(i);
+    check(page2 && sameBox(page1->getMediaBox(), page2->getMediaBox()) &&
+	  sameBox(page1->getCropBox(), page2->getCropBox()) &&
+	  page1->getRotate() == page2->getRotate(),
+	  "page boxes", name);
+  }
+  delete doc;
+}
+
+static void testFile(const char *name, GBool xrefStream) {
+  PDFDoc *ref, *doc;
+  std::string data, data2;
+  time_t modTime;
+  size_t idPos;
+
+  data = makeFile(xrefStream, fileID1);
+  writeFile(name, data, 0);
+  modTime = getModTime((char *)name);
+  idPos = data.find(fileID1);
+  check(idPos != std::string::npos, "ID written", name);
+  if (xrefStream) {
+    check(idPos + 1024 < data.size(), "ID not at the end", name);
+  }
+
+  // the index is written when the document is opened
+  ref = openDoc(name, gFalse);
+  check(ref->isOk() && !hasIndex(name), "no index yet", name);
+  doc = openDoc(name, gTrue);
+  check(doc->isOk(), "open and save the index", name);
+  delete doc;
+  checkIndexed(name, ref);
+  delete ref;
+
+  // a different ID, with the same size and modification time
+  data2 = data;
+  data2.replace(idPos, strlen(fileID1), fileID0);
+  check(data2.size() == data.size() && data2 != data, "ID changed", name);
+  writeFile(name, data2, modTime);
+  check(getModTime((char *)name) == modTime, "modification time kept",
+	name);
+  check(!hasIndex(name), "index rejected after a change of ID", name);
+
+  // back to the original: the index is valid again
+  writeFile(name, data, modTime);
+  check(hasIndex(name), "index kept", name);
+
+  // a change in the first kilobyte
+  data2 = data;
+  data2[strlen("%PDF-1.")] = '4';
+  writeFile(name, data2, modTime);
+  check(!hasIndex(name), "index rejected after a change at the start", name);
+
+  // a different size
+  writeFile(name, data + "\n", modTime);
+  check(!hasIndex(name), "index rejected after a change of size", name);
+
+  // a different modification time
+  writeFile(name, data, modTime - 10);
+  check(!hasIndex(name), "index rejected after a change of time", name);
+
+  // the document can still be opened, and its index is written again
+  ref = openDoc(name, gFalse);
+  doc = openDoc(name, gTrue);
+  check(doc->isOk() && doc->getNumPages() == ref->getNumPages(),
+	"open after a change", name);
+  delete doc;
+  checkIndexed(name, ref);
+  delete ref;
+
+  remove(name);
+}
+
+//------------------------------------------------------------------------
+
+int main(int argc, char *argv[]) {
+  GDir *dir;
+  GDirEntry *entry;
+
+  globalParams = new GlobalParams();
+  globalParams->setErrQuiet(gTrue);
+
+#ifdef _WIN32
+  _mkdir(indexDir);
+#else
+  mkdir(indexDir, 0755);
+#endif
+
+  testFile("docindex-test.pdf", gFalse);
+  testFile("docindex-test-xrefstm.pdf", gTrue);
+
+  dir = new GDir((char *)indexDir, gFalse);
+  while ((entry = dir->getNextEntry())) {
+    remove(entry->getFullPath()->getCString());
+    delete entry;
+  }
+  delete dir;
+#ifdef _WIN32
+  _rmdir(indexDir);
+#else
+  rmdir(indexDir);
+#endif
+
+  delete globalParams;
+
+  if (failures) {
+    fprintf(stderr, "%d failures\n", failures);
+    return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
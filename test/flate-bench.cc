@@ -0,0 +1,258 @@
+//========================================================================
+//
+// flate-bench.cc
+//
+// Decodes all the FlateDecode streams of a document with the builtin
+// FlateStream and with the zlib backed ZlibFlateStream, and reports the
+// throughput of each.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#include <stdio.h>
+#include <string.h>
+#include "goo/gmem.h"
+#include "goo/GooString.h"
+#include "goo/GooTimer.h"
+#include "GlobalParams.h"
+#include "Error.h"
+#include "Object.h"
+#include "Stream.h"
+#include "FlateStream.h"
+#include "PDFDoc.h"
+#include "XRef.h"
+#include "utils/parseargs.h"
+
+struct FlateBenchStream {
+  char *buf;			// undecoded data
+  int len;
+  int predictor, columns, colors, bits;
+};
+
+static int iterations = 5;
+static int chunkSize = 65536;
+static GBool printHelp = gFalse;
+
+static const ArgDesc argDesc[] = {
+  {"-n",      argInt,      &iterations,      0,
+   "number of times each stream is decoded"},
+  {"-chunk",  argInt,      &chunkSize,       0,
+   "number of bytes requested per read"},
+  {"-h",      argFlag,     &printHelp,       0,
+   "print usage information"},
+  {"-help",   argFlag,     &printHelp,       0,
+   "print usage information"},
+  {"--help",  argFlag,     &printHelp,       0,
+   "print usage information"},
+  {"-?",      argFlag,     &printHelp,       0,
+   "print usage information"},
+  {NULL}
+};
+
+static int getIntParam(Dict *params, const char *key, int def) {
+  Object obj;
+  int val;
+
+  val = def;
+  if (params && params->lookup(key, &obj)->isInt()) {
+    val = obj.getInt();
+  }
+  obj.free();
+  return val;
+}
+
+// Returns true if <dict> has a single FlateDecode filter, and fills in
+// the predictor parameters.
+static GBool isFlate(Dict *dict, FlateBenchStream *fs) {
+  Object filter, parms, obj;
+  Dict *params;
+  GBool ok;
+
+  ok = gFalse;
+  dict->lookup("Filter", &filter);
+  if (filter.isArray() && filter.arrayGetLength() == 1) {
+    filter.arrayGet(0, &obj);
+    filter.free();
+    obj.copy(&filter);
+    obj.free();
+  }
+  if (filter.isName("FlateDecode") || filter.isName("Fl")) {
+    ok = gTrue;
+    dict->lookup("DecodeParms", &parms);
+    if (parms.isArray() && parms.arrayGetLength() == 1) {
+      parms.arrayGet(0, &obj);
+      parms.free();
+      obj.copy(&parms);
+      obj.free();
+    }
+    params = parms.isDict() ? parms.getDict() : NULL;
+    fs->predictor = getIntParam(params, "Predictor", 1);
+    fs->columns = getIntParam(params, "Columns", 1);
+    fs->colors = getIntParam(params, "Colors", 1);
+    fs->bits = getIntParam(params, "BitsPerComponent", 8);
+    parms.free();
+  }
+  filter.free();
+  return ok;
+}
+
+static FlateBenchStream *collectStreams(PDFDoc *doc, int *nStreams) {
+  FlateBenchStream *streams;
+  XRef *xref;
+  Stream *raw;
+  Object obj;
+  char *buf;
+  int size, bufSize, len, n, i;
+
+  xref = doc->getXRef();
+  streams = NULL;
+  size = 0;
+  *nStreams = 0;
+  for (i = 1; i < xref->getNumObjects(); ++i) {
+    if (!xref->fetch(i, xref->getEntry(i)->gen, &obj)->isStream()) {
+      obj.free();
+      continue;
+    }
+    if (*nStreams == size) {
+      size = size ? 2 * size : 64;
+      streams = (FlateBenchStream *)greallocn(streams, size,
+					      sizeof(FlateBenchStream));
+    }
+    if (isFlate(obj.streamGetDict(), &streams[*nStreams])) {
+      raw = obj.getStream()->getUndecodedStream();
+      raw->reset();
+      bufSize = 65536;
+      buf = (char *)gmalloc(bufSize);
+      len = 0;
+      while ((n = raw->doGetChars(bufSize - len, (Guchar *)buf + len)) > 0) {
+	len += n;
+	if (len == bufSize) {
+	  bufSize *= 2;
+	  buf = (char *)grealloc(buf, bufSize);
+	}
+      }
+      raw->close();
+      streams[*nStreams].buf = buf;
+      streams[*nStreams].len = len;
+      ++*nStreams;
+    }
+    obj.free();
+  }
+  return streams;
+}
+
+// Decode <fs> and return the number of decoded bytes.  If <out> is
+// non-NULL, the decoded data is appended to it.
+static long decode(FlateBenchStream *fs, GBool useZlib, Guchar *chunk,
+		   GooString *out) {
+  Stream *str;
+  Object dictObj;
+  long total;
+  int n;
+
+  dictObj.initNull();
+  str = new MemStream(fs->buf, 0, fs->len, &dictObj);
+  if (useZlib) {
+    str = new ZlibFlateStream(str, fs->predictor, fs->columns,
+			      fs->colors, fs->bits);
+  } else {
+    str = new FlateStream(str, fs->predictor, fs->columns,
+			  fs->colors, fs->bits);
+  }
+  str->reset();
+  total = 0;
+  while ((n = str->doGetChars(chunkSize, chunk)) > 0) {
+    if (out) {
+      out->append((char *)chunk, n);
+    }
+    total += n;
+  }
+  delete str;
+  return total;
+}
+
+static double bench(FlateBenchStream *streams, int nStreams, GBool useZlib,
+		    Guchar *chunk, long *total) {
+  GooTimer timer;
+  int i, j;
+
+  *total = 0;
+  timer.start();
+  for (i = 0; i < iterations; ++i) {
+    for (j = 0; j < nStreams; ++j) {
+      *total += decode(&streams[j], useZlib, chunk, NULL);
+    }
+  }
+  timer.stop();
+  return timer.getElapsed();
+}
+
+int main (int argc, char *argv[])
+{
+  PDFDoc *doc;
+  FlateBenchStream *streams;
+  GooString *a, *b;
+  Guchar *chunk;
+  double builtinTime, zlibTime;
+  long builtinTotal, zlibTotal;
+  int nStreams, mismatches, i;
+
+  // parse args
+  GBool ok = parseArgs(argDesc, &argc, argv);
+  if (!ok || argc != 2 || printHelp || iterations < 1 || chunkSize < 1) {
+    printUsage(argv[0], "PDF-FILE", argDesc);
+    return printHelp ? 0 : 1;
+  }
+
+  globalParams = new GlobalParams();
+  setErrorCallback(NULL, NULL);
+
+  doc = new PDFDoc(new GooString(argv[1]));
+  if (!doc->isOk() || doc->isEncrypted()) {
+    fprintf(stderr, "Error loading document (or it is encrypted)\n");
+    delete doc;
+    delete globalParams;
+    return 1;
+  }
+  streams = collectStreams(doc, &nStreams);
+  chunk = (Guchar *)gmalloc(chunkSize);
+
+  // check that both backends produce the same data
+  mismatches = 0;
+  for (i = 0; i < nStreams; ++i) {
+    a = new GooString();
+    b = new GooString();
+    decode(&streams[i], gFalse, chunk, a);
+    decode(&streams[i], gTrue, chunk, b);
+    if (a->cmp(b)) {
+      ++mismatches;
+    }
+    delete a;
+    delete b;
+  }
+
+  builtinTime = bench(streams, nStreams, gFalse, chunk, &builtinTotal);
+  zlibTime = bench(streams, nStreams, gTrue, chunk, &zlibTotal);
+
+  printf("%d FlateDecode streams, %ld bytes decoded per pass\n",
+	 nStreams, builtinTotal / iterations);
+  printf("builtin: %8.3f s  %8.1f MB/s\n", builtinTime,
+	 builtinTime > 0 ? builtinTotal / builtinTime / 1e6 : 0);
+  printf("zlib:    %8.3f s  %8.1f MB/s\n", zlibTime,
+	 zlibTime > 0 ? zlibTotal / zlibTime / 1e6 : 0);
+  if (mismatches) {
+    printf("%d streams decoded differently\n", mismatches);
+  }
+
+  for (i = 0; i < nStreams; ++i) {
+    gfree(streams[i].buf);
+  }
+  gfree(streams);
+  gfree(chunk);
+  delete doc;
+  delete globalParams;
+  return mismatches ? 1 : 0;
+}
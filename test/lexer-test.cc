@@ -0,0 +1,165 @@
+//========================================================================
+//
+// lexer-test.cc
+//
+// Checks that the strings of indirect objects are read whole, when they
+// are longer than the lexer's token buffer and the object is followed
+// by others.  Past the token buffer, Lexer checks that a string is still
+// in the object it started in, from the position of the lexer in the
+// file, which is not the position of the stream: the lexer reads ahead.
+// The strings are read from memory and from a file, with and without
+// escapes, and a string that isn't terminated must still stop at the end
+// of its object.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "goo/GooString.h"
+#include "GlobalParams.h"
+#include "PDFDoc.h"
+#include "XRef.h"
+#include "test-pdf.h"
+
+static int failures = 0;
+
+static void check(GBool ok, const char *what, int len) {
+  if (!ok) {
+    fprintf(stderr, "FAIL: %s (length %d)\n", what, len);
+    ++failures;
+  }
+}
+
+//------------------------------------------------------------------------
+
+// A string of <len> letters, with an escaped and a nested parenthesis
+// every 50 characters if <escapes> is set.
+static void makeString(int len, GBool escapes,
+		       std::string *value, std::string *literal) {
+  char c;
+  int i;
+
+  value->clear();
+  *literal = "(";
+  for (i = 0; i < len; ++i) {
+    if (escapes && i % 50 == 49) {
+      c = (i / 50) % 2 ? '(' : ')';
+      *value += c;
+      *literal += '\\';
+      *literal += c;
+    } else if (escapes && i % 50 == 24 && i + 2 < len) {
+      *value += "()";
+      *literal += "()";
+      ++i;
+    } else {
+      c = (char)('a' + i % 26);
+      *value += c;
+      *literal += c;
+    }
+  }
+  *literal += ")";
+}
+
+static void testDoc(PDFDoc *doc, int first, int last, int len,
+		    const std::string &value, const char *what) {
+  Object obj, item;
+  int i;
+
+  check(doc->isOk(), what, len);
+  if (!doc->isOk()) {
+    return;
+  }
+
+  // every object is followed by another one
+  for (i = 0; i < 3; ++i) {
+    doc->getXRef()->fetch(first + i, 0, &obj);
+    check(obj.isDict(), what, len);
+    if (obj.isDict()) {
+      obj.dictLookup("Title", &item);
+      check(item.isString() && item.getString()->getLength() == len &&
+	    !memcmp(item.getString()->getCString(), value.data(), len),
+	    what, len);
+      item.free();
+    }
+    obj.free();
+  }
+
+  // a string that isn't terminated doesn't run into the next object
+  doc->getXRef()->fetch(last, 0, &obj);
+  if (obj.isDict()) {
+    obj.dictLookup("Title", &item);
+    check(!item.isString() ||
+	  !strstr(item.getString()->getCString(), "endobj"),
+	  "unterminated string", len);
+    item.free();
+  }
+  obj.free();
+}
+
+static void testLength(int len, GBool escapes) {
+  TestPDF pdf;
+  PDFDoc *doc;
+  GooString *fileName;
+  std::string value, literal, file;
+  FILE *f;
+  int catalog, first, last, i;
+
+  makeString(len, escapes, &value, &literal);
+  catalog = pdf.add("<< /Type /Catalog /Pages 2 0 R >>");
+  pdf.add("<< /Type /Pages /Kids [] /Count 0 >>");
+  first = pdf.add("<< /Title " + literal + " >>");
+  for (i = 1; i < 3; ++i) {
+    pdf.add("<< /Title " + literal + " /Next " + TestPDF::ref(first + i) +
+	    " >>");
+  }
+  last = pdf.add("<< /Title (" + value);
+  pdf.add("<< /Title " + literal + " >>");
+
+  doc = pdf.open(catalog);
+  testDoc(doc, first, last, len, value, "string in memory");
+  delete doc;
+
+  file = pdf.write(catalog);
+  fileName = new GooString("lexer-test.pdf");
+  if (!(f = fopen(fileName->getCString(), "wb"))) {
+    check(gFalse, "can't write lexer-test.pdf", len);
+    delete fileName;
+    return;
+  }
+  fwrite(file.data(), 1, file.size(), f);
+  fclose(f);
+  doc = new PDFDoc(fileName->copy());
+  testDoc(doc, first, last, len, value, "string in a file");
+  delete doc;
+  remove(fileName->getCString());
+  delete fileName;
+}
+
+//------------------------------------------------------------------------
+
+int main(int argc, char *argv[]) {
+  static const int lengths[] = { 1, 127, 128, 129, 255, 256, 257, 300, 5000 };
+  int i;
+
+  globalParams = new GlobalParams();
+  globalParams->setErrQuiet(gTrue);
+
+  for (i = 0; i < (int)(sizeof(lengths) / sizeof(int)); ++i) {
+    testLength(lengths[i], gFalse);
+    testLength(lengths[i], gTrue);
+  }
+
+  delete globalParams;
+
+  if (failures) {
+    fprintf(stderr, "%d failures\n", failures);
+    return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,683 @@
+//========================================================================
+//
+// page-tree-test.cc
+//
+// Checks the page lookups of Catalog (getPage, getPageRef, getPageAttrs
+// and findPage) against a model of the sequential page tree walk, on
+// nested and unbalanced page trees, with inherited attributes, empty
+// nodes, shared subtrees and kids that are not pages.  The lookups are
+// done in different orders, on a fresh document each time.
+//
+// Broken trees, with wrong or missing /Count entries, loops, direct or
+// missing kids, must give the same results once the page tree index
+// has seen all of them: the pages looked up before may have been found
+// from /Count entries that don't match the tree.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "GlobalParams.h"
+#include "PDFDoc.h"
+#include "Catalog.h"
+#include "Page.h"
+#include "test-pdf.h"
+
+static int failures = 0;
+
+static void check(GBool ok, const char *what, const char *tree, int pg) {
+  if (!ok) {
+    fprintf(stderr, "FAIL: %s (%s, page %d)\n", what, tree, pg);
+    ++failures;
+  }
+}
+
+//------------------------------------------------------------------------
+
+static unsigned int seed = 12345;
+
+static int randomInt(int n) {
+  seed = seed * 1103515245 + 12345;
+  return (int)((seed >> 16) % (unsigned int)n);
+}
+
+//------------------------------------------------------------------------
+// page trees
+//------------------------------------------------------------------------
+
+enum TreeNodeType {
+  nodePage,			// a page object
+  nodePages,			// an intermediate node
+  nodeJunk,			// an object that is not a dictionary
+  nodeDirect,			// a page written directly in /Kids
+  nodeMissing			// a reference to a missing object
+};
+
+// /Count value for a node without /Count
+#define noCount -1
+
+struct TreeNode {
+  TreeNodeType type;
+  std::vector<int> kids;	// indices in Tree::nodes
+  int count;			// /Count written, or noCount
+  GBool realCount;		// write /Count as a real number
+  int rotate;			// /Rotate written, or -1
+  int obj;			// object number
+};
+
+// nodes[0] is the root
+struct Tree {
+  std::vector<TreeNode> nodes;
+};
+
+static int addNode(Tree *tree, TreeNodeType type) {
+  TreeNode node;
+
+  node.type = type;
+  node.count = noCount;
+  node.realCount = gFalse;
+  node.rotate = -1;
+  node.obj = -1;
+  tree->nodes.push_back(node);
+  return (int)tree->nodes.size() - 1;
+}
+
+// Number of pages below node <idx>, in a tree without loops.
+static int countPages(Tree *tree, int idx) {
+  TreeNode *node;
+  size_t i;
+  int n;
+
+  node = &tree->nodes[idx];
+  if (node->type == nodePage) {
+    return 1;
+  }
+  n = 0;
+  if (node->type == nodePages) {
+    for (i = 0; i < node->kids.size(); ++i) {
+      n += countPages(tree, node->kids[i]);
+    }
+  }
+  return n;
+}
+
+// Set the /Count of every intermediate node to its number of pages.
+static void setCounts(Tree *tree) {
+  size_t i;
+
+  for (i = 0; i < tree->nodes.size(); ++i) {
+    if (tree->nodes[i].type == nodePages) {
+      tree->nodes[i].count = countPages(tree, (int)i);
+    }
+  }
+}
+
+static PDFDoc *writeTree(TestPDF *pdf, Tree *tree) {
+  TreeNode *node;
+  std::string s;
+  char buf[64];
+  size_t i, j;
+  int catalog;
+
+  catalog = pdf->reserve();
+  for (i = 0; i < tree->nodes.size(); ++i) {
+    node = &tree->nodes[i];
+    if (node->type == nodeMissing) {
+      node->obj = 99999;
+    } else if (node->type != nodeDirect) {
+      node->obj = pdf->reserve();
+    }
+  }
+  for (i = 0; i < tree->nodes.size(); ++i) {
+    node = &tree->nodes[i];
+    switch (node->type) {
+    case nodePage:
+      // the page width identifies the page object
+      snprintf(buf, sizeof(buf), "<< /Type /Page /MediaBox [0 0 %d 100]",
+	       node->obj);
+      s = buf;
+      break;
+    case nodePages:
+      s = "<< /Type /Pages /Kids [";
+      for (j = 0; j < node->kids.size(); ++j) {
+	if (tree->nodes[node->kids[j]].type == nodeDirect) {
+	  s += " << /Type /Page /MediaBox [0 0 1 1] >>";
+	} else {
+	  s += " " + TestPDF::ref(tree->nodes[node->kids[j]].obj);
+	}
+      }
+      s += " ]";
+      if (node->count != noCount) {
+	snprintf(buf, sizeof(buf), node->realCount ? " /Count %d.0"
+						     : " /Count %d",
+		 node->count);
+	s += buf;
+      }
+      break;
+    case nodeJunk:
+      pdf->set(node->obj, "42");
+      continue;
+    default:
+      continue;
+    }
+    if (node->rotate >= 0) {
+      snprintf(buf, sizeof(buf), " /Rotate %d", node->rotate);
+      s += buf;
+    }
+    s += " >>";
+    pdf->set(node->obj, s);
+  }
+  pdf->set(catalog, "<< /Type /Catalog /Pages " +
+			TestPDF::ref(tree->nodes[0].obj) + " >>");
+  return pdf->open(catalog);
+}
+
+//------------------------------------------------------------------------
+// model
+//------------------------------------------------------------------------
+
+struct ExpectedPage {
+  int obj;
+  int rotate;
+};
+
+// Walk the kids of node <idx> the way Catalog::cachePageTree does:
+// depth first, skipping kids that are not dictionaries and kids that
+// are one of their ancestors, and stopping at a direct kid or at a page
+// past <numPages>.  Returns false when the walk stops.
+static GBool walk(Tree *tree, int idx, std::vector<int> *ancestors,
+		  int rotate, int numPages, std::vector<ExpectedPage> *pages) {
+  TreeNode *node, *kid;
+  ExpectedPage page;
+  size_t i;
+  GBool ok;
+
+  node = &tree->nodes[idx];
+  if (node->rotate >= 0) {
+    rotate = node->rotate;
+  }
+  for (i = 0; i < node->kids.size(); ++i) {
+    kid = &tree->nodes[node->kids[i]];
+    if (kid->type == nodeDirect) {
+      return gFalse;
+    }
+    if (std::find(ancestors->begin(), ancestors->end(), kid->obj) !=
+	ancestors->end()) {
+      continue;
+    }
+    if (kid->type == nodePage) {
+      if ((int)pages->size() >= numPages) {
+	return gFalse;
+      }
+      page.obj = kid->obj;
+      page.rotate = kid->rotate >= 0 ? kid->rotate : rotate;
+      pages->push_back(page);
+    } else if (kid->type == nodePages) {
+      ancestors->push_back(kid->obj);
+      ok = walk(tree, node->kids[i], ancestors, rotate, numPages, pages);
+      ancestors->pop_back();
+      if (!ok) {
+	return gFalse;
+      }
+    }
+  }
+  return gTrue;
+}
+
+static int expectedNumPages(Tree *tree) {
+  return tree->nodes[0].count > 0 ? tree->nodes[0].count : 0;
+}
+
+static void expectedPages(Tree *tree, std::vector<ExpectedPage> *pages) {
+  std::vector<int> ancestors;
+
+  pages->clear();
+  ancestors.push_back(tree->nodes[0].obj);
+  walk(tree, 0, &ancestors, 0, expectedNumPages(tree), pages);
+}
+
+//------------------------------------------------------------------------
+// lookups
+//------------------------------------------------------------------------
+
+struct Lookup {
+  Tree *tree;
+  const char *name;
+  std::vector<ExpectedPage> expected;
+  Catalog *catalog;
+  GBool indexed;		// the page tree index can be used
+  GBool strict;			// must match the model
+};
+
+// The page tree index is not used for broken trees, nor for trees with
+// a node that has kids but no pages: the index doesn't look into nodes
+// with a zero /Count, so it can't tell whether they hide pages.
+static GBool usesIndex(Tree *tree, GBool broken) {
+  size_t i;
+
+  if (broken) {
+    return gFalse;
+  }
+  for (i = 0; i < tree->nodes.size(); ++i) {
+    if (tree->nodes[i].type == nodePages && tree->nodes[i].count == 0 &&
+	!tree->nodes[i].kids.empty()) {
+      return gFalse;
+    }
+  }
+  return gTrue;
+}
+
+static void checkPage(Lookup *l, int pg) {
+  ExpectedPage *e;
+  Page *page;
+  Ref *ref;
+
+  page = l->catalog->getPage(pg);
+  ref = l->catalog->getPageRef(pg);
+  if (page) {
+    check(ref && ref->num == page->getRef().num &&
+	  ref->gen == page->getRef().gen, "getPage/getPageRef", l->name, pg);
+    check((int)page->getMediaWidth() == page->getRef().num,
+	  "page attributes", l->name, pg);
+  }
+  if (!l->strict) {
+    return;
+  }
+  if (pg <= (int)l->expected.size()) {
+    e = &l->expected[pg - 1];
+    check(page && page->getRef().num == e->obj, "getPage", l->name, pg);
+    check(ref && ref->num == e->obj, "getPageRef", l->name, pg);
+    check(page && page->getRotate() == e->rotate, "inherited /Rotate",
+	  l->name, pg);
+  } else {
+    check(!page, "getPage past the end", l->name, pg);
+    check(!ref, "getPageRef past the end", l->name, pg);
+  }
+}
+
+static void checkPageAttrs(Lookup *l, int pg) {
+  ExpectedPage *e;
+  PageAttrs *attrs;
+  Ref ref;
+
+  attrs = l->catalog->getPageAttrs(pg, &ref);
+  if (!attrs) {
+    // allowed if the page tree index can't be used
+    check(!l->indexed || pg > (int)l->expected.size(), "getPageAttrs",
+	  l->name, pg);
+    return;
+  }
+  check((int)attrs->getMediaBox()->x2 == ref.num, "getPageAttrs box",
+	l->name, pg);
+  if (l->strict && pg <= (int)l->expected.size()) {
+    e = &l->expected[pg - 1];
+    check(ref.num == e->obj, "getPageAttrs ref", l->name, pg);
+    check(attrs->getRotate() == e->rotate, "getPageAttrs /Rotate",
+	  l->name, pg);
+  }
+  delete attrs;
+}
+
+// findPage() on every object of the tree: the first page using a page
+// object, or 0.
+static void checkFindPage(Lookup *l) {
+  TreeNode *node;
+  size_t i, j;
+  int pg;
+
+  for (i = 0; i < l->tree->nodes.size(); ++i) {
+    node = &l->tree->nodes[i];
+    if (node->type == nodeDirect) {
+      continue;
+    }
+    pg = l->catalog->findPage(node->obj, 0);
+    if (l->strict) {
+      for (j = 0; j < l->expected.size(); ++j) {
+	if (l->expected[j].obj == node->obj) {
+	  break;
+	}
+      }
+      check(pg == (j < l->expected.size() ? (int)j + 1 : 0), "findPage",
+	    l->name, (int)i);
+    } else if (pg > 0) {
+      check(l->catalog->getPageRef(pg) &&
+	    l->catalog->getPageRef(pg)->num == node->obj,
+	    "findPage/getPageRef", l->name, pg);
+    }
+    check(l->catalog->findPage(node->obj, 1) == 0, "findPage, wrong gen",
+	  l->name, (int)i);
+  }
+}
+
+static void shuffle(std::vector<int> *v) {
+  int i, j, t;
+
+  for (i = (int)v->size() - 1; i > 0; --i) {
+    j = randomInt(i + 1);
+    t = (*v)[i];
+    (*v)[i] = (*v)[j];
+    (*v)[j] = t;
+  }
+}
+
+// Look up all pages of <tree> in a few orders.  The page numbers go a
+// bit past the end.  If <broken>, the results are only checked against
+// the model after findPage(), which goes through all the pages.
+static void testTree(Tree *tree, GBool broken, const char *name) {
+  std::vector<int> order;
+  TestPDF *pdf;
+  PDFDoc *doc;
+  Lookup l;
+  int numPages, pattern, i, n;
+
+  l.tree = tree;
+  l.name = name;
+  l.indexed = usesIndex(tree, broken);
+  for (pattern = 0; pattern < 4; ++pattern) {
+    pdf = new TestPDF();
+    doc = writeTree(pdf, tree);
+    expectedPages(tree, &l.expected);
+    l.catalog = doc->getCatalog();
+    numPages = l.catalog->getNumPages();
+    check(numPages == expectedNumPages(tree), "getNumPages", name, 0);
+    order.clear();
+    for (i = 1; i <= numPages + 2; ++i) {
+      order.push_back(i);
+    }
+    l.strict = !broken;
+    switch (pattern) {
+    case 0:
+      // page refs first, then pages, in random order
+      shuffle(&order);
+      for (i = 0; i < (int)order.size(); ++i) {
+	if (!l.catalog->getPageRef(order[i])) {
+	  check(!l.strict || order[i] > (int)l.expected.size(),
+		"getPageRef", name, order[i]);
+	}
+      }
+      shuffle(&order);
+      for (i = 0; i < (int)order.size(); ++i) {
+	checkPage(&l, order[i]);
+      }
+      checkFindPage(&l);
+      break;
+    case 1:
+      // by object ID first, then pages from the end
+      checkFindPage(&l);
+      l.strict = gTrue;
+      for (i = (int)order.size() - 1; i >= 0; --i) {
+	checkPage(&l, order[i]);
+      }
+      break;
+    case 2:
+      // attributes only, as DocIndex does
+      for (i = 0; i < (int)order.size(); ++i) {
+	checkPageAttrs(&l, order[i]);
+      }
+      checkFindPage(&l);
+      break;
+    case 3:
+      // a random mix
+      n = 3 * (int)order.size();
+      for (i = 0; i < n; ++i) {
+	switch (randomInt(8)) {
+	case 0:
+	  checkFindPage(&l);
+	  break;
+	case 1:
+	case 2:
+	  checkPageAttrs(&l, 1 + randomInt((int)order.size()));
+	  break;
+	default:
+	  checkPage(&l, 1 + randomInt((int)order.size()));
+	  break;
+	}
+      }
+      break;
+    }
+
+    // everything again, after findPage() has seen all pages
+    checkFindPage(&l);
+    l.strict = gTrue;
+    for (i = 0; i < (int)order.size(); ++i) {
+      checkPage(&l, order[i]);
+    }
+    checkFindPage(&l);
+    delete doc;
+    delete pdf;
+  }
+}
+
+//------------------------------------------------------------------------
+// fixed trees
+//------------------------------------------------------------------------
+
+static int addPage(Tree *tree, int parent) {
+  int idx;
+
+  idx = addNode(tree, nodePage);
+  tree->nodes[parent].kids.push_back(idx);
+  return idx;
+}
+
+static int addPages(Tree *tree, int parent) {
+  int idx;
+
+  idx = addNode(tree, nodePages);
+  tree->nodes[parent].kids.push_back(idx);
+  return idx;
+}
+
+// A page, a node with three pages, a chain of nodes with one level per
+// page, an empty node, a kid that is not a dictionary and a page.  The
+// /Rotate of the chain is inherited, and overridden by one page.
+static void makeUnbalancedTree(Tree *tree) {
+  int a, b, c, d, i;
+
+  addNode(tree, nodePages);
+  addPage(tree, 0);
+  a = addPages(tree, 0);
+  for (i = 0; i < 3; ++i) {
+    addPage(tree, a);
+  }
+  b = addPages(tree, 0);
+  tree->nodes[b].rotate = 90;
+  c = b;
+  for (i = 0; i < 4; ++i) {
+    addPage(tree, c);
+    d = addPages(tree, c);
+    c = d;
+  }
+  tree->nodes[addPage(tree, c)].rotate = 180;
+  addPage(tree, c);
+  addPages(tree, 0);
+  tree->nodes[0].kids.push_back(addNode(tree, nodeJunk));
+  addPage(tree, 0);
+  setCounts(tree);
+  tree->nodes[a].realCount = gTrue;
+}
+
+// The same node twice in the root.
+static void makeSharedTree(Tree *tree) {
+  int a;
+
+  addNode(tree, nodePages);
+  a = addPages(tree, 0);
+  addPage(tree, a);
+  addPage(tree, a);
+  tree->nodes[0].kids.push_back(a);
+  addPage(tree, 0);
+  setCounts(tree);
+}
+
+//------------------------------------------------------------------------
+// random trees
+//------------------------------------------------------------------------
+
+static void addRandomKids(Tree *tree, int parent, int depth) {
+  int n, i, r;
+
+  n = depth == 0 ? 1 + randomInt(8) : randomInt(7);
+  for (i = 0; i < n; ++i) {
+    r = randomInt(20);
+    if (r < 11 || depth >= 6) {
+      addPage(tree, parent);
+    } else if (r < 19) {
+      addRandomKids(tree, addPages(tree, parent), depth + 1);
+    } else {
+      tree->nodes[parent].kids.push_back(addNode(tree, nodeJunk));
+    }
+    if (randomInt(10) == 0) {
+      tree->nodes[tree->nodes[parent].kids.back()].rotate =
+	  90 * randomInt(4);
+    }
+  }
+}
+
+static void makeRandomTree(Tree *tree) {
+  do {
+    tree->nodes.clear();
+    addNode(tree, nodePages);
+    addRandomKids(tree, 0, 0);
+  } while (countPages(tree, 0) == 0);
+  setCounts(tree);
+}
+
+// Pick a random intermediate node other than the root, or -1.
+static int randomPagesNode(Tree *tree) {
+  std::vector<int> nodes;
+  size_t i;
+
+  for (i = 1; i < tree->nodes.size(); ++i) {
+    if (tree->nodes[i].type == nodePages) {
+      nodes.push_back((int)i);
+    }
+  }
+  return nodes.empty() ? -1 : nodes[randomInt((int)nodes.size())];
+}
+
+// Find the path from the root to node <idx>, in a tree without loops.
+static GBool findPath(Tree *tree, int node, int idx, std::vector<int> *path) {
+  size_t i;
+
+  path->push_back(node);
+  if (node == idx) {
+    return gTrue;
+  }
+  for (i = 0; i < tree->nodes[node].kids.size(); ++i) {
+    if (findPath(tree, tree->nodes[node].kids[i], idx, path)) {
+      return gTrue;
+    }
+  }
+  path->pop_back();
+  return gFalse;
+}
+
+// Break a random tree in one of a few ways.
+static void breakTree(Tree *tree) {
+  std::vector<int> path;
+  TreeNode *node;
+  int idx, i;
+
+  idx = randomPagesNode(tree);
+  if (idx < 0) {
+    idx = 0;
+  }
+  node = &tree->nodes[idx];
+  switch (randomInt(7)) {
+  case 0:
+    // wrong /Count
+    node->count += randomInt(2) ? 1 + randomInt(2) : -1 - randomInt(2);
+    if (node->count < 0) {
+      node->count = 0;
+    }
+    break;
+  case 1:
+    // pages hidden behind a zero /Count
+    node->count = 0;
+    break;
+  case 2:
+    // no /Count
+    if (idx > 0) {
+      node->count = noCount;
+    }
+    break;
+  case 3:
+    // a kid that is one of the node's ancestors
+    findPath(tree, 0, idx, &path);
+    i = path[randomInt((int)path.size())];
+    tree->nodes[idx].kids.insert(tree->nodes[idx].kids.begin() +
+				 randomInt((int)node->kids.size() + 1), i);
+    break;
+  case 4:
+    // a page written in /Kids
+    i = addNode(tree, nodeDirect);
+    tree->nodes[idx].kids.insert(tree->nodes[idx].kids.begin() +
+				 randomInt((int)tree->nodes[idx].kids.size()
+					   + 1), i);
+    break;
+  case 5:
+    // a missing kid
+    i = addNode(tree, nodeMissing);
+    tree->nodes[idx].kids.insert(tree->nodes[idx].kids.begin() +
+				 randomInt((int)tree->nodes[idx].kids.size()
+					   + 1), i);
+    break;
+  case 6:
+    // wrong page count in the root
+    tree->nodes[0].count += randomInt(2) ? 1 + randomInt(2) : -1;
+    if (tree->nodes[0].count < 1) {
+      tree->nodes[0].count = 1;
+    }
+    break;
+  }
+}
+
+//------------------------------------------------------------------------
+
+int main(int argc, char *argv[]) {
+  Tree tree;
+  char name[64];
+  int iter;
+
+  globalParams = new GlobalParams();
+  globalParams->setErrQuiet(gTrue);
+
+  makeUnbalancedTree(&tree);
+  testTree(&tree, gFalse, "unbalanced tree");
+  tree.nodes.clear();
+  makeSharedTree(&tree);
+  testTree(&tree, gFalse, "shared subtree");
+
+  // a kid of the first node claims one page more than it has: the pages
+  // after it are shifted until the index notices
+  tree.nodes.clear();
+  makeSharedTree(&tree);
+  ++tree.nodes[1].count;
+  tree.nodes[0].count += 2;
+  testTree(&tree, gTrue, "shifted pages");
+
+  for (iter = 0; iter < 60; ++iter) {
+    makeRandomTree(&tree);
+    snprintf(name, sizeof(name), "random tree %d", iter);
+    testTree(&tree, gFalse, name);
+    breakTree(&tree);
+    snprintf(name, sizeof(name), "broken random tree %d", iter);
+    testTree(&tree, gTrue, name);
+  }
+
+  delete globalParams;
+
+  if (failures) {
+    fprintf(stderr, "%d failures\n", failures);
+    return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
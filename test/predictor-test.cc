@@ -0,0 +1,398 @@
+//========================================================================
+//
+// predictor-test.cc
+//
+// Checks the PNG and TIFF predictor kernels against the byte at a time
+// loop StreamPredictor used before them, on random rows of 1 to 8, 16
+// and 64 bytes per pixel, including partial rows.  Then decodes random
+// images through Flate streams with PNG and TIFF predictors, whole and
+// truncated in the middle of a row.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "goo/gmem.h"
+#include "GlobalParams.h"
+#include "Object.h"
+#include "Stream.h"
+#include "XRef.h"
+#include "PDFDoc.h"
+#include "GfxState.h"
+#include "PredictorKernels.h"
+#include "test-pdf.h"
+
+#define maxRowBytes 600
+
+static int failures = 0;
+
+static void check(GBool ok, const char *what, int pred, int bpp, int len) {
+  if (!ok) {
+    fprintf(stderr, "FAIL: %s (predictor %d, %d bytes per pixel, %d bytes)\n",
+	    what, pred, bpp, len);
+    ++failures;
+  }
+}
+
+//------------------------------------------------------------------------
+
+static unsigned int seed = 4321;
+
+static int randomInt(int n) {
+  seed = seed * 1103515245 + 12345;
+  return (int)((seed >> 16) % (unsigned int)n);
+}
+
+static void fillRandom(Guchar *p, int n) {
+  int i;
+
+  for (i = 0; i < n; ++i) {
+    p[i] = (Guchar)randomInt(256);
+  }
+}
+
+//------------------------------------------------------------------------
+// the PNG predictor loop of StreamPredictor::getNextLine before the
+// kernels, with <pixBytes> zero bytes in front of the row in <predLine>
+//------------------------------------------------------------------------
+
+static void oldUndoRow(Guchar *predLine, int pixBytes, int rowBytes,
+		       int curPred, Guchar *raw, int n) {
+  Guchar upLeftBuf[predictorMaxPixBytes + 1];
+  int left, up, upLeft, p, pa, pb, pc;
+  int c, i, j;
+
+  memset(upLeftBuf, 0, pixBytes + 1);
+  for (i = pixBytes; i < rowBytes; ++i) {
+    for (j = pixBytes; j > 0; --j) {
+      upLeftBuf[j] = upLeftBuf[j-1];
+    }
+    upLeftBuf[0] = predLine[i];
+    if (i - pixBytes >= n) {
+      break;
+    }
+    c = raw[i - pixBytes];
+    switch (curPred) {
+    case 11:			// PNG sub
+      predLine[i] = predLine[i - pixBytes] + (Guchar)c;
+      break;
+    case 12:			// PNG up
+      predLine[i] = predLine[i] + (Guchar)c;
+      break;
+    case 13:			// PNG average
+      predLine[i] = ((predLine[i - pixBytes] + predLine[i]) >> 1) +
+	            (Guchar)c;
+      break;
+    case 14:			// PNG Paeth
+      left = predLine[i - pixBytes];
+      up = predLine[i];
+      upLeft = upLeftBuf[pixBytes];
+      p = left + up - upLeft;
+      if ((pa = p - left) < 0)
+	pa = -pa;
+      if ((pb = p - up) < 0)
+	pb = -pb;
+      if ((pc = p - upLeft) < 0)
+	pc = -pc;
+      if (pa <= pb && pa <= pc)
+	predLine[i] = left + (Guchar)c;
+      else if (pb <= pc)
+	predLine[i] = up + (Guchar)c;
+      else
+	predLine[i] = upLeft + (Guchar)c;
+      break;
+    default:
+      predLine[i] = (Guchar)c;
+      break;
+    }
+  }
+}
+
+// the TIFF predictor loop for 8-bit components
+static void oldUndoTIFF(Guchar *predLine, int pixBytes, int rowBytes,
+			int nComps) {
+  int i;
+
+  for (i = pixBytes; i < rowBytes; ++i) {
+    predLine[i] += predLine[i - nComps];
+  }
+}
+
+//------------------------------------------------------------------------
+
+static void testKernels(int bpp) {
+  Guchar rowBuf[predictorMaxPixBytes + maxRowBytes];
+  Guchar refBuf[predictorMaxPixBytes + maxRowBytes];
+  Guchar raw[maxRowBytes];
+  Guchar *row;
+  int rowBytes, len, pred, y, iter;
+
+  row = rowBuf + bpp;
+  for (iter = 0; iter < 20; ++iter) {
+    // whole rows, most of the time, of 1 to 30 pixels
+    rowBytes = (randomInt(30) + 1) * bpp;
+    if (rowBytes > maxRowBytes) {
+      rowBytes = maxRowBytes;
+    }
+    memset(rowBuf, 0, sizeof(rowBuf));
+    fillRandom(row, rowBytes);
+    memcpy(refBuf, rowBuf, sizeof(rowBuf));
+    for (y = 0; y < 20; ++y) {
+      pred = 11 + randomInt(4);
+      len = randomInt(4) ? rowBytes : randomInt(rowBytes + 1);
+      fillRandom(raw, len);
+      oldUndoRow(refBuf, bpp, bpp + rowBytes, pred, raw, len);
+      switch (pred) {
+      case 11:
+	predictorUndoSub(row, raw, len, bpp);
+	break;
+      case 12:
+	predictorUndoUp(row, raw, len);
+	break;
+      case 13:
+	predictorUndoAverage(row, raw, len, bpp);
+	break;
+      case 14:
+	predictorUndoPaeth(row, raw, len, bpp);
+	break;
+      }
+      check(!memcmp(rowBuf, refBuf, bpp + rowBytes), "PNG kernel",
+	    pred, bpp, len);
+      // resync after a failure, to report each row once
+      memcpy(refBuf, rowBuf, sizeof(rowBuf));
+    }
+
+    // the TIFF predictor undoes Sub in place
+    if (bpp <= gfxColorMaxComps) {
+      oldUndoTIFF(refBuf, bpp, bpp + rowBytes, bpp);
+      predictorUndoSub(row, row, rowBytes, bpp);
+      check(!memcmp(rowBuf, refBuf, bpp + rowBytes), "TIFF kernel",
+	    2, bpp, rowBytes);
+    }
+  }
+}
+
+//------------------------------------------------------------------------
+// streams
+//------------------------------------------------------------------------
+
+// Wrap <data> in a zlib stream made of stored deflate blocks.
+static std::string storeZlib(const std::string &data) {
+  std::string s;
+  Guint a, b;
+  size_t pos, n, i;
+
+  s += (char)0x78;
+  s += (char)0x01;
+  pos = 0;
+  do {
+    n = data.size() - pos;
+    if (n > 65535) {
+      n = 65535;
+    }
+    s += (char)(pos + n == data.size() ? 1 : 0);
+    s += (char)(n & 0xff);
+    s += (char)(n >> 8);
+    s += (char)(~n & 0xff);
+    s += (char)((~n >> 8) & 0xff);
+    s.append(data, pos, n);
+    pos += n;
+  } while (pos < data.size());
+  a = 1;
+  b = 0;
+  for (i = 0; i < data.size(); ++i) {
+    a = (a + (Guchar)data[i]) % 65521;
+    b = (b + a) % 65521;
+  }
+  s += (char)(b >> 8);
+  s += (char)(b & 0xff);
+  s += (char)(a >> 8);
+  s += (char)(a & 0xff);
+  return s;
+}
+
+static int paethPredictor(int left, int up, int upLeft) {
+  int p, pa, pb, pc;
+
+  p = left + up - upLeft;
+  pa = p > left ? p - left : left - p;
+  pb = p > up ? p - up : up - p;
+  pc = p > upLeft ? p - upLeft : upLeft - p;
+  if (pa <= pb && pa <= pc) {
+    return left;
+  }
+  return pb <= pc ? up : upLeft;
+}
+
+// Apply a random PNG filter to each row of <image>.
+static std::string encodePNG(const std::vector<Guchar> &image, int rowBytes,
+			     int bpp) {
+  std::string s;
+  int nRows, pred, y, i, left, up, upLeft, pr;
+
+  nRows = (int)image.size() / rowBytes;
+  for (y = 0; y < nRows; ++y) {
+    pred = randomInt(5);
+    s += (char)pred;
+    for (i = 0; i < rowBytes; ++i) {
+      left = i >= bpp ? image[y * rowBytes + i - bpp] : 0;
+      up = y > 0 ? image[(y - 1) * rowBytes + i] : 0;
+      upLeft = y > 0 && i >= bpp ? image[(y - 1) * rowBytes + i - bpp] : 0;
+      switch (pred) {
+      case 1: pr = left; break;
+      case 2: pr = up; break;
+      case 3: pr = (left + up) >> 1; break;
+      case 4: pr = paethPredictor(left, up, upLeft); break;
+      default: pr = 0; break;
+      }
+      s += (char)(Guchar)(image[y * rowBytes + i] - pr);
+    }
+  }
+  return s;
+}
+
+// Apply the TIFF predictor to 8-bit components.
+static std::string encodeTIFF(const std::vector<Guchar> &image, int rowBytes,
+			      int nComps) {
+  std::string s;
+  int y, i;
+
+  for (y = 0; y < (int)image.size() / rowBytes; ++y) {
+    for (i = 0; i < rowBytes; ++i) {
+      s += (char)(Guchar)(image[y * rowBytes + i] -
+			  (i >= nComps ? image[y * rowBytes + i - nComps] : 0));
+    }
+  }
+  return s;
+}
+
+// Decode <filtered> the old way, as the PNG predictor streams did.
+static std::vector<Guchar> oldDecodePNG(const std::string &filtered,
+					int rowBytes, int bpp) {
+  std::vector<Guchar> out;
+  std::vector<Guchar> predLine(bpp + rowBytes, 0);
+  size_t pos;
+  int n;
+
+  for (pos = 0; pos + 1 < filtered.size(); pos += 1 + rowBytes) {
+    n = (int)(filtered.size() - pos - 1);
+    if (n > rowBytes) {
+      n = rowBytes;
+    }
+    oldUndoRow(&predLine[0], bpp, bpp + rowBytes, filtered[pos] + 10,
+	       (Guchar *)filtered.data() + pos + 1, n);
+    out.insert(out.end(), predLine.begin() + bpp, predLine.end());
+  }
+  return out;
+}
+
+static std::vector<Guchar> readAll(TestPDF *pdf, int num, int root) {
+  std::vector<Guchar> out;
+  PDFDoc *doc;
+  Object obj;
+  Guchar buf[97];
+  int n;
+
+  doc = pdf->open(root);
+  if (doc->getXRef()->fetch(num, 0, &obj)->isStream()) {
+    obj.streamReset();
+    // odd sized reads, to cross row boundaries
+    while ((n = obj.getStream()->doGetChars(sizeof(buf), buf)) > 0) {
+      out.insert(out.end(), buf, buf + n);
+    }
+  }
+  obj.free();
+  delete doc;
+  return out;
+}
+
+static void testStream(int predictor, int colors, int bits, int columns,
+		       GBool truncate) {
+  TestPDF pdf;
+  std::vector<Guchar> image, expected, decoded;
+  std::string filtered, dict;
+  char params[128];
+  int root, bpp, rowBytes, rows, num;
+
+  bpp = (colors * bits + 7) / 8;
+  rowBytes = (columns * colors * bits + 7) / 8;
+  rows = randomInt(20) + 1;
+  image.resize(rows * rowBytes);
+  fillRandom(&image[0], (int)image.size());
+
+  if (predictor >= 10) {
+    filtered = encodePNG(image, rowBytes, bpp);
+  } else {
+    filtered = encodeTIFF(image, rowBytes, colors);
+  }
+  expected = image;
+  if (truncate) {
+    // cut the last row in the middle, the partial row is returned with
+    // the rest taken from the previous row
+    filtered.resize(filtered.size() - 1 - randomInt(rowBytes - 1));
+    if (predictor >= 10) {
+      expected = oldDecodePNG(filtered, rowBytes, bpp);
+    } else {
+      expected.resize(filtered.size());
+    }
+  }
+
+  root = pdf.reserve();
+  snprintf(params, sizeof(params),
+	   " /DecodeParms << /Predictor %d /Colors %d"
+	   " /BitsPerComponent %d /Columns %d >>",
+	   predictor, colors, bits, columns);
+  dict = std::string("/Filter /FlateDecode") + params;
+  num = pdf.addStream(dict, storeZlib(filtered));
+  pdf.set(root, "<< /Type /Catalog /Pages " +
+	  TestPDF::ref(pdf.add("<< /Type /Pages /Kids [] /Count 0 >>")) +
+	  " >>");
+  decoded = readAll(&pdf, num, root);
+  if (truncate && predictor < 10) {
+    // the TIFF predictor is applied to the whole partial row, only the
+    // bytes that were read are checked
+    decoded.resize(expected.size() < decoded.size() ? expected.size()
+						     : decoded.size());
+  }
+  check(decoded == expected, truncate ? "truncated stream" : "stream",
+	predictor, bpp, rowBytes);
+}
+
+//------------------------------------------------------------------------
+
+int main(int argc, char *argv[]) {
+  static const int pixSizes[] = { 1, 2, 3, 4, 5, 6, 7, 8, 16, 64 };
+  int i, colors, bits, iter;
+
+  globalParams = new GlobalParams();
+
+  for (i = 0; i < (int)(sizeof(pixSizes) / sizeof(int)); ++i) {
+    testKernels(pixSizes[i]);
+  }
+
+  for (iter = 0; iter < 4; ++iter) {
+    for (colors = 1; colors <= 4; ++colors) {
+      for (bits = 1; bits <= 16; bits *= 2) {
+	testStream(15, colors, bits, randomInt(40) + 1, gFalse);
+	testStream(15, colors, bits, randomInt(40) + 16, gTrue);
+      }
+      testStream(2, colors, 8, randomInt(40) + 1, gFalse);
+      testStream(2, colors, 8, randomInt(40) + 16, gTrue);
+    }
+  }
+
+  delete globalParams;
+
+  if (failures) {
+    fprintf(stderr, "%d failures\n", failures);
+    return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,538 @@
+//========================================================================
+//
+// splash-area-test.cc
+//
+// Checks the exact-area coverage computed by SplashXPathRasterizer
+// against the 4x4 supersampling of SplashXPathScanner::renderAALine.
+//
+// Polygons, fixed ones and random self-intersecting ones, are filled
+// with the even-odd and the non-zero winding rule and compared pixel by
+// pixel with a reference: the area of the polygon clipped to the pixel.
+// That area is the integral of the winding number, which is the
+// coverage wherever the winding number only takes the values 0 and one
+// of +1 or -1 within the pixel.  The rasterizer applies the fill rule
+// to the same integral, so it must match the reference on those pixels;
+// on the others (crossings, overlaps) it is an approximation and only
+// checked against the fill rule.  The 4x4 supersampling must not be
+// closer to the reference than the exact coverage is.
+//
+// A circle made of Bezier curves is compared on its total area, and a
+// few shapes are filled through Splash with and without area
+// anti-aliasing.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "splash/SplashBitmap.h"
+#include "splash/SplashPath.h"
+#include "splash/SplashXPath.h"
+#include "splash/SplashXPathScanner.h"
+#include "splash/SplashXPathRasterizer.h"
+#include "splash/SplashPattern.h"
+#include "splash/Splash.h"
+
+// size of the test area, in pixels
+#define width 40
+#define height 40
+
+// samples per pixel side used to find the winding numbers in a pixel
+#define windingSamples 32
+
+// most vertices in a test polygon
+#define maxPoints 16
+
+static int failures = 0;
+
+static void check(GBool ok, const char *what, const char *shape) {
+  if (!ok) {
+    fprintf(stderr, "FAIL: %s (%s)\n", what, shape);
+    ++failures;
+  }
+}
+
+//------------------------------------------------------------------------
+
+static unsigned int seed = 12345;
+
+static int randomInt(int n) {
+  seed = seed * 1103515245 + 12345;
+  return (int)((seed >> 16) % (unsigned int)n);
+}
+
+// A random coordinate in [lo, hi].
+static double randomCoord(double lo, double hi) {
+  return lo + (hi - lo) * randomInt(65537) / 65536.0;
+}
+
+//------------------------------------------------------------------------
+// reference coverage
+//------------------------------------------------------------------------
+
+struct Polygon {
+  double x[maxPoints], y[maxPoints];
+  int n;
+};
+
+static void addPoint(Polygon *poly, double x, double y) {
+  poly->x[poly->n] = x;
+  poly->y[poly->n] = y;
+  ++poly->n;
+}
+
+static SplashPath *makePath(Polygon *poly) {
+  SplashPath *path;
+  int i;
+
+  path = new SplashPath();
+  path->moveTo(poly->x[0], poly->y[0]);
+  for (i = 1; i < poly->n; ++i) {
+    path->lineTo(poly->x[i], poly->y[i]);
+  }
+  path->close();
+  return path;
+}
+
+static void randomPolygon(Polygon *poly) {
+  int i;
+
+  // mostly inside, sometimes out of the computed area
+  poly->n = 3 + randomInt(maxPoints - 2);
+  for (i = 0; i < poly->n; ++i) {
+    poly->x[i] = randomCoord(-4, width + 4);
+    poly->y[i] = randomCoord(-4, height + 4);
+  }
+}
+
+static int winding(Polygon *poly, double x, double y) {
+  double xa, ya, xb, yb;
+  int i, count;
+
+  count = 0;
+  for (i = 0; i < poly->n; ++i) {
+    xa = poly->x[i];
+    ya = poly->y[i];
+    xb = poly->x[(i + 1) % poly->n];
+    yb = poly->y[(i + 1) % poly->n];
+    if ((ya <= y) != (yb <= y) &&
+	x < xa + (y - ya) * (xb - xa) / (yb - ya)) {
+      count += ya < yb ? 1 : -1;
+    }
+  }
+  return count;
+}
+
+// Clip the polygon (<x>, <y>, <n>) to one side of a pixel edge, in
+// place: the side where <sign> * (coordinate <axis> - <c>) >= 0.
+static void clipSide(double *x, double *y, int *n, int axis, double c,
+		     double sign) {
+  double xo[2 * maxPoints + 8], yo[2 * maxPoints + 8];
+  double da, db, t;
+  int i, j, m;
+
+  m = 0;
+  for (i = 0; i < *n; ++i) {
+    j = (i + 1) % *n;
+    da = sign * ((axis ? y[i] : x[i]) - c);
+    db = sign * ((axis ? y[j] : x[j]) - c);
+    if (da >= 0) {
+      xo[m] = x[i];
+      yo[m] = y[i];
+      ++m;
+    }
+    if ((da >= 0) != (db >= 0)) {
+      t = da / (da - db);
+      xo[m] = x[i] + t * (x[j] - x[i]);
+      yo[m] = y[i] + t * (y[j] - y[i]);
+      ++m;
+    }
+  }
+  memcpy(x, xo, m * sizeof(double));
+  memcpy(y, yo, m * sizeof(double));
+  *n = m;
+}
+
+// Integral of the winding number of <poly> over pixel (<px>, <py>): the
+// signed area of the polygon clipped to the pixel.
+static double windingArea(Polygon *poly, int px, int py) {
+  double x[2 * maxPoints + 8], y[2 * maxPoints + 8];
+  double a;
+  int n, i;
+
+  n = poly->n;
+  memcpy(x, poly->x, n * sizeof(double));
+  memcpy(y, poly->y, n * sizeof(double));
+  clipSide(x, y, &n, 0, px, 1);
+  clipSide(x, y, &n, 0, px + 1, -1);
+  clipSide(x, y, &n, 1, py, 1);
+  clipSide(x, y, &n, 1, py + 1, -1);
+  a = 0;
+  for (i = 0; i < n; ++i) {
+    a += x[i] * y[(i + 1) % n] - x[(i + 1) % n] * y[i];
+  }
+  // y goes down, so the edges going down (winding +1) run clockwise
+  return -a / 2;
+}
+
+// Reference coverage of each pixel, in [0, 1], and whether it is exact:
+// whether the winding number stays within 0 and one of +1 or -1 in the
+// pixel, as far as a grid of samples can tell.
+static void referenceCoverage(Polygon *poly, double *cov, GBool *exact) {
+  int x, y, i, j, w, wMin, wMax;
+
+  for (y = 0; y < height; ++y) {
+    for (x = 0; x < width; ++x) {
+      wMin = wMax = 0;
+      for (j = 0; j < windingSamples; ++j) {
+	for (i = 0; i < windingSamples; ++i) {
+	  w = winding(poly, x + (i + 0.5) / windingSamples,
+		      y + (j + 0.5) / windingSamples);
+	  if (w < wMin) {
+	    wMin = w;
+	  }
+	  if (w > wMax) {
+	    wMax = w;
+	  }
+	}
+      }
+      cov[y * width + x] = fabs(windingArea(poly, x, y));
+      exact[y * width + x] = (wMin == 0 && wMax <= 1) ||
+			     (wMax == 0 && wMin >= -1);
+    }
+  }
+}
+
+//------------------------------------------------------------------------
+// rasterizers
+//------------------------------------------------------------------------
+
+// Coverage computed by SplashXPathRasterizer, in [0, 1].
+static void areaCoverage(SplashPath *path, GBool eo, double *cov) {
+  SplashCoord matrix[6] = { 1, 0, 0, 1, 0, 0 };
+  SplashXPath *xPath;
+  SplashXPathRasterizer *rasterizer;
+  Guchar *line;
+  int x0, x1, x, y;
+
+  memset(cov, 0, width * height * sizeof(double));
+  xPath = new SplashXPath(path, matrix, 0.1, gTrue, gFalse, 0, gTrue);
+  xPath->sort();
+  rasterizer = new SplashXPathRasterizer(xPath, eo, 1, 0, width - 1);
+  for (y = 0; y < height; ++y) {
+    if ((line = rasterizer->renderLine(y, &x0, &x1))) {
+      for (x = x0; x <= x1; ++x) {
+	cov[y * width + x] = line[x - x0] / 255.0;
+      }
+    }
+  }
+  delete rasterizer;
+  delete xPath;
+}
+
+// Coverage computed by the 4x4 supersampling, in [0, 1].
+static void aaCoverage(SplashPath *path, GBool eo, double *cov) {
+  SplashCoord matrix[6] = { 1, 0, 0, 1, 0, 0 };
+  SplashXPath *xPath;
+  SplashXPathScanner *scanner;
+  SplashBitmap *aaBuf;
+  Guchar *row;
+  int x0, x1, x, y, xx, yy, n;
+
+  memset(cov, 0, width * height * sizeof(double));
+  aaBuf = new SplashBitmap(splashAASize * width, splashAASize, 1,
+			   splashModeMono1, gFalse);
+  xPath = new SplashXPath(path, matrix, 0.1, gTrue);
+  xPath->aaScale();
+  xPath->sort();
+  scanner = new SplashXPathScanner(xPath, eo, 0, splashAASize * height - 1);
+  for (y = 0; y < height; ++y) {
+    scanner->renderAALine(aaBuf, &x0, &x1, y);
+    for (x = x0 < 0 ? 0 : x0; x <= x1 && x < width; ++x) {
+      n = 0;
+      for (yy = 0; yy < splashAASize; ++yy) {
+	row = aaBuf->getDataPtr() + yy * aaBuf->getRowSize();
+	for (xx = splashAASize * x; xx < splashAASize * (x + 1); ++xx) {
+	  if (row[xx >> 3] & (0x80 >> (xx & 7))) {
+	    ++n;
+	  }
+	}
+      }
+      cov[y * width + x] = (double)n / (splashAASize * splashAASize);
+    }
+  }
+  delete scanner;
+  delete xPath;
+  delete aaBuf;
+}
+
+//------------------------------------------------------------------------
+// polygons
+//------------------------------------------------------------------------
+
+static void testPolygon(Polygon *poly, GBool eo, const char *name) {
+  static double ref[width * height], area[width * height];
+  static double aa[width * height];
+  static GBool exact[width * height];
+  SplashPath *path;
+  double maxErr, errArea, errAA, w;
+  int i, x, y;
+
+  path = makePath(poly);
+  referenceCoverage(poly, ref, exact);
+  areaCoverage(path, eo, area);
+  aaCoverage(path, eo, aa);
+  delete path;
+
+  maxErr = errArea = errAA = 0;
+  for (i = 0; i < width * height; ++i) {
+    if (exact[i]) {
+      if (fabs(area[i] - ref[i]) > maxErr) {
+	maxErr = fabs(area[i] - ref[i]);
+      }
+      errArea += fabs(area[i] - ref[i]);
+      errAA += fabs(aa[i] - ref[i]);
+    } else {
+      // the fill rule applied to the mean winding number
+      x = i % width;
+      y = i / width;
+      w = fabs(windingArea(poly, x, y));
+      if (eo) {
+	w -= 2 * floor(w / 2);
+	if (w > 1) {
+	  w = 2 - w;
+	}
+      } else if (w > 1) {
+	w = 1;
+      }
+      check(fabs(area[i] - w) <= 1.0 / 255, "approximated pixel", name);
+    }
+  }
+  check(maxErr <= 1.0 / 255, "pixel coverage", name);
+  check(errArea <= errAA, "closer to the reference than 4x4", name);
+}
+
+static void testFixedPolygons() {
+  Polygon poly;
+  double a;
+  int i;
+
+  // pixel aligned rectangle: no partial pixels at all
+  poly.n = 0;
+  addPoint(&poly, 4, 4);
+  addPoint(&poly, 20, 4);
+  addPoint(&poly, 20, 12);
+  addPoint(&poly, 4, 12);
+  testPolygon(&poly, gFalse, "aligned rectangle");
+
+  // rectangle on quarter pixels, where the 4x4 samples are exact too
+  poly.n = 0;
+  addPoint(&poly, 4.25, 4.75);
+  addPoint(&poly, 20.5, 4.75);
+  addPoint(&poly, 20.5, 12.25);
+  addPoint(&poly, 4.25, 12.25);
+  testPolygon(&poly, gFalse, "quarter pixel rectangle");
+
+  // thin slivers, narrower than a pixel and than a 4x4 sample
+  poly.n = 0;
+  addPoint(&poly, 2.1, 3.3);
+  addPoint(&poly, 2.3, 3.3);
+  addPoint(&poly, 37.4, 35.1);
+  addPoint(&poly, 37.2, 35.1);
+  testPolygon(&poly, gFalse, "thin sliver");
+  poly.n = 0;
+  addPoint(&poly, 1.5, 20.05);
+  addPoint(&poly, 38.5, 20.05);
+  addPoint(&poly, 38.5, 20.15);
+  addPoint(&poly, 1.5, 20.15);
+  testPolygon(&poly, gFalse, "horizontal hairline");
+
+  // triangle sticking out of the computed range on both sides
+  poly.n = 0;
+  addPoint(&poly, -10.3, 2.7);
+  addPoint(&poly, 50.6, 15.2);
+  addPoint(&poly, 10.1, 37.9);
+  testPolygon(&poly, gFalse, "clipped triangle");
+
+  // pentagram: the center is filled only with the non-zero rule
+  poly.n = 0;
+  for (i = 0; i < 5; ++i) {
+    a = 0.3 + i * 4 * M_PI / 5;
+    addPoint(&poly, 20.2 + 17.5 * cos(a), 19.7 + 17.5 * sin(a));
+  }
+  testPolygon(&poly, gFalse, "pentagram, non-zero");
+  testPolygon(&poly, gTrue, "pentagram, even-odd");
+}
+
+static void testRandomPolygons() {
+  Polygon poly;
+  char name[64];
+  int iter;
+
+  for (iter = 0; iter < 40; ++iter) {
+    randomPolygon(&poly);
+    sprintf(name, "random polygon %d", iter);
+    testPolygon(&poly, iter & 1, name);
+  }
+}
+
+//------------------------------------------------------------------------
+// curves
+//------------------------------------------------------------------------
+
+// Circle of radius 15, made of four Bezier curves, with a square hole
+// running the same way: the hole is filled only with the non-zero rule.
+static void testCircle(GBool eo, const char *name) {
+  static double area[width * height], aa[width * height];
+  SplashPath *path;
+  double k, sumArea, sumAA, expected;
+  int i;
+
+  k = 0.5523 * 15;
+  path = new SplashPath();
+  path->moveTo(35.3, 20.1);
+  path->curveTo(35.3, 20.1 + k, 20.3 + k, 35.1, 20.3, 35.1);
+  path->curveTo(20.3 - k, 35.1, 5.3, 20.1 + k, 5.3, 20.1);
+  path->curveTo(5.3, 20.1 - k, 20.3 - k, 5.1, 20.3, 5.1);
+  path->curveTo(20.3 + k, 5.1, 35.3, 20.1 - k, 35.3, 20.1);
+  path->close();
+  path->moveTo(14.6, 14.4);
+  path->lineTo(26.2, 14.4);
+  path->lineTo(26.2, 25.9);
+  path->lineTo(14.6, 25.9);
+  path->close();
+  areaCoverage(path, eo, area);
+  aaCoverage(path, eo, aa);
+  delete path;
+
+  sumArea = sumAA = 0;
+  for (i = 0; i < width * height; ++i) {
+    sumArea += area[i];
+    sumAA += aa[i];
+  }
+  expected = M_PI * 15 * 15;
+  if (eo) {
+    expected -= 11.6 * 11.5;
+  }
+  // the curves are flattened to within 0.1 pixel
+  check(fabs(sumArea - expected) <= 0.005 * expected, "circle area", name);
+  check(fabs(sumArea - expected) <= fabs(sumAA - expected),
+	"circle area closer than 4x4", name);
+}
+
+//------------------------------------------------------------------------
+// Splash fills
+//------------------------------------------------------------------------
+
+// Fill <path> in white on black through Splash, with or without area
+// anti-aliasing.
+static SplashBitmap *render(SplashPath *path, GBool eo, GBool areaAA) {
+  SplashColor black, white;
+  SplashBitmap *bitmap;
+  Splash *splash;
+
+  black[0] = 0x00;
+  white[0] = 0xff;
+  bitmap = new SplashBitmap(width, height, 1, splashModeMono8, gFalse);
+  splash = new Splash(bitmap, gTrue);
+  splash->setAreaAntialias(areaAA);
+  splash->clear(black);
+  splash->setFillPattern(new SplashSolidColor(white));
+  splash->fill(path, eo);
+  delete splash;
+  return bitmap;
+}
+
+// Both fills must paint the pixels with a neighbourhood that is all
+// inside the polygon, and leave alone the ones with a neighbourhood all
+// outside of it; the 4x4 samples can spill over into a next pixel, but
+// not further.  The area fill must put the same coverage through the
+// gamma table as the 4x4 one: where the 4x4 coverage is exact, both
+// fills give the same pixel.
+static void testSplashFill(Polygon *poly, GBool eo, const char *name) {
+  static double ref[width * height], area[width * height];
+  static double aa[width * height];
+  static GBool exact[width * height];
+  SplashPath *path;
+  SplashBitmap *aaBitmap, *areaBitmap;
+  Guchar pixAA, pixArea;
+  int x, y, dx, dy, i;
+  GBool flat;
+
+  path = makePath(poly);
+  referenceCoverage(poly, ref, exact);
+  areaCoverage(path, eo, area);
+  aaCoverage(path, eo, aa);
+  aaBitmap = render(path, eo, gFalse);
+  areaBitmap = render(path, eo, gTrue);
+  delete path;
+
+  for (y = 0; y < height; ++y) {
+    for (x = 0; x < width; ++x) {
+      i = y * width + x;
+      pixAA = aaBitmap->getDataPtr()[y * aaBitmap->getRowSize() + x];
+      pixArea = areaBitmap->getDataPtr()[y * areaBitmap->getRowSize() + x];
+      flat = gTrue;
+      for (dy = -1; dy <= 1; ++dy) {
+	for (dx = -1; dx <= 1; ++dx) {
+	  if (x + dx >= 0 && x + dx < width &&
+	      y + dy >= 0 && y + dy < height &&
+	      (!exact[i + dy * width + dx] ||
+	       ref[i + dy * width + dx] != ref[i])) {
+	    flat = gFalse;
+	  }
+	}
+      }
+      if (flat && (ref[i] == 0 || ref[i] == 1)) {
+	check(pixAA == (ref[i] == 0 ? 0 : 255),
+	      "4x4 fill of a flat pixel", name);
+	check(pixArea == (ref[i] == 0 ? 0 : 255),
+	      "area fill of a flat pixel", name);
+      }
+      if (exact[i] && area[i] == aa[i]) {
+	check(pixArea == pixAA, "same coverage, same pixel", name);
+      }
+    }
+  }
+  delete aaBitmap;
+  delete areaBitmap;
+}
+
+static void testSplashFills() {
+  Polygon poly;
+  double a;
+  int i;
+
+  poly.n = 0;
+  for (i = 0; i < 5; ++i) {
+    a = 0.3 + i * 4 * M_PI / 5;
+    addPoint(&poly, 20.2 + 17.5 * cos(a), 19.7 + 17.5 * sin(a));
+  }
+  testSplashFill(&poly, gFalse, "pentagram, non-zero");
+  testSplashFill(&poly, gTrue, "pentagram, even-odd");
+  for (i = 0; i < 10; ++i) {
+    randomPolygon(&poly);
+    testSplashFill(&poly, i & 1, "random polygon");
+  }
+}
+
+//------------------------------------------------------------------------
+
+int main(int argc, char *argv[]) {
+  testFixedPolygons();
+  testRandomPolygons();
+  testCircle(gFalse, "non-zero");
+  testCircle(gTrue, "even-odd");
+  testSplashFills();
+
+  if (failures) {
+    fprintf(stderr, "%d failures\n", failures);
+    return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,318 @@
+//========================================================================
+//
+// splash-span-test.cc
+//
+// Checks that the SSE2 and AVX2 span kernels of Splash, and the ones
+// picked at run time, give the same results as the portable ones, on
+// random spans of every length up to a few vectors, at every alignment,
+// with and without soft mask and shape, for 1 to splashMaxColorComps
+// color components.  The alpha values favour 0 and 255, where the
+// rounding and the aResult == 0 case are the most likely to go wrong.
+//
+// Then whole bitmaps, in each of the modes Splash composites with the
+// span kernels, are filled with a non-identity transfer function and
+// compared with what the per-pixel pipes do: where the result alpha is
+// 0 the pixel is black, and the transfer is not applied.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#include <stdio.h>
+#include <string.h>
+#include "splash/SplashSpanKernels.h"
+#include "splash/SplashBitmap.h"
+#include "splash/SplashPath.h"
+#include "splash/SplashPattern.h"
+#include "splash/Splash.h"
+
+// longest span, plus room for the alignment offset and a guard area
+#define maxSpan 80
+#define bufSize (maxSpan + 64)
+
+// value of the guard bytes around a span
+#define guardByte 0xa5
+
+// size of the bitmaps filled through Splash
+#define bitmapWidth 70
+#define bitmapHeight 3
+
+static int failures = 0;
+
+static void check(GBool ok, const char *what, int level, int n) {
+  if (!ok) {
+    fprintf(stderr, "FAIL: %s (level %d, n = %d)\n", what, level, n);
+    ++failures;
+  }
+}
+
+//------------------------------------------------------------------------
+
+static unsigned int seed = 12345;
+
+static int randomInt(int n) {
+  seed = seed * 1103515245 + 12345;
+  return (int)((seed >> 16) % (unsigned int)n);
+}
+
+// Mostly 0 and 255, with the values next to them and random ones.
+static Guchar randomAlpha() {
+  switch (randomInt(6)) {
+  case 0: return 0;
+  case 1: return 255;
+  case 2: return 1;
+  case 3: return 254;
+  default: return (Guchar)randomInt(256);
+  }
+}
+
+static void fillAlpha(Guchar *p, int n) {
+  int i;
+
+  for (i = 0; i < n; ++i) {
+    p[i] = randomAlpha();
+  }
+}
+
+static void fillRandom(Guchar *p, int n) {
+  int i;
+
+  for (i = 0; i < n; ++i) {
+    p[i] = (Guchar)randomInt(256);
+  }
+}
+
+// Check that the bytes of <buf> outside [off, off + n) are untouched.
+static GBool guardsOk(Guchar *buf, int off, int n) {
+  int i;
+
+  for (i = 0; i < bufSize; ++i) {
+    if ((i < off || i >= off + n) && buf[i] != guardByte) {
+      return gFalse;
+    }
+  }
+  return gTrue;
+}
+
+//------------------------------------------------------------------------
+
+static void testSourceAlpha(int level, SplashSpanSourceAlphaFunc sourceAlpha,
+			    SplashSpanSourceAlphaFunc ref) {
+  Guchar softMask[bufSize], shape[bufSize];
+  Guchar aSrc[bufSize], aSrcRef[bufSize];
+  Guchar aInput;
+  int n, off, mode, iter;
+
+  for (iter = 0; iter < 4; ++iter) {
+    for (n = 0; n <= maxSpan; ++n) {
+      for (mode = 0; mode < 4; ++mode) {
+	off = randomInt(32);
+	aInput = randomAlpha();
+	fillAlpha(softMask, bufSize);
+	fillAlpha(shape, bufSize);
+	memset(aSrc, guardByte, bufSize);
+	memset(aSrcRef, guardByte, bufSize);
+	(*ref)(aInput, (mode & 1) ? softMask + off : (Guchar *)NULL,
+	       (mode & 2) ? shape + off : (Guchar *)NULL, aSrcRef + off, n);
+	(*sourceAlpha)(aInput, (mode & 1) ? softMask + off : (Guchar *)NULL,
+		       (mode & 2) ? shape + off : (Guchar *)NULL,
+		       aSrc + off, n);
+	check(!memcmp(aSrc, aSrcRef, bufSize), "source alpha", level, n);
+	check(guardsOk(aSrc, off, n), "source alpha guard", level, n);
+      }
+    }
+  }
+}
+
+static void testComposite(int level, SplashSpanCompositeFunc composite,
+			  SplashSpanCompositeFunc ref) {
+  Guchar aSrc[bufSize], aDest[bufSize], aDestRef[bufSize];
+  Guchar compBuf[splashMaxColorComps][bufSize];
+  Guchar compBufRef[splashMaxColorComps][bufSize];
+  Guchar *comps[splashMaxColorComps], *compsRef[splashMaxColorComps];
+  Guchar cSrc[splashMaxColorComps];
+  int n, off, nComps, c, iter;
+
+  for (iter = 0; iter < 4; ++iter) {
+    for (n = 0; n <= maxSpan; ++n) {
+      for (nComps = 1; nComps <= splashMaxColorComps; ++nComps) {
+	off = randomInt(32);
+	memset(aSrc, guardByte, bufSize);
+	memset(aDest, guardByte, bufSize);
+	fillAlpha(aSrc + off, n);
+	fillAlpha(aDest + off, n);
+	memcpy(aDestRef, aDest, bufSize);
+	fillRandom(cSrc, splashMaxColorComps);
+	for (c = 0; c < nComps; ++c) {
+	  memset(compBuf[c], guardByte, bufSize);
+	  fillRandom(compBuf[c] + off, n);
+	  memcpy(compBufRef[c], compBuf[c], bufSize);
+	  comps[c] = compBuf[c] + off;
+	  compsRef[c] = compBufRef[c] + off;
+	}
+	(*ref)(aSrc + off, aDestRef + off, compsRef, cSrc, nComps, n);
+	(*composite)(aSrc + off, aDest + off, comps, cSrc, nComps, n);
+	check(!memcmp(aDest, aDestRef, bufSize), "composite alpha", level, n);
+	check(guardsOk(aDest, off, n), "composite alpha guard", level, n);
+	for (c = 0; c < nComps; ++c) {
+	  check(!memcmp(compBuf[c], compBufRef[c], bufSize),
+		"composite color", level, n);
+	  check(guardsOk(compBuf[c], off, n), "composite color guard",
+		level, n);
+	}
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------
+
+static inline int div255(int x) {
+  return (x + (x >> 8) + 0x80) >> 8;
+}
+
+// Fill a bitmap of random pixels, with random alpha values, with
+// <color> at alpha <aInput>, and check each pixel against the per-pixel
+// pipes.
+static void testFill(SplashColorMode mode, GBool vectorAntialias,
+		     Guchar aInput) {
+  static const char *modeNames[] = {
+    "Mono1", "Mono8", "RGB8", "BGR8", "XBGR8"
+  };
+  SplashBitmap *bitmap;
+  Splash *splash;
+  SplashPath *path;
+  SplashColor color;
+  Guchar transfer[4][256];
+  Guchar destBuf[bitmapHeight][bitmapWidth * 4];
+  Guchar aDestBuf[bitmapHeight][bitmapWidth];
+  Guchar *row, *aRow;
+  int nComps, pixSize, order[3];
+  int x, y, c, i, a, aResult, cResult;
+  GBool ok;
+
+  switch (mode) {
+  case splashModeMono8:
+    nComps = 1; pixSize = 1;
+    order[0] = 0;
+    break;
+  case splashModeRGB8:
+    nComps = 3; pixSize = 3;
+    order[0] = 0; order[1] = 1; order[2] = 2;
+    break;
+  case splashModeBGR8:
+    nComps = 3; pixSize = 3;
+    order[0] = 2; order[1] = 1; order[2] = 0;
+    break;
+  case splashModeXBGR8:
+    nComps = 3; pixSize = 4;
+    order[0] = 2; order[1] = 1; order[2] = 0;
+    break;
+  default:
+    return;
+  }
+
+  // transfer functions that map 0 to non-zero values
+  for (c = 0; c < 4; ++c) {
+    for (i = 0; i < 256; ++i) {
+      transfer[c][i] = (Guchar)(c & 1 ? 255 - i : (i / 2 + 64 * (c + 1)));
+    }
+  }
+  for (c = 0; c < nComps; ++c) {
+    color[c] = (Guchar)randomInt(256);
+  }
+
+  bitmap = new SplashBitmap(bitmapWidth, bitmapHeight, 1, mode, gTrue);
+  for (y = 0; y < bitmapHeight; ++y) {
+    row = bitmap->getDataPtr() + y * bitmap->getRowSize();
+    aRow = bitmap->getAlphaPtr() + y * bitmapWidth;
+    fillRandom(row, bitmapWidth * pixSize);
+    fillAlpha(aRow, bitmapWidth);
+    memcpy(destBuf[y], row, bitmapWidth * pixSize);
+    memcpy(aDestBuf[y], aRow, bitmapWidth);
+  }
+
+  splash = new Splash(bitmap, vectorAntialias);
+  splash->setTransfer(transfer[0], transfer[1], transfer[2], transfer[3]);
+  splash->setFillPattern(new SplashSolidColor(color));
+  splash->setFillAlpha(aInput / 255.0);
+  path = new SplashPath();
+  path->moveTo(-10, -10);
+  path->lineTo(bitmapWidth + 10, -10);
+  path->lineTo(bitmapWidth + 10, bitmapHeight + 10);
+  path->lineTo(-10, bitmapHeight + 10);
+  path->close();
+  splash->fill(path, gFalse);
+  delete path;
+  delete splash;
+
+  for (y = 0; y < bitmapHeight; ++y) {
+    row = bitmap->getDataPtr() + y * bitmap->getRowSize();
+    aRow = bitmap->getAlphaPtr() + y * bitmapWidth;
+    for (x = 0; x < bitmapWidth; ++x) {
+      a = aDestBuf[y][x];
+      aResult = aInput + a - div255(aInput * a);
+      ok = aRow[x] == aResult;
+      for (c = 0; c < nComps; ++c) {
+	if (aResult == 0) {
+	  cResult = 0;
+	} else {
+	  cResult = transfer[nComps == 1 ? 3 : c]
+		      [((aResult - aInput) * destBuf[y][x * pixSize + order[c]] +
+			aInput * color[c]) / aResult];
+	}
+	ok = ok && row[x * pixSize + order[c]] == cResult;
+      }
+      if (!ok) {
+	fprintf(stderr, "FAIL: fill %s%s, alpha %d, pixel (%d, %d)\n",
+		modeNames[mode], vectorAntialias ? " AA" : "", aInput, x, y);
+	++failures;
+      }
+    }
+  }
+  delete bitmap;
+}
+
+//------------------------------------------------------------------------
+
+int main(int argc, char *argv[]) {
+  SplashSpanSourceAlphaFunc sourceAlphaRef, sourceAlpha;
+  SplashSpanCompositeFunc compositeRef, composite;
+  static const SplashColorMode modes[] = {
+    splashModeMono8, splashModeRGB8, splashModeBGR8, splashModeXBGR8
+  };
+  static const Guchar alphas[] = { 0, 1, 128, 254, 255 };
+  int level, m, a, aa;
+
+  splashSpanGetKernels(splashSpanScalar, &sourceAlphaRef, &compositeRef);
+  for (level = splashSpanSSE2; level <= splashSpanAVX2; ++level) {
+    if (!splashSpanGetKernels((SplashSpanKernelLevel)level,
+			      &sourceAlpha, &composite)) {
+      printf("level %d not available\n", level);
+      continue;
+    }
+    testSourceAlpha(level, sourceAlpha, sourceAlphaRef);
+    testComposite(level, composite, compositeRef);
+  }
+
+  // the versions picked at run time, level -1 in the messages
+  testSourceAlpha(-1, &splashSpanSourceAlpha, sourceAlphaRef);
+  testComposite(-1, &splashSpanComposite, compositeRef);
+
+  for (m = 0; m < 4; ++m) {
+    for (a = 0; a < 5; ++a) {
+      for (aa = 0; aa < 2; ++aa) {
+	testFill(modes[m], aa, alphas[a]);
+      }
+    }
+  }
+
+  if (failures) {
+    fprintf(stderr, "%d failures\n", failures);
+    return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
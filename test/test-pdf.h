@@ -0,0 +1,168 @@
+//========================================================================
+//
+// test-pdf.h
+//
+// Builds small PDF files in memory for the unit tests.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef TEST_PDF_H
+#define TEST_PDF_H
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "goo/gmem.h"
+#include "Object.h"
+#include "Stream.h"
+#include "PDFDoc.h"
+
+//------------------------------------------------------------------------
+// TestPDF
+//
+// Objects are numbered from 1 in the order they are reserved or added.
+// The generated file has a classic xref table, or an xref stream, and a
+// trailer whose /Root is the object passed to open(), followed by the
+// entries set with setTrailer().  The TestPDF must outlive the PDFDocs
+// it opens, they read its buffer.
+//------------------------------------------------------------------------
+
+class TestPDF {
+public:
+
+  TestPDF() {}
+
+  ~TestPDF() {
+    for (size_t i = 0; i < bufs.size(); ++i) {
+      gfree(bufs[i]);
+    }
+  }
+
+  // Reserve an object number, for objects that are referenced before
+  // they are set.
+  int reserve() {
+    objs.push_back(std::string());
+    return (int)objs.size();
+  }
+
+  // Set the body of a reserved object.
+  void set(int num, const std::string &obj) {
+    objs[num - 1] = obj;
+  }
+
+  // Add an object, returns its number.
+  int add(const std::string &obj) {
+    objs.push_back(obj);
+    return (int)objs.size();
+  }
+
+  // Add a stream, <dict> is the content of the stream dictionary without
+  // /Length.
+  int addStream(const std::string &dict, const std::string &data) {
+    char len[32];
+
+    snprintf(len, sizeof(len), "%d", (int)data.size());
+    return add("<< " + dict + " /Length " + len + " >>\nstream\n" + data +
+	       "\nendstream");
+  }
+
+  // Set more entries of the trailer, e.g. " /ID [<...> <...>]".
+  void setTrailer(const std::string &entries) {
+    trailer = entries;
+  }
+
+  // Format a reference to object <num>.
+  static std::string ref(int num) {
+    char buf[32];
+
+    snprintf(buf, sizeof(buf), "%d 0 R", num);
+    return buf;
+  }
+
+  // Serialize the file with <root> as the document catalog, with an
+  // xref stream if <xrefStream> is set.
+  std::string write(int root, bool xrefStream = false) {
+    std::string s, data;
+    std::vector<size_t> offsets;
+    char buf[64];
+    size_t xrefOffset, i;
+
+    s = "%PDF-1.5\n";
+    for (i = 0; i < objs.size(); ++i) {
+      offsets.push_back(s.size());
+      snprintf(buf, sizeof(buf), "%d 0 obj\n", (int)i + 1);
+      s += buf;
+      s += objs[i].empty() ? std::string("null") : objs[i];
+      s += "\nendobj\n";
+    }
+    xrefOffset = s.size();
+    if (xrefStream) {
+      // /W [1 4 2], the last entry is the xref stream itself
+      offsets.push_back(xrefOffset);
+      data.append("\0\0\0\0\0\xff\xff", 7);
+      for (i = 0; i < offsets.size(); ++i) {
+	data += (char)1;
+	data += (char)(offsets[i] >> 24);
+	data += (char)(offsets[i] >> 16);
+	data += (char)(offsets[i] >> 8);
+	data += (char)offsets[i];
+	data.append("\0\0", 2);
+      }
+      snprintf(buf, sizeof(buf), "%d 0 obj\n", (int)offsets.size());
+      s += buf;
+      snprintf(buf, sizeof(buf),
+	       "<< /Type /XRef /Size %d /W [1 4 2] /Root %d 0 R",
+	       (int)offsets.size() + 1, root);
+      s += buf;
+      s += trailer;
+      snprintf(buf, sizeof(buf), " /Length %d >>\nstream\n", (int)data.size());
+      s += buf;
+      s += data;
+      snprintf(buf, sizeof(buf),
+	       "\nendstream\nendobj\nstartxref\n%d\n%%%%EOF\n",
+	       (int)xrefOffset);
+      s += buf;
+      return s;
+    }
+    snprintf(buf, sizeof(buf), "xref\n0 %d\n", (int)objs.size() + 1);
+    s += buf;
+    s += "0000000000 65535 f \n";
+    for (i = 0; i < offsets.size(); ++i) {
+      snprintf(buf, sizeof(buf), "%010d 00000 n \n", (int)offsets[i]);
+      s += buf;
+    }
+    snprintf(buf, sizeof(buf), "trailer\n<< /Size %d /Root %d 0 R",
+	     (int)objs.size() + 1, root);
+    s += buf;
+    s += trailer;
+    snprintf(buf, sizeof(buf), " >>\nstartxref\n%d\n%%%%EOF\n",
+	     (int)xrefOffset);
+    s += buf;
+    return s;
+  }
+
+  // Open the file with <root> as the document catalog.
+  PDFDoc *open(int root) {
+    std::string s;
+    char *buf;
+    Object obj;
+
+    s = write(root);
+    buf = (char *)gmalloc(s.size());
+    memcpy(buf, s.data(), s.size());
+    bufs.push_back(buf);
+    obj.initNull();
+    return new PDFDoc(new MemStream(buf, 0, s.size(), &obj));
+  }
+
+private:
+
+  std::vector<std::string> objs;
+  std::string trailer;
+  std::vector<char *> bufs;
+};
+
+#endif
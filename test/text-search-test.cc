@@ -0,0 +1,538 @@
+//========================================================================
+//
+// text-search-test.cc
+//
+// Checks that TextPage::findText, which walks the lines of the page's
+// TextIndex and stops early, finds the same matches as the linear
+// search it replaced.  The reference is that search, run on the blocks,
+// lines and words the TextPage exposes.
+//
+// The pages are random: columns of words from a small vocabulary, in
+// any of the four text directions, with a few lines in another
+// direction, and pages with a /Rotate, so the primary rotation is
+// often not 0.  Some words are drawn twice at the same place with a
+// different horizontal scaling, which gives matches that tie on their
+// position but not on their box.  Each page is searched for all the
+// matches forward and backward, as viewers do with startAtLast, and in
+// random windows.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "goo/gmem.h"
+#include "GlobalParams.h"
+#include "PDFDoc.h"
+#include "TextOutputDev.h"
+#include "UnicodeTypeTable.h"
+#include "test-pdf.h"
+
+#define nPages 24
+#define maxFinds 5000
+
+static int failures = 0;
+
+static void check(GBool ok, const char *what, int pg, const char *query) {
+  if (!ok) {
+    fprintf(stderr, "FAIL: %s (page %d, '%s')\n", what, pg, query);
+    ++failures;
+  }
+}
+
+//------------------------------------------------------------------------
+
+static unsigned int seed = 12345;
+
+static int randomInt(int n) {
+  seed = seed * 1103515245 + 12345;
+  return (int)((seed >> 16) % (unsigned int)n);
+}
+
+static const char *vocabulary[] = {
+  "alpha", "Alpha", "ALPHA", "alphabet", "beta", "bet", "gamma", "al",
+  "a", "delta", "12", "123", "1234"
+};
+#define vocabularySize ((int)(sizeof(vocabulary) / sizeof(char *)))
+
+static const char *queries[] = {
+  "alpha", "ALPHA", "al", "a", "bet", "ha be", "gamma", "12", "23",
+  "1234", "x"
+};
+#define nQueries ((int)(sizeof(queries) / sizeof(char *)))
+
+//------------------------------------------------------------------------
+// test document
+//------------------------------------------------------------------------
+
+// Text matrix rotations, 90 degrees apart.
+static const int rotations[4][4] = {
+  { 1, 0, 0, 1 }, { 0, 1, -1, 0 }, { -1, 0, 0, -1 }, { 0, -1, 1, 0 }
+};
+
+// Show <word> with rotation <rot>, at (<u>, <v>) in a 500x500 frame
+// centered on the page and turned with the text.
+static void showWord(std::string *content, int rot, double u, double v,
+		     double size, int scale, const char *word) {
+  const int *r;
+  char buf[256];
+
+  r = rotations[rot];
+  snprintf(buf, sizeof(buf),
+	   "BT /F1 %g Tf %d Tz %d %d %d %d %.2f %.2f Tm (%s) Tj ET\n",
+	   size, scale, r[0], r[1], r[2], r[3],
+	   306 + r[0] * u + r[2] * v, 396 + r[1] * u + r[3] * v, word);
+  *content += buf;
+}
+
+// Columns of lines of random words.  Some words are drawn a second time
+// at the same place, wider.
+static void showColumns(std::string *content, int rot, int nCols,
+			int nLines, double v0) {
+  const char *word;
+  double u, v, size;
+  int col, line, n, i;
+
+  size = 8 + randomInt(5);
+  for (col = 0; col < nCols; ++col) {
+    for (line = 0; line < nLines; ++line) {
+      u = -240 + col * (480.0 / nCols);
+      v = v0 - line * (size + 3);
+      n = 1 + randomInt(4);
+      for (i = 0; i < n; ++i) {
+	word = vocabulary[randomInt(vocabularySize)];
+	showWord(content, rot, u, v, size, 100, word);
+	if (randomInt(6) == 0) {
+	  showWord(content, rot, u, v, size, 140, word);
+	}
+	u += (strlen(word) + 1) * size * 0.6;
+      }
+    }
+  }
+}
+
+static PDFDoc *makeDoc(TestPDF *pdf) {
+  std::string content;
+  std::string kids;
+  char buf[64];
+  int catalog, pages, font, pg, rot, minorRot;
+
+  catalog = pdf->reserve();
+  pages = pdf->reserve();
+  font = pdf->add("<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica"
+		  " /Encoding /WinAnsiEncoding >>");
+  for (pg = 0; pg < nPages; ++pg) {
+    content.clear();
+    rot = pg % 4;
+    showColumns(&content, rot, 1 + randomInt(3), 10 + randomInt(20), 240);
+    if (pg % 3 == 0) {
+      // a few lines in another direction
+      minorRot = (rot + 1 + randomInt(3)) % 4;
+      showColumns(&content, minorRot, 1, 2 + randomInt(3), -200);
+    }
+    snprintf(buf, sizeof(buf), " /Rotate %d", 90 * ((pg / 4) % 4));
+    kids += " " + TestPDF::ref(
+	pdf->add("<< /Type /Page /Parent " + TestPDF::ref(pages) +
+		 " /MediaBox [0 0 612 792]" + buf +
+		 " /Resources << /Font << /F1 " + TestPDF::ref(font) +
+		 " >> >> /Contents " +
+		 TestPDF::ref(pdf->addStream("", content)) + " >>"));
+  }
+  snprintf(buf, sizeof(buf), " /Count %d >>", nPages);
+  pdf->set(pages, "<< /Type /Pages /Kids [" + kids + " ]" + buf);
+  pdf->set(catalog, "<< /Type /Catalog /Pages " + TestPDF::ref(pages) +
+			" >>");
+  return pdf->open(catalog);
+}
+
+//------------------------------------------------------------------------
+// reference search
+//------------------------------------------------------------------------
+
+struct RefLine {
+  int rot;
+  double xMin, yMin, xMax, yMax;
+  std::vector<double> edge;
+  Unicode *normalized;
+  int normalizedLen;
+  int *normalizedIdx;
+};
+
+struct RefBlock {
+  double xMin, yMin, xMax, yMax;
+  std::vector<RefLine> lines;
+};
+
+struct RefPage {
+  std::vector<RefBlock> blocks;
+  int primaryRot;
+  int ties;			// equal positions with different boxes
+};
+
+// Rebuild the text of the lines, as TextLine::coalesce does, from the
+// blocks in reading order.
+static void buildRefPage(TextPage *text, RefPage *ref) {
+  TextFlow *flow;
+  TextBlock *blk;
+  TextLine *line;
+  TextWord *word;
+  RefBlock rb;
+  RefLine rl;
+  std::vector<Unicode> chars;
+  double xMin, yMin, xMax, yMax;
+  int count[4];
+  int i;
+
+  ref->blocks.clear();
+  ref->ties = 0;
+  count[0] = count[1] = count[2] = count[3] = 0;
+  for (flow = text->getFlows(); flow; flow = flow->getNext()) {
+    for (blk = flow->getBlocks(); blk; blk = blk->getNext()) {
+      blk->getBBox(&rb.xMin, &rb.yMin, &rb.xMax, &rb.yMax);
+      rb.lines.clear();
+      for (line = blk->getLines(); line; line = line->getNext()) {
+	chars.clear();
+	rl.edge.clear();
+	rl.rot = line->getWords()->getRotation();
+	for (word = line->getWords(); word; word = word->getNext()) {
+	  word->getBBox(&xMin, &yMin, &xMax, &yMax);
+	  if (word == line->getWords() || xMin < rl.xMin) {
+	    rl.xMin = xMin;
+	  }
+	  if (word == line->getWords() || yMin < rl.yMin) {
+	    rl.yMin = yMin;
+	  }
+	  if (word == line->getWords() || xMax > rl.xMax) {
+	    rl.xMax = xMax;
+	  }
+	  if (word == line->getWords() || yMax > rl.yMax) {
+	    rl.yMax = yMax;
+	  }
+	  for (i = 0; i < word->getLength(); ++i) {
+	    chars.push_back(*word->getChar(i));
+	    rl.edge.push_back(word->getEdge(i));
+	  }
+	  if (word->getSpaceAfter()) {
+	    chars.push_back((Unicode)0x20);
+	    rl.edge.push_back(word->getEdge(word->getLength()));
+	  }
+	}
+	for (word = line->getWords(); word->getNext(); word = word->getNext()) ;
+	if (!word->getSpaceAfter()) {
+	  rl.edge.push_back(word->getEdge(word->getLength()));
+	} else {
+	  rl.edge.push_back(rl.edge.back());
+	}
+	count[rl.rot] += (int)chars.size();
+	rl.normalized = unicodeNormalizeNFKC(&chars[0], (int)chars.size(),
+					     &rl.normalizedLen,
+					     &rl.normalizedIdx, gTrue);
+	rb.lines.push_back(rl);
+      }
+      ref->blocks.push_back(rb);
+    }
+  }
+  ref->primaryRot = 0;
+  for (i = 1; i < 4; ++i) {
+    if (count[i] > count[ref->primaryRot]) {
+      ref->primaryRot = i;
+    }
+  }
+}
+
+static void freeRefPage(RefPage *ref) {
+  size_t i, j;
+
+  for (i = 0; i < ref->blocks.size(); ++i) {
+    for (j = 0; j < ref->blocks[i].lines.size(); ++j) {
+      gfree(ref->blocks[i].lines[j].normalized);
+      gfree(ref->blocks[i].lines[j].normalizedIdx);
+    }
+  }
+}
+
+// The linear search of findText() before the TextIndex, with the start
+// and stop points passed in.  The query is ASCII, so it needs no
+// reordering.
+static GBool refFindText(RefPage *ref, const char *query,
+			 GBool startAtTop, GBool stopAtBottom,
+			 GBool caseSensitive, GBool backward,
+			 GBool wholeWord,
+			 double xStart, double yStart,
+			 double xStop, double yStop,
+			 double *xMin, double *yMin,
+			 double *xMax, double *yMax) {
+  RefBlock *blk;
+  RefLine *line;
+  Unicode s[64];
+  std::vector<Unicode> txt;
+  double xMin0, yMin0, xMax0, yMax0;
+  double xMin1, yMin1, xMax1, yMax1;
+  int len, m, i, j, k, start, afterEnd, nBlocks;
+  size_t l;
+  GBool found;
+
+  len = (int)strlen(query);
+  for (i = 0; i < len; ++i) {
+    s[i] = caseSensitive ? (Unicode)query[i]
+			 : unicodeToUpper((Unicode)query[i]);
+  }
+  found = gFalse;
+  xMin0 = yMin0 = xMax0 = yMax0 = 0;
+  xMin1 = yMin1 = xMax1 = yMax1 = 0;
+  nBlocks = (int)ref->blocks.size();
+  for (i = backward ? nBlocks - 1 : 0;
+       backward ? i >= 0 : i < nBlocks;
+       i += backward ? -1 : 1) {
+    blk = &ref->blocks[i];
+    if (!startAtTop && ref->primaryRot == 0 &&
+	(backward ? blk->yMin > yStart : blk->yMax < yStart)) {
+      continue;
+    }
+    if (!stopAtBottom && ref->primaryRot == 0 &&
+	(backward ? blk->yMax < yStop : blk->yMin > yStop)) {
+      break;
+    }
+    for (l = 0; l < blk->lines.size(); ++l) {
+      line = &blk->lines[l];
+      if (!startAtTop && ref->primaryRot == 0 &&
+	  (backward ? line->yMin > yStart : line->yMin < yStart)) {
+	continue;
+      }
+      if (!stopAtBottom && ref->primaryRot == 0 &&
+	  (backward ? line->yMin < yStop : line->yMin > yStop)) {
+	continue;
+      }
+      m = line->normalizedLen;
+      txt.resize(m + 1);
+      for (k = 0; k < m; ++k) {
+	txt[k] = caseSensitive ? line->normalized[k]
+			       : unicodeToUpper(line->normalized[k]);
+      }
+      for (j = backward ? m - len : 0;
+	   backward ? j >= 0 : j <= m - len;
+	   j += backward ? -1 : 1) {
+	if (wholeWord &&
+	    ((j > 0 && unicodeTypeAlphaNum(txt[j - 1])) ||
+	     (j + len < m && unicodeTypeAlphaNum(txt[j + len])))) {
+	  continue;
+	}
+	for (k = 0; k < len && txt[j + k] == s[k]; ++k) ;
+	if (k < len) {
+	  continue;
+	}
+	start = line->normalizedIdx[j];
+	afterEnd = line->normalizedIdx[j + len - 1] + 1;
+	switch (line->rot) {
+	case 0:
+	  xMin1 = line->edge[start];
+	  xMax1 = line->edge[afterEnd];
+	  yMin1 = line->yMin;
+	  yMax1 = line->yMax;
+	  break;
+	case 1:
+	  xMin1 = line->xMin;
+	  xMax1 = line->xMax;
+	  yMin1 = line->edge[start];
+	  yMax1 = line->edge[afterEnd];
+	  break;
+	case 2:
+	  xMin1 = line->edge[afterEnd];
+	  xMax1 = line->edge[start];
+	  yMin1 = line->yMin;
+	  yMax1 = line->yMax;
+	  break;
+	case 3:
+	  xMin1 = line->xMin;
+	  xMax1 = line->xMax;
+	  yMin1 = line->edge[afterEnd];
+	  yMax1 = line->edge[start];
+	  break;
+	}
+	if (backward) {
+	  if (!((startAtTop ||
+		 yMin1 < yStart || (yMin1 == yStart && xMin1 < xStart)) &&
+		(stopAtBottom ||
+		 yMin1 > yStop || (yMin1 == yStop && xMin1 > xStop)))) {
+	    continue;
+	  }
+	} else {
+	  if (!((startAtTop ||
+		 yMin1 > yStart || (yMin1 == yStart && xMin1 > xStart)) &&
+		(stopAtBottom ||
+		 yMin1 < yStop || (yMin1 == yStop && xMin1 < xStop)))) {
+	    continue;
+	  }
+	}
+	if (found && yMin1 == yMin0 && xMin1 == xMin0 &&
+	    (xMax1 != xMax0 || yMax1 != yMax0)) {
+	  ++ref->ties;
+	}
+	// the first match found wins a tie
+	if (!found ||
+	    (backward ? (yMin1 > yMin0 || (yMin1 == yMin0 && xMin1 > xMin0))
+		      : (yMin1 < yMin0 ||
+			 (yMin1 == yMin0 && xMin1 < xMin0)))) {
+	  xMin0 = xMin1;
+	  xMax0 = xMax1;
+	  yMin0 = yMin1;
+	  yMax0 = yMax1;
+	  found = gTrue;
+	}
+      }
+    }
+  }
+  if (found) {
+    *xMin = xMin0;
+    *yMin = yMin0;
+    *xMax = xMax0;
+    *yMax = yMax0;
+  }
+  return found;
+}
+
+//------------------------------------------------------------------------
+
+static void toUnicode(const char *query, Unicode *u, int *len) {
+  int i;
+
+  *len = (int)strlen(query);
+  for (i = 0; i < *len; ++i) {
+    u[i] = (Unicode)query[i];
+  }
+}
+
+// Find all the matches, one after the other, as viewers do.
+static void testFindAll(TextPage *text, RefPage *ref, int pg,
+			const char *query, GBool caseSensitive,
+			GBool backward, GBool wholeWord) {
+  Unicode u[64];
+  double xMin, yMin, xMax, yMax;
+  double rxMin, ryMin, rxMax, ryMax;
+  int len, n;
+  GBool found, refFound;
+
+  toUnicode(query, u, &len);
+  xMin = yMin = xMax = yMax = 0;
+  rxMin = ryMin = rxMax = ryMax = 0;
+  for (n = 0; n < maxFinds; ++n) {
+    found = text->findText(u, len, n == 0, gTrue, n > 0, gFalse,
+			   caseSensitive, backward, wholeWord,
+			   &xMin, &yMin, &xMax, &yMax);
+    refFound = refFindText(ref, query, n == 0, gTrue, caseSensitive,
+			   backward, wholeWord, rxMin, ryMin, 0, 0,
+			   &rxMin, &ryMin, &rxMax, &ryMax);
+    check(found == refFound, "findText found", pg, query);
+    if (!found || !refFound) {
+      break;
+    }
+    check(xMin == rxMin && yMin == ryMin && xMax == rxMax && yMax == ryMax,
+	  "findText match", pg, query);
+    if (xMin != rxMin || yMin != ryMin) {
+      break;
+    }
+  }
+  check(n < maxFinds, "findText terminates", pg, query);
+}
+
+// Search between random start and stop points.
+static void testFindWindows(TextPage *text, RefPage *ref, int pg,
+			    const char *query) {
+  Unicode u[64];
+  double xMin, yMin, xMax, yMax;
+  double rxMin, ryMin, rxMax, ryMax;
+  double xStart, yStart, xStop, yStop;
+  int len, iter;
+  GBool startAtTop, stopAtBottom, caseSensitive, backward, wholeWord;
+  GBool found, refFound;
+
+  toUnicode(query, u, &len);
+  for (iter = 0; iter < 40; ++iter) {
+    startAtTop = randomInt(3) == 0;
+    stopAtBottom = randomInt(3) == 0;
+    caseSensitive = randomInt(2);
+    backward = randomInt(2);
+    wholeWord = randomInt(3) == 0;
+    xStart = randomInt(800);
+    yStart = randomInt(800);
+    xStop = randomInt(800);
+    yStop = randomInt(800);
+    xMin = xStart;
+    yMin = yStart;
+    xMax = xStop;
+    yMax = yStop;
+    found = text->findText(u, len, startAtTop, stopAtBottom, gFalse, gFalse,
+			   caseSensitive, backward, wholeWord,
+			   &xMin, &yMin, &xMax, &yMax);
+    refFound = refFindText(ref, query, startAtTop, stopAtBottom,
+			   caseSensitive, backward, wholeWord,
+			   xStart, yStart, xStop, yStop,
+			   &rxMin, &ryMin, &rxMax, &ryMax);
+    check(found == refFound, "findText window found", pg, query);
+    if (found && refFound) {
+      check(xMin == rxMin && yMin == ryMin &&
+	    xMax == rxMax && yMax == ryMax, "findText window match",
+	    pg, query);
+    }
+  }
+}
+
+//------------------------------------------------------------------------
+
+int main(int argc, char *argv[]) {
+  TestPDF pdf;
+  PDFDoc *doc;
+  TextOutputDev *textOut;
+  TextPage *text;
+  RefPage ref;
+  int rotCount[4];
+  int ties, pg, q;
+
+  globalParams = new GlobalParams();
+  globalParams->setErrQuiet(gTrue);
+  globalParams->setTextEncoding((char *)"UTF-8");
+
+  doc = makeDoc(&pdf);
+  check(doc->isOk() && doc->getNumPages() == nPages, "document", 0, "");
+  rotCount[0] = rotCount[1] = rotCount[2] = rotCount[3] = 0;
+  ties = 0;
+  for (pg = 1; pg <= doc->getNumPages(); ++pg) {
+    textOut = new TextOutputDev(NULL, gFalse, 0, gFalse, gFalse);
+    doc->displayPage(textOut, pg, 72, 72, 0, gTrue, gFalse, gFalse);
+    text = textOut->takeText();
+    delete textOut;
+    buildRefPage(text, &ref);
+    ++rotCount[ref.primaryRot];
+
+    for (q = 0; q < nQueries; ++q) {
+      testFindAll(text, &ref, pg, queries[q], gFalse, gFalse, gFalse);
+      testFindAll(text, &ref, pg, queries[q], gFalse, gTrue, gFalse);
+      testFindAll(text, &ref, pg, queries[q], gTrue, gFalse, gTrue);
+      testFindAll(text, &ref, pg, queries[q], gTrue, gTrue, gTrue);
+      testFindWindows(text, &ref, pg, queries[q]);
+    }
+    ties += ref.ties;
+
+    freeRefPage(&ref);
+    text->decRefCnt();
+  }
+  delete doc;
+  delete globalParams;
+
+  // make sure the cases the index has to get right did come up
+  check(rotCount[1] > 0 && rotCount[2] > 0 && rotCount[3] > 0,
+	"pages with a primary rotation other than 0", 0, "");
+  check(ties > 0, "matches tied on their position", 0, "");
+
+  if (failures) {
+    fprintf(stderr, "%d failures\n", failures);
+    return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,174 @@
+//========================================================================
+//
+// xref-reconstruct-bench.cc
+//
+// Reconstructs the xref table of a document, as is done for damaged
+// files, with one scanning thread and with several, checks that both
+// give the same table, and reports the time taken.  A plain
+// Stream::getLine() pass over the file, which is what the line-at-a-time
+// scanner used to cost at least, is timed for comparison.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#include <stdio.h>
+#include <string.h>
+#include "goo/gmem.h"
+#include "goo/gfile.h"
+#include "goo/GooString.h"
+#include "goo/GooTimer.h"
+#include "GlobalParams.h"
+#include "Error.h"
+#include "Object.h"
+#include "Stream.h"
+#include "MmapStream.h"
+#include "XRef.h"
+#include "utils/parseargs.h"
+
+static int iterations = 3;
+static int nThreads = 0;
+static GBool noMmap = gFalse;
+static GBool printHelp = gFalse;
+
+static const ArgDesc argDesc[] = {
+  {"-n",      argInt,      &iterations,      0,
+   "number of times the table is reconstructed"},
+  {"-j",      argInt,      &nThreads,        0,
+   "number of scanning threads (default: one per CPU)"},
+  {"-nommap", argFlag,     &noMmap,          0,
+   "read the file with FileStream instead of mapping it"},
+  {"-h",      argFlag,     &printHelp,       0,
+   "print usage information"},
+  {"-help",   argFlag,     &printHelp,       0,
+   "print usage information"},
+  {"--help",  argFlag,     &printHelp,       0,
+   "print usage information"},
+  {"-?",      argFlag,     &printHelp,       0,
+   "print usage information"},
+  {NULL}
+};
+
+// Reconstruct the xref table with <threads> scanning threads.  Returns
+// the table of the last pass, which the caller deletes.
+static XRef *bench(BaseStream *str, int threads, double *time) {
+  GooTimer timer;
+  XRef *xref;
+  int i;
+
+  globalParams->setXRefScanThreads(threads);
+  xref = NULL;
+  timer.start();
+  for (i = 0; i < iterations; ++i) {
+    delete xref;
+    // with no 'startxref' position, the table is always reconstructed
+    xref = new XRef(str, (Goffset)0);
+  }
+  timer.stop();
+  *time = timer.getElapsed() / iterations;
+  return xref;
+}
+
+static double benchGetLine(BaseStream *str, int *nLines) {
+  GooTimer timer;
+  char buf[256];
+  int i;
+
+  *nLines = 0;
+  timer.start();
+  for (i = 0; i < iterations; ++i) {
+    str->reset();
+    *nLines = 0;
+    while (str->getLine(buf, sizeof(buf))) {
+      ++*nLines;
+    }
+  }
+  timer.stop();
+  return timer.getElapsed() / iterations;
+}
+
+static int countDifferences(XRef *a, XRef *b) {
+  XRefEntry *ea, *eb;
+  int n, i;
+
+  n = 0;
+  if (a->isOk() != b->isOk() ||
+      a->getNumObjects() != b->getNumObjects() ||
+      a->getRootNum() != b->getRootNum() ||
+      (a->isOk() && a->getRootGen() != b->getRootGen())) {
+    ++n;
+  }
+  for (i = 0; i < a->getNumObjects() && i < b->getNumObjects(); ++i) {
+    ea = a->getEntry(i, gFalse);
+    eb = b->getEntry(i, gFalse);
+    if (ea->type != eb->type || ea->offset != eb->offset ||
+	ea->gen != eb->gen) {
+      ++n;
+    }
+  }
+  return n;
+}
+
+int main (int argc, char *argv[])
+{
+  BaseStream *str;
+  GooString *fileName;
+  GooFile *file;
+  XRef *serial, *parallel;
+  Object obj;
+  double getLineTime, serialTime, parallelTime;
+  Goffset len;
+  int nLines, differences;
+
+  // parse args
+  GBool ok = parseArgs(argDesc, &argc, argv);
+  if (!ok || argc != 2 || printHelp || iterations < 1 || nThreads < 0) {
+    printUsage(argv[0], "PDF-FILE", argDesc);
+    return printHelp ? 0 : 1;
+  }
+
+  globalParams = new GlobalParams();
+  setErrorCallback(NULL, NULL);
+
+  fileName = new GooString(argv[1]);
+  file = NULL;
+  str = noMmap ? (BaseStream *)NULL : MmapStream::open(fileName);
+  if (!str) {
+    if (!(file = GooFile::open(fileName))) {
+      fprintf(stderr, "Couldn't open file '%s'\n", argv[1]);
+      delete fileName;
+      delete globalParams;
+      return 1;
+    }
+    obj.initNull();
+    str = new FileStream(file, 0, gFalse, file->size(), &obj);
+  }
+  len = str->getLength();
+
+  getLineTime = benchGetLine(str, &nLines);
+  serial = bench(str, 1, &serialTime);
+  parallel = bench(str, nThreads, &parallelTime);
+  differences = countDifferences(serial, parallel);
+
+  printf("%lld bytes, %d lines, %d objects\n", (long long)len, nLines,
+	 serial->getNumObjects());
+  printf("getLine pass:     %8.3f s  %8.1f MB/s\n", getLineTime,
+	 getLineTime > 0 ? len / getLineTime / 1e6 : 0);
+  printf("1 thread:         %8.3f s  %8.1f MB/s\n", serialTime,
+	 serialTime > 0 ? len / serialTime / 1e6 : 0);
+  printf("parallel:         %8.3f s  %8.1f MB/s\n", parallelTime,
+	 parallelTime > 0 ? len / parallelTime / 1e6 : 0);
+  if (differences) {
+    printf("%d xref entries differ\n", differences);
+  }
+
+  delete serial;
+  delete parallel;
+  delete str;
+  delete file;
+  delete fileName;
+  delete globalParams;
+  return differences ? 1 : 0;
+}
@@ -51,18 +51,9 @@
 #include "splash/SplashBitmap.h"
 #include "splash/Splash.h"
 #include "SplashOutputDev.h"
+#include "SplashPageRenderer.h"
 
-// Uncomment to build pdftoppm with pthreads
-// You may also have to change the buildsystem to
-// link pdftoppm to pthread library
-// This is here for developer testing not user ready
-// #define UTILS_USE_PTHREADS 1
-
-#ifdef UTILS_USE_PTHREADS
-#include <errno.h>
-#include <pthread.h>
-#include <deque>
-#endif // UTILS_USE_PTHREADS
+#include <vector>
 
 static int firstPage = 1;
 static int lastPage = 0;
@@ -95,14 +86,17 @@ static char antialiasStr[16] = "";
 static char vectorAntialiasStr[16] = "";
 static GBool fontAntialias = gTrue;
 static GBool vectorAntialias = gTrue;
+static char areaAntialiasStr[16] = "";
+static GBool areaAntialias = gFalse;
 static char ownerPassword[33] = "";
 static char userPassword[33] = "";
 static char TiffCompressionStr[16] = "";
 static char thinLineModeStr[8] = "";
 static SplashThinLineMode thinLineMode = splashThinLineDefault;
-#ifdef UTILS_USE_PTHREADS
 static int numberOfJobs = 1;
-#endif // UTILS_USE_PTHREADS
+// Smallest band, in pixels, when a single page is rendered with several
+// jobs.
+static const int minBandHeight = 256;
 static GBool quiet = gFalse;
 static GBool printVersion = gFalse;
 static GBool printHelp = gFalse;
@@ -182,16 +176,16 @@ static const ArgDesc argDesc[] = {
    "enable font anti-aliasing: yes, no"},
   {"-aaVector",   argString,      vectorAntialiasStr, sizeof(vectorAntialiasStr),
    "enable vector anti-aliasing: yes, no"},
+  {"-aaArea",     argString,      areaAntialiasStr, sizeof(areaAntialiasStr),
+   "use exact pixel coverage for vector anti-aliasing: yes, no"},
   
   {"-opw",    argString,   ownerPassword,  sizeof(ownerPassword),
    "owner password (for encrypted files)"},
   {"-upw",    argString,   userPassword,   sizeof(userPassword),
    "user password (for encrypted files)"},
   
-#ifdef UTILS_USE_PTHREADS
   {"-j",      argInt,      &numberOfJobs,  0,
-   "number of jobs to run concurrently"},
-#endif // UTILS_USE_PTHREADS
+   "number of pages to render concurrently"},
 
   {"-q",      argFlag,     &quiet,         0,
    "don't print any messages or errors"},
@@ -208,24 +202,54 @@ static const ArgDesc argDesc[] = {
   {NULL}
 };
 
-static void savePageSlice(PDFDoc *doc,
-                   SplashOutputDev *splashOut, 
-                   int pg, int x, int y, int w, int h, 
-                   double pg_w, double pg_h, 
-                   char *ppmFile) {
-  if (w == 0) w = (int)ceil(pg_w);
-  if (h == 0) h = (int)ceil(pg_h);
-  w = (x+w > pg_w ? (int)ceil(pg_w-x) : w);
-  h = (y+h > pg_h ? (int)ceil(pg_h-y) : h);
+struct PageJob {
+  int pg;
+  double x_res, y_res;
+  int x, y, w, h;
+  char *ppmFile;
+};
+
+struct RenderData {
+  SplashColor paperColor;
+  std::vector<PageJob> jobs;	// indexed by page number
+};
+
+static SplashOutputDev *createOutputDev(PDFDoc *doc, void *data) {
+  RenderData *renderData = (RenderData *)data;
+  SplashOutputDev *splashOut;
+
+  splashOut = new SplashOutputDev(mono ? splashModeMono1 :
+				    gray ? splashModeMono8 :
+#if SPLASH_CMYK
+				    (jpegcmyk || overprint) ? splashModeDeviceN8 :
+#endif
+				             splashModeRGB8, 4,
+				  gFalse, renderData->paperColor, gTrue, thinLineMode);
+  splashOut->setFontAntialias(fontAntialias);
+  splashOut->setVectorAntialias(vectorAntialias);
+  splashOut->setAreaAntialias(areaAntialias);
+  splashOut->startDoc(doc);
+  return splashOut;
+}
+
+static void renderPageSlice(PDFDoc *doc, SplashOutputDev *splashOut,
+			    int pg, void *data) {
+  PageJob *job = &((RenderData *)data)->jobs[pg];
+
   doc->displayPageSlice(splashOut, 
-    pg, x_resolution, y_resolution, 
+    pg, job->x_res, job->y_res, 
     0,
     !useCropBox, gFalse, gFalse,
-    x, y, w, h
+    job->x, job->y, job->w, job->h
   );
+}
+
+static void savePageSlice(int pg, SplashBitmap *bitmap, void *data) {
+  PageJob *job = &((RenderData *)data)->jobs[pg];
+  char *ppmFile = job->ppmFile;
+  double x_resolution = job->x_res;
+  double y_resolution = job->y_res;
 
-  SplashBitmap *bitmap = splashOut->getBitmap();
-  
   if (ppmFile != NULL) {
     if (png) {
       bitmap->writeImgFile(splashFormatPng, ppmFile, x_resolution, y_resolution);
@@ -253,58 +277,10 @@ static void savePageSlice(PDFDoc *doc,
       bitmap->writePNMFile(stdout);
     }
   }
+  delete[] ppmFile;
+  job->ppmFile = NULL;
 }
 
-#ifdef UTILS_USE_PTHREADS
-
-struct PageJob {
-  PDFDoc *doc;
-  int pg;
-  
-  double pg_w, pg_h;
-  SplashColor* paperColor;
-  
-  char *ppmFile;
-};
-
-static std::deque<PageJob> pageJobQueue;
-static pthread_mutex_t pageJobMutex = PTHREAD_MUTEX_INITIALIZER;
-
-static void processPageJobs() {
-  while(true) {
-    // pop the next job or exit if queue is empty
-    pthread_mutex_lock(&pageJobMutex);
-    
-    if(pageJobQueue.empty()) {
-      pthread_mutex_unlock(&pageJobMutex);
-      return;
-    }
-    
-    PageJob pageJob = pageJobQueue.front();
-    pageJobQueue.pop_front();
-    
-    pthread_mutex_unlock(&pageJobMutex);
-    
-    // process the job    
-    SplashOutputDev *splashOut = new SplashOutputDev(mono ? splashModeMono1 :
-                  gray ? splashModeMono8 :
-#if SPLASH_CMYK
-        			    (jpegcmyk || overprint) ? splashModeDeviceN8 :
-#endif
-		              splashModeRGB8, 4, gFalse, *pageJob.paperColor, gTrue, thinLineMode);
-    splashOut->setFontAntialias(fontAntialias);
-    splashOut->setVectorAntialias(vectorAntialias);
-    splashOut->startDoc(pageJob.doc);
-    
-    savePageSlice(pageJob.doc, splashOut, pageJob.pg, x, y, w, h, pageJob.pg_w, pageJob.pg_h, pageJob.ppmFile);
-    
-    delete splashOut;
-    delete[] pageJob.ppmFile;
-  }
-}
-
-#endif // UTILS_USE_PTHREADS
-
 static int numberOfCharacters(unsigned int n)
 {
   int charNum = 0;
@@ -323,12 +299,9 @@ int main(int argc, char *argv[]) {
   char *ppmRoot = NULL;
   char *ppmFile;
   GooString *ownerPW, *userPW;
-  SplashColor paperColor;
-#ifndef UTILS_USE_PTHREADS
-  SplashOutputDev *splashOut;
-#else
-  pthread_t* jobs;
-#endif // UTILS_USE_PTHREADS
+  RenderData renderData;
+  std::vector<int> pages;
+  SplashPageRenderer *renderer;
   GBool ok;
   int exitCode;
   int pg, pg_num_len;
@@ -371,6 +344,11 @@ int main(int argc, char *argv[]) {
       fprintf(stderr, "Bad '-aaVector' value on command line\n");
     }
   }
+  if (areaAntialiasStr[0]) {
+    if (!GlobalParams::parseYesNo2(areaAntialiasStr, &areaAntialias)) {
+      fprintf(stderr, "Bad '-aaArea' value on command line\n");
+    }
+  }
 
   // read config file
   globalParams = new GlobalParams();
@@ -453,35 +431,18 @@ int main(int argc, char *argv[]) {
   if (jpegcmyk || overprint) {
     globalParams->setOverprintPreview(gTrue);
     for (int cp = 0; cp < SPOT_NCOMPS+4; cp++)
-      paperColor[cp] = 0;
+      renderData.paperColor[cp] = 0;
   } else 
 #endif
   {
-    paperColor[0] = 255;
-    paperColor[1] = 255;
-    paperColor[2] = 255;
+    renderData.paperColor[0] = 255;
+    renderData.paperColor[1] = 255;
+    renderData.paperColor[2] = 255;
   }
   
-#ifndef UTILS_USE_PTHREADS
-
-  splashOut = new SplashOutputDev(mono ? splashModeMono1 :
-				    gray ? splashModeMono8 :
-#if SPLASH_CMYK
-				    (jpegcmyk || overprint) ? splashModeDeviceN8 :
-#endif
-				             splashModeRGB8, 4,
-				  gFalse, paperColor, gTrue, thinLineMode);
-
-
-
-  splashOut->setFontAntialias(fontAntialias);
-  splashOut->setVectorAntialias(vectorAntialias);
-  splashOut->startDoc(doc);
-  
-#endif // UTILS_USE_PTHREADS
-  
   if (sz != 0) w = h = sz;
   pg_num_len = numberOfCharacters(doc->getNumPages());
+  renderData.jobs.resize(lastPage + 1);
   for (pg = firstPage; pg <= lastPage; ++pg) {
     if (printOnlyEven && pg % 2 == 0) continue;
     if (printOnlyOdd && pg % 2 == 1) continue;
@@ -527,55 +488,45 @@ int main(int argc, char *argv[]) {
     } else {
       ppmFile = NULL;
     }
-#ifndef UTILS_USE_PTHREADS
-    // process job in main thread
-    savePageSlice(doc, splashOut, pg, x, y, w, h, pg_w, pg_h, ppmFile);
-    
-    delete[] ppmFile;
-#else
-    
-    // queue job for worker threads
-    PageJob pageJob = {
-      .doc = doc,
-      .pg = pg,
-      
-      .pg_w = pg_w, .pg_h = pg_h,
-      
-      .paperColor = &paperColor,
-      
-      .ppmFile = ppmFile
-    };
-    
-    pageJobQueue.push_back(pageJob);
-    
-#endif // UTILS_USE_PTHREADS
+    // the page size and resolution can change from page to page, so
+    // they are computed here and handed to the renderer with the page
+    PageJob *job = &renderData.jobs[pg];
+    job->pg = pg;
+    job->x_res = x_resolution;
+    job->y_res = y_resolution;
+    job->x = x;
+    job->y = y;
+    job->w = (w == 0) ? (int)ceil(pg_w) : w;
+    job->h = (h == 0) ? (int)ceil(pg_h) : h;
+    job->w = (x+job->w > pg_w ? (int)ceil(pg_w-x) : job->w);
+    job->h = (y+job->h > pg_h ? (int)ceil(pg_h-y) : job->h);
+    job->ppmFile = ppmFile;
+    pages.push_back(pg);
   }
-#ifndef UTILS_USE_PTHREADS
-  delete splashOut;
-#else
-  
-  // spawn worker threads and wait on them
-  jobs = (pthread_t*)malloc(numberOfJobs * sizeof(pthread_t));
 
-  for(int i=0; i < numberOfJobs; ++i) {
-    if(pthread_create(&jobs[i], NULL, (void* (*)(void*))processPageJobs, NULL) != 0) {
-	    fprintf(stderr, "pthread_create() failed with errno: %d\n", errno);
-	    exit(EXIT_FAILURE);
-    }
-  }
-  
-  for(int i=0; i < numberOfJobs; ++i) {
-    if(pthread_join(jobs[i], NULL) != 0) {
-      fprintf(stderr, "pthread_join() failed with errno: %d\n", errno);
-      exit(EXIT_FAILURE);
+  exitCode = 0;
+  renderer = new SplashPageRenderer(doc, numberOfJobs);
+  if (pages.size() == 1 && renderer->getNumWorkers() > 1) {
+    // a single page is split into bands rendered in parallel
+    PageJob *job = &renderData.jobs[pages[0]];
+    SplashBitmap *bitmap = renderer->renderBands(job->pg,
+						 job->x_res, job->y_res, 0,
+						 !useCropBox, gFalse, gFalse,
+						 job->x, job->y,
+						 job->w, job->h, minBandHeight,
+						 &createOutputDev, &renderData);
+    if (bitmap) {
+      savePageSlice(job->pg, bitmap, &renderData);
+      delete bitmap;
+    } else {
+      fprintf(stderr, "Couldn't allocate the page bitmap\n");
+      exitCode = 3;
     }
+  } else {
+    renderer->render(pages, &createOutputDev, &renderPageSlice,
+		     &savePageSlice, &renderData);
   }
-
-  free(jobs);
-  
-#endif // UTILS_USE_PTHREADS
-
-  exitCode = 0;
+  delete renderer;
 
   // clean up
  err1: